@@ -22,6 +22,8 @@ constexpr const char* VALUE_USE_LOCAL_MONITOR = "UseLocalMonitor";
 constexpr const char* VALUE_MIN_PLAYOUT_BUFFER = "minPlayoutBuffer";
 constexpr const char* VALUE_MAX_PLAYOUT_BUFFER = "maxPlayoutBuffer";
 constexpr const char* VALUE_USE_FEC = "useFEC";
+constexpr const char* VALUE_INLINE_TRANSMIT = "InlineTransmit";
+constexpr const char* VALUE_DRIFT_COMPENSATION = "DriftCompensation";
 constexpr const char* VALUE_SERVER_NAME = "ServerName";
 constexpr const char* VALUE_SERVER_PORT = "Port";
 constexpr const char* VALUE_USE_LOCALHOST = "UseLocalhost";
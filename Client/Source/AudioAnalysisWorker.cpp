@@ -0,0 +1,121 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "AudioAnalysisWorker.h"
+
+AudioAnalysisWorker::AudioAnalysisWorker()
+	: juce::Thread("JammerNetz analysis")
+{
+	setChannelSetup(JammerNetzChannelSetup(false));
+}
+
+AudioAnalysisWorker::~AudioAnalysisWorker() { shutdown(); }
+
+void AudioAnalysisWorker::start()
+{
+	if (!isThreadRunning()) {
+		startThread(juce::Thread::Priority::low);
+	}
+}
+
+void AudioAnalysisWorker::shutdown()
+{
+	signalThreadShouldExit();
+	wakeup_.wakeUp();
+	stopThread(2000);
+	// The transmit worker stops before it shuts down its analysis.
+	queue_.reset();
+}
+
+void AudioAnalysisWorker::prepare(int channels)
+{
+	slab_.allocate(queue_.slotCount(), channels, MAXIMUM_SAMPLE_BUFFER_SIZE);
+	meterBuffer_.setSize(channels, MAXIMUM_SAMPLE_BUFFER_SIZE);
+}
+
+void AudioAnalysisWorker::setChannelSetup(const JammerNetzChannelSetup& setup)
+{
+	auto shared = std::make_shared<const JammerNetzChannelSetup>(setup);
+	channelSetup_.store(shared, std::memory_order_release);
+	// Send the new setup right away, levels follow with the next analysed block
+	outgoingSetup_.store(shared, std::memory_order_release);
+	for (size_t channel = 0; channel < setup.channels.size(); ++channel) {
+		tuner_.setChannelEnabled(channel, setup.channels[channel].target != Mute);
+	}
+}
+
+void AudioAnalysisWorker::enqueue(const TransmitAudioFrame& frame)
+{
+	if (!isThreadRunning()) {
+		analyse(frame);
+		return;
+	}
+	if (frame.channels > slab_.channels()) {
+		skipped_.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	const bool queued = queue_.tryWrite([this, &frame](TransmitAudioFrame& copy, size_t slot) {
+		copy.channels = frame.channels;
+		copy.numSamples = frame.numSamples;
+		copy.samples = slab_.slot(slot);
+		for (int channel = 0; channel < frame.channels; ++channel) {
+			juce::FloatVectorOperations::copy(copy.channel(channel), frame.channel(channel), frame.numSamples);
+		}
+	});
+	if (!queued) {
+		skipped_.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+std::shared_ptr<const JammerNetzChannelSetup> AudioAnalysisWorker::outgoingSetup() const
+{
+	return outgoingSetup_.load(std::memory_order_acquire);
+}
+
+float AudioAnalysisWorker::channelPitch(size_t channel) const { return tuner_.getPitch(channel); }
+FFAU::LevelMeterSource* AudioAnalysisWorker::meterSource() noexcept { return &meterSource_; }
+uint64_t AudioAnalysisWorker::analysedFrames() const noexcept { return analysed_.load(std::memory_order_relaxed); }
+uint64_t AudioAnalysisWorker::skippedFrames() const noexcept { return skipped_.load(std::memory_order_relaxed); }
+size_t AudioAnalysisWorker::frameBytes() const noexcept { return slab_.bytes(); }
+
+void AudioAnalysisWorker::run()
+{
+	while (!threadShouldExit()) {
+		const bool hadFrame = queue_.tryRead([this](TransmitAudioFrame& frame) { analyse(frame); });
+		if (!hadFrame) {
+			wakeup_.wait([this]() { return threadShouldExit() || queue_.size() > 0; });
+		}
+	}
+}
+
+void AudioAnalysisWorker::analyse(const TransmitAudioFrame& frame)
+{
+	std::array<const float*, JAMMERNETZ_MAX_AUDIO_CHANNELS> pointers {};
+	meterBuffer_.setSize(frame.channels, frame.numSamples, false, false, true);
+	for (int channel = 0; channel < frame.channels; ++channel) {
+		pointers[static_cast<size_t>(channel)] = frame.channel(channel);
+		meterBuffer_.copyFrom(channel, 0, pointers[static_cast<size_t>(channel)], frame.numSamples);
+	}
+	tuner_.detectPitch(pointers.data(), frame.channels, frame.numSamples, frame.sampleRate);
+	meterSource_.measureBlock(meterBuffer_);
+	analysed_.fetch_add(1, std::memory_order_relaxed);
+
+	const auto setup = channelSetup_.load(std::memory_order_acquire);
+	if (!setup || setup->channels.size() != static_cast<size_t>(frame.channels)) {
+		return;
+	}
+	auto outgoing = std::make_shared<JammerNetzChannelSetup>(*setup);
+	for (int channel = 0; channel < frame.channels; ++channel) {
+		auto& details = outgoing->channels[static_cast<size_t>(channel)];
+		details.mag = meterSource_.getMaxLevel(channel);
+		details.rms = meterSource_.getRMSLevel(channel);
+		details.pitch = tuner_.getPitch(static_cast<size_t>(channel));
+	}
+	// A setup change since the load above wins, the next block carries the levels again
+	if (channelSetup_.load(std::memory_order_acquire) == setup) {
+		outgoingSetup_.store(std::move(outgoing), std::memory_order_release);
+	}
+}
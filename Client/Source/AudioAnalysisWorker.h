@@ -0,0 +1,76 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "AtomicSharedPtr.h"
+#include "BoundedSpscQueue.h"
+#include "IncludeFFMeters.h"
+#include "RealtimeAudioFrames.h"
+#include "Tuner.h"
+
+// Meters and tuner of the outgoing audio, behind the send instead of in front of it.
+// The result is published as the channel setup the next packet carries.
+class AudioAnalysisWorker final : private juce::Thread {
+public:
+	AudioAnalysisWorker();
+	~AudioAnalysisWorker() override;
+
+	void start();
+	void shutdown();
+	// Sizes the queued frames for this many channels, call while the worker is shut down
+	void prepare(int channels);
+	void setChannelSetup(const JammerNetzChannelSetup& setup);
+
+	// Called by the transmit worker after sending. While the thread runs this only copies the
+	// audio and never blocks or allocates, without it the frame is analysed right away.
+	void enqueue(const TransmitAudioFrame& frame);
+	// For the inline transmit mode, fill() writes the frame straight into the queue. Returns false
+	// without calling fill() when the thread does not run or the queue is full. The frame has room
+	// for the prepared channels.
+	template <typename Fill>
+	bool enqueueWith(Fill&& fill)
+	{
+		if (!isThreadRunning()) {
+			return false;
+		}
+		const bool queued = queue_.tryWrite([this, &fill](TransmitAudioFrame& frame, size_t slot) {
+			frame.samples = slab_.slot(slot);
+			fill(frame);
+		});
+		if (!queued) {
+			skipped_.fetch_add(1, std::memory_order_relaxed);
+		}
+		return queued;
+	}
+
+	// The channel setup to send, with levels and pitch of the latest analysed block
+	std::shared_ptr<const JammerNetzChannelSetup> outgoingSetup() const;
+	float channelPitch(size_t channel) const;
+	FFAU::LevelMeterSource* meterSource() noexcept;
+
+	uint64_t analysedFrames() const noexcept;
+	uint64_t skippedFrames() const noexcept;
+	// Like prepare(), only while the worker is shut down
+	size_t frameBytes() const noexcept;
+
+private:
+	void run() override;
+	void analyse(const TransmitAudioFrame& frame);
+
+	// The meters only need the latest blocks, about 20 ms
+	static constexpr int queueCapacity = 8;
+	QueueWakeup wakeup_; // Before queue_, which notifies it
+	BoundedSpscQueue<TransmitAudioFrame> queue_ { queueCapacity, &wakeup_ };
+	AudioFrameSlab slab_;
+	AtomicSharedPtr<const JammerNetzChannelSetup> channelSetup_;
+	AtomicSharedPtr<const JammerNetzChannelSetup> outgoingSetup_;
+	juce::AudioBuffer<float> meterBuffer_;
+	Tuner tuner_;
+	FFAU::LevelMeterSource meterSource_;
+	std::atomic<uint64_t> analysed_ { 0 };
+	std::atomic<uint64_t> skipped_ { 0 };
+};
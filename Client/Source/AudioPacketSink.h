@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include "BuffersConfig.h"
 #include "JammerNetzPackage.h"
 
 #include <memory>
@@ -15,6 +16,10 @@ struct ControlData
 {
 	std::optional<float> bpm;
 	std::optional<MidiSignal> midiSignal;
+	int sampleRate { SAMPLE_RATE }; // Of the session the audio was converted to
+	// Local stamps of a frame selected by LatencyTrace, 0.0 when not traced.
+	double captureTimeMs { 0.0 };
+	double enqueueTimeMs { 0.0 };
 };
 
 // Boundary between audio processing and packet construction/transport. The audio
@@ -27,3 +32,18 @@ public:
 		std::shared_ptr<AudioBuffer<float>> audioBuffer,
 		ControlData controllers) = 0;
 };
+
+// Transport for audio packets that are serialized before they reach the network code, used by the
+// inline transmit mode. Both calls come from the transmit path, only nextMessageCounter() from the audio thread.
+class AudioDatagramSink {
+public:
+	static constexpr int maximumBatch = 16;
+
+	virtual ~AudioDatagramSink() = default;
+
+	// Lock-free, shared with AudioPacketSink::sendData() so both paths number one stream
+	virtual uint64 nextMessageCounter() noexcept = 0;
+	// Sends up to maximumBatch datagrams at once and returns how many went out. Every buffer
+	// holds MAXFRAMESIZE bytes and may be encrypted in place.
+	virtual int sendDatagrams(uint8* const* datagrams, const size_t* sizes, int count) = 0;
+};
@@ -6,6 +6,8 @@
 
 #include "AudioReceiveWorker.h"
 
+#include "ClientScheduling.h"
+
 #include <utility>
 
 AudioReceiveWorker::AudioReceiveWorker(JammerNetzSession& session)
@@ -19,25 +21,53 @@ void AudioReceiveWorker::start()
 {
 	if (!isThreadRunning()) {
 		startThread(juce::Thread::Priority::high);
+		ClientScheduling::instance().apply(*this, ClientThreadRole::Receive);
 	}
 }
 
 void AudioReceiveWorker::shutdown()
 {
 	signalThreadShouldExit();
+	wakeup_.wakeUp();
 	stopThread(2000);
 	// The owner stops the audio callback and network receive callback before
 	// shutdown, so neither queue has a producer or consumer at this point.
-	inboundQueue_.reset();
 	outputQueue_.reset();
+	claimedFrames_.store(0, std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(packetQueueMutex_);
 	packetQueue_.reset();
 }
 
-void AudioReceiveWorker::enqueue(std::shared_ptr<JammerNetzAudioData> packet)
+void AudioReceiveWorker::enqueue(const JammerNetzAudioDataView& packet)
+{
+	{
+		std::lock_guard<std::mutex> lock(packetQueueMutex_);
+		if (packetQueue_.push(packet)) {
+			sampleBufferSize_ = packet.numSamples();
+		}
+	}
+	wakeup_.notify();
+}
+
+void AudioReceiveWorker::enqueue(JammerNetzAudioData const& packet)
 {
-	if (packet && !inboundQueue_.tryWrite([&packet](std::shared_ptr<JammerNetzAudioData>& slot) { slot = std::move(packet); })) {
-		inboundOverruns_.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(packetQueueMutex_);
+		if (packetQueue_.push(packet)) {
+			sampleBufferSize_ = packet.audioBuffer()->getNumSamples();
+		}
 	}
+	wakeup_.notify();
+}
+
+const RemoteAudioFrame* AudioReceiveWorker::peekFrame(int index) noexcept
+{
+	return outputQueue_.peek(index);
+}
+
+void AudioReceiveWorker::discardFrames(int count) noexcept
+{
+	outputQueue_.discard(count);
 }
 
 bool AudioReceiveWorker::tryPop(RemoteAudioFrame& frame)
@@ -45,19 +75,35 @@ bool AudioReceiveWorker::tryPop(RemoteAudioFrame& frame)
 	return outputQueue_.tryRead([&frame](RemoteAudioFrame& queued) { frame = queued; });
 }
 
-int AudioReceiveWorker::readyFrames() const noexcept { return outputQueue_.size(); }
+void AudioReceiveWorker::setClaimedFrames(int count) noexcept
+{
+	claimedFrames_.store(count, std::memory_order_relaxed);
+	wakeup_.notify();
+}
+
+int AudioReceiveWorker::readyFrames() const noexcept
+{
+	return std::max(0, outputQueue_.size() - claimedFrames_.load(std::memory_order_relaxed));
+}
 
 void AudioReceiveWorker::setPlayoutRange(uint64_t minimumFrames, uint64_t maximumFrames) noexcept
 {
 	minimumFrames_.store(minimumFrames, std::memory_order_relaxed);
 	maximumFrames_.store(std::max(minimumFrames, maximumFrames), std::memory_order_relaxed);
+	wakeup_.notify();
 }
 
-void AudioReceiveWorker::requestRebuffer() noexcept { rebufferRequested_.store(true, std::memory_order_release); }
+void AudioReceiveWorker::requestRebuffer() noexcept
+{
+	rebufferRequested_.store(true, std::memory_order_release);
+	wakeup_.notify();
+}
 
 uint64_t AudioReceiveWorker::requestReset() noexcept
 {
-	return requestedGeneration_.fetch_add(1, std::memory_order_acq_rel) + 1;
+	const auto generation = requestedGeneration_.fetch_add(1, std::memory_order_acq_rel) + 1;
+	wakeup_.notify();
+	return generation;
 }
 
 uint64_t AudioReceiveWorker::currentGeneration() const noexcept { return requestedGeneration_.load(std::memory_order_acquire); }
@@ -72,21 +118,29 @@ std::optional<float> AudioReceiveWorker::takeServerBpmUpdate() noexcept
 
 uint64_t AudioReceiveWorker::discardedFrames() const noexcept
 {
-	return discarded_.load(std::memory_order_relaxed) + inboundOverruns_.load(std::memory_order_relaxed);
+	return discarded_.load(std::memory_order_relaxed);
 }
 uint64_t AudioReceiveWorker::outputQueueOverruns() const noexcept
 {
-	return inboundOverruns_.load(std::memory_order_relaxed) + outputOverruns_.load(std::memory_order_relaxed);
+	return outputOverruns_.load(std::memory_order_relaxed);
+}
+std::string AudioReceiveWorker::qualityStatement() const
+{
+	std::lock_guard<std::mutex> lock(packetQueueMutex_);
+	return packetQueue_.qualityStatement();
+}
+JammerNetzStreamQualityInfo AudioReceiveWorker::qualityInfo() const
+{
+	std::lock_guard<std::mutex> lock(packetQueueMutex_);
+	return packetQueue_.qualityInfoPackage();
 }
-std::string AudioReceiveWorker::qualityStatement() const { return packetQueue_.qualityStatement(); }
 FFAU::LevelMeterSource* AudioReceiveWorker::meterSource() noexcept { return &sessionMeterSource_; }
 
 void AudioReceiveWorker::run()
 {
 	while (!threadShouldExit()) {
-		if (!processNextFrame()) {
-			juce::Thread::sleep(1);
-		}
+		// Nothing to do until a packet arrives, the callback takes a frame or a request comes in
+		wakeup_.wait([this]() { return threadShouldExit() || processNextFrame(); });
 	}
 }
 
@@ -99,18 +153,34 @@ bool AudioReceiveWorker::processNextPendingFrame()
 }
 
 bool AudioReceiveWorker::processNextFrame()
+{
+	bool prepared = false;
+	{
+		std::lock_guard<std::mutex> lock(packetQueueMutex_);
+		prepared = processPacketQueue();
+	}
+	if (prepared) {
+		updateSessionMeter();
+	}
+	return prepared;
+}
+
+bool AudioReceiveWorker::processPacketQueue()
 {
 	applyResetIfRequested();
-	drainInbound();
 	if (rebufferRequested_.exchange(false, std::memory_order_acq_rel)) {
 		streamStarted_.store(false, std::memory_order_release);
 		recoveringFromOverrun_ = false;
 	}
 
-	const auto minimum = minimumFrames_.load(std::memory_order_relaxed);
-	const auto maximum = maximumFrames_.load(std::memory_order_relaxed);
+	// The playout range counts SAMPLE_BUFFER_SIZE blocks, keep its length in time for the session's block size
+	const auto scaled = [this](const std::atomic<uint64_t>& frames) {
+		return static_cast<uint64_t>(blocksForSampleBufferSize(static_cast<int>(frames.load(std::memory_order_relaxed)), sampleBufferSize_));
+	};
+	const auto minimum = scaled(minimumFrames_);
+	const auto maximum = scaled(maximumFrames_);
 	const auto combinedReadyFrames = [this]() {
-		return static_cast<uint64_t>(outputQueue_.size()) + static_cast<uint64_t>(packetQueue_.size());
+		return static_cast<uint64_t>(readyFrames()) + static_cast<uint64_t>(packetQueue_.size());
 	};
 
 	// The prepared queue is the queue the audio callback actually drains. If
@@ -120,9 +190,8 @@ bool AudioReceiveWorker::processNextFrame()
 		recoveringFromOverrun_ = true;
 	}
 	if (recoveringFromOverrun_) {
-		std::shared_ptr<JammerNetzAudioData> discardedPacket;
 		bool fillIn = false;
-		while (combinedReadyFrames() > minimum && packetQueue_.try_pop(discardedPacket, fillIn)) {
+		while (combinedReadyFrames() > minimum && packetQueue_.tryPop(discardScratch_, fillIn)) {
 			discarded_.fetch_add(1, std::memory_order_relaxed);
 		}
 		if (combinedReadyFrames() <= minimum) {
@@ -136,7 +205,7 @@ bool AudioReceiveWorker::processNextFrame()
 
 	return streamStarted_.load(std::memory_order_acquire)
 		&& !recoveringFromOverrun_
-		&& static_cast<uint64_t>(outputQueue_.size()) < maximum
+		&& static_cast<uint64_t>(readyFrames()) < maximum
 		&& prepareOneFrame();
 }
 
@@ -146,60 +215,34 @@ void AudioReceiveWorker::applyResetIfRequested()
 	if (requested == activeGeneration_.load(std::memory_order_relaxed)) {
 		return;
 	}
-	std::shared_ptr<JammerNetzAudioData> packet;
-	while (inboundQueue_.tryRead([&packet](std::shared_ptr<JammerNetzAudioData>& queued) { packet = std::move(queued); })) {}
 	packetQueue_.reset();
 	streamStarted_.store(false, std::memory_order_release);
 	recoveringFromOverrun_ = false;
 	activeGeneration_.store(requested, std::memory_order_release);
 }
 
-void AudioReceiveWorker::drainInbound()
-{
-	std::shared_ptr<JammerNetzAudioData> packet;
-	while (inboundQueue_.tryRead([&packet](std::shared_ptr<JammerNetzAudioData>& queued) { packet = std::move(queued); })) {
-		packetQueue_.push(std::move(packet));
-	}
-}
-
 bool AudioReceiveWorker::prepareOneFrame()
 {
-	if (outputQueue_.freeSpace() == 0) {
-		return false;
-	}
-	std::shared_ptr<JammerNetzAudioData> packet;
-	bool fillIn = false;
-	if (!packetQueue_.try_pop(packet, fillIn) || !packet || !packet->audioBuffer()) {
+	if (outputQueue_.freeSpace() == 0 || packetQueue_.size() == 0) {
 		return false;
 	}
 
-	const auto audio = packet->audioBuffer();
+	// The packet queue holds the decoded samples, this copies the next packet or its fill-in into the slot the audio callback mixes from
 	const auto generation = activeGeneration_.load(std::memory_order_acquire);
+	float bpm = 0.0f;
 	const bool written = outputQueue_.tryWrite([&](RemoteAudioFrame& frame) {
+		bool fillIn = false;
+		packetQueue_.tryPop(frame, fillIn);
 		frame.generation = generation;
-		frame.sourceTimestamp = packet->timestamp();
-		frame.serverSampleEnd = packet->serverTime();
-		frame.bpm = packet->bpm();
-		frame.midiSignal = packet->midiSignal();
-		for (int channel = 0; channel < 2; ++channel) {
-			auto& destination = frame.samples[static_cast<size_t>(channel)];
-			if (channel < audio->getNumChannels()) {
-				const auto samplesToCopy = std::min(SAMPLE_BUFFER_SIZE, audio->getNumSamples());
-				juce::FloatVectorOperations::copy(destination.data(), audio->getReadPointer(channel), samplesToCopy);
-				juce::FloatVectorOperations::clear(destination.data() + samplesToCopy, SAMPLE_BUFFER_SIZE - samplesToCopy);
-			} else {
-				destination.fill(0.0f);
-			}
-		}
+		bpm = frame.bpm;
 	});
 	if (!written) {
 		outputOverruns_.fetch_add(1, std::memory_order_relaxed);
 		return false;
 	}
 
-	latestServerBpm_.store(packet->bpm(), std::memory_order_relaxed);
+	latestServerBpm_.store(bpm, std::memory_order_relaxed);
 	serverBpmPending_.store(true, std::memory_order_release);
-	updateSessionMeter();
 	return true;
 }
 
@@ -9,9 +9,11 @@
 #include "BoundedSpscQueue.h"
 #include "IncludeFFMeters.h"
 #include "JammerNetzSession.h"
-#include "PacketStreamQueue.h"
+#include "FixedPacketStreamQueue.h"
 #include "RealtimeAudioFrames.h"
 
+#include <mutex>
+
 class AudioReceiveWorker final : private juce::Thread {
 public:
 	explicit AudioReceiveWorker(JammerNetzSession& session);
@@ -19,11 +21,22 @@ public:
 
 	void start();
 	void shutdown();
-	void enqueue(std::shared_ptr<JammerNetzAudioData> packet);
+	// Called by the network receive thread, which decodes straight into the packet queue's slot
+	void enqueue(const JammerNetzAudioDataView& packet);
+	void enqueue(JammerNetzAudioData const& packet);
 	// Process queued input synchronously when the background thread is stopped.
 	// Returns true when one output frame was prepared.
 	bool processNextPendingFrame();
+	// The audio callback mixes the prepared frames straight from the queue. peekFrame(0) is the oldest
+	// ready frame, it stays valid until discardFrames() hands its slot back to this worker.
+	const RemoteAudioFrame* peekFrame(int index) noexcept;
+	void discardFrames(int count) noexcept;
+	// The frames at the front the callback has taken for playout. They still occupy the queue,
+	// but no longer count against the playout range.
+	void setClaimedFrames(int count) noexcept;
+	// Copies the oldest frame out and discards it
 	bool tryPop(RemoteAudioFrame& frame);
+	// Prepared frames not claimed yet
 	int readyFrames() const noexcept;
 
 	void setPlayoutRange(uint64_t minimumFrames, uint64_t maximumFrames) noexcept;
@@ -35,24 +48,31 @@ public:
 	uint64_t discardedFrames() const noexcept;
 	uint64_t outputQueueOverruns() const noexcept;
 	std::string qualityStatement() const;
+	JammerNetzStreamQualityInfo qualityInfo() const;
 	FFAU::LevelMeterSource* meterSource() noexcept;
 
 private:
 	void run() override;
 	bool processNextFrame();
+	bool processPacketQueue();
 	void applyResetIfRequested();
-	void drainInbound();
 	bool prepareOneFrame();
 	void updateSessionMeter();
 
-	// Network bursts are dropped at 512 packets. Prepared PCM waits in a
-	// separate 256-frame queue; the worker pauses instead of blocking audio.
-	static constexpr int inputCapacity = 512;
+	// Packets are reordered in a preallocated ring the receive thread decodes into, a burst longer than
+	// the ring fast forwards it. Prepared PCM waits in a separate 256-frame queue; the worker pauses
+	// instead of blocking audio. Neither allocates per packet.
 	static constexpr int outputCapacity = 256;
 	JammerNetzSession& session_;
-	BoundedSpscQueue<std::shared_ptr<JammerNetzAudioData>> inboundQueue_ { inputCapacity };
-	PacketStreamQueue packetQueue_ { "server" };
-	BoundedSpscQueue<RemoteAudioFrame> outputQueue_ { outputCapacity };
+	// Wakes the worker for new packets, for space freed by the audio callback and for requests.
+	// Declared before the queues, which notify it.
+	QueueWakeup wakeup_;
+	// Held by the receive thread for one decode and by the worker for one frame, the audio callback never takes it
+	mutable std::mutex packetQueueMutex_;
+	FixedPacketStreamQueue packetQueue_ { "server" };
+	RemoteAudioFrame discardScratch_; // Packets skipped to recover from an overrun are popped into this
+	BoundedSpscQueue<RemoteAudioFrame> outputQueue_ { outputCapacity, nullptr, &wakeup_ };
+	std::atomic<int> claimedFrames_ { 0 };
 	FFAU::LevelMeterSource sessionMeterSource_;
 	std::atomic<uint64_t> minimumFrames_ { CLIENT_PLAYOUT_JITTER_BUFFER };
 	std::atomic<uint64_t> maximumFrames_ { CLIENT_PLAYOUT_MAX_BUFFER };
@@ -63,7 +83,7 @@ private:
 	std::atomic<float> latestServerBpm_ { 0.0f };
 	std::atomic<bool> serverBpmPending_ { false };
 	std::atomic<uint64_t> discarded_ { 0 };
-	std::atomic<uint64_t> inboundOverruns_ { 0 };
 	std::atomic<uint64_t> outputOverruns_ { 0 };
 	bool recoveringFromOverrun_ { false };
+	int sampleBufferSize_ { SAMPLE_BUFFER_SIZE }; // Of the latest packet, guarded by packetQueueMutex_
 };
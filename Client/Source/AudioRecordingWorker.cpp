@@ -11,6 +11,8 @@ AudioRecordingWorker::AudioRecordingWorker(std::shared_ptr<Recorder> localRecord
 	, localRecorder_(std::move(localRecorder))
 	, masterRecorder_(std::move(masterRecorder))
 {
+	slab_.allocate(queue_.slotCount(), defaultChannels, defaultSamplesPerChannel);
+	frameBytes_.store(slab_.bytes(), std::memory_order_relaxed);
 }
 
 AudioRecordingWorker::~AudioRecordingWorker() { shutdown(); }
@@ -25,11 +27,28 @@ void AudioRecordingWorker::start()
 void AudioRecordingWorker::shutdown()
 {
 	signalThreadShouldExit();
+	wakeup_.wakeUp();
 	stopThread(2000);
 	// The owning engine stops its audio callback producer before shutdown.
 	queue_.reset();
 }
 
+void AudioRecordingWorker::prepare(int channels, int samplesPerChannel)
+{
+	channels = juce::jlimit(1, JAMMERNETZ_MAX_AUDIO_CHANNELS, channels);
+	samplesPerChannel = juce::jlimit(1, JAMMERNETZ_MAX_CALLBACK_SAMPLES, samplesPerChannel);
+	if (channels == slab_.channels() && samplesPerChannel == slab_.samplesPerChannel()) {
+		return;
+	}
+	const bool running = isThreadRunning();
+	shutdown();
+	slab_.allocate(queue_.slotCount(), channels, samplesPerChannel);
+	frameBytes_.store(slab_.bytes(), std::memory_order_relaxed);
+	if (running) {
+		start();
+	}
+}
+
 bool AudioRecordingWorker::enqueue(RecordingTarget target, const float* const* channels, int numChannels, int numSamples) noexcept
 {
 	const auto& recorder = target == RecordingTarget::local ? localRecorder_ : masterRecorder_;
@@ -37,39 +56,55 @@ bool AudioRecordingWorker::enqueue(RecordingTarget target, const float* const* c
 	if (recordingGeneration == 0) {
 		return true;
 	}
-	if (!channels || numChannels <= 0 || numChannels > JAMMERNETZ_MAX_AUDIO_CHANNELS
-		|| numSamples <= 0 || numSamples > JAMMERNETZ_MAX_CALLBACK_SAMPLES) {
+	if (!channels || numChannels <= 0 || numChannels > slab_.channels() || numSamples <= 0) {
 		dropped_.fetch_add(1, std::memory_order_relaxed);
 		return false;
 	}
-	const bool queued = queue_.tryWrite([&](RecordingAudioFrame& frame) {
-		frame.target = target;
-		frame.recordingGeneration = recordingGeneration;
-		frame.channels = numChannels;
-		frame.samplesPerChannel = numSamples;
-		for (int channel = 0; channel < numChannels; ++channel) {
-			if (channels[channel]) {
-				juce::FloatVectorOperations::copy(frame.samples[static_cast<size_t>(channel)].data(), channels[channel], numSamples);
-			} else {
-				juce::FloatVectorOperations::clear(frame.samples[static_cast<size_t>(channel)].data(), numSamples);
+	auto& pendingLoss = pendingLoss_[static_cast<size_t>(target)];
+	if (pendingLoss.recordingGeneration != recordingGeneration) {
+		// A loss of the previous recording does not belong into this one
+		pendingLoss = { recordingGeneration, 0 };
+	}
+	bool queued = true;
+	for (int offset = 0; offset < numSamples; offset += slab_.samplesPerChannel()) {
+		const int pieceSamples = std::min(slab_.samplesPerChannel(), numSamples - offset);
+		const bool written = queue_.tryWrite([&](RecordingAudioFrame& frame, size_t slot) {
+			frame.target = target;
+			frame.recordingGeneration = recordingGeneration;
+			frame.channels = numChannels;
+			frame.samplesPerChannel = pieceSamples;
+			frame.stride = slab_.samplesPerChannel();
+			frame.lostSamplesBefore = pendingLoss.samples;
+			frame.samples = slab_.slot(slot);
+			for (int channel = 0; channel < numChannels; ++channel) {
+				if (channels[channel]) {
+					juce::FloatVectorOperations::copy(frame.channel(channel), channels[channel] + offset, pieceSamples);
+				} else {
+					juce::FloatVectorOperations::clear(frame.channel(channel), pieceSamples);
+				}
 			}
+		});
+		if (written) {
+			pendingLoss.samples = 0;
+		} else {
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+			pendingLoss.samples += pieceSamples;
+			queued = false;
 		}
-	});
-	if (!queued) {
-		dropped_.fetch_add(1, std::memory_order_relaxed);
 	}
 	return queued;
 }
 
 uint64_t AudioRecordingWorker::writtenFrames() const noexcept { return written_.load(std::memory_order_relaxed); }
 uint64_t AudioRecordingWorker::droppedFrames() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+size_t AudioRecordingWorker::frameBytes() const noexcept { return frameBytes_.load(std::memory_order_relaxed); }
 
 void AudioRecordingWorker::run()
 {
 	while (!threadShouldExit() || queue_.size() > 0) {
 		const bool hadFrame = queue_.tryRead([this](RecordingAudioFrame& frame) { writeFrame(frame); });
 		if (!hadFrame) {
-			juce::Thread::sleep(2);
+			wakeup_.wait([this]() { return threadShouldExit() || queue_.size() > 0; });
 		}
 	}
 }
@@ -80,9 +115,13 @@ void AudioRecordingWorker::writeFrame(RecordingAudioFrame& frame)
 	if (!recorder || frame.recordingGeneration != recorder->recordingGeneration()) {
 		return;
 	}
+	if (frame.lostSamplesBefore > 0) {
+		// Keeps the file in time, the gap gets a dropout marker right where the audio was lost
+		recorder->saveDropout(frame.lostSamplesBefore);
+	}
 	std::array<const float*, JAMMERNETZ_MAX_AUDIO_CHANNELS> pointers {};
 	for (int channel = 0; channel < frame.channels; ++channel) {
-		pointers[static_cast<size_t>(channel)] = frame.samples[static_cast<size_t>(channel)].data();
+		pointers[static_cast<size_t>(channel)] = frame.channel(channel);
 	}
 	recorder->saveBlock(pointers.data(), frame.samplesPerChannel);
 	written_.fetch_add(1, std::memory_order_relaxed);
@@ -10,6 +10,8 @@
 #include "RealtimeAudioFrames.h"
 #include "Recorder.h"
 
+#include <array>
+
 class AudioRecordingWorker final : private juce::Thread {
 public:
 	AudioRecordingWorker(std::shared_ptr<Recorder> localRecorder, std::shared_ptr<Recorder> masterRecorder);
@@ -17,20 +19,38 @@ public:
 
 	void start();
 	void shutdown();
+	// Sizes the queued frames, until then they have room for defaultChannels and defaultSamplesPerChannel.
+	// The audio callback must not run, a running worker writes what is queued and is restarted to resize.
+	void prepare(int channels, int samplesPerChannel);
+	// Blocks longer than the prepared frames are queued in pieces, more channels than prepared are dropped
 	bool enqueue(RecordingTarget target, const float* const* channels, int numChannels, int numSamples) noexcept;
 
 	uint64_t writtenFrames() const noexcept;
 	uint64_t droppedFrames() const noexcept;
+	size_t frameBytes() const noexcept;
 
 private:
 	void run() override;
 	void writeFrame(RecordingAudioFrame& frame);
 
-	// Recording is best-effort: the ninth pending callback block is dropped.
+	// The recorder buffers seconds of audio, this queue only decouples the audio callback.
+	// Should the ninth pending callback block still not fit, it is recorded as a dropout.
 	static constexpr int queueCapacity = 8;
-	BoundedSpscQueue<RecordingAudioFrame> queue_ { queueCapacity };
+	static constexpr int defaultChannels = 2;
+	static constexpr int defaultSamplesPerChannel = 1024;
+	QueueWakeup wakeup_; // Before queue_, which notifies it
+	BoundedSpscQueue<RecordingAudioFrame> queue_ { queueCapacity, &wakeup_ };
+	AudioFrameSlab slab_;
 	std::shared_ptr<Recorder> localRecorder_;
 	std::shared_ptr<Recorder> masterRecorder_;
 	std::atomic<uint64_t> written_ { 0 };
 	std::atomic<uint64_t> dropped_ { 0 };
+	std::atomic<size_t> frameBytes_ { 0 };
+	// Audio callback only. Samples dropped per RecordingTarget since its last queued frame, that frame carries
+	// them so the dropout lands where the audio was lost.
+	struct PendingLoss {
+		uint64_t recordingGeneration { 0 };
+		int samples { 0 };
+	};
+	std::array<PendingLoss, 2> pendingLoss_ {};
 };
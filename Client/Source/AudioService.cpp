@@ -12,6 +12,7 @@
 #include "AudioDeviceDiscovery.h"
 #include "AudioInputPermission.h"
 #include "AudioCorrectness.h"
+#include "SampleRateConverter.h"
 #include "Encryption.h"
 #include "Settings.h"
 
@@ -178,6 +179,16 @@ int AudioService::currentPacketSize()
 	return engine_.currentPacketSize();
 }
 
+int AudioService::networkBlockSize() const
+{
+	return engine_.networkBlockSize();
+}
+
+int AudioService::sessionSampleRate() const
+{
+	return engine_.sessionSampleRate();
+}
+
 int AudioService::safeUdpPayloadSize() const
 {
 	return engine_.safeUdpPayloadSize();
@@ -228,6 +239,8 @@ void AudioService::refreshEngineConfiguration()
 	const auto minimum = static_cast<uint64>(std::max<int64>(1, configuredMinimum));
 	const auto maximum = static_cast<uint64>(std::max<int64>(1, configuredMaximum));
 	engine_.setPlayoutBufferRange(minimum, maximum);
+	engine_.setInlineTransmit(data.getProperty(VALUE_INLINE_TRANSMIT, false));
+	engine_.setDriftCompensation(data.getProperty(VALUE_DRIFT_COMPENSATION, true));
 	engine_.setMasterVolume(static_cast<double>(outputController.getProperty(VALUE_VOLUME, 100.0)) / 100.0);
 	engine_.setMonitorBalance(outputController.getProperty(VALUE_MONITOR_BALANCE, 0.0));
 	engine_.setLocalMonitoring(mixer.getProperty(VALUE_USE_LOCAL_MONITOR, false));
@@ -264,7 +277,7 @@ void AudioService::refreshSessionConfiguration()
 	if (session_.isAvailable()) {
 		session_.updateConfiguration(*configuration);
 	} else {
-		session_.start([this](std::shared_ptr<JammerNetzAudioData> audio) { engine_.enqueueRemoteAudio(std::move(audio)); }, *configuration);
+		session_.start([this](const JammerNetzAudioDataView& audio) { engine_.enqueueRemoteAudio(audio); }, *configuration);
 	}
 	engine_.newServer();
 }
@@ -297,7 +310,7 @@ void AudioService::valueTreePropertyChanged(ValueTree& treeWhosePropertyHasChang
 		refreshChannelSetup(getSetup(Data::instance().get().getChildWithName(VALUE_INPUT_SETUP)));
 	}
 	else if (property == Identifier(VALUE_MIN_PLAYOUT_BUFFER) || property == Identifier(VALUE_MAX_PLAYOUT_BUFFER)
-		|| property == Identifier(VALUE_SERVER_BPM)) {
+		|| property == Identifier(VALUE_SERVER_BPM) || property == Identifier(VALUE_INLINE_TRANSMIT)) {
 		refreshEngineConfiguration();
 	}
 	else if (property == Identifier(VALUE_SERVER_NAME) || property == Identifier(VALUE_SERVER_PORT)
@@ -426,10 +439,14 @@ void AudioService::restartAudio(std::shared_ptr<ChannelSetup> inputSetup, std::s
 				reportAudioStartupFailure("the device reported an invalid sample rate");
 				return;
 			}
-			if (std::abs(actualSampleRate - static_cast<double>(SAMPLE_RATE)) > 0.5) {
-				reportAudioStartupFailure("the device opened at " + String(actualSampleRate) + " Hz instead of " + String(SAMPLE_RATE) + " Hz");
+			// Any other rate is converted to the session's rate by the engine
+			if (!SampleRateConverter::supportsRate(actualSampleRate)) {
+				reportAudioStartupFailure("the device opened at " + String(actualSampleRate) + " Hz, which can't be converted to the session rate");
 				return;
 			}
+			if (std::abs(actualSampleRate - static_cast<double>(SAMPLE_RATE)) > 0.5) {
+				SimpleLogger::instance()->postMessage("Audio device runs at " + String(actualSampleRate) + " Hz, converting to the session rate");
+			}
 
 			const auto inputLatencyInMS = static_cast<double>(audioDevice_->getInputLatencyInSamples()) / actualSampleRate * 1000.0;
 			Data::instance().get().setProperty(VALUE_INPUT_LATENCY, inputLatencyInMS, nullptr);
@@ -54,6 +54,8 @@ public:
 	double currentRTT();
 	std::string currentReceptionQuality() const;
 	int currentPacketSize();
+	int networkBlockSize() const;
+	int sessionSampleRate() const;
 	int safeUdpPayloadSize() const;
 	PathMtuDiscoveryStatus mtuDiscoveryStatus() const;
 
@@ -6,13 +6,20 @@
 
 #include "AudioTransmitWorker.h"
 
+#include "ClientScheduling.h"
+
 #include <utility>
 
 AudioTransmitWorker::AudioTransmitWorker(JammerNetzSession& session,
 	std::shared_ptr<AudioPacketSink> packetSink)
 	: juce::Thread("JammerNetz transmit"), session_(session), packetSink_(std::move(packetSink))
+	, sendBuffer_(std::make_shared<juce::AudioBuffer<float>>())
+	, inlineSender_([this]() { return analysis_.outgoingSetup(); },
+		[this]() -> AudioDatagramSink* {
+			return packetSink_ ? dynamic_cast<AudioDatagramSink*>(packetSink_.get()) : session_.sender();
+		})
 {
-	channelSetup_.store(std::make_shared<const JammerNetzChannelSetup>(false), std::memory_order_release);
+	allocateFrames(defaultChannels);
 }
 
 AudioTransmitWorker::~AudioTransmitWorker()
@@ -23,44 +30,84 @@ AudioTransmitWorker::~AudioTransmitWorker()
 void AudioTransmitWorker::start()
 {
 	if (!isThreadRunning()) {
+		analysis_.start();
+		inlineSender_.start();
 		startThread(juce::Thread::Priority::high);
+		ClientScheduling::instance().apply(*this, ClientThreadRole::Send);
 	}
 }
 
 void AudioTransmitWorker::shutdown()
 {
 	signalThreadShouldExit();
+	wakeup_.wakeUp();
 	stopThread(2000);
+	inlineSender_.shutdown();
+	analysis_.shutdown();
 	// The owning engine stops its audio callback producer before shutdown.
 	queue_.reset();
 }
 
+void AudioTransmitWorker::prepare(int channels)
+{
+	channels = juce::jlimit(1, JAMMERNETZ_MAX_AUDIO_CHANNELS, channels);
+	if (channels == slab_.channels()) {
+		return;
+	}
+	const bool running = isThreadRunning();
+	shutdown();
+	allocateFrames(channels);
+	if (running) {
+		start();
+	}
+}
+
+void AudioTransmitWorker::allocateFrames(int channels)
+{
+	// Room for the largest block size, the session's size can change while frames are queued
+	slab_.allocate(queue_.slotCount(), channels, MAXIMUM_SAMPLE_BUFFER_SIZE);
+	inlineSlab_.allocate(1, channels, MAXIMUM_SAMPLE_BUFFER_SIZE);
+	inlineFrame_.samples = inlineSlab_.slot(0);
+	sendBuffer_->setSize(channels, MAXIMUM_SAMPLE_BUFFER_SIZE);
+	analysis_.prepare(channels);
+	frameBytes_.store(slab_.bytes() + inlineSlab_.bytes() + analysis_.frameBytes(), std::memory_order_relaxed);
+}
+
 void AudioTransmitWorker::setChannelSetup(const JammerNetzChannelSetup& setup)
 {
-	channelSetup_.store(std::make_shared<const JammerNetzChannelSetup>(setup), std::memory_order_release);
+	analysis_.setChannelSetup(setup);
+}
+
+void AudioTransmitWorker::setInlineTransmit(bool enabled) noexcept
+{
+	inlineTransmit_.store(enabled, std::memory_order_relaxed);
+}
+
+bool AudioTransmitWorker::isInlineTransmit() const noexcept
+{
+	return inlineTransmit_.load(std::memory_order_relaxed) && inlineSender_.isRunning();
 }
 
 bool AudioTransmitWorker::hasCapacity() const noexcept
 {
-	return queue_.freeSpace() > 0;
+	// The inline sender counts its own drops
+	return isInlineTransmit() || queue_.freeSpace() > 0;
 }
 
-bool AudioTransmitWorker::enqueueFrom(RingBuffer& source, int channels, std::optional<float> bpm, std::optional<MidiSignal> midiSignal)
+bool AudioTransmitWorker::enqueueFrom(RingBuffer& source, int channels, int numSamples, int sampleRate, std::optional<float> bpm,
+	std::optional<MidiSignal> midiSignal, double captureTimeMs)
 {
-	if (channels <= 0 || channels > JAMMERNETZ_MAX_AUDIO_CHANNELS) {
+	if (channels <= 0 || channels > slab_.channels() || numSamples <= 0 || numSamples > MAXIMUM_SAMPLE_BUFFER_SIZE) {
 		recordDroppedFrame();
 		return false;
 	}
+	if (isInlineTransmit()) {
+		return sendInline(source, channels, numSamples, sampleRate, bpm, midiSignal, captureTimeMs);
+	}
 
-	const bool written = queue_.tryWrite([&](TransmitAudioFrame& frame) {
-		frame.channels = channels;
-		frame.bpm = bpm;
-		frame.midiSignal = midiSignal;
-		std::array<float*, JAMMERNETZ_MAX_AUDIO_CHANNELS> pointers {};
-		for (int channel = 0; channel < channels; ++channel) {
-			pointers[static_cast<size_t>(channel)] = frame.samples[static_cast<size_t>(channel)].data();
-		}
-		source.read(pointers.data(), channels, SAMPLE_BUFFER_SIZE);
+	const bool written = queue_.tryWrite([&](TransmitAudioFrame& frame, size_t slot) {
+		frame.samples = slab_.slot(slot);
+		readFrame(frame, source, channels, numSamples, sampleRate, bpm, midiSignal, captureTimeMs);
 	});
 
 	if (written) {
@@ -71,22 +118,61 @@ bool AudioTransmitWorker::enqueueFrom(RingBuffer& source, int channels, std::opt
 	return written;
 }
 
+bool AudioTransmitWorker::sendInline(RingBuffer& source, int channels, int numSamples, int sampleRate, std::optional<float> bpm,
+	std::optional<MidiSignal> midiSignal, double captureTimeMs)
+{
+	// The frame the analysis reads is the frame that is serialized, there is no copy just for sending
+	auto readAndSend = [&](TransmitAudioFrame& frame) {
+		readFrame(frame, source, channels, numSamples, sampleRate, bpm, midiSignal, captureTimeMs);
+		inlineSender_.send(frame);
+	};
+	if (!analysis_.enqueueWith(readAndSend)) {
+		readAndSend(inlineFrame_);
+	}
+	enqueued_.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void AudioTransmitWorker::readFrame(TransmitAudioFrame& frame, RingBuffer& source, int channels, int numSamples,
+	std::optional<float> bpm, std::optional<MidiSignal> midiSignal, double captureTimeMs)
+{
+	frame.channels = channels;
+	frame.numSamples = numSamples;
+	frame.sampleRate = sampleRate;
+	frame.bpm = bpm;
+	frame.midiSignal = midiSignal;
+	std::array<float*, JAMMERNETZ_MAX_AUDIO_CHANNELS> pointers {};
+	for (int channel = 0; channel < channels; ++channel) {
+		pointers[static_cast<size_t>(channel)] = frame.channel(channel);
+	}
+	source.read(pointers.data(), channels, numSamples);
+	frame.captureTimeMs = captureTimeMs;
+	frame.enqueueTimeMs = captureTimeMs > 0.0 ? juce::Time::getMillisecondCounterHiRes() : 0.0;
+}
+
 void AudioTransmitWorker::recordDroppedFrame() noexcept
 {
 	dropped_.fetch_add(1, std::memory_order_relaxed);
 }
 
 uint64_t AudioTransmitWorker::enqueuedFrames() const noexcept { return enqueued_.load(std::memory_order_relaxed); }
-uint64_t AudioTransmitWorker::sentFrames() const noexcept { return sent_.load(std::memory_order_relaxed); }
-uint64_t AudioTransmitWorker::droppedFrames() const noexcept { return dropped_.load(std::memory_order_relaxed); }
-float AudioTransmitWorker::channelPitch(size_t channel) const { return tuner_.getPitch(channel); }
-FFAU::LevelMeterSource* AudioTransmitWorker::meterSource() noexcept { return &meterSource_; }
+uint64_t AudioTransmitWorker::sentFrames() const noexcept
+{
+	return sent_.load(std::memory_order_relaxed) + inlineSender_.sentDatagrams();
+}
+uint64_t AudioTransmitWorker::droppedFrames() const noexcept
+{
+	return dropped_.load(std::memory_order_relaxed) + inlineSender_.droppedDatagrams();
+}
+size_t AudioTransmitWorker::frameBytes() const noexcept { return frameBytes_.load(std::memory_order_relaxed); }
+float AudioTransmitWorker::channelPitch(size_t channel) const { return analysis_.channelPitch(channel); }
+FFAU::LevelMeterSource* AudioTransmitWorker::meterSource() noexcept { return analysis_.meterSource(); }
 
 void AudioTransmitWorker::run()
 {
 	while (!threadShouldExit()) {
 		if (!processNextFrame()) {
-			juce::Thread::sleep(1);
+			wakeup_.wait([this]() { return threadShouldExit() || queue_.size() > 0; });
 		}
 	}
 }
@@ -106,34 +192,27 @@ bool AudioTransmitWorker::processNextFrame()
 
 void AudioTransmitWorker::processFrame(TransmitAudioFrame& frame)
 {
-	std::array<float*, JAMMERNETZ_MAX_AUDIO_CHANNELS> pointers {};
-	for (int channel = 0; channel < frame.channels; ++channel) {
-		pointers[static_cast<size_t>(channel)] = frame.samples[static_cast<size_t>(channel)].data();
-	}
-	auto audio = std::make_shared<juce::AudioBuffer<float>>(pointers.data(), frame.channels, SAMPLE_BUFFER_SIZE);
-	tuner_.detectPitch(audio);
-	meterSource_.measureBlock(*audio);
-
-	const auto setup = channelSetup_.load(std::memory_order_acquire);
+	// Nothing but the send happens before the packet is out. The setup already carries
+	// the levels and pitch of the previous blocks, analysing this one comes after.
+	const auto setup = analysis_.outgoingSetup();
+	auto* packetSink = packetSink_ ? packetSink_.get() : session_.sender();
 	if (!setup || setup->channels.size() != static_cast<size_t>(frame.channels)) {
 		recordDroppedFrame();
-		return;
-	}
-	JammerNetzChannelSetup outgoing = *setup;
-	for (int channel = 0; channel < frame.channels; ++channel) {
-		auto& details = outgoing.channels[static_cast<size_t>(channel)];
-		details.mag = meterSource_.getMaxLevel(channel);
-		details.rms = meterSource_.getRMSLevel(channel);
-		details.pitch = tuner_.getPitch(static_cast<size_t>(channel));
 	}
-
-	auto* packetSink = packetSink_ ? packetSink_.get() : session_.sender();
-	if (packetSink) {
+	else if (packetSink) {
+		sendBuffer_->setSize(frame.channels, frame.numSamples, false, false, true);
+		for (int channel = 0; channel < frame.channels; ++channel) {
+			sendBuffer_->copyFrom(channel, 0, frame.channel(channel), frame.numSamples);
+		}
 		ControlData controls;
 		controls.bpm = frame.bpm;
 		controls.midiSignal = frame.midiSignal;
-		if (packetSink->sendData(outgoing, audio, controls)) {
+		controls.sampleRate = frame.sampleRate;
+		controls.captureTimeMs = frame.captureTimeMs;
+		controls.enqueueTimeMs = frame.enqueueTimeMs;
+		if (packetSink->sendData(*setup, sendBuffer_, controls)) {
 			sent_.fetch_add(1, std::memory_order_relaxed);
 		}
 	}
+	analysis_.enqueue(frame);
 }
@@ -6,14 +6,13 @@
 
 #pragma once
 
-#include "AtomicSharedPtr.h"
+#include "AudioAnalysisWorker.h"
 #include "AudioPacketSink.h"
 #include "BoundedSpscQueue.h"
-#include "IncludeFFMeters.h"
+#include "InlineAudioSender.h"
 #include "JammerNetzSession.h"
 #include "RealtimeAudioFrames.h"
 #include "RingBuffer.h"
-#include "Tuner.h"
 
 class AudioTransmitWorker final : private juce::Thread {
 public:
@@ -23,10 +22,20 @@ public:
 
 	void start();
 	void shutdown();
+	// Sizes the queued frames for the channels sent, until then there is room for defaultChannels.
+	// The audio callback must not run, a running worker is restarted to resize.
+	void prepare(int channels);
 	void setChannelSetup(const JammerNetzChannelSetup& setup);
+	// Serialize in the audio callback and send from a dedicated thread instead of going through
+	// this worker. Takes effect while the worker runs, the analysis still follows the send.
+	void setInlineTransmit(bool enabled) noexcept;
+	bool isInlineTransmit() const noexcept;
 
 	bool hasCapacity() const noexcept;
-	bool enqueueFrom(RingBuffer& source, int channels, std::optional<float> bpm, std::optional<MidiSignal> midiSignal);
+	// Frames with more channels than prepared or more than MAXIMUM_SAMPLE_BUFFER_SIZE samples are dropped.
+	// captureTimeMs is non-zero only while LatencyTrace is enabled.
+	bool enqueueFrom(RingBuffer& source, int channels, int numSamples, int sampleRate, std::optional<float> bpm,
+		std::optional<MidiSignal> midiSignal, double captureTimeMs = 0.0);
 	// Process one queued frame synchronously when the background thread is stopped.
 	bool processNextPendingFrame();
 	void recordDroppedFrame() noexcept;
@@ -34,23 +43,38 @@ public:
 	uint64_t enqueuedFrames() const noexcept;
 	uint64_t sentFrames() const noexcept;
 	uint64_t droppedFrames() const noexcept;
+	size_t frameBytes() const noexcept;
 	float channelPitch(size_t channel) const;
 	FFAU::LevelMeterSource* meterSource() noexcept;
 
 private:
 	void run() override;
+	void allocateFrames(int channels);
 	bool processNextFrame();
 	void processFrame(TransmitAudioFrame& frame);
+	bool sendInline(RingBuffer& source, int channels, int numSamples, int sampleRate, std::optional<float> bpm,
+		std::optional<MidiSignal> midiSignal, double captureTimeMs);
+	static void readFrame(TransmitAudioFrame& frame, RingBuffer& source, int channels, int numSamples,
+		std::optional<float> bpm, std::optional<MidiSignal> midiSignal, double captureTimeMs);
 
 	// About 170 ms at 48 kHz. New frames are dropped when the worker stalls.
 	static constexpr int queueCapacity = 64;
+	static constexpr int defaultChannels = 2;
 	JammerNetzSession& session_;
 	std::shared_ptr<AudioPacketSink> packetSink_;
-	BoundedSpscQueue<TransmitAudioFrame> queue_ { queueCapacity };
-	AtomicSharedPtr<const JammerNetzChannelSetup> channelSetup_;
-	Tuner tuner_;
-	FFAU::LevelMeterSource meterSource_;
+	QueueWakeup wakeup_; // Before queue_, which notifies it
+	BoundedSpscQueue<TransmitAudioFrame> queue_ { queueCapacity, &wakeup_ };
+	AudioFrameSlab slab_;
+	// Handed to the sink for every packet, sized once so sending never allocates here
+	std::shared_ptr<juce::AudioBuffer<float>> sendBuffer_;
+	AudioAnalysisWorker analysis_;
+	InlineAudioSender inlineSender_;
+	std::atomic<bool> inlineTransmit_ { false };
+	// Used by the inline mode when the analysis queue is full
+	TransmitAudioFrame inlineFrame_;
+	AudioFrameSlab inlineSlab_;
 	std::atomic<uint64_t> enqueued_ { 0 };
 	std::atomic<uint64_t> sent_ { 0 };
 	std::atomic<uint64_t> dropped_ { 0 };
+	std::atomic<size_t> frameBytes_ { 0 };
 };
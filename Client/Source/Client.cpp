@@ -7,6 +7,8 @@
 #include "Client.h"
 
 #include "JammerNetzPackage.h"
+#include "LatencyTrace.h"
+#include "NetworkImpairment.h"
 #include "ServerInfo.h"
 #include "StreamLogger.h"
 
@@ -14,6 +16,8 @@
 #include "XPlatformUtils.h"
 
 #include <algorithm>
+#include <array>
+#include <cerrno>
 
 #if JUCE_WINDOWS
 #ifndef NOMINMAX
@@ -22,8 +26,10 @@
 #include <winsock2.h>
 #include <ws2ipdef.h>
 #elif JUCE_LINUX || JUCE_MAC
+#include <netdb.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #endif
 
 Client::Client(DatagramSocket& socket) : socket_(socket), messageCounter_(10) /* TODO - because of the pre-fill on server side, can't be 0 */
@@ -65,7 +71,7 @@ void Client::setCryptoKey(const void* keyData, int keyBytes)
 
 bool Client::sendData(String const &remoteHostname, int remotePort, void *data, int numbytes) {
 	// Writing will block until the socket is ready to write
-	auto bytesWritten = socket_.write(remoteHostname, remotePort, data, numbytes);
+	auto bytesWritten = NetworkImpairment::instance().write(socket_, remoteHostname, remotePort, data, numbytes);
 	if (bytesWritten == -1 || bytesWritten != numbytes) {
 		// This is bad - when could this happen?
 		// Well, for once, if the remoteHostname is empty or incorrect
@@ -88,10 +94,9 @@ bool Client::sendData(JammerNetzChannelSetup const& channelSetup, std::shared_pt
     }
 
     // Create a message
-    JammerNetzAudioData audioMessage(messageCounter_, Time::getMillisecondCounterHiRes(), channelSetup, SAMPLE_RATE,
+    JammerNetzAudioData audioMessage(nextMessageCounter(), Time::getMillisecondCounterHiRes(), channelSetup, controllers.sampleRate,
                                      controllers.bpm, toSend, audioBuffer, fecBlock);
 
-    messageCounter_++;
     size_t totalBytes;
     audioMessage.serialize(sendBuffer_, totalBytes);
 
@@ -99,31 +104,160 @@ bool Client::sendData(JammerNetzChannelSetup const& channelSetup, std::shared_pt
     std::shared_ptr<AudioBlock> redundencyData = std::make_shared<AudioBlock>();
     redundencyData->messageCounter = audioMessage.messageCounter();
     redundencyData->timestamp = audioMessage.timestamp();
+    redundencyData->sampleRate = controllers.sampleRate;
     redundencyData->channelSetup = channelSetup;
     redundencyData->audioBuffer = std::make_shared<AudioBuffer<float>>();
     *redundencyData->audioBuffer = *audioBuffer; // Deep copy
     fecBuffer_.push(redundencyData);
 	const bool sent = sendBufferToServer(totalBytes);
+	auto& latencyTrace = LatencyTrace::instance();
+	if (latencyTrace.isSampled(audioMessage.messageCounter()) && controllers.captureTimeMs > 0.0) {
+		latencyTrace.stampAt(0, audioMessage.messageCounter(), LatencyStage::Capture, controllers.captureTimeMs, audioBuffer->getNumSamples());
+		latencyTrace.stampAt(0, audioMessage.messageCounter(), LatencyStage::TransmitEnqueue, controllers.enqueueTimeMs);
+		latencyTrace.stamp(0, audioMessage.messageCounter(), LatencyStage::Send);
+	}
 	maybeSendMtuProbe();
 	return sent;
 }
 
-bool Client::sendBufferToServer(size_t totalBytes)
+uint64 Client::nextMessageCounter() noexcept
 {
-	// Send off to server
+	return messageCounter_.fetch_add(1, std::memory_order_relaxed);
+}
+
+int Client::sendDatagrams(uint8* const* datagrams, const size_t* sizes, int count)
+{
+	count = (std::min)(count, maximumBatch);
+	if (count <= 0) {
+		return 0;
+	}
+	std::array<int, maximumBatch> wireSizes {};
+	{
+		ScopedLock blowfishLock(blowFishLock_);
+		for (int i = 0; i < count; ++i) {
+			if (blowFish_) {
+				wireSizes[static_cast<size_t>(i)] = blowFish_->encrypt(datagrams[i], sizes[i], MAXFRAMESIZE);
+				if (wireSizes[static_cast<size_t>(i)] == -1) {
+					std::cerr << "Fatal: Couldn't encrypt package, not sending to server!" << std::endl;
+					return 0;
+				}
+			}
+			else if (sizet_is_safe_as_int(sizes[i])) {
+				wireSizes[static_cast<size_t>(i)] = static_cast<int>(sizes[i]);
+			}
+			else {
+				return 0;
+			}
+		}
+	}
+	currentBlockSize_ = wireSizes[static_cast<size_t>(count - 1)];
+
 	String servername;
 	int serverPort;
-	bool useLocalhost;
+	currentServer(servername, serverPort);
+	int sent = 0;
+	if (!sendDatagramBatch(servername, serverPort, datagrams, wireSizes.data(), count, sent)) {
+		// One at a time through the impairment shim, or where there is no sendmmsg
+		for (int i = sent; i < count; ++i) {
+			if (sendData(servername, serverPort, datagrams[i], wireSizes[static_cast<size_t>(i)])) {
+				sent++;
+			}
+		}
+	}
 	{
-		ScopedLock lock(serverLock_);
-		servername = serverName_;
-		serverPort = serverPort_.load(std::memory_order_relaxed);
-		useLocalhost = useLocalhost_.load(std::memory_order_relaxed);
+		// The probe is serialized into sendBuffer_
+		ScopedLock lockSocket(socketLock_);
+		maybeSendMtuProbe();
+	}
+	return sent;
+}
+
+bool Client::sendDatagramBatch(String const &serverName, int serverPort, uint8* const* datagrams, const int* sizes, int count, int &outSent)
+{
+	outSent = 0;
+#if JUCE_LINUX
+	if (NetworkImpairment::instance().isEnabled()) {
+		return false;
+	}
+	// juce::DatagramSocket looks the host up for every write, resolve it only when the server changes
+	if (serverName != resolvedServerName_ || serverPort != resolvedServerPort_) {
+		resolvedServerName_ = serverName;
+		resolvedServerPort_ = serverPort;
+		resolvedAddress_.clear();
+		// Any family the name resolves to, but the first address our socket can actually send to
+		int socketFamily = AF_UNSPEC;
+		socklen_t familySize = sizeof(socketFamily);
+		getsockopt(socket_.getRawSocketHandle(), SOL_SOCKET, SO_DOMAIN, &socketFamily, &familySize);
+		addrinfo hints {};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_DGRAM;
+		addrinfo* info = nullptr;
+		if (getaddrinfo(serverName.toRawUTF8(), String(serverPort).toRawUTF8(), &hints, &info) == 0) {
+			for (const addrinfo* candidate = info; candidate != nullptr; candidate = candidate->ai_next) {
+				if (candidate->ai_family == socketFamily) {
+					const auto* address = reinterpret_cast<const uint8*>(candidate->ai_addr);
+					resolvedAddress_.assign(address, address + candidate->ai_addrlen);
+					break;
+				}
+			}
+		}
+		if (info != nullptr) {
+			freeaddrinfo(info);
+		}
+	}
+	if (resolvedAddress_.empty()) {
+		return false;
 	}
 
-	if (useLocalhost) {
-		servername = "127.0.0.1";
+	std::array<iovec, maximumBatch> buffers {};
+	std::array<mmsghdr, maximumBatch> messages {};
+	for (size_t i = 0; i < static_cast<size_t>(count); ++i) {
+		buffers[i].iov_base = datagrams[i];
+		buffers[i].iov_len = static_cast<size_t>(sizes[i]);
+		messages[i].msg_hdr.msg_name = resolvedAddress_.data();
+		messages[i].msg_hdr.msg_namelen = static_cast<socklen_t>(resolvedAddress_.size());
+		messages[i].msg_hdr.msg_iov = &buffers[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
 	}
+	int next = 0;
+	while (next < count) {
+		const int result = ::sendmmsg(socket_.getRawSocketHandle(), messages.data() + next, static_cast<unsigned int>(count - next), 0);
+		if (result > 0) {
+			next += result;
+			outSent += result;
+		}
+		else if (result < 0 && errno == EINTR) {
+			continue;
+		}
+		else if (result == 0 || errno == EAGAIN || errno == EWOULDBLOCK) {
+			// Socket buffer full, the rest of this batch is lost like any other late packet
+			break;
+		}
+		else {
+			// Only this datagram failed, e.g. a pending ICMP error of an earlier one, carry on with the next
+			++next;
+		}
+	}
+	return true;
+#else
+	juce::ignoreUnused(serverName, serverPort, datagrams, sizes, count);
+	return false;
+#endif
+}
+
+void Client::currentServer(String &serverName, int &serverPort) const
+{
+	ScopedLock lock(serverLock_);
+	serverName = useLocalhost_.load(std::memory_order_relaxed) ? String("127.0.0.1") : serverName_;
+	serverPort = serverPort_.load(std::memory_order_relaxed);
+}
+
+bool Client::sendBufferToServer(size_t totalBytes)
+{
+	// Send off to server
+	String servername;
+	int serverPort;
+	currentServer(servername, serverPort);
 
 	{
 		ScopedLock blowfishLock(blowFishLock_);
@@ -254,16 +388,7 @@ bool Client::sendMtuProbe(const PathMtuProbe& probe)
 
 		String serverName;
 		int serverPort;
-		bool useLocalhost;
-		{
-			const ScopedLock serverLock(serverLock_);
-			serverName = serverName_;
-			serverPort = serverPort_.load(std::memory_order_relaxed);
-			useLocalhost = useLocalhost_.load(std::memory_order_relaxed);
-		}
-		if (useLocalhost) {
-			serverName = "127.0.0.1";
-		}
+		currentServer(serverName, serverPort);
 		return sendData(serverName, serverPort, sendBuffer_, wireBytes);
 	}
 	return false;
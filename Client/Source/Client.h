@@ -15,7 +15,7 @@
 #include "PathMtuDiscovery.h"
 #include "nlohmann/json.hpp"
 
-class Client : public AudioPacketSink {
+class Client : public AudioPacketSink, public AudioDatagramSink {
 public:
 	Client(DatagramSocket& socket);
 	~Client() override;
@@ -23,6 +23,8 @@ public:
 	bool sendData(JammerNetzChannelSetup const& channelSetup,
 		std::shared_ptr<AudioBuffer<float>> audioBuffer,
 		ControlData controllers) override;
+	uint64 nextMessageCounter() noexcept override;
+	int sendDatagrams(uint8* const* datagrams, const size_t* sizes, int count) override;
 	bool sendControl(nlohmann::json &json);
 	void setServer(const juce::String& serverName, int serverPort, bool useLocalhost);
 	void setUseFEC(bool enabled);
@@ -38,17 +40,19 @@ public:
 private:
 	bool sendData(String const &remoteHostname, int remotePort, void *data, int numbytes);
     bool sendBufferToServer(size_t totalBytes);
+	void currentServer(String &serverName, int &serverPort) const;
+	bool sendDatagramBatch(String const &serverName, int serverPort, uint8* const* datagrams, const int* sizes, int count, int &outSent);
 	void maybeSendMtuProbe();
 	bool sendMtuProbe(const PathMtuProbe& probe);
 	bool enableDoNotFragment();
 
 	DatagramSocket &socket_;
-	uint64 messageCounter_;
+	std::atomic<uint64> messageCounter_;
 	uint8 sendBuffer_[65536];
 	std::atomic_int currentBlockSize_;
 	std::atomic<bool> useFEC_;
 	juce::CriticalSection socketLock_;
-	juce::CriticalSection serverLock_;
+	mutable juce::CriticalSection serverLock_;
 	String serverName_;
 	std::atomic<int> serverPort_;
 	std::atomic<bool> useLocalhost_;
@@ -58,4 +62,11 @@ private:
 	std::unique_ptr<BlowFish> blowFish_;
 	mutable juce::CriticalSection mtuDiscoveryLock_;
 	PathMtuDiscovery mtuDiscovery_;
+
+#if JUCE_LINUX
+	// Only used by sendDatagrams(), which is called from one thread
+	String resolvedServerName_;
+	int resolvedServerPort_ { 0 };
+	std::vector<uint8> resolvedAddress_; // sockaddr of the server, empty when it could not be resolved
+#endif
 };
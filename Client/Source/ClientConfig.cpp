@@ -23,12 +23,18 @@ ClientConfigurator::ClientConfigurator()
 	maxLength_.setTextBoxStyle(Slider::TextBoxRight, true, 50, 30);
 	maxLength_.setRange(Range<double>(1.0, 80.0), 1.0);
 	useFEC_.setButtonText("Heal");
+	inlineTransmit_.setButtonText("Send inline");
+	inlineTransmit_.setTooltip("Send straight from the audio callback, for small device buffers");
+	driftCompensation_.setButtonText("Follow clock");
+	driftCompensation_.setTooltip("Resample to the server's clock, so the buffers keep their length in long sessions");
 
 	addAndMakeVisible(bufferLabel_);
 	addAndMakeVisible(bufferLength_);
 	addAndMakeVisible(maxLabel_);
 	addAndMakeVisible(maxLength_);
 	addAndMakeVisible(useFEC_);
+	addAndMakeVisible(inlineTransmit_);
+	addAndMakeVisible(driftCompensation_);
 
 	bindControls();
 }
@@ -42,7 +48,10 @@ void ClientConfigurator::resized()
 	bufferLength_.setBounds(row1.removeFromLeft(kSliderWithBoxWidth));
 	auto row2 = area.removeFromTop(kLineSpacing).withTrimmedTop(kNormalInset);
 	maxLabel_.setBounds(row2.removeFromLeft(kLabelWidth));
+	inlineTransmit_.setBounds(row2.removeFromRight(kLabelWidth));
 	maxLength_.setBounds(row2.removeFromLeft(kSliderWithBoxWidth));
+	auto row3 = area.removeFromTop(kLineSpacing).withTrimmedTop(kNormalInset);
+	driftCompensation_.setBounds(row3.removeFromRight(kLabelWidth));
 }
 
 void ClientConfigurator::bindControls()
@@ -57,7 +66,15 @@ void ClientConfigurator::bindControls()
 	if (!data.hasProperty(VALUE_USE_FEC)) {
 		data.setProperty(VALUE_USE_FEC, false, nullptr);
 	}
+	if (!data.hasProperty(VALUE_INLINE_TRANSMIT)) {
+		data.setProperty(VALUE_INLINE_TRANSMIT, false, nullptr);
+	}
+	if (!data.hasProperty(VALUE_DRIFT_COMPENSATION)) {
+		data.setProperty(VALUE_DRIFT_COMPENSATION, true, nullptr);
+	}
 	bufferLength_.getValueObject().referTo(data.getPropertyAsValue(VALUE_MIN_PLAYOUT_BUFFER, nullptr));
 	maxLength_.getValueObject().referTo(data.getPropertyAsValue(VALUE_MAX_PLAYOUT_BUFFER, nullptr));
 	useFEC_.getToggleStateValue().referTo(data.getPropertyAsValue(VALUE_USE_FEC, nullptr));
+	inlineTransmit_.getToggleStateValue().referTo(data.getPropertyAsValue(VALUE_INLINE_TRANSMIT, nullptr));
+	driftCompensation_.getToggleStateValue().referTo(data.getPropertyAsValue(VALUE_DRIFT_COMPENSATION, nullptr));
 }
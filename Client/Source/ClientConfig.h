@@ -22,4 +22,6 @@ private:
 	Label maxLabel_;
 	Slider maxLength_;
 	ToggleButton useFEC_;
+	ToggleButton inlineTransmit_;
+	ToggleButton driftCompensation_;
 };
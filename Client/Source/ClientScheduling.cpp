@@ -0,0 +1,30 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "ClientScheduling.h"
+
+ClientScheduling& ClientScheduling::instance()
+{
+	static ClientScheduling scheduling;
+	return scheduling;
+}
+
+void ClientScheduling::configure(const ThreadSchedulingConfig& receive, const ThreadSchedulingConfig& send)
+{
+	receive_ = receive;
+	send_ = send;
+}
+
+void ClientScheduling::apply(juce::Thread& thread, ClientThreadRole role) const
+{
+	const auto& config = role == ClientThreadRole::Receive ? receive_ : send_;
+	if (config.isDefault()) {
+		return;
+	}
+	// A missing capability only shows here, so say what the thread was actually granted
+	const auto result = applyThreadScheduling(thread.getThreadId(), config);
+	juce::Logger::writeToLog(thread.getThreadName() + " " + juce::String(result.description));
+}
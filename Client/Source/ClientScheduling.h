@@ -0,0 +1,29 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "ThreadScheduling.h"
+
+enum class ClientThreadRole : uint8_t {
+	Receive, // Network receive and the preparation of received audio
+	Send // Transmit worker and inline sender
+};
+
+// Scheduling of the client's network and audio worker threads, set from the command line before the audio
+// service starts. The workers apply it every time they (re)start their thread.
+class ClientScheduling {
+public:
+	static ClientScheduling& instance();
+
+	void configure(const ThreadSchedulingConfig& receive, const ThreadSchedulingConfig& send);
+	// Leaves the JUCE priority of the thread alone unless a scheduling was configured for its role
+	void apply(juce::Thread& thread, ClientThreadRole role) const;
+
+private:
+	ThreadSchedulingConfig receive_;
+	ThreadSchedulingConfig send_;
+};
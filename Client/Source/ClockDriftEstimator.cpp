@@ -0,0 +1,132 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "ClockDriftEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Before the first packets we only know the clocks are quartz
+constexpr double initialDriftDeviation = 200.0e-6;
+// Temperature moves a quartz by about a ppm in ten minutes, as a random walk per sample
+constexpr double driftWalkPerSample = 1.0e-6 * 1.0e-6 / (600.0 * 48000.0);
+// The earliest packets still jitter by the callback granularity of the device
+constexpr double minimumNoise = 32.0 * 32.0;
+constexpr double initialNoise = 128.0 * 128.0;
+constexpr double noiseSmoothing = 0.01;
+// Innovations beyond five standard deviations are late packets or a jump of the server time
+constexpr double outlierVariances = 25.0;
+constexpr int observationsBeforeGating = 8;
+constexpr int outliersBeforeRestart = 32;
+constexpr uint64_t observationsBeforeLock = 32;
+
+} // namespace
+
+ClockDriftEstimator::ClockDriftEstimator()
+{
+	reset();
+}
+
+void ClockDriftEstimator::reset() noexcept
+{
+	offset_ = 0.0;
+	drift_ = 0.0;
+	p00_ = 0.0;
+	p01_ = 0.0;
+	p11_ = 0.0;
+	noise_ = initialNoise;
+	lastLocal_ = 0.0;
+	observations_ = 0;
+	consecutiveOutliers_ = 0;
+	windowCount_ = 0;
+}
+
+void ClockDriftEstimator::restart(double localSamples, double residual) noexcept
+{
+	const auto windowCount = windowCount_;
+	reset();
+	windowCount_ = windowCount;
+	offset_ = residual;
+	p00_ = noise_;
+	p11_ = initialDriftDeviation * initialDriftDeviation;
+	lastLocal_ = localSamples;
+	observations_ = 1;
+}
+
+void ClockDriftEstimator::addObservation(double localSamples, double serverSamples) noexcept
+{
+	const double residual = serverSamples - localSamples;
+	if (!std::isfinite(residual)) {
+		return;
+	}
+	// A packet can only arrive late, so the earliest of a window is closest to the true offset
+	if (windowCount_ == 0 || residual > windowResidual_) {
+		windowResidual_ = residual;
+		windowLocal_ = localSamples;
+	}
+	if (++windowCount_ == windowPackets) {
+		update(windowLocal_, windowResidual_);
+		windowCount_ = 0;
+	}
+}
+
+void ClockDriftEstimator::update(double localSamples, double residual) noexcept
+{
+	if (observations_ == 0) {
+		restart(localSamples, residual);
+		return;
+	}
+
+	// Predict to this packet's arrival. Packets arrive in bursts, the local position never goes back.
+	const double elapsed = std::max(0.0, localSamples - lastLocal_);
+	const double predictedOffset = offset_ + drift_ * elapsed;
+	const double p00 = p00_ + 2.0 * elapsed * p01_ + elapsed * elapsed * p11_;
+	const double p01 = p01_ + elapsed * p11_;
+	const double p11 = p11_ + driftWalkPerSample * elapsed;
+
+	const double innovation = residual - predictedOffset;
+	const double variance = p00 + noise_;
+	if (observations_ >= observationsBeforeGating && innovation * innovation > outlierVariances * variance) {
+		if (++consecutiveOutliers_ >= outliersBeforeRestart) {
+			// Not jitter anymore, the server restarted its clock or the device stalled
+			restart(localSamples, residual);
+		}
+		return;
+	}
+	consecutiveOutliers_ = 0;
+	const double offsetGain = p00 / variance;
+	const double driftGain = p01 / variance;
+	offset_ = predictedOffset + offsetGain * innovation;
+	drift_ += driftGain * innovation;
+	p00_ = (1.0 - offsetGain) * p00;
+	p01_ = (1.0 - offsetGain) * p01;
+	p11_ = p11 - driftGain * p01;
+	lastLocal_ = std::max(lastLocal_, localSamples);
+	noise_ = std::max(minimumNoise, noise_ + noiseSmoothing * (innovation * innovation - noise_));
+	++observations_;
+}
+
+double ClockDriftEstimator::drift() const noexcept
+{
+	return isLocked() ? std::clamp(drift_, -maximumDrift, maximumDrift) : 0.0;
+}
+
+bool ClockDriftEstimator::isLocked() const noexcept
+{
+	return observations_ >= observationsBeforeLock && driftUncertainty() < lockedUncertainty;
+}
+
+double ClockDriftEstimator::driftUncertainty() const noexcept
+{
+	return std::sqrt(std::max(0.0, p11_));
+}
+
+uint64_t ClockDriftEstimator::observations() const noexcept
+{
+	return observations_;
+}
@@ -0,0 +1,58 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// Estimates how much faster the server's clock runs than our audio device's. Each packet carries the server
+// time it was mixed at, we pair it with the samples the device had played when it arrived. The least delayed
+// packet of every window feeds a Kalman filter over offset and drift, so the estimate gets better the longer
+// the session runs.
+//
+// Not thread safe, it is fed from the network thread which publishes the drift for the audio callback.
+class ClockDriftEstimator {
+public:
+	// Quartz clocks are within 100 ppm, more than this is a device lying about its rate
+	static constexpr double maximumDrift = 500.0e-6;
+	// The drift is used once its standard deviation is below this
+	static constexpr double lockedUncertainty = 5.0e-6;
+
+	ClockDriftEstimator();
+
+	void reset() noexcept;
+	// Both positions count samples at the session rate
+	void addObservation(double localSamples, double serverSamples) noexcept;
+
+	// Server samples per local sample minus one, 0.0 until locked
+	double drift() const noexcept;
+	bool isLocked() const noexcept;
+	double driftUncertainty() const noexcept;
+	// Filter updates so far, one per window of packets
+	uint64_t observations() const noexcept;
+
+private:
+	static constexpr int windowPackets = 16;
+
+	void update(double localSamples, double residual) noexcept;
+	void restart(double localSamples, double residual) noexcept;
+
+	// Offset of the server time against ours at lastLocal_, and the drift. P is their covariance.
+	double offset_ { 0.0 };
+	double drift_ { 0.0 };
+	double p00_ { 0.0 };
+	double p01_ { 0.0 };
+	double p11_ { 0.0 };
+	// Variance of the arrival jitter, learned from the innovations
+	double noise_ { 0.0 };
+	double lastLocal_ { 0.0 };
+	uint64_t observations_ { 0 };
+	int consecutiveOutliers_ { 0 };
+	// The least delayed packet of the current window
+	double windowResidual_ { 0.0 };
+	double windowLocal_ { 0.0 };
+	int windowCount_ { 0 };
+};
@@ -6,6 +6,9 @@
 
 #include "DataReceiveThread.h"
 
+#include "JammerNetzMessageView.h"
+#include "LatencyTrace.h"
+#include "NetworkImpairment.h"
 #include "StreamLogger.h"
 
 #include "XPlatformUtils.h"
@@ -13,7 +16,7 @@
 #include <limits>
 
 DataReceiveThread::DataReceiveThread(DatagramSocket &socket,
-	std::function<void(std::shared_ptr<JammerNetzAudioData>)> newDataHandler,
+	std::function<void(const JammerNetzAudioDataView&)> newDataHandler,
 	std::function<void(bool)> mtuCapabilityHandler,
 	std::function<void(uint64, int)> mtuAcknowledgementHandler)
 	: Thread("ReceiveDataFromServer"), socket_(socket), newDataHandler_(newDataHandler),
@@ -31,7 +34,7 @@ void DataReceiveThread::run()
 {
 	while (!threadShouldExit()) {
 		try {
-			switch (socket_.waitUntilReady(true, 500)) {
+			switch (NetworkImpairment::instance().waitUntilReady(socket_, true, 500)) {
 		case 0:
 			// Timeout on socket, no client connected within timeout period
 			isReceiving_ = false;
@@ -40,7 +43,7 @@ void DataReceiveThread::run()
 			// Ready to read data from socket!
 			String senderIPAdress;
 			int senderPortNumber;
-			int dataRead = socket_.read(readbuffer_, MAXFRAMESIZE, false, senderIPAdress, senderPortNumber);
+			int dataRead = NetworkImpairment::instance().read(socket_, readbuffer_, MAXFRAMESIZE, false, senderIPAdress, senderPortNumber);
 			if (dataRead == -1) {
 				recordReceiveError("Error reading data from socket");
 				continue;
@@ -69,66 +72,56 @@ void DataReceiveThread::run()
 #else
 			{
 #endif
-				auto message = JammerNetzMessage::deserialize(readbuffer_, safe_int_to_sizet(messageLength));
-				if (message) {
+				const auto message = decodeJammerNetzMessage(readbuffer_, safe_int_to_sizet(messageLength));
+				if (const auto error = std::get_if<JammerNetzDecodeError>(&message)) {
+					if (*error == JammerNetzDecodeError::UnknownType) {
+						recordReceiveError("Received packet with an unknown message type");
+					}
+				}
+				else {
 					isReceiving_ = true;
-					switch (message->getType()) {
-					case JammerNetzMessage::AUDIODATA: {
-						auto audioData = std::dynamic_pointer_cast<JammerNetzAudioData>(message);
-						if (audioData) {
-							if (!JammerNetzProtocol::supportsSplitSessionInfo(audioData->protocolVersion())) {
-								if (const auto legacySession = audioData->legacySessionSetup()) {
-									ScopedLock sessionLock(sessionDataLock_);
-									currentSession_ = *legacySession;
-								}
-							}
-							// Hand off to player
-							currentRTT_ = Time::getMillisecondCounterHiRes() - audioData->timestamp();
-							newDataHandler_(audioData);
+				}
+				if (const auto audio = std::get_if<JammerNetzAudioDataView>(&message)) {
+					if (!JammerNetzProtocol::supportsSplitSessionInfo(audio->protocolVersion())) {
+						if (const auto legacySession = audio->legacySessionSetup()) {
+							ScopedLock sessionLock(sessionDataLock_);
+							currentSession_ = *legacySession;
 						}
-						break;
 					}
-					case JammerNetzMessage::CLIENTINFO: {
-						auto clientInfo = std::dynamic_pointer_cast<JammerNetzClientInfoMessage>(message);
-						if (clientInfo) {
-							if (mtuCapabilityHandler_) {
-								mtuCapabilityHandler_(clientInfo->supportsCapability(JammerNetzCapability::MtuProbeV1));
-							}
-							// Yes, got it. Copy it! This is thread safe if and only if the read function to the shared_ptr is atomic!
-							lastClientInfoMessage_.store(std::make_shared<JammerNetzClientInfoMessage>(*clientInfo), std::memory_order_release);
-						}
-						break;
+					// Hand off to player, which decodes the samples straight out of our buffer
+					currentRTT_ = Time::getMillisecondCounterHiRes() - audio->timestamp();
+					LatencyTrace::instance().stamp(0, audio->messageCounter(), LatencyStage::ClientReceive);
+					newDataHandler_(*audio);
+				}
+				else if (const auto clientInfo = std::get_if<JammerNetzClientInfoView>(&message)) {
+					if (mtuCapabilityHandler_) {
+						mtuCapabilityHandler_(clientInfo->supportsCapability(JammerNetzCapability::MtuProbeV1));
 					}
-                    case JammerNetzMessage::SESSIONSETUP: {
-                        auto sessionInfo = std::dynamic_pointer_cast<JammerNetzSessionInfoMessage>(message);
-                        if (sessionInfo) {
-							if (mtuCapabilityHandler_) {
-								mtuCapabilityHandler_(sessionInfo->supportsCapability(JammerNetzCapability::MtuProbeV1));
-							}
-							ScopedLock sessionLock(sessionDataLock_);
-                            currentSession_ = sessionInfo->channels_;
-                        }
-                        break;
-                    }
-                    case JammerNetzMessage::MessageType::GENERIC_JSON: {
-						auto control = std::dynamic_pointer_cast<JammerNetzControlMessage>(message);
-						if (control && control->json_.contains("mtu_ack_v1")) {
-							const auto& acknowledgement = control->json_["mtu_ack_v1"];
-							if (acknowledgement.is_object() && acknowledgement.contains("id")
-								&& acknowledgement["id"].is_number_unsigned()
-								&& acknowledgement.contains("size") && acknowledgement["size"].is_number_integer()
-								&& mtuAcknowledgementHandler_) {
-								const auto payloadBytes = acknowledgement["size"].get<int64_t>();
-								if (payloadBytes > 0 && payloadBytes <= std::numeric_limits<int>::max()) {
-									mtuAcknowledgementHandler_(acknowledgement["id"].get<uint64>(),
-										static_cast<int>(payloadBytes));
-								}
+					// This is thread safe if and only if the read function to the shared_ptr is atomic!
+					lastClientInfoMessage_.store(clientInfo->toMessage(), std::memory_order_release);
+				}
+				else if (const auto sessionInfo = std::get_if<JammerNetzSessionInfoView>(&message)) {
+					if (mtuCapabilityHandler_) {
+						mtuCapabilityHandler_(sessionInfo->supportsCapability(JammerNetzCapability::MtuProbeV1));
+					}
+					auto session = sessionInfo->toMessage();
+					ScopedLock sessionLock(sessionDataLock_);
+					currentSession_ = session->channels_;
+				}
+				else if (const auto control = std::get_if<JammerNetzControlView>(&message)) {
+					const auto json = control->json();
+					if (json && json->contains("mtu_ack_v1")) {
+						const auto& acknowledgement = (*json)["mtu_ack_v1"];
+						if (acknowledgement.is_object() && acknowledgement.contains("id")
+							&& acknowledgement["id"].is_number_unsigned()
+							&& acknowledgement.contains("size") && acknowledgement["size"].is_number_integer()
+							&& mtuAcknowledgementHandler_) {
+							const auto payloadBytes = acknowledgement["size"].get<int64_t>();
+							if (payloadBytes > 0 && payloadBytes <= std::numeric_limits<int>::max()) {
+								mtuAcknowledgementHandler_(acknowledgement["id"].get<uint64>(),
+									static_cast<int>(payloadBytes));
 							}
 						}
-						break;
-					}
-					default:
-						recordReceiveError("Received packet with an unknown message type");
 					}
 				}
 			}
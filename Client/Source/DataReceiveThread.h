@@ -10,13 +10,14 @@
 
 #include "JammerNetzPackage.h"
 #include "JammerNetzClientInfoMessage.h"
+#include "JammerNetzMessageView.h"
 
 #include "AtomicSharedPtr.h"
 
 class DataReceiveThread : public Thread {
 public:
 	DataReceiveThread(DatagramSocket & socket,
-		std::function<void(std::shared_ptr<JammerNetzAudioData>)> newDataHandler,
+		std::function<void(const JammerNetzAudioDataView&)> newDataHandler,
 		std::function<void(bool)> mtuCapabilityHandler,
 		std::function<void(uint64, int)> mtuAcknowledgementHandler);
 	virtual ~DataReceiveThread() override;
@@ -35,7 +36,7 @@ private:
 
 	DatagramSocket &socket_;
 	uint8 readbuffer_[MAXFRAMESIZE];
-	std::function<void(std::shared_ptr<JammerNetzAudioData>)> newDataHandler_;
+	std::function<void(const JammerNetzAudioDataView&)> newDataHandler_;
 	std::function<void(bool)> mtuCapabilityHandler_;
 	std::function<void(uint64, int)> mtuAcknowledgementHandler_;
 	std::unique_ptr<BlowFish> blowFish_;
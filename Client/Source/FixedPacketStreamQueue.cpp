@@ -0,0 +1,295 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "FixedPacketStreamQueue.h"
+
+#include <algorithm>
+#include <limits>
+
+FixedPacketStreamQueue::FixedPacketStreamQueue(std::string const &streamName, int capacity)
+{
+	qualityData_.streamName = streamName;
+	prepare(capacity);
+}
+
+void FixedPacketStreamQueue::prepare(int capacity)
+{
+	slots_.assign(static_cast<size_t>(std::max(1, capacity)), Slot());
+	reset();
+}
+
+int FixedPacketStreamQueue::capacity() const noexcept
+{
+	return static_cast<int>(slots_.size());
+}
+
+bool FixedPacketStreamQueue::push(JammerNetzAudioDataView const &packet)
+{
+	const auto messageCounter = packet.messageCounter();
+	if (!acceptCounter(messageCounter)) {
+		return false;
+	}
+
+	auto &slot = slotFor(messageCounter);
+	readBlock(packet.block(0), slot.audio);
+	slot.hasFec = packet.blockCount() > 1;
+	if (slot.hasFec) {
+		readBlock(packet.block(1), slot.fec);
+	}
+	return queued(slot, messageCounter, packet.timestamp());
+}
+
+bool FixedPacketStreamQueue::push(JammerNetzAudioData const &packet)
+{
+	const auto audio = packet.audioBuffer();
+	if (!audio) {
+		return false;
+	}
+	const auto messageCounter = packet.messageCounter();
+	if (!acceptCounter(messageCounter)) {
+		return false;
+	}
+
+	auto &slot = slotFor(messageCounter);
+	slot.audio.messageCounter = messageCounter;
+	slot.audio.timestamp = packet.timestamp();
+	slot.audio.serverTime = packet.serverTime();
+	slot.audio.bpm = packet.bpm();
+	slot.audio.midiSignal = packet.midiSignal();
+	copyAudio(*audio, slot.audio);
+	const auto fec = packet.fecBlock();
+	slot.hasFec = fec && fec->audioBuffer;
+	if (slot.hasFec) {
+		slot.fec.messageCounter = fec->messageCounter;
+		slot.fec.timestamp = fec->timestamp;
+		slot.fec.serverTime = fec->serverTime;
+		slot.fec.bpm = fec->bpm;
+		slot.fec.midiSignal = fec->midiSignal;
+		copyAudio(*fec->audioBuffer, slot.fec);
+	}
+	return queued(slot, messageCounter, packet.timestamp());
+}
+
+bool FixedPacketStreamQueue::queued(Slot &slot, juce::uint64 messageCounter, double timestamp)
+{
+	slot.occupied = true;
+	++size_;
+
+	qualityData_.packagesPushed++;
+	if (messageCounter < lastPushedMessage_) {
+		// Ups, this came in out of order (but not too late, else we classify it as "tooLateOrDuplicate")
+		qualityData_.outOfOrderPacketCounter++;
+		qualityData_.maxWrongOrderSpan = std::max((uint64) qualityData_.maxWrongOrderSpan, lastPushedMessage_ - messageCounter);
+	}
+	lastPushedMessage_ = messageCounter;
+	highestPushedMessage_ = std::max(highestPushedMessage_, messageCounter);
+	jitter_.measure(timestamp, qualityData_);
+	return true;
+}
+
+bool FixedPacketStreamQueue::tryPop(RemoteAudioFrame &frame, bool &outIsFillIn)
+{
+	if (size_ == 0) {
+		return false;
+	}
+	// Every queued packet is in the window, so this stops within capacity steps
+	auto messageCounter = base_;
+	while (!slotFor(messageCounter).occupied) {
+		messageCounter++;
+	}
+	auto &slot = slotFor(messageCounter);
+
+	if (!hasPopped_ || lastPoppedMessage_ + 1 == messageCounter) {
+		// This is either the very first message, or the correct one without a gap
+		writeFrame(slot.audio, frame);
+		slot.occupied = false;
+		--size_;
+		lastPoppedMessage_ = messageCounter;
+		hasPopped_ = true;
+		base_ = messageCounter + 1;
+		currentGap_ = 0;
+		outIsFillIn = false;
+		qualityData_.packagesPopped++;
+		return true;
+	}
+
+	// The packet we wait for is missing. Like PacketStreamQueue, fill in from the next packet we have
+	// and leave that in its slot: its FEC copy or a repeat of it for the first missing packet, silence
+	// right before it if the gap goes on.
+	juce::uint64 fillInCounter;
+	if (currentGap_ < 1) {
+		fillInCounter = lastPoppedMessage_ + 1;
+		if (writeFillIn(slot, fillInCounter, frame)) {
+			qualityData_.dropsHealed++;
+		}
+		else {
+			qualityData_.droppedPacketCounter++;
+		}
+	}
+	else {
+		// Never repeat this again, take the next package even if there was a drop and restart consecutive counting
+		fillInCounter = messageCounter - 1;
+		writeFillIn(slot, fillInCounter, frame);
+		for (auto &channel : frame.samples) {
+			channel.fill(0.0f);
+		}
+		qualityData_.droppedPacketCounter++;
+	}
+	lastPoppedMessage_ = fillInCounter;
+	base_ = fillInCounter + 1;
+	currentGap_++;
+	qualityData_.maxLengthOfGap = std::max((uint64) qualityData_.maxLengthOfGap, currentGap_);
+	outIsFillIn = true;
+	return true;
+}
+
+void FixedPacketStreamQueue::reset()
+{
+	for (auto &slot : slots_) {
+		slot.occupied = false;
+	}
+	size_ = 0;
+	base_ = 0;
+	highestPushedMessage_ = 0;
+	lastPushedMessage_ = 0;
+	lastPoppedMessage_ = 0;
+	hasPopped_ = false;
+	currentGap_ = 0;
+	jitter_.reset();
+	qualityData_.reset();
+}
+
+size_t FixedPacketStreamQueue::size() const noexcept
+{
+	return size_;
+}
+
+std::string FixedPacketStreamQueue::qualityStatement() const
+{
+	return qualityData_.qualityStatement();
+}
+
+JammerNetzStreamQualityInfo FixedPacketStreamQueue::qualityInfoPackage() const
+{
+	return qualityData_.qualityInfoPackage();
+}
+
+FixedPacketStreamQueue::Slot &FixedPacketStreamQueue::slotFor(juce::uint64 messageCounter) noexcept
+{
+	return slots_[static_cast<size_t>(messageCounter % slots_.size())];
+}
+
+bool FixedPacketStreamQueue::acceptCounter(juce::uint64 messageCounter)
+{
+	// A packet at or below the last popped counter has already been consumed or concealed
+	if (hasPopped_ && messageCounter <= lastPoppedMessage_) {
+		qualityData_.tooLateOrDuplicate++;
+		return false;
+	}
+	const auto capacity = static_cast<juce::uint64>(slots_.size());
+	if (size_ == 0 && !hasPopped_) {
+		base_ = messageCounter;
+	}
+	else if (messageCounter < base_) {
+		// Nothing popped yet and this one was overtaken by its successors. Move the window down if they still fit.
+		if (highestPushedMessage_ - messageCounter >= capacity) {
+			qualityData_.tooLateOrDuplicate++;
+			return false;
+		}
+		base_ = messageCounter;
+	}
+	if (messageCounter - base_ >= capacity) {
+		fastForwardTo(messageCounter - capacity + 1);
+	}
+	if (slotFor(messageCounter).occupied) {
+		// Within the window the slot can only hold the same counter
+		qualityData_.duplicatePacketCounter++;
+		return false;
+	}
+	return true;
+}
+
+void FixedPacketStreamQueue::fastForwardTo(juce::uint64 newBase)
+{
+	const auto end = std::min(newBase, base_ + static_cast<juce::uint64>(slots_.size()));
+	uint64 discarded = 0;
+	for (auto messageCounter = base_; messageCounter < end && size_ > 0; ++messageCounter) {
+		auto &slot = slotFor(messageCounter);
+		if (slot.occupied) {
+			slot.occupied = false;
+			--size_;
+			++discarded;
+		}
+	}
+	// Like PacketStreamQueue::fastForwardToSize() this is a rebase, not a gap to conceal. The oldest
+	// packet left becomes the next real one.
+	base_ = newBase;
+	hasPopped_ = false;
+	currentGap_ = 0;
+	qualityData_.droppedPacketCounter.fetch_add(static_cast<std::int64_t>(discarded), std::memory_order_relaxed);
+	qualityData_.packagesPopped.fetch_add(discarded, std::memory_order_relaxed);
+}
+
+void FixedPacketStreamQueue::copyAudio(juce::AudioBuffer<float> const &audio, FrameData &destination)
+{
+	// The decoder only accepts supported block sizes
+	destination.numSamples = std::min(MAXIMUM_SAMPLE_BUFFER_SIZE, audio.getNumSamples());
+	for (int channel = 0; channel < 2; ++channel) {
+		auto &samples = destination.samples[static_cast<size_t>(channel)];
+		if (channel < audio.getNumChannels()) {
+			juce::FloatVectorOperations::copy(samples.data(), audio.getReadPointer(channel), destination.numSamples);
+		}
+		else {
+			juce::FloatVectorOperations::clear(samples.data(), destination.numSamples);
+		}
+	}
+}
+
+void FixedPacketStreamQueue::readBlock(JammerNetzPNPAudioBlock const &block, FrameData &destination) noexcept
+{
+	destination.messageCounter = block.messageCounter();
+	destination.timestamp = block.timestamp();
+	destination.serverTime = block.serverTime();
+	destination.bpm = block.bpm();
+	destination.midiSignal = block.midiSignal();
+	// The decoder only accepts supported block sizes
+	destination.numSamples = JammerNetzAudioData::numSamples(block);
+	float *channels[] = { destination.samples[0].data(), destination.samples[1].data() };
+	JammerNetzAudioData::readSamples(block, channels, 2);
+}
+
+void FixedPacketStreamQueue::writeFrame(FrameData const &source, RemoteAudioFrame &frame)
+{
+	for (size_t channel = 0; channel < frame.samples.size(); ++channel) {
+		juce::FloatVectorOperations::copy(frame.samples[channel].data(), source.samples[channel].data(), source.numSamples);
+	}
+	frame.numSamples = source.numSamples;
+	frame.sourceTimestamp = source.timestamp;
+	frame.sourceMessageCounter = source.messageCounter;
+	frame.serverSampleEnd = source.serverTime;
+	frame.bpm = source.bpm;
+	frame.midiSignal = source.midiSignal;
+}
+
+bool FixedPacketStreamQueue::writeFillIn(Slot const &later, juce::uint64 messageCounter, RemoteAudioFrame &frame)
+{
+	if (later.hasFec && later.fec.messageCounter == messageCounter) {
+		writeFrame(later.fec, frame);
+		return true;
+	}
+	// No FEC data available, fall back to "repeat last package". Infer the end sample of the missing
+	// predecessor, and never duplicate a transient MIDI Start/Stop command from the later packet.
+	writeFrame(later.audio, frame);
+	const auto samples = static_cast<uint64>(later.audio.numSamples);
+	const auto missingFrames = later.audio.messageCounter > messageCounter ? later.audio.messageCounter - messageCounter : 1;
+	const auto missingSamples = samples <= std::numeric_limits<uint64>::max() / missingFrames
+		? samples * missingFrames
+		: std::numeric_limits<uint64>::max();
+	frame.sourceMessageCounter = messageCounter;
+	frame.serverSampleEnd = later.audio.serverTime >= missingSamples ? later.audio.serverTime - missingSamples : 0;
+	frame.midiSignal = MidiSignal_None;
+	return false;
+}
@@ -0,0 +1,84 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include "JammerNetzMessageView.h"
+#include "PacketStreamQueue.h"
+#include "RealtimeAudioFrames.h"
+
+#include <array>
+#include <vector>
+
+// The client side PacketStreamQueue. Packets are decoded into a ring of preallocated slots indexed by
+// their message counter, so reordering, duplicate detection and the fill-ins for gaps (FEC or repeat)
+// happen in place. After prepare() neither push() nor tryPop() allocate.
+//
+// It heals gaps exactly like PacketStreamQueue. A packet further ahead than the capacity fast forwards the
+// window, the packets that fall out of it count as dropped.
+class FixedPacketStreamQueue {
+public:
+	// 680 ms of 128 sample blocks, ten times the default playout maximum of the receive worker
+	static constexpr int defaultCapacity = 256;
+
+	explicit FixedPacketStreamQueue(std::string const &streamName, int capacity = defaultCapacity);
+
+	// Allocates the slots and resets. Not synchronised with push() and tryPop().
+	void prepare(int capacity);
+	int capacity() const noexcept;
+
+	// Converts the first two channels straight from the receive buffer into the packet's slot
+	bool push(JammerNetzAudioDataView const &packet);
+	// Copies the first two channels, the packet can be released right after
+	bool push(JammerNetzAudioData const &packet);
+	// The frame's generation is left to the caller
+	bool tryPop(RemoteAudioFrame &frame, bool &outIsFillIn);
+	void reset();
+	size_t size() const noexcept;
+
+	std::string qualityStatement() const;
+	JammerNetzStreamQualityInfo qualityInfoPackage() const;
+
+private:
+	struct FrameData {
+		juce::uint64 messageCounter { 0 };
+		double timestamp { 0.0 };
+		juce::uint64 serverTime { 0 };
+		float bpm { 0.0f };
+		MidiSignal midiSignal { MidiSignal_None };
+		int numSamples { 0 };
+		std::array<std::array<float, MAXIMUM_SAMPLE_BUFFER_SIZE>, 2> samples {};
+	};
+	struct Slot {
+		bool occupied { false };
+		bool hasFec { false };
+		FrameData audio;
+		FrameData fec;
+	};
+
+	Slot &slotFor(juce::uint64 messageCounter) noexcept;
+	bool acceptCounter(juce::uint64 messageCounter);
+	bool queued(Slot &slot, juce::uint64 messageCounter, double timestamp);
+	void fastForwardTo(juce::uint64 newBase);
+	static void copyAudio(juce::AudioBuffer<float> const &audio, FrameData &destination);
+	static void readBlock(JammerNetzPNPAudioBlock const &block, FrameData &destination) noexcept;
+	static void writeFrame(FrameData const &source, RemoteAudioFrame &frame);
+	static bool writeFillIn(Slot const &later, juce::uint64 messageCounter, RemoteAudioFrame &frame);
+
+	std::vector<Slot> slots_;
+	size_t size_ { 0 };
+	// All queued packets have counters in [base_, base_ + capacity). Once a packet was popped, base_ is the next one due.
+	juce::uint64 base_ { 0 };
+	juce::uint64 highestPushedMessage_ { 0 };
+	juce::uint64 lastPushedMessage_ { 0 };
+	juce::uint64 lastPoppedMessage_ { 0 };
+	bool hasPopped_ { false };
+	juce::uint64 currentGap_ { 0 };
+	JitterMeter jitter_;
+	StreamQualityData qualityData_;
+};
@@ -0,0 +1,136 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "InlineAudioSender.h"
+
+#include "ClientScheduling.h"
+#include "LatencyTrace.h"
+
+#include <array>
+#include <utility>
+
+InlineAudioSender::InlineAudioSender(SetupSource setupSource, SinkSource sinkSource)
+	: juce::Thread("JammerNetz inline send"), setupSource_(std::move(setupSource)), sinkSource_(std::move(sinkSource))
+	, ring_(static_cast<size_t>(ringCapacity + 1))
+{
+}
+
+InlineAudioSender::~InlineAudioSender() { shutdown(); }
+
+void InlineAudioSender::start()
+{
+	if (!isThreadRunning()) {
+		startThread(juce::Thread::Priority::high);
+		ClientScheduling::instance().apply(*this, ClientThreadRole::Send);
+	}
+}
+
+void InlineAudioSender::shutdown()
+{
+	signalThreadShouldExit();
+	wakeup_.wakeUp();
+	stopThread(2000);
+	// The owning engine stops its audio callback producer before shutdown.
+	sink_.store(nullptr, std::memory_order_release);
+	publishedSetup_.reset();
+	setups_.reset();
+	fifo_.reset();
+}
+
+bool InlineAudioSender::isRunning() const noexcept { return isThreadRunning(); }
+uint64_t InlineAudioSender::sentDatagrams() const noexcept { return sent_.load(std::memory_order_relaxed); }
+uint64_t InlineAudioSender::droppedDatagrams() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+bool InlineAudioSender::send(const TransmitAudioFrame& frame)
+{
+	while (setups_.tryRead([this](SetupSlot& slot) { std::swap(setup_, slot.setup); })) {}
+	auto* sink = sink_.load(std::memory_order_acquire);
+	if (sink == nullptr || setup_.channels.size() != static_cast<size_t>(frame.channels)) {
+		// Have the sender thread publish a matching setup
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		wakeup_.notify();
+		return false;
+	}
+
+	int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+	fifo_.prepareToWrite(1, start1, size1, start2, size2);
+	if (size1 == 0) {
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	std::array<const float*, JAMMERNETZ_MAX_AUDIO_CHANNELS> channels {};
+	for (size_t channel = 0; channel < static_cast<size_t>(frame.channels); ++channel) {
+		channels[channel] = frame.channel(static_cast<int>(channel));
+	}
+	auto& datagram = ring_[static_cast<size_t>(start1)];
+	datagram.messageCounter = sink->nextMessageCounter();
+	datagram.size = serializer_.serialize(datagram.bytes.data(), datagram.messageCounter, juce::Time::getMillisecondCounterHiRes(), setup_,
+		frame.bpm.value_or(0.0f), frame.midiSignal.value_or(MidiSignal_None), channels.data(), frame.channels, frame.numSamples, frame.sampleRate);
+	datagram.numSamples = frame.numSamples;
+	datagram.captureTimeMs = frame.captureTimeMs;
+	datagram.enqueueTimeMs = frame.captureTimeMs > 0.0 ? juce::Time::getMillisecondCounterHiRes() : 0.0;
+	fifo_.finishedWrite(1);
+	wakeup_.notify();
+	return true;
+}
+
+void InlineAudioSender::run()
+{
+	while (!threadShouldExit()) {
+		publishSetupAndSink();
+		sendReady();
+		wakeup_.wait([this]() { return threadShouldExit() || fifo_.getNumReady() > 0; });
+	}
+}
+
+void InlineAudioSender::publishSetupAndSink()
+{
+	sink_.store(sinkSource_(), std::memory_order_release);
+	auto setup = setupSource_();
+	if (setup && setup != publishedSetup_ && setups_.tryWrite([&setup](SetupSlot& slot) { slot.setup = *setup; })) {
+		publishedSetup_ = std::move(setup);
+	}
+}
+
+void InlineAudioSender::sendReady()
+{
+	const int ready = fifo_.getNumReady();
+	if (ready == 0) {
+		return;
+	}
+	int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+	fifo_.prepareToRead(ready, start1, size1, start2, size2);
+	std::array<Datagram*, ringCapacity> batch {};
+	std::array<uint8*, ringCapacity> datagrams {};
+	std::array<size_t, ringCapacity> sizes {};
+	int count = 0;
+	auto collect = [&](int start, int size) {
+		for (int index = start; index < start + size; ++index, ++count) {
+			auto& datagram = ring_[static_cast<size_t>(index)];
+			batch[static_cast<size_t>(count)] = &datagram;
+			datagrams[static_cast<size_t>(count)] = datagram.bytes.data();
+			sizes[static_cast<size_t>(count)] = datagram.size;
+		}
+	};
+	collect(start1, size1);
+	collect(start2, size2);
+
+	auto* sink = sink_.load(std::memory_order_acquire);
+	const int sent = sink != nullptr ? sink->sendDatagrams(datagrams.data(), sizes.data(), count) : 0;
+	sent_.fetch_add(static_cast<uint64_t>(sent), std::memory_order_relaxed);
+	dropped_.fetch_add(static_cast<uint64_t>(count - sent), std::memory_order_relaxed);
+
+	auto& latencyTrace = LatencyTrace::instance();
+	for (int index = 0; index < sent; ++index) {
+		const auto* datagram = batch[static_cast<size_t>(index)];
+		if (latencyTrace.isSampled(datagram->messageCounter) && datagram->captureTimeMs > 0.0) {
+			latencyTrace.stampAt(0, datagram->messageCounter, LatencyStage::Capture, datagram->captureTimeMs, datagram->numSamples);
+			latencyTrace.stampAt(0, datagram->messageCounter, LatencyStage::TransmitEnqueue, datagram->enqueueTimeMs);
+			latencyTrace.stamp(0, datagram->messageCounter, LatencyStage::Send);
+		}
+	}
+	fifo_.finishedRead(count);
+}
@@ -0,0 +1,72 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "AudioPacketSink.h"
+#include "BoundedSpscQueue.h"
+#include "RealtimeAudioFrames.h"
+
+#include <functional>
+#include <vector>
+
+// Opt-in transmit path for small device buffers. The audio callback serializes each block straight
+// into a preallocated datagram, and a high priority thread encrypts and sends all datagrams that are
+// ready in one batch. Neither side waits for the other, a block that finds the ring full is dropped.
+class InlineAudioSender final : private juce::Thread {
+public:
+	using SetupSource = std::function<std::shared_ptr<const JammerNetzChannelSetup>()>;
+	using SinkSource = std::function<AudioDatagramSink*()>;
+
+	// Both sources are polled by the sender thread only
+	InlineAudioSender(SetupSource setupSource, SinkSource sinkSource);
+	~InlineAudioSender() override;
+
+	void start();
+	void shutdown();
+	bool isRunning() const noexcept;
+
+	// Audio thread. Never blocks, and does not allocate once the first packets went out.
+	// Returns false when the block was dropped.
+	bool send(const TransmitAudioFrame& frame);
+
+	uint64_t sentDatagrams() const noexcept;
+	uint64_t droppedDatagrams() const noexcept;
+
+private:
+	struct Datagram {
+		std::vector<uint8> bytes = std::vector<uint8>(MAXFRAMESIZE);
+		size_t size { 0 };
+		uint64 messageCounter { 0 };
+		int numSamples { 0 };
+		double captureTimeMs { 0.0 };
+		double enqueueTimeMs { 0.0 };
+	};
+	struct SetupSlot {
+		JammerNetzChannelSetup setup { false };
+	};
+
+	void run() override;
+	void publishSetupAndSink();
+	void sendReady();
+
+	// About 40 ms, one batch
+	static constexpr int ringCapacity = AudioDatagramSink::maximumBatch;
+	SetupSource setupSource_;
+	SinkSource sinkSource_;
+	QueueWakeup wakeup_;
+	juce::AbstractFifo fifo_ { ringCapacity + 1 };
+	std::vector<Datagram> ring_;
+	// The sender thread copies new setups into a slot and the audio thread swaps them in,
+	// so the audio thread neither copies nor frees a setup
+	BoundedSpscQueue<SetupSlot> setups_ { 2 };
+	std::shared_ptr<const JammerNetzChannelSetup> publishedSetup_; // Sender thread
+	JammerNetzChannelSetup setup_ { false }; // Audio thread
+	JammerNetzAudioSerializer serializer_; // Audio thread
+	std::atomic<AudioDatagramSink*> sink_ { nullptr };
+	std::atomic<uint64_t> sent_ { 0 };
+	std::atomic<uint64_t> dropped_ { 0 };
+};
@@ -7,6 +7,7 @@
 #include "JammerNetzAudioEngine.h"
 
 #include "BuffersConfig.h"
+#include "LatencyTrace.h"
 #include "Logger.h"
 
 #include <cmath>
@@ -42,6 +43,11 @@ void clearOutputChannels(float* const* outputChannelData, int numOutputChannels,
 	}
 }
 
+JammerNetzChannelSetup stereoRecordingSetup()
+{
+	return JammerNetzChannelSetup(false, { JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Left), JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Right) });
+}
+
 } // namespace
 
 JammerNetzAudioEngine::JammerNetzAudioEngine(JammerNetzSession& session,
@@ -49,7 +55,6 @@ JammerNetzAudioEngine::JammerNetzAudioEngine(JammerNetzSession& session,
 	std::shared_ptr<AudioPacketSink> packetSink)
 	: session_(session)
 	, recordingDirectory_(recordingDirectory)
-	, remoteScratch_(2, JAMMERNETZ_MAX_CALLBACK_SAMPLES)
 	, masterVolume_(1.0)
 	, monitorBalance_(0.0)
 	, serverBpm_(0.0)
@@ -61,7 +66,6 @@ JammerNetzAudioEngine::JammerNetzAudioEngine(JammerNetzSession& session,
 	inputState_.store(configuredInputState_.get(), std::memory_order_release);
 	minPlayoutBufferLength_ = CLIENT_PLAYOUT_JITTER_BUFFER;
 	maxPlayoutBufferLength_ = CLIENT_PLAYOUT_MAX_BUFFER;
-	playoutBuffer_ = std::make_unique<RingBuffer>(2, PLAYOUT_RINGBUFFER_SIZE);
 	transmitWorker_ = std::make_unique<AudioTransmitWorker>(session_, std::move(packetSink));
 	receiveWorker_ = std::make_unique<AudioReceiveWorker>(session_);
 	outMeterSource_.resize(2, 1);
@@ -88,8 +92,11 @@ void JammerNetzAudioEngine::start(bool enableRecording)
 	if (enableRecording) {
 		uploadRecorder_ = std::make_shared<Recorder>(recordingDirectory_, "LocalRecording", RecordingType::WAV);
 		masterRecorder_ = std::make_shared<Recorder>(recordingDirectory_, "MasterRecording", RecordingType::FLAC);
-		masterRecorder_->setChannelInfo(SAMPLE_RATE, JammerNetzChannelSetup(false, { JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Left), JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Right) }));
+		masterRecorder_->setChannelInfo(preparedDeviceRate(), stereoRecordingSetup());
 		recordingWorker_ = std::make_unique<AudioRecordingWorker>(uploadRecorder_, masterRecorder_);
+		if (const auto blockSize = preparedBlockSize_.load(std::memory_order_relaxed); blockSize > 0) {
+			recordingWorker_->prepare(recordingChannels(), blockSize);
+		}
 		recordingWorker_->start();
 	}
 	transmitWorker_->start();
@@ -103,6 +110,8 @@ void JammerNetzAudioEngine::shutdown()
 		juce::Thread::sleep(1);
 	}
 	started_ = false;
+	// No callback runs anymore, hand the claimed frames back before the receive worker resets its queue
+	resetPlayoutState();
 	if (auto* tap = outputTap_.exchange(nullptr, std::memory_order_acq_rel)) {
 		tap->release();
 	}
@@ -124,10 +133,36 @@ void JammerNetzAudioEngine::shutdown()
 	uploadRecorder_.reset();
 }
 
+void JammerNetzAudioEngine::enqueueRemoteAudio(const JammerNetzAudioDataView& packet)
+{
+	observeRemoteAudio(packet.numSamples(), packet.sampleRate(), packet.serverTime());
+	if (receiveWorker_) {
+		receiveWorker_->enqueue(packet);
+	}
+}
+
 void JammerNetzAudioEngine::enqueueRemoteAudio(std::shared_ptr<JammerNetzAudioData> buffer)
 {
+	const auto audio = buffer ? buffer->audioBuffer() : nullptr;
+	if (!audio) {
+		return;
+	}
+	observeRemoteAudio(audio->getNumSamples(), buffer->sampleRate(), buffer->serverTime());
 	if (receiveWorker_) {
-		receiveWorker_->enqueue(std::move(buffer));
+		receiveWorker_->enqueue(*buffer);
+	}
+}
+
+void JammerNetzAudioEngine::observeRemoteAudio(int numSamples, int sampleRate, uint64 serverTime)
+{
+	// The server mixes at the session's block size, send ours in the same size so we take part in the mix
+	if (numSamples != networkBlockSize_.load(std::memory_order_relaxed)) {
+		setNetworkBlockSize(numSamples);
+	}
+	// And in its rate, the audio callback picks that up and converts if the device runs at another rate
+	if (isSupportedSampleRate(sampleRate)) {
+		sessionSampleRate_.store(sampleRate, std::memory_order_relaxed);
+		observeServerClock(sampleRate, serverTime);
 	}
 }
 
@@ -150,6 +185,43 @@ void JammerNetzAudioEngine::setPlayoutBufferRange(uint64 minimumLength, uint64 m
 	}
 }
 
+void JammerNetzAudioEngine::setNetworkBlockSize(int sampleBufferSize)
+{
+	if (isSupportedSampleBufferSize(sampleBufferSize)) {
+		networkBlockSize_.store(sampleBufferSize, std::memory_order_relaxed);
+	}
+	else {
+		jassertfalse;
+	}
+}
+
+int JammerNetzAudioEngine::networkBlockSize() const noexcept
+{
+	return networkBlockSize_.load(std::memory_order_relaxed);
+}
+
+int JammerNetzAudioEngine::sessionSampleRate() const noexcept
+{
+	return sessionSampleRate_.load(std::memory_order_relaxed);
+}
+
+void JammerNetzAudioEngine::setInlineTransmit(bool enabled)
+{
+	if (transmitWorker_) {
+		transmitWorker_->setInlineTransmit(enabled);
+	}
+}
+
+void JammerNetzAudioEngine::setDriftCompensation(bool enabled)
+{
+	driftCompensation_.store(enabled, std::memory_order_relaxed);
+}
+
+double JammerNetzAudioEngine::clockDrift() const noexcept
+{
+	return clockDrift_.load(std::memory_order_relaxed);
+}
+
 void JammerNetzAudioEngine::setMasterVolume(double volume)
 {
 	masterVolume_.store(volume, std::memory_order_relaxed);
@@ -254,6 +326,9 @@ void JammerNetzAudioEngine::newServer()
 		expectedRemoteGeneration_.store(receiveWorker_->requestReset(), std::memory_order_release);
 	}
 	resetPlayoutRequested_.store(true, std::memory_order_release);
+	// Another server, another clock
+	driftEstimatorResetRequested_.store(true, std::memory_order_release);
+	clockDrift_.store(0.0, std::memory_order_relaxed);
 }
 
 void JammerNetzAudioEngine::measureSamplesPerTime(PlayoutQualityInfo &qualityInfo, int numSamples) const {
@@ -325,9 +400,97 @@ void JammerNetzAudioEngine::calcLocalMonitoring(const float* const* inputChannel
 	}
 }
 
+int JammerNetzAudioEngine::playoutReadySamples() const noexcept
+{
+	return playoutClaimedSamples_ - playoutFrameOffset_;
+}
+
+void JammerNetzAudioEngine::mixClaimedFrames(AudioBuffer<float>& outputBuffer, int numSamples, float volume) noexcept
+{
+	const int outputChannels = std::min(2, outputBuffer.getNumChannels());
+	int written = 0;
+	while (written < numSamples) {
+		const auto* frame = receiveWorker_->peekFrame(0);
+		jassert(frame != nullptr && playoutClaimedFrames_ > 0);
+		const int samples = std::min(frame->numSamples - playoutFrameOffset_, numSamples - written);
+		for (int c = 0; c < outputChannels; c++) {
+			outputBuffer.addFrom(c, written, frame->samples[static_cast<size_t>(c)].data() + playoutFrameOffset_, samples, volume);
+		}
+		written += samples;
+		playoutFrameOffset_ += samples;
+		if (playoutFrameOffset_ == frame->numSamples) {
+			playoutClaimedSamples_ -= frame->numSamples;
+			receiveWorker_->discardFrames(1);
+			receiveWorker_->setClaimedFrames(--playoutClaimedFrames_);
+			playoutFrameOffset_ = 0;
+		}
+	}
+}
+
+void JammerNetzAudioEngine::mixConvertedFrames(AudioBuffer<float>& outputBuffer, int numSamples, float volume) noexcept
+{
+	// Mix at the session rate, then convert to the device rate. The claimed frames cover
+	// outputConverter_.inputSamplesFor(numSamples), which is what the chunks add up to.
+	const int outputChannels = std::min(2, outputBuffer.getNumChannels());
+	for (int written = 0; written < numSamples; written += conversionChunkSamples) {
+		const int chunkSamples = std::min(conversionChunkSamples, numSamples - written);
+		const int sessionSamples = outputConverter_.inputSamplesFor(chunkSamples);
+		AudioBuffer<float> sessionBuffer(sessionPlayoutChannels_.data(), 2, sessionSamples);
+		sessionBuffer.clear();
+		mixClaimedFrames(sessionBuffer, sessionSamples, volume);
+		const int converted = outputConverter_.process(sessionPlayoutChannels_.data(), 2, sessionSamples,
+			convertedPlayoutChannels_.data(), chunkSamples);
+		for (int c = 0; c < outputChannels; c++) {
+			outputBuffer.addFrom(c, written, convertedPlayoutChannels_[static_cast<size_t>(c)], converted);
+		}
+	}
+}
+
+void JammerNetzAudioEngine::ingestConverted(RingBuffer& ingestBuffer, const float* const* inputChannelData, int numInputChannels,
+	int numSamples) noexcept
+{
+	if (numInputChannels > inputConverter_.channels()) {
+		// The channel setup grew since prepare(), like the transmit worker we drop until the next one
+		inputBlocksDropped_.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	std::array<const float*, JAMMERNETZ_MAX_AUDIO_CHANNELS> chunkInputs {};
+	for (int offset = 0; offset < numSamples; offset += conversionChunkSamples) {
+		const int chunkSamples = std::min(conversionChunkSamples, numSamples - offset);
+		for (int channel = 0; channel < numInputChannels; ++channel) {
+			chunkInputs[static_cast<size_t>(channel)] = inputChannelData[channel] + offset;
+		}
+		const int converted = inputConverter_.process(chunkInputs.data(), numInputChannels, chunkSamples,
+			convertedInputChannels_.data(), convertedInputSamples_);
+		if (converted <= ingestBuffer.getFreeSpace()) {
+			ingestBuffer.write(convertedInputChannels_.data(), numInputChannels, converted);
+		} else {
+			inputBlocksDropped_.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+void JammerNetzAudioEngine::configureRateConversion(int deviceRate, int sessionRate) noexcept
+{
+	// The filters were computed by prepare()
+	inputConverter_.setRates(deviceRate, sessionRate);
+	outputConverter_.setRates(sessionRate, deviceRate);
+	convertedSessionRate_ = sessionRate;
+	// The claimed frames were counted at the old rate
+	resetPlayoutState();
+	isPlaying_.store(false, std::memory_order_release);
+}
+
 void JammerNetzAudioEngine::resetPlayoutState() noexcept
 {
-	playoutBuffer_->clear();
+	outputConverter_.reset();
+	if (receiveWorker_) {
+		receiveWorker_->discardFrames(playoutClaimedFrames_);
+		receiveWorker_->setClaimedFrames(0);
+	}
+	playoutClaimedFrames_ = 0;
+	playoutClaimedSamples_ = 0;
+	playoutFrameOffset_ = 0;
 	playoutTimingRead_ = 0;
 	playoutTimingWrite_ = 0;
 	playoutTimingCount_ = 0;
@@ -339,17 +502,19 @@ void JammerNetzAudioEngine::appendPlayoutTiming(const RemoteAudioFrame& frame) n
 {
 	if (playoutTimingCount_ == playoutTimingMarkers_.size()) {
 		midiTimingMarkersDropped_.fetch_add(1, std::memory_order_relaxed);
-		playoutSamplesWritten_ += SAMPLE_BUFFER_SIZE;
+		playoutSamplesWritten_ += static_cast<uint64_t>(frame.numSamples);
 		return;
 	}
 	auto& marker = playoutTimingMarkers_[playoutTimingWrite_];
 	marker.playoutSample = playoutSamplesWritten_;
 	marker.serverSampleEnd = frame.serverSampleEnd;
+	marker.numSamples = frame.numSamples;
 	marker.bpm = frame.bpm;
 	marker.midiSignal = frame.midiSignal;
+	marker.sourceMessageCounter = frame.sourceMessageCounter;
 	playoutTimingWrite_ = (playoutTimingWrite_ + 1) % playoutTimingMarkers_.size();
 	++playoutTimingCount_;
-	playoutSamplesWritten_ += SAMPLE_BUFFER_SIZE;
+	playoutSamplesWritten_ += static_cast<uint64_t>(frame.numSamples);
 }
 
 void JammerNetzAudioEngine::scheduleMidiForPlayout(int numSamples) noexcept
@@ -370,9 +535,11 @@ void JammerNetzAudioEngine::scheduleMidiForPlayout(int numSamples) noexcept
 			const auto frameOffset = marker.playoutSample > playoutSamplesRead_
 				? marker.playoutSample - playoutSamplesRead_
 				: 0;
-			scheduleMidiFrame(sender, marker.serverSampleEnd, marker.bpm, marker.midiSignal,
+			scheduleMidiFrame(sender, marker.serverSampleEnd, marker.numSamples, marker.bpm, marker.midiSignal,
 				frameOffset, playoutStart);
 		}
+		// The frame's first sample reaches the device in this callback.
+		LatencyTrace::instance().stamp(0, marker.sourceMessageCounter, LatencyStage::Playout);
 		playoutTimingRead_ = (playoutTimingRead_ + 1) % playoutTimingMarkers_.size();
 		--playoutTimingCount_;
 	}
@@ -380,27 +547,30 @@ void JammerNetzAudioEngine::scheduleMidiForPlayout(int numSamples) noexcept
 	playoutSamplesRead_ = readEnd;
 }
 
-void JammerNetzAudioEngine::scheduleMidiFrame(MidiSendThread* sender, uint64 serverSampleEnd, float bpm,
+void JammerNetzAudioEngine::scheduleMidiFrame(MidiSendThread* sender, uint64 serverSampleEnd, int frameSamples, float bpm,
 	MidiSignal signal, uint64_t frameOffsetSamples, std::chrono::steady_clock::time_point playoutStart) noexcept
 {
-	const auto atSampleOffset = [playoutStart](double samples) {
+	// Playout and server positions both count samples at the session rate
+	const auto sessionRate = static_cast<double>(sessionSampleRate_.load(std::memory_order_relaxed));
+	const auto atSampleOffset = [playoutStart, sessionRate](double samples) {
 		return playoutStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
-			std::chrono::duration<double>(samples / static_cast<double>(SAMPLE_RATE)));
+			std::chrono::duration<double>(samples / sessionRate));
 	};
 	if (signal != MidiSignal_None) {
 		sender->enqueueAt(atSampleOffset(static_cast<double>(frameOffsetSamples)), bpm, signal, false);
 	}
 
-	if (!std::isfinite(bpm) || bpm <= 0.0f || bpm > 1000.0f || serverSampleEnd < SAMPLE_BUFFER_SIZE) {
+	if (!std::isfinite(bpm) || bpm <= 0.0f || bpm > 1000.0f || frameSamples <= 0
+		|| serverSampleEnd < static_cast<uint64>(frameSamples)) {
 		return;
 	}
 	constexpr double pulsesPerQuarterNote = 24.0;
-	const double samplesPerPulse = static_cast<double>(SAMPLE_RATE) * 60.0
+	const double samplesPerPulse = sessionRate * 60.0
 		/ (static_cast<double>(bpm) * pulsesPerQuarterNote);
 	if (!std::isfinite(samplesPerPulse) || samplesPerPulse <= 0.0) {
 		return;
 	}
-	const double frameStart = static_cast<double>(serverSampleEnd - SAMPLE_BUFFER_SIZE);
+	const double frameStart = static_cast<double>(serverSampleEnd - static_cast<uint64>(frameSamples));
 	const double frameEnd = static_cast<double>(serverSampleEnd);
 	const auto firstPulse = static_cast<uint64_t>(std::ceil(frameStart / samplesPerPulse - 1.0e-12));
 	// The UI currently caps tempo at 250 BPM (one pulse per 480 samples). Keep
@@ -434,6 +604,7 @@ void JammerNetzAudioEngine::process(const float* const* inputChannelData, int nu
 		return;
 	}
 	const auto callbackStart = std::chrono::steady_clock::now();
+	publishDeviceClock(callbackStart, numSamples);
 	if (numInputChannels > JAMMERNETZ_MAX_AUDIO_CHANNELS || numOutputChannels > JAMMERNETZ_MAX_AUDIO_CHANNELS) {
 		for (int channel = 0; channel < numOutputChannels; ++channel) {
 			if (outputChannelData[channel]) {
@@ -473,6 +644,8 @@ void JammerNetzAudioEngine::processChunk(const float* const* inputChannelData, i
 	int numOutputChannels, int numSamples)
 {
 	float* const* constnessCorrection = const_cast<float* const*>(inputChannelData);
+	auto& latencyTrace = LatencyTrace::instance();
+	const double captureTimeMs = latencyTrace.isEnabled() ? Time::getMillisecondCounterHiRes() : 0.0;
 	PlayoutQualityInfo qualityInfo = lastPlayoutQualityInfo_;
 	if (resetQualityInfo_.exchange(false, std::memory_order_acq_rel)) {
 		qualityInfo = PlayoutQualityInfo();
@@ -480,8 +653,32 @@ void JammerNetzAudioEngine::processChunk(const float* const* inputChannelData, i
 	if (resetPlayoutRequested_.exchange(false, std::memory_order_acq_rel)) {
 		resetPlayoutState();
 		isPlaying_.store(false, std::memory_order_release);
+		// A new device or server, play directly until its clock is known
+		followingDrift_ = false;
 	}
 	const auto* inputState = inputState_.load(std::memory_order_acquire);
+	const int sessionRate = sessionSampleRate_.load(std::memory_order_relaxed);
+	if (sessionRate != convertedSessionRate_ && inputConverter_.isPrepared()) {
+		configureRateConversion(preparedDeviceRate(), sessionRate);
+	}
+	const bool driftCompensation = driftCompensation_.load(std::memory_order_relaxed);
+	// The drift reads zero until the estimate locked, there is nothing to follow before
+	const double drift = driftCompensation ? clockDrift_.load(std::memory_order_relaxed) : 0.0;
+	followingDrift_ = driftCompensation && (followingDrift_ || drift != 0.0);
+	const bool converting = inputConverter_.isPrepared()
+		&& (inputConverter_.inputRate() != inputConverter_.outputRate() || followingDrift_);
+	if (converting != convertingPlayout_) {
+		// Switching between the direct and the converted path, start the converters from silence
+		inputConverter_.reset();
+		outputConverter_.reset();
+		convertingPlayout_ = converting;
+		resampling_.store(converting, std::memory_order_relaxed);
+	}
+	if (converting) {
+		// When the server runs faster, we play its samples faster and send it more of ours
+		inputConverter_.setRatioAdjustment(1.0 / (1.0 + drift));
+		outputConverter_.setRatioAdjustment(1.0 + drift);
+	}
 
 	// Measure time passed
 	measureSamplesPerTime(qualityInfo, numSamples);
@@ -507,20 +704,23 @@ void JammerNetzAudioEngine::processChunk(const float* const* inputChannelData, i
 			recordingWorker_->enqueue(RecordingTarget::local, inputChannelData, numInputChannels, numSamples);
 		}
 
-		if (numSamples <= inputState->ingestBuffer->getFreeSpace()) {
+		if (converting) {
+			ingestConverted(*inputState->ingestBuffer, inputChannelData, numInputChannels, numSamples);
+		} else if (numSamples <= inputState->ingestBuffer->getFreeSpace()) {
 			inputState->ingestBuffer->write(constnessCorrection, numInputChannels, numSamples);
 		} else {
 			inputBlocksDropped_.fetch_add(1, std::memory_order_relaxed);
 		}
 
-		while (inputState->ingestBuffer->getNumReady() >= SAMPLE_BUFFER_SIZE) {
+		const int blockSize = networkBlockSize_.load(std::memory_order_relaxed);
+		while (inputState->ingestBuffer->getNumReady() >= blockSize) {
 			if (transmitWorker_ && transmitWorker_->hasCapacity()) {
-				if (!transmitWorker_->enqueueFrom(*inputState->ingestBuffer, numInputChannels,
-						clientBpm_.takeLatest(), takeMidiSignalToSend())) {
-					inputState->ingestBuffer->discard(SAMPLE_BUFFER_SIZE);
+				if (!transmitWorker_->enqueueFrom(*inputState->ingestBuffer, numInputChannels, blockSize, sessionRate,
+						clientBpm_.takeLatest(), takeMidiSignalToSend(), captureTimeMs)) {
+					inputState->ingestBuffer->discard(blockSize);
 				}
 			} else {
-				inputState->ingestBuffer->discard(SAMPLE_BUFFER_SIZE);
+				inputState->ingestBuffer->discard(blockSize);
 				if (transmitWorker_) {
 					transmitWorker_->recordDroppedFrame();
 				}
@@ -545,30 +745,37 @@ void JammerNetzAudioEngine::processChunk(const float* const* inputChannelData, i
 		calcLocalMonitoring(inputChannelData, numInputChannels, outputBuffer, inputState->setup);
 	}
 
-	// For playout, we have to have enough bytes in the out ringbuffer to fill the output audio block.
-	// Let's see if we have enough data from the network!
-
-	while (receiveWorker_ && playoutBuffer_->getNumReady() < numSamples) {
-		RemoteAudioFrame frame;
-		if (!receiveWorker_->tryPop(frame)) {
+	// For playout, the claimed frames have to cover the output audio block. The frames stay in the
+	// receive worker's queue and are mixed from there, so the PCM is copied once in this callback.
+	// Let's see if we have enough data from the network! Counted at the session rate.
+	const int playoutSamples = converting ? outputConverter_.inputSamplesFor(numSamples) : numSamples;
+	while (receiveWorker_ && playoutReadySamples() < playoutSamples) {
+		const auto* frame = receiveWorker_->peekFrame(playoutClaimedFrames_);
+		if (!frame) {
 			break;
 		}
-		if (frame.generation != expectedRemoteGeneration_.load(std::memory_order_acquire)) {
+		if (frame->generation != expectedRemoteGeneration_.load(std::memory_order_acquire)) {
+			// Stale frames can only be dropped from the front, after the claimed ones have played
+			if (playoutClaimedFrames_ > 0) {
+				break;
+			}
+			receiveWorker_->discardFrames(1);
 			continue;
 		}
-		std::array<const float*, 2> pointers { frame.samples[0].data(), frame.samples[1].data() };
-		playoutBuffer_->write(pointers.data(), 2, SAMPLE_BUFFER_SIZE);
-		appendPlayoutTiming(frame);
-		qualityInfo.toPlayLatency_ = Time::getMillisecondCounterHiRes() - frame.sourceTimestamp;
+		appendPlayoutTiming(*frame);
+		playoutClaimedSamples_ += frame->numSamples;
+		receiveWorker_->setClaimedFrames(++playoutClaimedFrames_);
+		latencyTrace.stamp(0, frame->sourceMessageCounter, LatencyStage::PlayoutWrite);
+		qualityInfo.toPlayLatency_ = Time::getMillisecondCounterHiRes() - frame->sourceTimestamp;
 	}
 	qualityInfo.currentPlayQueueLength_ = receiveWorker_ ? static_cast<uint64>(receiveWorker_->readyFrames()) : 0;
 	qualityInfo.discardedPackageCounter_ = receiveWorker_ ? receiveWorker_->discardedFrames() : 0;
-	if (!isPlaying_.load(std::memory_order_acquire) && playoutBuffer_->getNumReady() >= numSamples) {
+	if (!isPlaying_.load(std::memory_order_acquire) && playoutReadySamples() >= playoutSamples) {
 		isPlaying_.store(true, std::memory_order_release);
 	}
 
 	if (isPlaying_.load(std::memory_order_acquire)) {
-		if (playoutBuffer_->getNumReady() < numSamples) {
+		if (playoutReadySamples() < playoutSamples) {
 			qualityInfo.playUnderruns_++;
 			isPlaying_.store(false, std::memory_order_release);
 			resetPlayoutState();
@@ -577,14 +784,12 @@ void JammerNetzAudioEngine::processChunk(const float* const* inputChannelData, i
 			}
 		}
 		else {
-			scheduleMidiForPlayout(numSamples);
-			std::array<float*, 2> scratchPointers { remoteScratch_.getWritePointer(0), remoteScratch_.getWritePointer(1) };
-			playoutBuffer_->read(scratchPointers.data(), 2, numSamples);
-
+			scheduleMidiForPlayout(playoutSamples);
 			auto [_, remoteVolume] = calcMonitorGain(monitorBalance_.load(std::memory_order_relaxed));
-			float volume = (float) (remoteVolume * masterVolume_);
-			for (int c = 0; c < std::min(2, outputBuffer.getNumChannels()); c++) {
-				outputBuffer.addFrom(c, 0, remoteScratch_.getReadPointer(c), numSamples, volume);
+			if (converting) {
+				mixConvertedFrames(outputBuffer, numSamples, (float) (remoteVolume * masterVolume_));
+			} else {
+				mixClaimedFrames(outputBuffer, numSamples, (float) (remoteVolume * masterVolume_));
 			}
 		}
 	}
@@ -620,6 +825,114 @@ void JammerNetzAudioEngine::prepare(double sampleRate, int maximumBlockSize)
 	if (auto* tap = outputTap_.load(std::memory_order_acquire)) {
 		tap->prepare(sampleRate, maximumBlockSize);
 	}
+	if (midiPlayalong_) {
+		midiPlayalong_->prepare(sampleRate);
+	}
+	// No callback runs now, so the workers can resize their frames
+	preparedBlockSize_.store(maximumBlockSize, std::memory_order_relaxed);
+	if (transmitWorker_) {
+		transmitWorker_->prepare(configuredInputChannels());
+	}
+	if (recordingWorker_) {
+		recordingWorker_->prepare(recordingChannels(), maximumBlockSize);
+	}
+	// The recordings are made at the device rate, the network runs at the session rate
+	if (masterRecorder_) {
+		masterRecorder_->setChannelInfo(preparedDeviceRate(), stereoRecordingSetup());
+	}
+	if (uploadRecorder_) {
+		if (const auto* inputState = inputState_.load(std::memory_order_acquire)) {
+			uploadRecorder_->setChannelInfo(preparedDeviceRate(), inputState->setup);
+		}
+	}
+	const int inputChannels = std::max(1, configuredInputChannels());
+	inputConverter_.prepare(inputChannels, conversionChunkSamples);
+	convertedInputSamples_ = SampleRateConverter::maximumOutputSamples(conversionChunkSamples);
+	convertedInput_.assign(static_cast<size_t>(inputChannels) * static_cast<size_t>(convertedInputSamples_), 0.0f);
+	for (int channel = 0; channel < inputChannels; ++channel) {
+		convertedInputChannels_[static_cast<size_t>(channel)] = convertedInput_.data() + channel * convertedInputSamples_;
+	}
+	const int sessionSamples = SampleRateConverter::maximumInputSamples(conversionChunkSamples);
+	outputConverter_.prepare(2, sessionSamples);
+	// The session can switch to any supported rate while the device runs, so the callback only picks a filter
+	for (const int sessionRate : SUPPORTED_SAMPLE_RATES) {
+		inputConverter_.prepareRates(preparedDeviceRate(), sessionRate);
+		outputConverter_.prepareRates(sessionRate, preparedDeviceRate());
+	}
+	sessionPlayout_.assign(2 * static_cast<size_t>(sessionSamples), 0.0f);
+	convertedPlayout_.assign(2 * static_cast<size_t>(conversionChunkSamples), 0.0f);
+	for (size_t channel = 0; channel < 2; ++channel) {
+		sessionPlayoutChannels_[channel] = sessionPlayout_.data() + channel * static_cast<size_t>(sessionSamples);
+		convertedPlayoutChannels_[channel] = convertedPlayout_.data() + channel * static_cast<size_t>(conversionChunkSamples);
+	}
+	// Configured by the next callback
+	convertedSessionRate_ = 0;
+	// The device clock starts over, and might be another device
+	driftEstimatorResetRequested_.store(true, std::memory_order_release);
+}
+
+int JammerNetzAudioEngine::preparedDeviceRate() const noexcept
+{
+	return static_cast<int>(std::lround(preparedSampleRate_.load(std::memory_order_relaxed)));
+}
+
+void JammerNetzAudioEngine::publishDeviceClock(std::chrono::steady_clock::time_point callbackStart, int numSamples) noexcept
+{
+	const auto sequence = deviceClockSequence_.load(std::memory_order_relaxed);
+	deviceClockSequence_.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	deviceClockSamples_.store(deviceSamplesPlayed_, std::memory_order_relaxed);
+	deviceClockNanoseconds_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(callbackStart.time_since_epoch()).count(),
+		std::memory_order_relaxed);
+	deviceClockSequence_.store(sequence + 2, std::memory_order_release);
+	deviceSamplesPlayed_ += static_cast<uint64_t>(numSamples);
+}
+
+void JammerNetzAudioEngine::observeServerClock(int sessionRate, uint64 serverTime) noexcept
+{
+	if (driftEstimatorResetRequested_.exchange(false, std::memory_order_acq_rel) || sessionRate != driftEstimatorSessionRate_) {
+		driftEstimator_.reset();
+		driftEstimatorSessionRate_ = sessionRate;
+		clockDrift_.store(0.0, std::memory_order_relaxed);
+	}
+	if (serverTime == 0) {
+		return;
+	}
+
+	// Where the device is now, interpolated from the last callback. Whole callbacks would be too coarse.
+	uint64_t samples = 0;
+	int64_t callbackNanoseconds = 0;
+	bool consistent = false;
+	for (int attempt = 0; attempt < 4 && !consistent; ++attempt) {
+		const auto sequence = deviceClockSequence_.load(std::memory_order_acquire);
+		samples = deviceClockSamples_.load(std::memory_order_relaxed);
+		callbackNanoseconds = deviceClockNanoseconds_.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		consistent = (sequence & 1U) == 0 && deviceClockSequence_.load(std::memory_order_relaxed) == sequence;
+	}
+	const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	const auto sinceCallback = now - callbackNanoseconds;
+	// No callback for a while means the device is not running, its clock tells us nothing
+	constexpr int64_t stalledNanoseconds = 100'000'000;
+	const auto deviceRate = preparedSampleRate_.load(std::memory_order_relaxed);
+	if (!consistent || callbackNanoseconds == 0 || sinceCallback < 0 || sinceCallback > stalledNanoseconds || deviceRate <= 0.0) {
+		return;
+	}
+	const double deviceSamples = static_cast<double>(samples) + static_cast<double>(sinceCallback) * 1.0e-9 * deviceRate;
+	driftEstimator_.addObservation(deviceSamples * sessionRate / deviceRate, static_cast<double>(serverTime));
+	clockDrift_.store(driftEstimator_.drift(), std::memory_order_relaxed);
+}
+
+int JammerNetzAudioEngine::configuredInputChannels() const
+{
+	const auto* inputState = inputState_.load(std::memory_order_acquire);
+	return inputState ? static_cast<int>(inputState->setup.channels.size()) : 0;
+}
+
+int JammerNetzAudioEngine::recordingChannels() const
+{
+	// The master recording is stereo
+	return std::max(configuredInputChannels(), 2);
 }
 
 void JammerNetzAudioEngine::release()
@@ -651,7 +964,7 @@ void JammerNetzAudioEngine::setChannelSetup(JammerNetzChannelSetup const &channe
 		ingestBuffer = channelSetup.channels.empty() ? nullptr : std::make_shared<RingBuffer>(static_cast<int>(channelSetup.channels.size()), INGEST_RINGBUFFER_SIZE);
 	}
 	if (uploadRecorder_) {
-		uploadRecorder_->setChannelInfo(SAMPLE_RATE, channelSetup);
+		uploadRecorder_->setChannelInfo(preparedDeviceRate(), channelSetup);
 	}
 
 	inputChannelMismatchReported_.store(false, std::memory_order_release);
@@ -702,6 +1015,7 @@ PlayoutQualityInfo JammerNetzAudioEngine::getPlayoutQualityInfo()
 	latest.discardedPackageCounter_ = publishedDiscarded_.load(std::memory_order_relaxed);
 	latest.toPlayLatency_ = publishedLatency_.load(std::memory_order_relaxed);
 	latest.measuredSampleRate = publishedSampleRate_.load(std::memory_order_relaxed);
+	latest.clockDriftPpm = clockDrift() * 1.0e6;
 	return latest;
 }
 
@@ -712,10 +1026,15 @@ RealtimeWorkerStats JammerNetzAudioEngine::getRealtimeWorkerStats() const
 	stats.maximumCallbackNanoseconds = maximumCallbackNanoseconds_.load(std::memory_order_relaxed);
 	stats.callbackDeadlineMisses = callbackDeadlineMisses_.load(std::memory_order_relaxed);
 	stats.inputBlocksDropped = inputBlocksDropped_.load(std::memory_order_relaxed);
+	stats.driftCompensation = driftCompensation_.load(std::memory_order_relaxed);
+	stats.clockDriftPpm = clockDrift() * 1.0e6;
+	stats.resampling = resampling_.load(std::memory_order_relaxed);
 	if (transmitWorker_) {
 		stats.transmitFramesQueued = transmitWorker_->enqueuedFrames();
 		stats.transmitFramesSent = transmitWorker_->sentFrames();
 		stats.transmitFramesDropped = transmitWorker_->droppedFrames();
+		stats.transmitInline = transmitWorker_->isInlineTransmit();
+		stats.frameBytes += transmitWorker_->frameBytes();
 	}
 	if (receiveWorker_) {
 		stats.receiveFramesDiscarded = receiveWorker_->discardedFrames();
@@ -724,6 +1043,7 @@ RealtimeWorkerStats JammerNetzAudioEngine::getRealtimeWorkerStats() const
 	if (recordingWorker_) {
 		stats.recordingFramesWritten = recordingWorker_->writtenFrames();
 		stats.recordingFramesDropped = recordingWorker_->droppedFrames();
+		stats.frameBytes += recordingWorker_->frameBytes();
 	}
 	stats.midiTransportCommandsDropped = midiTransportCommandsDropped_.load(std::memory_order_relaxed);
 	stats.midiTimingMarkersDropped = midiTimingMarkersDropped_.load(std::memory_order_relaxed);
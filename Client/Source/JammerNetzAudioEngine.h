@@ -24,6 +24,8 @@
 #include "MidiRecorder.h"
 #include "MidiPlayAlong.h"
 #include "MidiSendThread.h"
+#include "SampleRateConverter.h"
+#include "ClockDriftEstimator.h"
 
 #include "AtomicSharedPtr.h"
 
@@ -35,7 +37,7 @@
 struct PlayoutQualityInfo {
 	PlayoutQualityInfo()
 		: currentPlayQueueLength_(0), playUnderruns_(0), discardedPackageCounter_(0),
-		toPlayLatency_(0.0), numSamplesSinceStart_(-1), measuredSampleRate(0.0) {}
+		toPlayLatency_(0.0), numSamplesSinceStart_(-1), measuredSampleRate(0.0), clockDriftPpm(0.0) {}
 
 	uint64 currentPlayQueueLength_; // Prepared PCM frames waiting in AudioReceiveWorker.
 	uint64 playUnderruns_;
@@ -46,6 +48,7 @@ struct PlayoutQualityInfo {
 	std::chrono::time_point<std::chrono::steady_clock> startTime_;
 	std::chrono::time_point<std::chrono::steady_clock> lastTime_;
 	double measuredSampleRate; // in Hz
+	double clockDriftPpm; // How much faster the server's clock runs, 0 until the estimate is locked
 };
 
 struct RealtimeWorkerStats {
@@ -56,10 +59,19 @@ struct RealtimeWorkerStats {
 	uint64_t transmitFramesQueued { 0 };
 	uint64_t transmitFramesSent { 0 };
 	uint64_t transmitFramesDropped { 0 };
+	// The callback serializes the packets itself, the callback times above include that
+	bool transmitInline { false };
+	// The playout and the input are resampled to follow the server's clock, once its drift is known
+	bool driftCompensation { false };
+	double clockDriftPpm { 0.0 };
+	// The converters are in the path, for another device rate or to follow the drift
+	bool resampling { false };
 	uint64_t receiveFramesDiscarded { 0 };
 	uint64_t receiveQueueOverruns { 0 };
 	uint64_t recordingFramesWritten { 0 };
 	uint64_t recordingFramesDropped { 0 };
+	// Sample storage preallocated for the transmit and recording queues
+	size_t frameBytes { 0 };
 	uint64_t midiTransportCommandsDropped { 0 };
 	uint64_t midiOutputEventsDropped { 0 };
 	uint64_t midiTimingMarkersDropped { 0 };
@@ -106,9 +118,13 @@ public:
 	void setMidiSignalToSend(MidiSignal signal);
 
 	void process(const float* const* inputChannelData, int numInputChannels, float* const* outputChannelData, int numOutputChannels, int numSamples);
+	// Also sizes the worker queues for the configured input channels and this block size, so set the channel setup first
 	void prepare(double sampleRate, int maximumBlockSize);
 	void release();
 	void setOutputTap(AudioOutputTap* tap) noexcept;
+	// Called by the network receive thread. The view is decoded straight into the jitter buffer, so a packet from
+	// the server costs no allocation.
+	void enqueueRemoteAudio(const JammerNetzAudioDataView& packet);
 	void enqueueRemoteAudio(std::shared_ptr<JammerNetzAudioData> buffer);
 	// Headless callers use this instead of starting the background transmit thread.
 	bool processNextOutgoingPacket();
@@ -116,6 +132,17 @@ public:
 	bool processNextIncomingPacket();
 
 	void setPlayoutBufferRange(uint64 minimumLength, uint64 maximumLength);
+	// Samples per network packet. Follows the block size of the packets received from the server.
+	void setNetworkBlockSize(int sampleBufferSize);
+	int networkBlockSize() const noexcept;
+	// The rate the server mixes at, taken from its packets. A device at another rate is converted to and from it.
+	int sessionSampleRate() const noexcept;
+	void setInlineTransmit(bool enabled);
+	// Trims the conversion to the session rate by the estimated drift of the server's clock against the device's,
+	// so the playout buffer keeps its depth over long sessions. Converts at equal rates too, adding 16 samples latency.
+	void setDriftCompensation(bool enabled);
+	// How much faster the server's clock runs than the device's, as a fraction. 0.0 until the estimate has locked.
+	double clockDrift() const noexcept;
 	void setMasterVolume(double volume);
 	void setMonitorBalance(double balance);
 	void setLocalMonitoring(bool enabled);
@@ -162,15 +189,26 @@ private:
 	};
 
 	void measureSamplesPerTime(PlayoutQualityInfo &qualityInfo, int numSamples) const;
+	int preparedDeviceRate() const noexcept;
+	void publishDeviceClock(std::chrono::steady_clock::time_point callbackStart, int numSamples) noexcept;
+	void observeRemoteAudio(int numSamples, int sampleRate, uint64 serverTime);
+	void observeServerClock(int sessionRate, uint64 serverTime) noexcept;
+	int configuredInputChannels() const;
+	int recordingChannels() const;
 	void processChunk(const float* const* inputChannelData, int numInputChannels, float* const* outputChannelData,
 		int numOutputChannels, int numSamples);
 
 	void calcLocalMonitoring(const float* const* inputChannels, int numInputChannels, AudioBuffer<float>& outputBuffer,
 		const JammerNetzChannelSetup& channelSetup);
+	int playoutReadySamples() const noexcept;
+	void mixClaimedFrames(AudioBuffer<float>& outputBuffer, int numSamples, float volume) noexcept;
+	void mixConvertedFrames(AudioBuffer<float>& outputBuffer, int numSamples, float volume) noexcept;
+	void ingestConverted(RingBuffer& ingestBuffer, const float* const* inputChannelData, int numInputChannels, int numSamples) noexcept;
+	void configureRateConversion(int deviceRate, int sessionRate) noexcept;
 	void resetPlayoutState() noexcept;
 	void appendPlayoutTiming(const RemoteAudioFrame& frame) noexcept;
 	void scheduleMidiForPlayout(int numSamples) noexcept;
-	void scheduleMidiFrame(MidiSendThread* sender, uint64 serverSampleEnd, float bpm,
+	void scheduleMidiFrame(MidiSendThread* sender, uint64 serverSampleEnd, int frameSamples, float bpm,
 		MidiSignal signal, uint64_t frameOffsetSamples,
 		std::chrono::steady_clock::time_point playoutStart) noexcept;
 	std::optional<MidiSignal> takeMidiSignalToSend() noexcept;
@@ -185,8 +223,11 @@ private:
 	std::atomic<uint64_t> completedAudioEpoch_ { 0 };
 	std::atomic<uint32_t> activeAudioCallbacks_ { 0 };
 	std::atomic<bool> shutdownRequested_ { false };
-	std::unique_ptr<RingBuffer> playoutBuffer_;
-	juce::AudioBuffer<float> remoteScratch_;
+	// Frames at the front of the receive worker's queue that are due for playout, the first
+	// of them has played up to playoutFrameOffset_. Only touched by the audio callback.
+	int playoutClaimedFrames_ { 0 };
+	int playoutClaimedSamples_ { 0 };
+	int playoutFrameOffset_ { 0 };
 	std::array<float, JAMMERNETZ_MAX_CALLBACK_SAMPLES> silentMeterChannel_ {};
 	std::atomic<AudioOutputTap*> outputTap_ { nullptr };
 
@@ -227,10 +268,12 @@ private:
 	struct PlayoutTimingMarker {
 		uint64_t playoutSample { 0 };
 		uint64 serverSampleEnd { 0 };
+		int numSamples { 0 };
 		float bpm { 0.0f };
 		MidiSignal midiSignal { MidiSignal_None };
+		uint64 sourceMessageCounter { 0 };
 	};
-	static constexpr size_t maxPlayoutTimingMarkers = PLAYOUT_RINGBUFFER_SIZE / SAMPLE_BUFFER_SIZE + 1;
+	static constexpr size_t maxPlayoutTimingMarkers = PLAYOUT_RINGBUFFER_SIZE / MINIMUM_SAMPLE_BUFFER_SIZE + 1;
 	std::array<PlayoutTimingMarker, maxPlayoutTimingMarkers> playoutTimingMarkers_ {};
 	size_t playoutTimingRead_ { 0 };
 	size_t playoutTimingWrite_ { 0 };
@@ -245,6 +288,38 @@ private:
 	std::atomic<double> publishedLatency_ { 0.0 };
 	std::atomic<double> publishedSampleRate_ { 0.0 };
 	std::atomic<double> preparedSampleRate_ { SAMPLE_RATE };
+	std::atomic<int> preparedBlockSize_ { 0 };
+	std::atomic<int> networkBlockSize_ { SAMPLE_BUFFER_SIZE };
+	std::atomic<int> sessionSampleRate_ { SAMPLE_RATE };
+	// Device to session rate for the input, session to device rate for the playout. Sized in prepare(),
+	// everything else only touched by the audio callback.
+	static constexpr int conversionChunkSamples = 512;
+	SampleRateConverter inputConverter_;
+	SampleRateConverter outputConverter_;
+	std::vector<float> convertedInput_;
+	std::array<float*, JAMMERNETZ_MAX_AUDIO_CHANNELS> convertedInputChannels_ {};
+	int convertedInputSamples_ { 0 };
+	std::vector<float> sessionPlayout_;
+	std::array<float*, 2> sessionPlayoutChannels_ {};
+	std::vector<float> convertedPlayout_;
+	std::array<float*, 2> convertedPlayoutChannels_ {};
+	int convertedSessionRate_ { 0 };
+	bool convertingPlayout_ { false };
+	// Set once the drift estimate locked, so the converters stay in the path when it briefly reads zero again
+	bool followingDrift_ { false };
+	std::atomic<bool> resampling_ { false };
+	std::atomic<bool> driftCompensation_ { false };
+	// Samples the device has played and when the callback started, a sequence lock so the network thread
+	// reads both from the same callback. Odd while the audio callback writes.
+	std::atomic<uint32_t> deviceClockSequence_ { 0 };
+	std::atomic<uint64_t> deviceClockSamples_ { 0 };
+	std::atomic<int64_t> deviceClockNanoseconds_ { 0 };
+	uint64_t deviceSamplesPlayed_ { 0 };
+	// Only used by the thread receiving the packets
+	ClockDriftEstimator driftEstimator_;
+	int driftEstimatorSessionRate_ { 0 };
+	std::atomic<bool> driftEstimatorResetRequested_ { false };
+	std::atomic<double> clockDrift_ { 0.0 };
 	std::atomic<uint64_t> callbackCount_ { 0 };
 	std::atomic<uint64_t> maximumCallbackNanoseconds_ { 0 };
 	std::atomic<uint64_t> callbackDeadlineMisses_ { 0 };
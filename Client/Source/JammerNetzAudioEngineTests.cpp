@@ -5,22 +5,37 @@
 */
 
 #include "JammerNetzAudioEngine.h"
+#include "AllocationCounter.h"
 #include "AudioReceiveWorker.h"
 #include "BuffersConfig.h"
 #include "DeterministicAudioTestSupport.h"
 #include "BoundedSpscQueue.h"
+#include "ClockDriftEstimator.h"
+#include "FixedPacketStreamQueue.h"
+#include "JammerNetzMessageView.h"
+#include "NetworkImpairment.h"
 #include "RingBuffer.h"
+#include "SampleRateConverter.h"
+#include "Tuner.h"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cmath>
 #include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
 #include <type_traits>
+#include <variant>
 #include <vector>
 
 namespace {
 
+using jammernetz::test::AllocationCounter;
+
 class CapturingOutputTap final : public AudioOutputTap {
 public:
 	void prepare(double sampleRate, int maximumBlockSize) override
@@ -66,7 +81,7 @@ public:
 		auto capturedAudio = std::make_shared<AudioBuffer<float>>();
 		*capturedAudio = *audioBuffer;
 		packets.push_back(std::make_shared<JammerNetzAudioData>(
-			nextMessageCounter++, nextTimestamp++, channelSetup, SAMPLE_RATE,
+			nextMessageCounter++, nextTimestamp++, channelSetup, controllers.sampleRate,
 			controllers.bpm, midiSignal, std::move(capturedAudio), nullptr));
 		return true;
 	}
@@ -78,7 +93,42 @@ private:
 	double nextTimestamp { 0.0 };
 };
 
+// Receives the datagrams of the inline transmit mode on its sender thread
+class CapturingDatagramSink final : public AudioPacketSink, public AudioDatagramSink {
+public:
+	bool sendData(JammerNetzChannelSetup const&, std::shared_ptr<AudioBuffer<float>>, ControlData) override
+	{
+		workerPackets.fetch_add(1);
+		return true;
+	}
+
+	uint64 nextMessageCounter() noexcept override { return counter_.fetch_add(1); }
+
+	int sendDatagrams(uint8* const* datagrams, const size_t* sizes, int count) override
+	{
+		const std::lock_guard<std::mutex> lock(lock_);
+		for (int index = 0; index < count; ++index) {
+			packets_.push_back(std::dynamic_pointer_cast<JammerNetzAudioData>(JammerNetzMessage::deserialize(datagrams[index], sizes[index])));
+		}
+		return count;
+	}
+
+	std::vector<std::shared_ptr<JammerNetzAudioData>> packets() const
+	{
+		const std::lock_guard<std::mutex> lock(lock_);
+		return packets_;
+	}
+
+	std::atomic<int> workerPackets { 0 };
+
+private:
+	std::atomic<uint64> counter_ { 10 };
+	mutable std::mutex lock_;
+	std::vector<std::shared_ptr<JammerNetzAudioData>> packets_;
+};
+
 static_assert(std::is_base_of_v<AudioPacketSink, Client>);
+static_assert(std::is_base_of_v<AudioDatagramSink, Client>);
 
 TEST(RingBufferTest, ReadsFromTheFifoStartAfterWrapping)
 {
@@ -112,6 +162,30 @@ std::shared_ptr<JammerNetzAudioData> remotePacket(uint64 counter)
 		counter, juce::Time::getMillisecondCounterHiRes(), setup, SAMPLE_RATE, 120.0f, MidiSignal_None, audio, nullptr);
 }
 
+// Every sample is the counter, the FEC copy of the predecessor is marked by an extra half
+std::shared_ptr<JammerNetzAudioData> sequencedPacket(uint64 counter, bool withFec)
+{
+	JammerNetzChannelSetup setup(false, {
+		JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Left),
+		JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Right)
+	});
+	auto audio = std::make_shared<juce::AudioBuffer<float>>(2, SAMPLE_BUFFER_SIZE);
+	for (int channel = 0; channel < 2; ++channel) {
+		juce::FloatVectorOperations::fill(audio->getWritePointer(channel), static_cast<float>(counter), SAMPLE_BUFFER_SIZE);
+	}
+	AudioBlock block(static_cast<double>(counter), counter, counter * SAMPLE_BUFFER_SIZE, 120.0f, MidiSignal_Start, SAMPLE_RATE, setup, audio);
+	std::shared_ptr<AudioBlock> fec;
+	if (withFec && counter > 0) {
+		auto previous = std::make_shared<juce::AudioBuffer<float>>(2, SAMPLE_BUFFER_SIZE);
+		for (int channel = 0; channel < 2; ++channel) {
+			juce::FloatVectorOperations::fill(previous->getWritePointer(channel), static_cast<float>(counter - 1) + 0.5f, SAMPLE_BUFFER_SIZE);
+		}
+		fec = std::make_shared<AudioBlock>(static_cast<double>(counter - 1), counter - 1, (counter - 1) * SAMPLE_BUFFER_SIZE,
+			120.0f, MidiSignal_None, SAMPLE_RATE, setup, previous);
+	}
+	return std::make_shared<JammerNetzAudioData>(block, fec);
+}
+
 TEST(JammerNetzSessionTest, ConstructionHasNoExternalSideEffects)
 {
 	JammerNetzSession session;
@@ -303,6 +377,384 @@ TEST(JammerNetzAudioEngineTest, MixesASimulatedRemoteFrame)
 	EXPECT_FLOAT_EQ(*serverBpm, 120.0f);
 }
 
+TEST(JammerNetzAudioEngineTest, MixesRemoteFramesAcrossCallbackBoundaries)
+{
+	JammerNetzSession session;
+	JammerNetzAudioEngine engine(session, juce::File());
+	engine.setPlayoutBufferRange(1, 4);
+	engine.setLocalMonitoring(false);
+
+	// A ramp across three frames, played back in callbacks of 96 samples
+	constexpr int frames = 3;
+	for (int counter = 1; counter <= frames; ++counter) {
+		auto packet = remotePacket(static_cast<uint64>(counter));
+		for (int sample = 0; sample < SAMPLE_BUFFER_SIZE; ++sample) {
+			const auto value = 1.0e-4f * static_cast<float>((counter - 1) * SAMPLE_BUFFER_SIZE + sample);
+			packet->audioBuffer()->setSample(0, sample, value);
+			packet->audioBuffer()->setSample(1, sample, -value);
+		}
+		engine.enqueueRemoteAudio(packet);
+	}
+	for (int frame = 0; frame < frames; ++frame) {
+		ASSERT_TRUE(engine.processNextIncomingPacket());
+	}
+
+	constexpr int blockSize = 96;
+	const float gain = static_cast<float>(std::sqrt(0.5));
+	float unusedInput = 0.0f;
+	const float* inputs[] { &unusedInput };
+	for (int block = 0; block < frames * SAMPLE_BUFFER_SIZE / blockSize; ++block) {
+		std::array<float, blockSize> left {};
+		std::array<float, blockSize> right {};
+		float* outputs[] { left.data(), right.data() };
+		engine.process(inputs, 0, outputs, 2, blockSize);
+		for (int sample = 0; sample < blockSize; ++sample) {
+			const auto expected = gain * 1.0e-4f * static_cast<float>(block * blockSize + sample);
+			ASSERT_NEAR(left[static_cast<size_t>(sample)], expected, 1.0e-5f);
+			ASSERT_NEAR(right[static_cast<size_t>(sample)], -expected, 1.0e-5f);
+		}
+	}
+	EXPECT_EQ(engine.getPlayoutQualityInfo().playUnderruns_, 0u);
+}
+
+TEST(JammerNetzAudioEngineTest, FollowsTheBlockSizeOfTheServer)
+{
+	JammerNetzSession session;
+	auto sink = std::make_shared<CapturingAudioPacketSink>();
+	JammerNetzAudioEngine engine(session, juce::File(), sink);
+	engine.setChannelSetup(monoLocalSetup());
+	engine.prepare(48000.0, SAMPLE_BUFFER_SIZE);
+	engine.setPlayoutBufferRange(1, 4);
+	engine.setLocalMonitoring(false);
+	EXPECT_EQ(engine.networkBlockSize(), SAMPLE_BUFFER_SIZE);
+
+	// The minimum of one 128 sample block takes two blocks of 64
+	constexpr int serverBlockSize = 64;
+	JammerNetzChannelSetup remoteSetup(false, {
+		JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Left),
+		JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Right)
+	});
+	for (uint64 counter = 1; counter <= 2; ++counter) {
+		auto remoteAudio = std::make_shared<juce::AudioBuffer<float>>(2, serverBlockSize);
+		for (int channel = 0; channel < 2; ++channel) {
+			juce::FloatVectorOperations::fill(remoteAudio->getWritePointer(channel), 0.25f, serverBlockSize);
+		}
+		engine.enqueueRemoteAudio(std::make_shared<JammerNetzAudioData>(
+			counter, juce::Time::getMillisecondCounterHiRes(), remoteSetup, SAMPLE_RATE, 120.0f, MidiSignal_None, remoteAudio, nullptr));
+	}
+	EXPECT_EQ(engine.networkBlockSize(), serverBlockSize);
+	ASSERT_TRUE(engine.processNextIncomingPacket());
+	ASSERT_TRUE(engine.processNextIncomingPacket());
+
+	std::array<float, SAMPLE_BUFFER_SIZE> input;
+	std::array<float, SAMPLE_BUFFER_SIZE> left {};
+	std::array<float, SAMPLE_BUFFER_SIZE> right {};
+	input.fill(0.5f);
+	const float* inputs[] { input.data() };
+	float* outputs[] { left.data(), right.data() };
+	engine.process(inputs, 1, outputs, 2, SAMPLE_BUFFER_SIZE);
+
+	const float expectedGain = static_cast<float>(0.25 * std::sqrt(0.5));
+	EXPECT_NEAR(left.front(), expectedGain, 1.0e-5f);
+	EXPECT_NEAR(left.back(), expectedGain, 1.0e-5f);
+	EXPECT_NEAR(right.back(), expectedGain, 1.0e-5f);
+	EXPECT_EQ(engine.getPlayoutQualityInfo().playUnderruns_, 0u);
+
+	ASSERT_TRUE(engine.processNextOutgoingPacket());
+	ASSERT_TRUE(engine.processNextOutgoingPacket());
+	EXPECT_FALSE(engine.processNextOutgoingPacket());
+	ASSERT_EQ(sink->packets.size(), 2U);
+	for (const auto& packet : sink->packets) {
+		ASSERT_EQ(packet->audioBuffer()->getNumSamples(), serverBlockSize);
+		EXPECT_FLOAT_EQ(packet->audioBuffer()->getSample(0, serverBlockSize - 1), 0.5f);
+	}
+}
+
+TEST(JammerNetzAudioEngineTest, ConvertsBetweenTheDeviceAndTheSessionRate)
+{
+	JammerNetzSession session;
+	auto sink = std::make_shared<CapturingAudioPacketSink>();
+	JammerNetzAudioEngine engine(session, juce::File(), sink);
+	engine.setChannelSetup(monoLocalSetup());
+	engine.prepare(44100.0, SAMPLE_BUFFER_SIZE);
+	engine.setPlayoutBufferRange(1, 16);
+	engine.setLocalMonitoring(false);
+
+	// 512 samples at 44.1 kHz take 558 at 48 kHz, plus the converter's lookahead
+	constexpr int frames = 8;
+	for (int counter = 1; counter <= frames; ++counter) {
+		auto packet = remotePacket(static_cast<uint64>(counter));
+		for (int channel = 0; channel < 2; ++channel) {
+			juce::FloatVectorOperations::fill(packet->audioBuffer()->getWritePointer(channel), 0.25f, SAMPLE_BUFFER_SIZE);
+		}
+		engine.enqueueRemoteAudio(packet);
+	}
+	for (int frame = 0; frame < frames; ++frame) {
+		ASSERT_TRUE(engine.processNextIncomingPacket());
+	}
+	EXPECT_EQ(engine.sessionSampleRate(), SAMPLE_RATE);
+
+	std::array<float, SAMPLE_BUFFER_SIZE> input;
+	input.fill(0.5f);
+	const float* inputs[] { input.data() };
+	std::array<float, SAMPLE_BUFFER_SIZE> left {};
+	std::array<float, SAMPLE_BUFFER_SIZE> right {};
+	for (int block = 0; block < 4; ++block) {
+		float* outputs[] { left.data(), right.data() };
+		engine.process(inputs, 1, outputs, 2, SAMPLE_BUFFER_SIZE);
+	}
+	const float expectedGain = static_cast<float>(0.25 * std::sqrt(0.5));
+	EXPECT_NEAR(left.back(), expectedGain, 1.0e-3f);
+	EXPECT_NEAR(right.back(), expectedGain, 1.0e-3f);
+	EXPECT_EQ(engine.getPlayoutQualityInfo().playUnderruns_, 0u);
+
+	while (engine.processNextOutgoingPacket()) {
+	}
+	ASSERT_EQ(sink->packets.size(), 4U);
+	for (const auto& packet : sink->packets) {
+		EXPECT_EQ(packet->sampleRate(), SAMPLE_RATE);
+		ASSERT_EQ(packet->audioBuffer()->getNumSamples(), SAMPLE_BUFFER_SIZE);
+	}
+	EXPECT_NEAR(sink->packets.back()->audioBuffer()->getSample(0, SAMPLE_BUFFER_SIZE - 1), 0.5f, 1.0e-3f);
+
+	// A server running at another rate takes the engine along
+	auto fastPacket = std::make_shared<JammerNetzAudioData>(static_cast<uint64>(frames + 1), juce::Time::getMillisecondCounterHiRes(),
+		remotePacket(0)->channelSetup(), 96000, 120.0f, MidiSignal_None, std::make_shared<juce::AudioBuffer<float>>(2, SAMPLE_BUFFER_SIZE), nullptr);
+	engine.enqueueRemoteAudio(fastPacket);
+	EXPECT_EQ(engine.sessionSampleRate(), 96000);
+}
+
+TEST(JammerNetzAudioEngineTest, PlaysDirectlyUntilTheServerClockIsKnown)
+{
+	JammerNetzSession session;
+	auto sink = std::make_shared<CapturingAudioPacketSink>();
+	JammerNetzAudioEngine engine(session, juce::File(), sink);
+	engine.setChannelSetup(monoLocalSetup());
+	engine.prepare(SAMPLE_RATE, SAMPLE_BUFFER_SIZE);
+	engine.setPlayoutBufferRange(1, 16);
+	engine.setLocalMonitoring(false);
+	engine.setDriftCompensation(true);
+
+	constexpr int frames = 8;
+	for (int counter = 1; counter <= frames; ++counter) {
+		auto packet = remotePacket(static_cast<uint64>(counter));
+		for (int channel = 0; channel < 2; ++channel) {
+			juce::FloatVectorOperations::fill(packet->audioBuffer()->getWritePointer(channel), 0.25f, SAMPLE_BUFFER_SIZE);
+		}
+		engine.enqueueRemoteAudio(packet);
+	}
+	for (int frame = 0; frame < frames; ++frame) {
+		ASSERT_TRUE(engine.processNextIncomingPacket());
+	}
+
+	std::array<float, SAMPLE_BUFFER_SIZE> input;
+	input.fill(0.5f);
+	const float* inputs[] { input.data() };
+	std::array<float, SAMPLE_BUFFER_SIZE> left {};
+	std::array<float, SAMPLE_BUFFER_SIZE> right {};
+	for (int block = 0; block < 4; ++block) {
+		float* outputs[] { left.data(), right.data() };
+		engine.process(inputs, 1, outputs, 2, SAMPLE_BUFFER_SIZE);
+	}
+	const float expectedGain = static_cast<float>(0.25 * std::sqrt(0.5));
+	EXPECT_NEAR(left.back(), expectedGain, 1.0e-3f);
+	EXPECT_NEAR(right.back(), expectedGain, 1.0e-3f);
+	EXPECT_EQ(engine.getPlayoutQualityInfo().playUnderruns_, 0u);
+	// A few packets are not enough to tell the drift, so there is nothing to resample for yet
+	const auto stats = engine.getRealtimeWorkerStats();
+	EXPECT_TRUE(stats.driftCompensation);
+	EXPECT_EQ(stats.clockDriftPpm, 0.0);
+	EXPECT_FALSE(stats.resampling);
+
+	while (engine.processNextOutgoingPacket()) {
+	}
+	ASSERT_EQ(sink->packets.size(), 3U);
+	EXPECT_NEAR(sink->packets.back()->audioBuffer()->getSample(0, SAMPLE_BUFFER_SIZE - 1), 0.5f, 1.0e-3f);
+}
+
+TEST(SampleRateConverterTest, ConvertsASineBetweenCommonRates)
+{
+	constexpr std::array<std::array<int, 2>, 4> rates { { { 44100, 48000 }, { 48000, 44100 }, { 48000, 96000 }, { 96000, 44100 } } };
+	for (const auto& [inputRate, outputRate] : rates) {
+		SCOPED_TRACE(inputRate);
+		SCOPED_TRACE(outputRate);
+		SampleRateConverter converter;
+		converter.prepare(1, 512);
+		converter.setRates(inputRate, outputRate);
+		std::vector<float> input(512);
+		std::vector<float> output(static_cast<size_t>(SampleRateConverter::maximumOutputSamples(512)));
+		const double frequency = 1000.0;
+		int64_t consumed = 0;
+		int64_t produced = 0;
+		float maximumError = 0.0f;
+		// Odd block sizes, so the phase does not repeat with the blocks
+		for (int block = 0; block < 50; ++block) {
+			const int samples = 37 + (block * 131) % 476;
+			for (int sample = 0; sample < samples; ++sample) {
+				input[static_cast<size_t>(sample)] = static_cast<float>(std::sin(2.0 * juce::MathConstants<double>::pi * frequency
+					* static_cast<double>(consumed + sample) / inputRate));
+			}
+			const float* in[] { input.data() };
+			float* out[] { output.data() };
+			const int expected = converter.outputSamplesFor(samples);
+			const int written = converter.process(in, 1, samples, out, static_cast<int>(output.size()));
+			ASSERT_EQ(written, expected);
+			for (int sample = 0; sample < written; ++sample) {
+				// The first outputs still see the silence before the start
+				if (produced + sample < SampleRateConverter::taps) {
+					continue;
+				}
+				const auto ideal = std::sin(2.0 * juce::MathConstants<double>::pi * frequency * static_cast<double>(produced + sample) / outputRate);
+				maximumError = std::max(maximumError, std::abs(output[static_cast<size_t>(sample)] - static_cast<float>(ideal)));
+			}
+			consumed += samples;
+			produced += written;
+		}
+		EXPECT_LT(maximumError, 1.0e-3f);
+		// Never more than the lookahead behind the exact ratio
+		EXPECT_NEAR(static_cast<double>(produced), static_cast<double>(consumed) * outputRate / inputRate,
+			SampleRateConverter::taps / 2.0 * outputRate / inputRate + 1.0);
+	}
+}
+
+TEST(SampleRateConverterTest, PullsExactlyTheInputForTheOutputWithoutAllocating)
+{
+	SampleRateConverter converter;
+	converter.prepare(2, SampleRateConverter::maximumInputSamples(512));
+	converter.setRates(48000, 44100);
+	std::vector<float> input(static_cast<size_t>(SampleRateConverter::maximumInputSamples(512)), 0.25f);
+	std::array<float, 500> left {};
+	std::array<float, 500> right {};
+	const float* in[] { input.data(), input.data() };
+	float* out[] { left.data(), right.data() };
+
+	// The playout claims the input for a whole callback, then converts it in chunks
+	const int total = converter.inputSamplesFor(3000);
+	int pulled = 0;
+	uint64_t allocations = 0;
+	{
+		AllocationCounter counter;
+		for (int chunk = 0; chunk < 6; ++chunk) {
+			const int needed = converter.inputSamplesFor(500);
+			pulled += needed;
+			ASSERT_EQ(converter.process(in, 2, needed, out, 500), 500);
+		}
+		allocations = counter.allocations();
+	}
+	EXPECT_EQ(pulled, total);
+	EXPECT_NEAR(left.back(), 0.25f, 1.0e-4f);
+	EXPECT_NEAR(right.back(), 0.25f, 1.0e-4f);
+	if (!AllocationCounter::enabled) {
+		GTEST_SKIP() << "Allocations are only counted with JAMMERNETZ_ALLOCATION_TESTS";
+	}
+	EXPECT_EQ(allocations, 0u);
+}
+
+TEST(SampleRateConverterTest, SwitchesToPreparedRatesWithoutAllocating)
+{
+	SampleRateConverter prepared;
+	prepared.prepare(1, 512);
+	prepared.prepareRates(48000, 44100);
+	prepared.prepareRates(48000, 96000);
+	SampleRateConverter computed;
+	computed.prepare(1, 512);
+	computed.setRates(48000, 96000);
+	uint64_t allocations = 0;
+	{
+		AllocationCounter counter;
+		prepared.setRates(48000, 44100);
+		prepared.setRates(48000, 96000);
+		allocations = counter.allocations();
+	}
+
+	std::vector<float> input(512);
+	for (size_t sample = 0; sample < input.size(); ++sample) {
+		input[sample] = static_cast<float>(std::sin(0.05 * static_cast<double>(sample)));
+	}
+	std::vector<float> fromPrepared(static_cast<size_t>(SampleRateConverter::maximumOutputSamples(512)));
+	std::vector<float> fromComputed(fromPrepared.size());
+	const float* in[] { input.data() };
+	float* preparedOut[] { fromPrepared.data() };
+	float* computedOut[] { fromComputed.data() };
+	const int written = prepared.process(in, 1, 512, preparedOut, static_cast<int>(fromPrepared.size()));
+	ASSERT_EQ(computed.process(in, 1, 512, computedOut, static_cast<int>(fromComputed.size())), written);
+	EXPECT_EQ(fromPrepared, fromComputed);
+	if (!AllocationCounter::enabled) {
+		GTEST_SKIP() << "Allocations are only counted with JAMMERNETZ_ALLOCATION_TESTS";
+	}
+	EXPECT_EQ(allocations, 0u);
+}
+
+TEST(SampleRateConverterTest, FollowsARatioAdjustment)
+{
+	SampleRateConverter converter;
+	converter.prepare(1, 512);
+	converter.setRates(48000, 48000);
+	// A server clock 1000 ppm fast, we have to read that many more of its samples
+	converter.setRatioAdjustment(1.001);
+	std::vector<float> input(512, 0.5f);
+	std::vector<float> output(static_cast<size_t>(SampleRateConverter::maximumOutputSamples(512)));
+	const float* in[] { input.data() };
+	float* out[] { output.data() };
+	int64_t consumed = 0;
+	int64_t produced = 0;
+	for (int block = 0; block < 1000; ++block) {
+		const int expected = converter.outputSamplesFor(512);
+		ASSERT_EQ(converter.process(in, 1, 512, out, static_cast<int>(output.size())), expected);
+		consumed += 512;
+		produced += expected;
+	}
+	EXPECT_NEAR(static_cast<double>(produced), static_cast<double>(consumed) / 1.001, SampleRateConverter::taps / 2.0 + 1.0);
+	EXPECT_NEAR(output.front(), 0.5f, 1.0e-4f);
+}
+
+// Packets mixed every 128 server samples, arriving with an exponential network delay and the odd late one
+void feedDriftingServer(ClockDriftEstimator& estimator, double drift, int firstPacket, int packets, double serverOffset = 0.0)
+{
+	std::mt19937 random(42);
+	std::exponential_distribution<double> jitter(1.0 / 48.0);
+	for (int packet = firstPacket; packet < firstPacket + packets; ++packet) {
+		const double serverTime = 128.0 * packet;
+		double arrival = (serverTime - serverOffset) / (1.0 + drift) + 480.0 + jitter(random);
+		if (packet % 50 == 0) {
+			arrival += 2000.0;
+		}
+		estimator.addObservation(arrival, serverTime);
+	}
+}
+
+TEST(ClockDriftEstimatorTest, LocksOntoTheDriftThroughTheJitter)
+{
+	constexpr int packetsPerSecond = 375;
+	for (const double drift : { 100.0e-6, -40.0e-6, 0.0 }) {
+		SCOPED_TRACE(drift);
+		ClockDriftEstimator estimator;
+		feedDriftingServer(estimator, drift, 1, packetsPerSecond);
+		// A second is far too short to tell ppm from jitter
+		EXPECT_FALSE(estimator.isLocked());
+		EXPECT_EQ(estimator.drift(), 0.0);
+		feedDriftingServer(estimator, drift, 1 + packetsPerSecond, 90 * packetsPerSecond);
+		ASSERT_TRUE(estimator.isLocked());
+		EXPECT_NEAR(estimator.drift(), drift, 1.0e-6);
+	}
+}
+
+TEST(ClockDriftEstimatorTest, StartsOverWhenTheServerTimeJumps)
+{
+	constexpr int packets = 60 * 375;
+	ClockDriftEstimator estimator;
+	feedDriftingServer(estimator, 50.0e-6, 1, packets);
+	ASSERT_TRUE(estimator.isLocked());
+
+	// The server restarted its clock, this is not a drift to follow
+	feedDriftingServer(estimator, 50.0e-6, 1, 1024, 128.0 * packets);
+	EXPECT_FALSE(estimator.isLocked());
+	EXPECT_EQ(estimator.drift(), 0.0);
+	feedDriftingServer(estimator, 50.0e-6, 1025, packets, 128.0 * packets);
+	ASSERT_TRUE(estimator.isLocked());
+	EXPECT_NEAR(estimator.drift(), 50.0e-6, 1.0e-6);
+}
+
 TEST(BoundedSpscQueueTest, RejectsWritesWhenFullAndPreservesOrder)
 {
 	BoundedSpscQueue<int> queue(2);
@@ -336,6 +788,52 @@ TEST(BoundedSpscQueueTest, ResetReleasesRetainedItemsAndMakesQueueReusable)
 	EXPECT_EQ(value, 7);
 }
 
+TEST(BoundedSpscQueueTest, PassesTheSlotIndexToCallbacksThatTakeIt)
+{
+	BoundedSpscQueue<int> queue(2);
+	EXPECT_EQ(queue.slotCount(), 3);
+	std::array<int, 3> storage {};
+	for (int value = 1; value <= 4; ++value) {
+		EXPECT_TRUE(queue.tryWrite([&](int& item, size_t slot) {
+			item = static_cast<int>(slot);
+			storage[slot] = value;
+		}));
+		EXPECT_TRUE(queue.tryRead([&](int& item, size_t slot) {
+			EXPECT_EQ(static_cast<size_t>(item), slot);
+			EXPECT_EQ(storage[slot], value);
+		}));
+	}
+}
+
+TEST(BoundedSpscQueueTest, ParkedConsumerWakesOnWriteAndOnWakeUp)
+{
+	QueueWakeup wakeup;
+	BoundedSpscQueue<int> queue(4, &wakeup);
+	std::atomic<bool> stop { false };
+	std::atomic<int> sum { 0 };
+	std::thread consumer([&]() {
+		while (!stop.load()) {
+			if (!queue.tryRead([&](int& value) { sum.fetch_add(value); })) {
+				wakeup.wait([&]() { return stop.load() || queue.size() > 0; });
+			}
+		}
+	});
+
+	for (int i = 1; i <= 100; ++i) {
+		while (!queue.tryWrite([i](int& value) { value = i; })) {
+			std::this_thread::yield();
+		}
+	}
+	while (sum.load() != 5050) {
+		std::this_thread::yield();
+	}
+	// Nothing written, only the unconditional wake up lets the consumer see the stop flag
+	stop.store(true);
+	wakeup.wakeUp();
+	consumer.join();
+	EXPECT_EQ(sum.load(), 5050);
+}
+
 TEST(LatestBpmMailboxTest, CoalescesToLatestValueWithoutClearingANewerWrite)
 {
 	LatestBpmMailbox mailbox;
@@ -454,6 +952,33 @@ TEST(PathMtuProbeIntegrationTest, SendsAnExactSizeProbeAfterCapabilityAdvertisem
 	EXPECT_EQ(message->json_["mtu_probe_v1"]["size"].get<int>(), probeBytes);
 }
 
+TEST(JammerNetzAudioEngineTest, SendsBeforeAnalysingAndReportsLevelsWithTheNextPacket)
+{
+	JammerNetzSession session;
+	auto sink = std::make_shared<CapturingAudioPacketSink>();
+	JammerNetzAudioEngine engine(session, juce::File(), sink);
+	engine.setChannelSetup(monoLocalSetup());
+	engine.setLocalMonitoring(false);
+
+	std::array<float, SAMPLE_BUFFER_SIZE> input;
+	std::array<float, SAMPLE_BUFFER_SIZE> left {};
+	std::array<float, SAMPLE_BUFFER_SIZE> right {};
+	input.fill(0.75f);
+	const float* inputs[] { input.data() };
+	float* outputs[] { left.data(), right.data() };
+	engine.process(inputs, 1, outputs, 2, SAMPLE_BUFFER_SIZE);
+	engine.process(inputs, 1, outputs, 2, SAMPLE_BUFFER_SIZE);
+	ASSERT_TRUE(engine.processNextOutgoingPacket());
+	ASSERT_TRUE(engine.processNextOutgoingPacket());
+
+	ASSERT_EQ(sink->packets.size(), 2U);
+	// Nothing was analysed when the first packet went out
+	EXPECT_FLOAT_EQ(sink->packets[0]->channelSetup().channels.at(0).mag, 0.0f);
+	EXPECT_NEAR(sink->packets[1]->channelSetup().channels.at(0).mag, 0.75f, 1.0e-5f);
+	EXPECT_GT(sink->packets[1]->channelSetup().channels.at(0).rms, 0.0f);
+	EXPECT_FLOAT_EQ(sink->packets[1]->audioBuffer()->getSample(0, 0), 0.75f);
+}
+
 TEST(JammerNetzAudioEngineTest, DropsFramesInsteadOfBlockingWhenTransmitWorkerIsStalled)
 {
 	JammerNetzSession session;
@@ -472,25 +997,261 @@ TEST(JammerNetzAudioEngineTest, DropsFramesInsteadOfBlockingWhenTransmitWorkerIs
 	EXPECT_GT(stats.transmitFramesDropped, 0u);
 }
 
-TEST(JammerNetzAudioEngineTest, BoundsReceiveBurstsBeforeTheWorkerStarts)
+TEST(JammerNetzAudioEngineTest, SizesTransmitFramesForThePreparedChannels)
 {
 	JammerNetzSession session;
-	JammerNetzAudioEngine engine(session, juce::File());
-	auto audio = std::make_shared<juce::AudioBuffer<float>>(2, SAMPLE_BUFFER_SIZE);
-	JammerNetzChannelSetup setup(false, {
-		JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Left),
-		JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Right)
-	});
-	auto packet = std::make_shared<JammerNetzAudioData>(
-		1, 0.0, setup, SAMPLE_RATE, 120.0f, MidiSignal_None, audio, nullptr);
-
-	for (int frame = 0; frame < 600; ++frame) {
-		engine.enqueueRemoteAudio(packet);
+	auto sink = std::make_shared<CapturingAudioPacketSink>();
+	JammerNetzAudioEngine engine(session, juce::File(), sink);
+	JammerNetzChannelSetup setup(true);
+	for (int channel = 0; channel < 3; ++channel) {
+		setup.channels.emplace_back(JammerNetzChannelTarget::Mono);
 	}
+	engine.setChannelSetup(setup);
+	std::array<std::array<float, SAMPLE_BUFFER_SIZE>, 3> input {};
+	input[2].fill(0.25f);
+	std::array<float, SAMPLE_BUFFER_SIZE> left {};
+	std::array<float, SAMPLE_BUFFER_SIZE> right {};
+	const float* inputs[] { input[0].data(), input[1].data(), input[2].data() };
+	float* outputs[] { left.data(), right.data() };
+
+	// Until the device is prepared the frames only have room for stereo
+	engine.process(inputs, 3, outputs, 2, SAMPLE_BUFFER_SIZE);
+	EXPECT_FALSE(engine.processNextOutgoingPacket());
+	EXPECT_EQ(engine.getRealtimeWorkerStats().transmitFramesDropped, 1u);
+	const auto stereoBytes = engine.getRealtimeWorkerStats().frameBytes;
+	EXPECT_GT(stereoBytes, 0u);
 
+	engine.prepare(48000.0, SAMPLE_BUFFER_SIZE);
+	EXPECT_EQ(engine.getRealtimeWorkerStats().frameBytes, stereoBytes / 2 * 3);
+	engine.process(inputs, 3, outputs, 2, SAMPLE_BUFFER_SIZE);
+	ASSERT_TRUE(engine.processNextOutgoingPacket());
+	ASSERT_EQ(sink->packets.size(), 1U);
+	ASSERT_EQ(sink->packets.front()->audioBuffer()->getNumChannels(), 3);
+	EXPECT_FLOAT_EQ(sink->packets.front()->audioBuffer()->getSample(2, SAMPLE_BUFFER_SIZE - 1), 0.25f);
+}
+
+TEST(JammerNetzAudioEngineTest, InlineTransmitSerializesInTheCallbackAndSendsFromTheSenderThread)
+{
+	JammerNetzSession session;
+	auto sink = std::make_shared<CapturingDatagramSink>();
+	JammerNetzAudioEngine engine(session, juce::File(), sink);
+	engine.setChannelSetup(monoLocalSetup());
+	engine.setLocalMonitoring(false);
+	engine.setInlineTransmit(true);
+	engine.start(false);
+
+	std::array<float, SAMPLE_BUFFER_SIZE> input;
+	std::array<float, SAMPLE_BUFFER_SIZE> left {};
+	std::array<float, SAMPLE_BUFFER_SIZE> right {};
+	input.fill(0.5f);
+	const float* inputs[] { input.data() };
+	float* outputs[] { left.data(), right.data() };
+	// Blocks are dropped until the sender thread has handed the setup to the callback
+	for (int block = 0; block < 2000 && sink->packets().size() < 4; ++block) {
+		engine.process(inputs, 1, outputs, 2, SAMPLE_BUFFER_SIZE);
+		juce::Thread::sleep(1);
+	}
 	const auto stats = engine.getRealtimeWorkerStats();
-	EXPECT_EQ(stats.receiveQueueOverruns, 88u);
-	EXPECT_EQ(stats.receiveFramesDiscarded, 88u);
+	engine.shutdown();
+
+	const auto packets = sink->packets();
+	ASSERT_GE(packets.size(), 4U);
+	EXPECT_TRUE(stats.transmitInline);
+	EXPECT_EQ(sink->workerPackets.load(), 0);
+	for (size_t index = 0; index < packets.size(); ++index) {
+		ASSERT_NE(packets[index], nullptr);
+		EXPECT_EQ(packets[index]->messageCounter(), 10U + index);
+		EXPECT_TRUE(packets[index]->channelSetup().isLocalMonitoringDontSendEcho);
+		ASSERT_EQ(packets[index]->audioBuffer()->getNumChannels(), 1);
+		EXPECT_NEAR(packets[index]->audioBuffer()->getSample(0, SAMPLE_BUFFER_SIZE - 1), 0.5f, 1.0e-4f);
+	}
+	// The analysis still runs behind the send
+	EXPECT_NEAR(packets.back()->channelSetup().channels.at(0).mag, 0.5f, 1.0e-5f);
+}
+
+TEST(AudioReceiveWorkerTest, BoundsReceiveBurstsBeforeItStarts)
+{
+	JammerNetzSession session;
+	AudioReceiveWorker worker(session);
+	constexpr int burst = 600;
+	for (uint64 counter = 1; counter <= burst; ++counter) {
+		worker.enqueue(*remotePacket(counter));
+	}
+
+	// The packet ring fast forwards past the oldest packets instead of growing
+	const auto quality = worker.qualityInfo();
+	EXPECT_EQ(quality.packagesPushed, static_cast<uint64_t>(burst));
+	EXPECT_EQ(quality.droppedPacketCounter, burst - FixedPacketStreamQueue::defaultCapacity);
+	EXPECT_EQ(worker.outputQueueOverruns(), 0u);
+}
+
+TEST(AudioReceiveWorkerTest, DecodesDatagramsIntoItsQueueWithoutAllocating)
+{
+	constexpr int packets = 200;
+	std::vector<std::vector<uint8>> datagrams;
+	for (uint64 counter = 1; counter <= packets; ++counter) {
+		// Inside the 16 bit range of the wire format
+		auto packet = sequencedPacket(counter, true);
+		packet->audioBuffer()->applyGain(1.0f / 1024.0f);
+		if (const auto fec = packet->fecBlock()) {
+			fec->audioBuffer->applyGain(1.0f / 1024.0f);
+		}
+		std::vector<uint8> datagram(MAXFRAMESIZE);
+		size_t bytes = 0;
+		packet->serialize(datagram.data(), bytes);
+		datagram.resize(bytes);
+		datagrams.push_back(std::move(datagram));
+	}
+
+	JammerNetzSession session;
+	AudioReceiveWorker worker(session);
+	worker.setPlayoutRange(1, 4);
+	uint64_t allocations = 0;
+	RemoteAudioFrame frame;
+	std::vector<std::pair<uint64, float>> played;
+	played.reserve(packets);
+	for (auto const& datagram : datagrams) {
+		const auto decoded = decodeJammerNetzMessage(datagram.data(), datagram.size());
+		const auto* audio = std::get_if<JammerNetzAudioDataView>(&decoded);
+		ASSERT_NE(audio, nullptr);
+		{
+			// What the network receive thread does per packet
+			AllocationCounter counter;
+			worker.enqueue(*audio);
+			allocations += counter.allocations();
+		}
+		worker.processNextPendingFrame();
+		while (worker.tryPop(frame)) {
+			played.emplace_back(frame.sourceMessageCounter, frame.samples[1][SAMPLE_BUFFER_SIZE - 1]);
+		}
+	}
+
+	ASSERT_EQ(played.size(), static_cast<size_t>(packets));
+	for (size_t i = 0; i < played.size(); ++i) {
+		EXPECT_EQ(played[i].first, i + 1);
+		EXPECT_NEAR(played[i].second, static_cast<float>(i + 1) / 1024.0f, 1.0e-4f);
+	}
+	if (!AllocationCounter::enabled) {
+		GTEST_SKIP() << "Allocations are only counted with JAMMERNETZ_ALLOCATION_TESTS";
+	}
+	EXPECT_EQ(allocations, 0u);
+}
+
+TEST(FixedPacketStreamQueueTest, HealsGapsInPlaceLikePacketStreamQueue)
+{
+	FixedPacketStreamQueue queue("test", 8);
+	const auto sampleOf = [](RemoteAudioFrame const& frame) { return frame.samples[1][SAMPLE_BUFFER_SIZE - 1]; };
+	for (const uint64 counter : { 1u, 2u, 4u, 4u, 8u }) {
+		queue.push(*sequencedPacket(counter, counter != 8));
+	}
+	EXPECT_EQ(queue.size(), 4u);
+
+	RemoteAudioFrame frame;
+	bool fillIn = false;
+	std::vector<std::pair<uint64, float>> played;
+	std::vector<bool> fillIns;
+	while (queue.tryPop(frame, fillIn)) {
+		played.emplace_back(frame.sourceMessageCounter, sampleOf(frame));
+		fillIns.push_back(fillIn);
+		if (frame.sourceMessageCounter == 5) {
+			// The repeat of 8 stands in for 5 and must not repeat its transport command
+			EXPECT_EQ(frame.serverSampleEnd, 5u * SAMPLE_BUFFER_SIZE);
+			EXPECT_EQ(frame.midiSignal, MidiSignal_None);
+		}
+	}
+	// 3 comes from the FEC copy in 4, 5 has no FEC and repeats 8, 7 is silence as the gap goes on
+	EXPECT_EQ(played, (std::vector<std::pair<uint64, float>> {
+		{ 1, 1.0f }, { 2, 2.0f }, { 3, 3.5f }, { 4, 4.0f }, { 5, 8.0f }, { 7, 0.0f }, { 8, 8.0f } }));
+	EXPECT_EQ(fillIns, (std::vector<bool> { false, false, true, false, true, true, false }));
+	EXPECT_FALSE(queue.push(*sequencedPacket(6, true)));
+
+	const auto quality = queue.qualityInfoPackage();
+	EXPECT_EQ(quality.duplicatePacketCounter, 1);
+	EXPECT_EQ(quality.tooLateOrDuplicate, 1u);
+	EXPECT_EQ(quality.dropsHealed, 1u);
+	EXPECT_EQ(quality.droppedPacketCounter, 2);
+}
+
+TEST(FixedPacketStreamQueueTest, DoesNotAllocateUnderNetworkImpairment)
+{
+	struct Scenario {
+		const char* name;
+		NetworkImpairmentConfig config;
+		bool lossy { false };
+	};
+	std::vector<Scenario> scenarios(3);
+	scenarios[0].name = "bursty loss";
+	scenarios[0].config.goodToBad = 0.02;
+	scenarios[0].config.badToGood = 0.3;
+	scenarios[0].config.lossInBad = 0.5;
+	scenarios[0].config.jitterMs = 2.0;
+	scenarios[0].lossy = true;
+	scenarios[1].name = "reordering";
+	scenarios[1].config.delayMs = 10.0;
+	scenarios[1].config.jitterMs = 8.0;
+	scenarios[1].config.jitterDistribution = JitterDistribution::Normal;
+	scenarios[2].name = "duplicates and tail latency";
+	scenarios[2].config.duplicateProbability = 0.1;
+	scenarios[2].config.lossInGood = 0.02;
+	scenarios[2].config.jitterMs = 3.0;
+	scenarios[2].config.jitterDistribution = JitterDistribution::Pareto;
+	scenarios[2].lossy = true;
+
+	constexpr int packets = 2000;
+	constexpr double frameMs = 1000.0 * SAMPLE_BUFFER_SIZE / SAMPLE_RATE;
+	constexpr double playoutDelayMs = 40.0;
+	for (auto& scenario : scenarios) {
+		SCOPED_TRACE(scenario.name);
+		struct Arrival {
+			double dueMs;
+			std::shared_ptr<JammerNetzAudioData> packet;
+		};
+		std::vector<Arrival> arrivals;
+		NetworkImpairmentModel link(scenario.config, 42);
+		for (uint64 counter = 1; counter <= packets; ++counter) {
+			const auto decision = link.decide(1000, static_cast<double>(counter) * frameMs);
+			auto packet = sequencedPacket(counter, true);
+			for (int copy = 0; copy < decision.copies; ++copy) {
+				arrivals.push_back({ decision.deliveryMs[static_cast<size_t>(copy)], packet });
+			}
+		}
+		std::stable_sort(arrivals.begin(), arrivals.end(), [](Arrival const& a, Arrival const& b) { return a.dueMs < b.dueMs; });
+		std::vector<uint64> played(static_cast<size_t>(packets) * 2);
+		size_t playedCount = 0;
+
+		FixedPacketStreamQueue queue("impaired");
+		RemoteAudioFrame frame;
+		bool fillIn = false;
+		double nextPlayoutMs = arrivals.front().dueMs + playoutDelayMs;
+		uint64_t allocations = 0;
+		{
+			AllocationCounter counter;
+			for (auto const& arrival : arrivals) {
+				for (; nextPlayoutMs < arrival.dueMs; nextPlayoutMs += frameMs) {
+					if (queue.tryPop(frame, fillIn) && playedCount < played.size()) {
+						played[playedCount++] = frame.sourceMessageCounter;
+					}
+				}
+				queue.push(*arrival.packet);
+			}
+			while (queue.tryPop(frame, fillIn) && playedCount < played.size()) {
+				played[playedCount++] = frame.sourceMessageCounter;
+			}
+			allocations = counter.allocations();
+		}
+
+		if (AllocationCounter::enabled) {
+			EXPECT_EQ(allocations, 0u);
+		}
+		ASSERT_GT(playedCount, static_cast<size_t>(packets) / 2);
+		// Fill-ins included, every counter plays at most once and in order
+		const auto playedEnd = played.begin() + static_cast<std::ptrdiff_t>(playedCount);
+		EXPECT_TRUE(std::is_sorted(played.begin(), playedEnd));
+		EXPECT_EQ(std::adjacent_find(played.begin(), playedEnd), playedEnd);
+		if (scenario.lossy) {
+			EXPECT_GT(queue.qualityInfoPackage().dropsHealed, 0u);
+		}
+	}
 }
 
 TEST(AudioReceiveWorkerTest, CapsPreparedPlayoutAfterAConsumerHiccup)
@@ -504,7 +1265,7 @@ TEST(AudioReceiveWorkerTest, CapsPreparedPlayoutAfterAConsumerHiccup)
 	// consuming. The old worker filled its separate prepared queue indefinitely
 	// because the configured maximum was enforced only on the ordering queue.
 	for (uint64 counter = 1; counter <= 12; ++counter) {
-		worker.enqueue(remotePacket(counter));
+		worker.enqueue(*remotePacket(counter));
 		juce::Thread::sleep(4);
 	}
 	for (int attempt = 0; attempt < 100 && worker.discardedFrames() == 0; ++attempt) {
@@ -548,4 +1309,44 @@ TEST(MidiSendThreadTest, FutureMessageDoesNotReserveAQueueSlotWhileWaiting)
 	sender.shutdown();
 }
 
+TEST(TunerTest, DetectsPitchOnDecimatedAudioAndSkipsGatedChannels)
+{
+	Tuner tuner;
+	tuner.setChannelEnabled(2, false);
+	std::array<std::array<float, SAMPLE_BUFFER_SIZE>, 3> samples {};
+	const std::array<const float*, 3> channels { samples[0].data(), samples[1].data(), samples[2].data() };
+	int position = 0;
+	for (int block = 0; block < SAMPLE_RATE / SAMPLE_BUFFER_SIZE; ++block) {
+		for (int i = 0; i < SAMPLE_BUFFER_SIZE; ++i, ++position) {
+			const auto sine = 0.5f * static_cast<float>(std::sin(2.0 * juce::MathConstants<double>::pi * 220.0 * position / SAMPLE_RATE));
+			samples[0][static_cast<size_t>(i)] = sine;
+			samples[1][static_cast<size_t>(i)] = 0.0001f * sine; // -86 dB, below the gate
+			samples[2][static_cast<size_t>(i)] = sine;
+		}
+		tuner.detectPitch(channels.data(), 3, SAMPLE_BUFFER_SIZE, SAMPLE_RATE);
+	}
+	EXPECT_NEAR(tuner.getPitch(0), 220.0f, 4.0f);
+	EXPECT_EQ(tuner.getPitch(1), 0.0f);
+	EXPECT_EQ(tuner.getPitch(2), 0.0f);
+	EXPECT_EQ(tuner.analysedBlocks(), static_cast<uint64_t>(SAMPLE_RATE / SAMPLE_BUFFER_SIZE));
+	EXPECT_EQ(tuner.skippedBlocks(), 0u);
+}
+
+TEST(TunerTest, DetectsPitchAtTheRateOfTheAudio)
+{
+	constexpr int deviceRate = 44100;
+	Tuner tuner;
+	std::array<float, SAMPLE_BUFFER_SIZE> samples {};
+	const std::array<const float*, 1> channels { samples.data() };
+	int position = 0;
+	for (int block = 0; block < deviceRate / SAMPLE_BUFFER_SIZE; ++block) {
+		for (int i = 0; i < SAMPLE_BUFFER_SIZE; ++i, ++position) {
+			samples[static_cast<size_t>(i)] = 0.5f * static_cast<float>(std::sin(2.0 * juce::MathConstants<double>::pi * 220.0 * position / deviceRate));
+		}
+		tuner.detectPitch(channels.data(), 1, SAMPLE_BUFFER_SIZE, deviceRate);
+	}
+	// Analysed as 48 kHz, this would read about 239 Hz
+	EXPECT_NEAR(tuner.getPitch(0), 220.0f, 4.0f);
+}
+
 } // namespace
@@ -6,9 +6,12 @@
 
 #include "JammerNetzSession.h"
 
+#include "ClientScheduling.h"
+#include "NetworkImpairment.h"
+
 #include <iostream>
 
-bool JammerNetzSession::start(std::function<void(std::shared_ptr<JammerNetzAudioData>)> newDataHandler,
+bool JammerNetzSession::start(std::function<void(const JammerNetzAudioDataView&)> newDataHandler,
 	const JammerNetzSessionConfiguration& configuration)
 {
 	if (!shutdown_.exchange(false, std::memory_order_acq_rel)) {
@@ -50,6 +53,7 @@ bool JammerNetzSession::start(std::function<void(std::shared_ptr<JammerNetzAudio
 		});
 	updateConfiguration(configuration);
 	receiver_->startThread();
+	ClientScheduling::instance().apply(*receiver_, ClientThreadRole::Receive);
 	return true;
 }
 
@@ -75,6 +79,9 @@ void JammerNetzSession::shutdown()
 	}
 	receiver_.reset();
 	sender_.reset();
+	if (socket_) {
+		NetworkImpairment::instance().forget(*socket_);
+	}
 	socket_.reset();
 }
 
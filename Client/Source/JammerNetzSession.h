@@ -25,7 +25,7 @@ public:
 	virtual ~JammerNetzSession();
 
 	// Lifecycle calls are owned by AudioService and must be serialized on its message thread.
-	bool start(std::function<void(std::shared_ptr<JammerNetzAudioData>)> newDataHandler,
+	bool start(std::function<void(const JammerNetzAudioDataView&)> newDataHandler,
 		const JammerNetzSessionConfiguration& configuration);
 	void updateConfiguration(const JammerNetzSessionConfiguration& configuration);
 	void shutdown();
@@ -7,19 +7,24 @@
 #include "JuceHeader.h"
 
 #include "AudioService.h"
+#include "ClientScheduling.h"
+#include "LatencyTrace.h"
 #include "MainComponent.h"
+#include "NetworkImpairment.h"
 #include "StreamLogger.h"
 #include "Settings.h"
 #include "Data.h"
 
 #include "version.cpp"
 
+#include <iostream>
+
 #ifdef USE_SENTRY
 #include "sentry.h"
 #include "sentry-config.h"
 #endif
 
-class ClientApplication  : public JUCEApplication
+class ClientApplication  : public JUCEApplication, private Timer
 {
 public:
     ClientApplication() {}
@@ -33,10 +38,72 @@ public:
 		// Parse the command line arguments
 		auto list = ArgumentList("Client.exe", commandLine);
 		String clientID;
+		String latencyTracePath;
+		uint64_t latencyTraceInterval = LatencyTrace::defaultSampleInterval;
+		String impairmentSpec;
+		String receiveSchedulingSpec;
+		String sendSchedulingSpec;
+		bool lockMemory = false;
 		for (auto arg : list.arguments) {
 			if (arg == "--clientID") {
 				clientID = arg.getLongOptionValue();
 			}
+			else if (arg == "--latency-trace") {
+				latencyTracePath = arg.getLongOptionValue();
+			}
+			else if (arg == "--trace-interval") {
+				latencyTraceInterval = static_cast<uint64_t>(std::max(1, arg.getLongOptionValue().getIntValue()));
+			}
+			else if (arg == "--impair") {
+				impairmentSpec = arg.getLongOptionValue();
+			}
+			else if (arg == "--receive-scheduling") {
+				receiveSchedulingSpec = arg.getLongOptionValue();
+			}
+			else if (arg == "--send-scheduling") {
+				sendSchedulingSpec = arg.getLongOptionValue();
+			}
+			else if (arg == "--lock-memory") {
+				lockMemory = true;
+			}
+		}
+		if (latencyTracePath.isNotEmpty()) {
+			// Opt-in diagnostics: every n-th packet is stamped along the whole path and written as JSONL
+			LatencyTrace::instance().enable(latencyTraceInterval);
+			latencyTraceWriter_ = std::make_unique<LatencyTraceWriter>(File::getCurrentWorkingDirectory().getChildFile(latencyTracePath));
+			startTimer(1000);
+		}
+		if (impairmentSpec.isNotEmpty()) {
+			// Simulated bad network between this client and the server, see NetworkImpairmentConfig::parse for the spec
+			std::string error;
+			if (auto impairment = NetworkImpairmentConfig::parse(impairmentSpec.toStdString(), error)) {
+				NetworkImpairment::instance().enable(*impairment);
+			}
+			else {
+				// Same as the server, a test run on a perfect network by accident is worse than none
+				std::cerr << "Invalid network impairment: " << error << std::endl;
+				setApplicationReturnValue(-1);
+				quit();
+				return;
+			}
+		}
+		// Real-time scheduling and cpu pinning of the network and audio workers, the same specs as the server takes
+		std::string schedulingError;
+		const auto receiveScheduling = ThreadSchedulingConfig::parse(receiveSchedulingSpec.toStdString(), schedulingError);
+		const auto sendScheduling = ThreadSchedulingConfig::parse(sendSchedulingSpec.toStdString(), schedulingError);
+		if (!receiveScheduling || !sendScheduling) {
+			std::cerr << "Invalid thread scheduling: " << schedulingError << std::endl;
+			setApplicationReturnValue(-1);
+			quit();
+			return;
+		}
+		ClientScheduling::instance().configure(*receiveScheduling, *sendScheduling);
+		if (lockMemory) {
+			// Before the audio service allocates its threads and buffers, so they are faulted in right away
+			std::string error;
+			if (!lockProcessMemory(error)) {
+				std::cerr << "Memory not locked: " << error << std::endl;
+			}
 		}
 
 		// This method is where you should put your application's initialization code..
@@ -106,7 +173,12 @@ public:
 
     void shutdown() override
     {
-		audioService_->shutdown();
+		if (audioService_) {
+			audioService_->shutdown();
+		}
+		NetworkImpairment::instance().disable();
+		stopTimer();
+		latencyTraceWriter_.reset();
 		StreamLogger::instance().flushBuffer();
 		Logger::setCurrentLogger(nullptr);
 
@@ -114,6 +186,13 @@ public:
         mainWindow = nullptr; // (deletes our window)
     }
 
+    void timerCallback() override
+    {
+		if (latencyTraceWriter_) {
+			latencyTraceWriter_->flush();
+		}
+    }
+
     //==============================================================================
     void systemRequestedQuit() override
     {
@@ -170,6 +249,7 @@ public:
 private:
 	std::unique_ptr<FileLogger> logger_;
 	std::shared_ptr<AudioService> audioService_;
+	std::unique_ptr<LatencyTraceWriter> latencyTraceWriter_;
     std::unique_ptr<MainWindow> mainWindow;
 };
 
@@ -360,7 +360,7 @@ void MainComponent::resized()
 	nameEntry_.setBounds(nameRow.removeFromLeft(kEntryBoxWidth));
 	nameChange_.setBounds(nameRow.removeFromLeft(kLabelWidth / 2).withTrimmedLeft(kNormalInset));
 
-	clientConfigurator_.setBounds(clientConfigArea.removeFromBottom(kLineSpacing * 2));
+	clientConfigurator_.setBounds(clientConfigArea.removeFromBottom(kLineSpacing * 3));
 	connectionInfo_.setBounds(clientConfigArea.removeFromBottom(kLineSpacing));
 	serverStatus_.setBounds(clientConfigArea);
 
@@ -514,6 +514,7 @@ void MainComponent::timerCallback()
 	PlayoutQualityInfo qualityInfo = audioService_->getPlayoutQualityInfo();
 	status << "Quality information" << std::endl << std::fixed << std::setprecision(2);
 	status << "Sample rate measured " << qualityInfo.measuredSampleRate << std::endl;
+	status << "Clock drift: " << qualityInfo.clockDriftPpm << " ppm" << std::endl;
 	status << "Underruns: " << qualityInfo.playUnderruns_ << std::endl;
 	status << "Input latency: " << inputLatency << "ms" << std::endl;
 	status << "Output latency: " << outputLatency << "ms" << std::endl;
@@ -528,7 +529,7 @@ void MainComponent::timerCallback()
 	const auto packetSize = audioService_->currentPacketSize();
 	const auto safePayloadSize = audioService_->safeUdpPayloadSize();
 	const auto mtuStatus = audioService_->mtuDiscoveryStatus();
-	const auto packetsPerSecond = static_cast<double>(SAMPLE_RATE) / static_cast<double>(SAMPLE_BUFFER_SIZE);
+	const auto packetsPerSecond = static_cast<double>(audioService_->sessionSampleRate()) / static_cast<double>(audioService_->networkBlockSize());
 	const auto bandwidthMegabits = static_cast<double>(packetSize) * 8.0 * packetsPerSecond / (1024.0 * 1024.0);
 	connectionInfo << std::fixed << std::setprecision(2)
 		<< "UDP payload: " << packetSize << " / " << safePayloadSize << " bytes ";
@@ -8,7 +8,7 @@
 
 #include "BuffersConfig.h"
 
-MidiPlayAlong::MidiPlayAlong(String fileName) : isPlaying_(false)
+MidiPlayAlong::MidiPlayAlong(String fileName) : startTime_(0.0), sampleRate_(SAMPLE_RATE), isPlaying_(false)
 {
 	loadNewPlayalongFile(fileName);
 }
@@ -34,6 +34,11 @@ juce::String MidiPlayAlong::karaoke() const
 	return karaoke_;
 }
 
+void MidiPlayAlong::prepare(double sampleRate)
+{
+	sampleRate_ = sampleRate;
+}
+
 void MidiPlayAlong::loadNewPlayalongFile(String fileName)
 {
 	File physicalFile(fileName);
@@ -53,7 +58,7 @@ void MidiPlayAlong::loadNewPlayalongFile(String fileName)
 						if (message.isTextMetaEvent()) {
 							auto text = message.getTextFromTextMetaEvent().toStdString();
 							ignoreUnused(text);
-							int timestamp = (int)(message.getTimeStamp() * 0.001 * SAMPLE_RATE);
+							int timestamp = (int)(message.getTimeStamp() * 0.001 * sampleRate_);
 							ignoreUnused(timestamp);
 							collector_.addEvent(message, 0.0);
 						}
@@ -72,7 +77,7 @@ void MidiPlayAlong::fillNextMidiBuffer(std::vector<MidiMessage> &destBuffer, int
 	if (isPlaying_) {
 		double timeElapsed = Time::getMillisecondCounterHiRes() * 0.001 - startTime_;
 		double fileStartTime = collector_.getStartTime();
-		double endTime = timeElapsed + numSamples / (double)SAMPLE_RATE;
+		double endTime = timeElapsed + numSamples / sampleRate_;
 
 		int index = collector_.getNextIndexAtTime(timeElapsed - fileStartTime);
 		while (index < collector_.getNumEvents()) {
@@ -18,6 +18,8 @@ public:
 	String karaoke() const;
 
 	void loadNewPlayalongFile(String fileName);
+	// The rate of the device the buffers are filled for
+	void prepare(double sampleRate);
 
 	void fillNextMidiBuffer(std::vector<MidiMessage> &destBuffer, int numSamples);
 
@@ -26,6 +28,7 @@ private:
 	MidiFile midiFile_;
 	MidiMessageSequence collector_;
 	double startTime_;
+	double sampleRate_;
 	bool isPlaying_;
 
 	String karaoke_;
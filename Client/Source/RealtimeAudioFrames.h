@@ -12,20 +12,53 @@
 
 #include <array>
 #include <optional>
+#include <vector>
 
 constexpr int JAMMERNETZ_MAX_AUDIO_CHANNELS = 64;
 constexpr int JAMMERNETZ_MAX_CALLBACK_SAMPLES = 8192;
 
+// The samples of every slot of a queue in one allocation, sized for the channels in use when the
+// device is prepared instead of for the worst case. The channels of a slot follow each other,
+// samplesPerChannel floats apart.
+class AudioFrameSlab {
+public:
+	// Not synchronised, whoever reads or writes the slots has to be stopped
+	void allocate(int slots, int channels, int samplesPerChannel)
+	{
+		channels_ = channels;
+		samplesPerChannel_ = samplesPerChannel;
+		samples_.assign(static_cast<size_t>(slots) * static_cast<size_t>(channels) * static_cast<size_t>(samplesPerChannel), 0.0f);
+	}
+
+	int channels() const noexcept { return channels_; }
+	int samplesPerChannel() const noexcept { return samplesPerChannel_; }
+	size_t bytes() const noexcept { return samples_.size() * sizeof(float); }
+	float* slot(size_t slot) noexcept { return samples_.data() + slot * static_cast<size_t>(channels_) * static_cast<size_t>(samplesPerChannel_); }
+
+private:
+	std::vector<float> samples_;
+	int channels_ { 0 };
+	int samplesPerChannel_ { 0 };
+};
+
 struct TransmitAudioFrame {
 	int channels { 0 };
-	std::array<std::array<float, SAMPLE_BUFFER_SIZE>, JAMMERNETZ_MAX_AUDIO_CHANNELS> samples {};
+	int numSamples { SAMPLE_BUFFER_SIZE }; // The session's block size
+	int sampleRate { SAMPLE_RATE }; // The session's rate, the samples are converted to it
+	float* samples { nullptr }; // MAXIMUM_SAMPLE_BUFFER_SIZE per channel, in the slab of the queue holding the frame
 	std::optional<float> bpm;
 	std::optional<MidiSignal> midiSignal;
+	double captureTimeMs { 0.0 };
+	double enqueueTimeMs { 0.0 };
+
+	float* channel(int channel) const noexcept { return samples + static_cast<size_t>(channel) * MAXIMUM_SAMPLE_BUFFER_SIZE; }
 };
 
 struct RemoteAudioFrame {
-	std::array<std::array<float, SAMPLE_BUFFER_SIZE>, 2> samples {};
+	std::array<std::array<float, MAXIMUM_SAMPLE_BUFFER_SIZE>, 2> samples {};
+	int numSamples { SAMPLE_BUFFER_SIZE }; // The block size of the session the frame was mixed in
 	double sourceTimestamp { 0.0 };
+	uint64 sourceMessageCounter { 0 };
 	uint64 generation { 0 };
 	// The server stamps frames with the sample position immediately after the
 	// final sample in this block. Keep the timing and transport data beside the
@@ -42,5 +75,9 @@ struct RecordingAudioFrame {
 	uint64_t recordingGeneration { 0 };
 	int channels { 0 };
 	int samplesPerChannel { 0 };
-	std::array<std::array<float, JAMMERNETZ_MAX_CALLBACK_SAMPLES>, JAMMERNETZ_MAX_AUDIO_CHANNELS> samples {};
+	int stride { 0 }; // Distance of the channels, samplesPerChannel is at most this
+	int lostSamplesBefore { 0 }; // Dropped between the previous frame of this target and this one
+	float* samples { nullptr }; // In the slab of the queue holding the frame
+
+	float* channel(int channel) const noexcept { return samples + static_cast<size_t>(channel) * static_cast<size_t>(stride); }
 };
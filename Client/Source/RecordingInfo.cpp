@@ -139,7 +139,16 @@ void RecordingInfo::updateData()
 		recording_.setToggleState(!isLive, dontSendNotification);
 
 		auto elapsed = recorder_.lock()->getElapsedTime();
-		recordingTime_.setText(elapsed.getDescription(), dontSendNotification);
+		auto elapsedText = elapsed.getDescription();
+		// Only bother the user when the disk is falling behind
+		const auto statistics = recorder_.lock()->getStatistics();
+		if (statistics.bufferFill() > 0.1) {
+			elapsedText << ", disk buffer " << roundToInt(statistics.bufferFill() * 100.0) << "%";
+		}
+		if (statistics.dropouts > 0) {
+			elapsedText << ", " << String(statistics.dropouts) << (statistics.dropouts == 1 ? " dropout" : " dropouts");
+		}
+		recordingTime_.setText(elapsedText, dontSendNotification);
 		recordingTime_.setVisible(isLive && elapsed.inSeconds() > 1);
 
 		recordingFileName_.setText(recorder_.lock()->getFilename(), dontSendNotification);
@@ -0,0 +1,274 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "SampleRateConverter.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+constexpr double pi = 3.14159265358979323846;
+// Kaiser window, about 70 dB stopband
+constexpr double kaiserBeta = 7.0;
+// Fraction of the lower Nyquist frequency we pass, the rest is the transition band of the short filter
+constexpr double passband = 0.85;
+// Largest ratio between two supported rates, rounded up
+constexpr int maximumRatio = (SampleRateConverter::maximumRate + SampleRateConverter::minimumRate - 1) / SampleRateConverter::minimumRate;
+constexpr int lanes = 8;
+static_assert(SampleRateConverter::taps % lanes == 0, "The dot product runs in lanes");
+
+double besselI0(double x) noexcept
+{
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 32; ++k) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1.0e-12) {
+			break;
+		}
+	}
+	return sum;
+}
+
+// Split into lanes so the compiler can vectorize the sum without reassociating floats
+float dotProduct(const float* coefficients, const float* samples) noexcept
+{
+	std::array<float, lanes> partial {};
+	for (int tap = 0; tap < SampleRateConverter::taps; tap += lanes) {
+		for (int lane = 0; lane < lanes; ++lane) {
+			partial[static_cast<size_t>(lane)] += coefficients[tap + lane] * samples[tap + lane];
+		}
+	}
+	return std::accumulate(partial.begin(), partial.end(), 0.0f);
+}
+
+} // namespace
+
+bool SampleRateConverter::supportsRate(double sampleRate) noexcept
+{
+	const auto rounded = std::round(sampleRate);
+	return std::abs(sampleRate - rounded) < 0.01 && rounded >= minimumRate && rounded <= maximumRate;
+}
+
+int SampleRateConverter::maximumOutputSamples(int inputSamples) noexcept
+{
+	return (inputSamples + taps) * maximumRatio + 1;
+}
+
+int SampleRateConverter::maximumInputSamples(int outputSamples) noexcept
+{
+	return outputSamples * maximumRatio + 2 * taps;
+}
+
+SampleRateConverter::SampleRateConverter()
+	: computed_(static_cast<size_t>((phases + 1) * taps))
+	, window_(static_cast<size_t>((phases + 1) * taps))
+{
+	// The window does not depend on the rates, only the sinc does
+	const double halfLength = taps / 2.0;
+	const double normalisation = besselI0(kaiserBeta);
+	for (int phase = 0; phase <= phases; ++phase) {
+		for (int tap = 0; tap < taps; ++tap) {
+			const double distance = static_cast<double>(phase) / phases + (taps / 2 - 1 - tap);
+			const double relative = std::min(1.0, std::abs(distance) / halfLength);
+			window_[static_cast<size_t>(phase * taps + tap)] = static_cast<float>(besselI0(kaiserBeta * std::sqrt(1.0 - relative * relative)) / normalisation);
+		}
+	}
+	setRates(inputRate_, outputRate_);
+}
+
+void SampleRateConverter::prepare(int channels, int maximumInputSamples)
+{
+	channels_ = std::max(0, channels);
+	maximumInputSamples_ = std::max(0, maximumInputSamples);
+	stride_ = historyCapacity + maximumInputSamples_;
+	buffers_.assign(static_cast<size_t>(channels_) * static_cast<size_t>(stride_), 0.0f);
+	// Drops the tables, the filter in use is computed again
+	prepared_.clear();
+	setRates(inputRate_, outputRate_);
+}
+
+void SampleRateConverter::prepareRates(int inputRate, int outputRate)
+{
+	inputRate = std::max(1, inputRate);
+	outputRate = std::max(1, outputRate);
+	for (const auto& prepared : prepared_) {
+		if (prepared.inputRate == inputRate && prepared.outputRate == outputRate) {
+			return;
+		}
+	}
+	// The tables keep their storage when the vector grows, so the filter in use stays valid
+	prepared_.push_back({ inputRate, outputRate, std::vector<float>(static_cast<size_t>((phases + 1) * taps)) });
+	computeFilter(inputRate, outputRate, prepared_.back().coefficients.data());
+}
+
+bool SampleRateConverter::isPrepared() const noexcept
+{
+	return channels_ > 0 && maximumInputSamples_ > 0;
+}
+
+int SampleRateConverter::channels() const noexcept
+{
+	return channels_;
+}
+
+void SampleRateConverter::setRates(int inputRate, int outputRate) noexcept
+{
+	inputRate_ = std::max(1, inputRate);
+	outputRate_ = std::max(1, outputRate);
+	const auto divisor = std::gcd(inputRate_, outputRate_);
+	inputStep_ = inputRate_ / divisor;
+	outputStep_ = outputRate_ / divisor;
+	unitsPerSample_ = outputStep_ << fractionBits;
+	step_ = inputStep_ << fractionBits;
+	filter_ = nullptr;
+	for (const auto& prepared : prepared_) {
+		if (prepared.inputRate == inputRate_ && prepared.outputRate == outputRate_) {
+			filter_ = prepared.coefficients.data();
+		}
+	}
+	if (!filter_) {
+		computeFilter(inputRate_, outputRate_, computed_.data());
+		filter_ = computed_.data();
+	}
+	reset();
+}
+
+int SampleRateConverter::inputRate() const noexcept
+{
+	return inputRate_;
+}
+
+int SampleRateConverter::outputRate() const noexcept
+{
+	return outputRate_;
+}
+
+void SampleRateConverter::setRatioAdjustment(double factor) noexcept
+{
+	// Only meant for clock drift, anything bigger would need another filter
+	const auto exact = static_cast<double>(inputStep_ << fractionBits);
+	step_ = std::max<int64_t>(1, std::llround(exact * std::clamp(factor, 0.99, 1.01)));
+}
+
+void SampleRateConverter::reset() noexcept
+{
+	// Start with silence as history, so the first output sample lines up with the first input sample
+	historyLength_ = taps / 2 - 1;
+	time_ = static_cast<int64_t>(historyLength_) * unitsPerSample_;
+	std::fill(buffers_.begin(), buffers_.end(), 0.0f);
+}
+
+int SampleRateConverter::outputSamplesFor(int inputSamples) const noexcept
+{
+	const auto end = availableEnd(std::min(inputSamples, maximumInputSamples_));
+	if (end <= time_) {
+		return 0;
+	}
+	return static_cast<int>((end - time_ + step_ - 1) / step_);
+}
+
+int SampleRateConverter::inputSamplesFor(int outputSamples) const noexcept
+{
+	if (outputSamples <= 0) {
+		return 0;
+	}
+	const auto lastPosition = (time_ + static_cast<int64_t>(outputSamples - 1) * step_) / unitsPerSample_;
+	return static_cast<int>(std::max<int64_t>(0, lastPosition + taps / 2 + 1 - historyLength_));
+}
+
+int SampleRateConverter::process(const float* const* input, int numChannels, int inputSamples, float* const* output, int maximumOutput) noexcept
+{
+	if (!isPrepared() || numChannels <= 0 || numChannels > channels_) {
+		return 0;
+	}
+	inputSamples = std::clamp(inputSamples, 0, maximumInputSamples_);
+	for (int c = 0; c < channels_; ++c) {
+		auto* destination = channel(c) + historyLength_;
+		if (c < numChannels && input[c]) {
+			std::memcpy(destination, input[c], static_cast<size_t>(inputSamples) * sizeof(float));
+		}
+		else {
+			std::fill(destination, destination + inputSamples, 0.0f);
+		}
+	}
+
+	const auto end = availableEnd(inputSamples);
+	std::array<float, taps> coefficients {};
+	int written = 0;
+	while (time_ < end && written < maximumOutput) {
+		const auto position = time_ / unitsPerSample_;
+		const double phase = static_cast<double>(time_ % unitsPerSample_) * phases / static_cast<double>(unitsPerSample_);
+		const auto row = std::min(static_cast<int>(phase), phases - 1);
+		const auto weight = static_cast<float>(phase - row);
+		// Interpolate the coefficients once, all channels share them
+		const auto* lower = filter_ + row * taps;
+		const auto* upper = lower + taps;
+		for (int tap = 0; tap < taps; ++tap) {
+			coefficients[static_cast<size_t>(tap)] = lower[tap] + weight * (upper[tap] - lower[tap]);
+		}
+		const auto first = static_cast<size_t>(position - (taps / 2 - 1));
+		for (int c = 0; c < numChannels; ++c) {
+			output[c][written] = dotProduct(coefficients.data(), channel(c) + first);
+		}
+		++written;
+		time_ += step_;
+	}
+
+	// Keep what the next output needs as history
+	const auto length = static_cast<int64_t>(historyLength_ + inputSamples);
+	auto keepFrom = std::max<int64_t>(0, time_ / unitsPerSample_ - (taps / 2 - 1));
+	keepFrom = std::min(keepFrom, length);
+	if (length - keepFrom > historyCapacity) {
+		// Only when the caller keeps passing more than it reads back, drop the oldest samples
+		keepFrom = length - historyCapacity;
+	}
+	historyLength_ = static_cast<int>(length - keepFrom);
+	for (int c = 0; c < channels_; ++c) {
+		auto* samples = channel(c);
+		std::memmove(samples, samples + keepFrom, static_cast<size_t>(historyLength_) * sizeof(float));
+	}
+	time_ = std::max(time_ - keepFrom * unitsPerSample_, static_cast<int64_t>(taps / 2 - 1) * unitsPerSample_);
+	return written;
+}
+
+void SampleRateConverter::computeFilter(int inputRate, int outputRate, float* filter) const noexcept
+{
+	// Downsampling has to cut at the output's Nyquist frequency
+	const double cutoff = passband * std::min(1.0, static_cast<double>(outputRate) / static_cast<double>(inputRate));
+	for (int phase = 0; phase <= phases; ++phase) {
+		auto* row = filter + phase * taps;
+		double sum = 0.0;
+		for (int tap = 0; tap < taps; ++tap) {
+			const double distance = static_cast<double>(phase) / phases + (taps / 2 - 1 - tap);
+			const double x = pi * cutoff * distance;
+			const double sinc = std::abs(x) < 1.0e-9 ? 1.0 : std::sin(x) / x;
+			const double value = sinc * window_[static_cast<size_t>(phase * taps + tap)];
+			row[tap] = static_cast<float>(value);
+			sum += value;
+		}
+		// Unity gain at DC for every phase, else the interpolation would modulate a constant signal
+		for (int tap = 0; tap < taps; ++tap) {
+			row[tap] = static_cast<float>(row[tap] / sum);
+		}
+	}
+}
+
+int64_t SampleRateConverter::availableEnd(int inputSamples) const noexcept
+{
+	// An output needs taps / 2 samples after its position
+	return static_cast<int64_t>(historyLength_ + inputSamples - taps / 2) * unitsPerSample_;
+}
+
+float* SampleRateConverter::channel(int channel) noexcept
+{
+	return buffers_.data() + static_cast<size_t>(channel) * static_cast<size_t>(stride_);
+}
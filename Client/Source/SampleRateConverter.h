@@ -0,0 +1,96 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Converts between the rate of the audio device and the rate of the session, for any pair of integer rates.
+// A polyphase windowed sinc filter of 32 taps, the phase is kept as an exact fraction so there is no drift
+// however long it runs. The latency is half the filter length, 16 input samples.
+//
+// The ratio can be trimmed by a few hundred ppm to follow a clock that drifts against ours.
+//
+// Only prepare() and prepareRates() allocate, everything else is safe on the audio thread.
+class SampleRateConverter {
+public:
+	static constexpr int taps = 32;
+	static constexpr int phases = 256;
+	// Device rates we can convert from and to
+	static constexpr int minimumRate = 22050;
+	static constexpr int maximumRate = 192000;
+
+	static bool supportsRate(double sampleRate) noexcept;
+	// Bounds for any pair of supported rates, used to size the buffers around the converter
+	static int maximumOutputSamples(int inputSamples) noexcept;
+	static int maximumInputSamples(int outputSamples) noexcept;
+
+	SampleRateConverter();
+
+	// Sizes the history for the channels and the largest block passed to process(), and forgets the prepared rates
+	void prepare(int channels, int maximumInputSamples);
+	// Computes the filter for that pair of rates now, so setRates() only has to pick it
+	void prepareRates(int inputRate, int outputRate);
+	bool isPrepared() const noexcept;
+	int channels() const noexcept;
+
+	// Switches to the filter for the ratio and resets. A pair that was not prepared computes its filter here,
+	// which takes too long for the audio thread.
+	void setRates(int inputRate, int outputRate) noexcept;
+	int inputRate() const noexcept;
+	int outputRate() const noexcept;
+	// Reads that many more input samples per output than the rates say, 1.0 is exact. Takes effect with the
+	// next output and keeps the phase, so it can follow a drift estimate continuously.
+	void setRatioAdjustment(double factor) noexcept;
+	void reset() noexcept;
+
+	// How many samples process() returns for that many input samples
+	int outputSamplesFor(int inputSamples) const noexcept;
+	// The fewest input samples for process() to return at least outputSamples
+	int inputSamplesFor(int outputSamples) const noexcept;
+
+	// Returns the number of samples written per channel. Input beyond the prepared block size is ignored,
+	// output beyond maximumOutput stays in the history for the next call.
+	int process(const float* const* input, int numChannels, int inputSamples, float* const* output, int maximumOutput) noexcept;
+
+private:
+	static constexpr int historyCapacity = 2 * taps;
+	// Sub-divides the exact fraction for the ratio adjustment, 0.06 ppm for the coarsest ratio
+	static constexpr int fractionBits = 24;
+
+	struct PreparedFilter {
+		int inputRate;
+		int outputRate;
+		std::vector<float> coefficients;
+	};
+
+	void computeFilter(int inputRate, int outputRate, float* filter) const noexcept;
+	int64_t availableEnd(int inputSamples) const noexcept;
+	float* channel(int channel) noexcept;
+
+	// (phases + 1) rows of taps, the extra row lets us interpolate past the last phase
+	const float* filter_ { nullptr };
+	std::vector<PreparedFilter> prepared_;
+	// For rates that were not prepared
+	std::vector<float> computed_;
+	std::vector<float> window_;
+	std::vector<float> buffers_;
+	int channels_ { 0 };
+	int stride_ { 0 };
+	int maximumInputSamples_ { 0 };
+	int inputRate_ { 48000 };
+	int outputRate_ { 48000 };
+	// The ratio reduced to lowest terms
+	int64_t inputStep_ { 1 };
+	int64_t outputStep_ { 1 };
+	// Time per input sample and per output, the step includes the ratio adjustment
+	int64_t unitsPerSample_ { 1 };
+	int64_t step_ { 1 };
+	int historyLength_ { 0 };
+	// Position of the next output in the buffer, in 1/unitsPerSample_ input samples
+	int64_t time_ { 0 };
+};
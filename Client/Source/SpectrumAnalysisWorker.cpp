@@ -80,7 +80,7 @@ void SpectrumAnalysisWorker::run()
 	while (!threadShouldExit() || queue_.size() > 0) {
 		const auto hadFrame = queue_.tryRead([this](SpectrumAudioFrame& frame) { processFrame(frame); });
 		if (!hadFrame)
-			juce::Thread::sleep(2);
+			wakeup_.wait([this]() { return threadShouldExit() || queue_.size() > 0; });
 	}
 }
 
@@ -100,5 +100,6 @@ void SpectrumAnalysisWorker::processFrame(SpectrumAudioFrame& frame)
 void SpectrumAnalysisWorker::shutdown()
 {
 	signalThreadShouldExit();
+	wakeup_.wakeUp();
 	stopThread(2000);
 }
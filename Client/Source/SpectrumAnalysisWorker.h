@@ -38,7 +38,8 @@ private:
 	void shutdown();
 
 	static constexpr int queueCapacity = 8;
-	BoundedSpscQueue<SpectrumAudioFrame> queue_ { queueCapacity };
+	QueueWakeup wakeup_; // Before queue_, which notifies it
+	BoundedSpscQueue<SpectrumAudioFrame> queue_ { queueCapacity, &wakeup_ };
 	std::shared_ptr<Spectrogram> analyzer_;
 	std::atomic<std::uint64_t> processed_ { 0 };
 	std::atomic<std::uint64_t> dropped_ { 0 };
@@ -6,10 +6,14 @@
 
 #include "Tuner.h"
 
+#include "BoundedSpscQueue.h"
 #include "BuffersConfig.h"
+#include "RealtimeAudioFrames.h"
 
 #include <array>
 #include <atomic>
+#include <bitset>
+#include <cmath>
 
 #ifndef __GNUC__
 #pragma warning( push )
@@ -44,32 +48,87 @@
 namespace q = cycfi::q;
 using namespace q::literals;
 
-class Tuner::TunerImpl {
+namespace {
+
+// Gated and decimated audio of one block, what the pitch detectors need
+struct TunerFrame {
+	int channels { 0 };
+	int samples { 0 };
+	int sampleRate { 0 }; // Before decimation
+	std::bitset<JAMMERNETZ_MAX_AUDIO_CHANNELS> active;
+	std::array<std::array<float, SAMPLE_BUFFER_SIZE>, JAMMERNETZ_MAX_AUDIO_CHANNELS> decimated {};
+};
+
+}
+
+class Tuner::TunerImpl final : private Thread {
 public:
-	TunerImpl() {
+	TunerImpl(int decimation, float gateDecibels)
+		: Thread("JammerNetz tuner")
+		, decimation_(jmax(1, decimation))
+		, gate_(Decibels::decibelsToGain(gateDecibels))
+	{
 		for (auto& pitch : lastPitches) {
 			pitch.store(0.0f, std::memory_order_relaxed);
 		}
+		for (auto& enabled : enabled_) {
+			enabled.store(true, std::memory_order_relaxed);
+		}
 	}
 
-	void detectPitch(std::shared_ptr<AudioBuffer<float>> audioData) {
-		if (audioData) {
+	~TunerImpl() override {
+		shutdown();
+	}
 
-			auto readPointers = audioData->getArrayOfReadPointers();
-			for (size_t channel = 0; channel < (size_t) audioData->getNumChannels(); channel++) {
-				// Do we already create a detector for this channel?
-				if (detectors.size() <= channel) {
-					detectors.push_back(std::make_unique<q::pitch_detector>(50.0_Hz, 2000.0_Hz, (float) SAMPLE_RATE, q::lin_to_db(0.0)));
-				}
+	void start() {
+		if (!isThreadRunning()) {
+			background_.store(true, std::memory_order_release);
+			startThread(Thread::Priority::low);
+		}
+	}
 
-				// Feed the samples of this channel into the pitch detector
-				for (size_t s = 0; s < (size_t) audioData->getNumSamples(); s++) {
-					(*detectors[channel])(readPointers[channel][s]);
-				}
-				if (channel < lastPitches.size()) {
-					lastPitches[channel].store(detectors[channel]->predict_frequency(), std::memory_order_release);
+	void shutdown() {
+		signalThreadShouldExit();
+		wakeup_.wakeUp();
+		stopThread(2000);
+		background_.store(false, std::memory_order_release);
+		// The producer is stopped before the tuner is shut down
+		queue_.reset();
+	}
+
+	void detectPitch(const float* const* channels, int numChannels, int numSamples, int sampleRate) {
+		if (!channels || numChannels <= 0 || sampleRate <= 0) {
+			return;
+		}
+		if (sampleRate != filterRate_) {
+			// Anti aliasing for the decimation. One biquad only falls off at 12 dB per octave, so the cutoff sits at
+			// half the decimated Nyquist frequency, still above the 2 kHz the detectors look for at the default decimation.
+			const auto lowPass = IIRCoefficients::makeLowPass(sampleRate, 0.25 * sampleRate / decimation_);
+			for (auto& filter : filters_) {
+				filter.setCoefficients(lowPass);
+				filter.reset();
+			}
+			filterRate_ = sampleRate;
+		}
+		numChannels = jmin(numChannels, JAMMERNETZ_MAX_AUDIO_CHANNELS);
+		for (int done = 0; done < numSamples; done += SAMPLE_BUFFER_SIZE) {
+			const int samples = jmin(SAMPLE_BUFFER_SIZE, numSamples - done);
+			if (background_.load(std::memory_order_acquire)) {
+				const bool queued = queue_.tryWrite([&](TunerFrame& frame) { prepareFrame(frame, channels, numChannels, done, samples); });
+				if (!queued) {
+					skipped_.fetch_add(1, std::memory_order_relaxed);
 				}
 			}
+			else {
+				prepareFrame(inlineFrame_, channels, numChannels, done, samples);
+				analyse(inlineFrame_);
+			}
+		}
+	}
+
+	void setChannelEnabled(size_t channel, bool enabled) {
+		if (channel < enabled_.size()) {
+			enabled_[channel].store(enabled, std::memory_order_relaxed);
 		}
 	}
 
@@ -82,24 +141,146 @@ public:
 		}
 	}
 
+	uint64_t analysedBlocks() const noexcept { return analysed_.load(std::memory_order_relaxed); }
+	uint64_t skippedBlocks() const noexcept { return skipped_.load(std::memory_order_relaxed); }
+
 private:
+	void run() override {
+		while (!threadShouldExit()) {
+			if (!queue_.tryRead([this](TunerFrame& frame) { analyse(frame); })) {
+				wakeup_.wait([this]() { return threadShouldExit() || queue_.size() > 0; });
+			}
+		}
+	}
+
+	// Runs on the caller of detectPitch(), kept cheap: one pass for the gate, one for filter and decimation
+	void prepareFrame(TunerFrame& frame, const float* const* channels, int numChannels, int offset, int numSamples) {
+		frame.channels = numChannels;
+		frame.sampleRate = filterRate_;
+		frame.active.reset();
+		// All channels share the decimation phase, so a gated channel comes back in step with the others
+		int decimated = 0;
+		for (int sample = phase_; sample < numSamples; sample += decimation_) {
+			++decimated;
+		}
+		frame.samples = decimated;
+		const int phase = phase_;
+		phase_ = phase + decimated * decimation_ - numSamples;
+		for (int channel = 0; channel < numChannels; ++channel) {
+			const auto index = static_cast<size_t>(channel);
+			const float* input = channels[channel] ? channels[channel] + offset : nullptr;
+			if (!input || !enabled_[index].load(std::memory_order_relaxed) || rms(input, numSamples) < gate_) {
+				continue;
+			}
+			frame.active.set(index);
+			auto* output = frame.decimated[index].data();
+			if (decimation_ == 1) {
+				FloatVectorOperations::copy(output, input, numSamples);
+				continue;
+			}
+			FloatVectorOperations::copy(scratch_.data(), input, numSamples);
+			filters_[index].processSamples(scratch_.data(), numSamples);
+			for (int i = 0; i < decimated; ++i) {
+				output[i] = scratch_[static_cast<size_t>(phase + i * decimation_)];
+			}
+		}
+	}
+
+	void analyse(TunerFrame& frame) {
+		if (frame.sampleRate != detectorRate_) {
+			// The detectors are tuned to their rate, start over with new ones
+			detectors.clear();
+			detectorRate_ = frame.sampleRate;
+		}
+		for (size_t channel = 0; channel < static_cast<size_t>(frame.channels); channel++) {
+			if (!frame.active.test(channel)) {
+				// Gated channels show no pitch. Only analyse() writes the pitches, so they never go back in time.
+				lastPitches[channel].store(0.0f, std::memory_order_release);
+				continue;
+			}
+			// Do we already create a detector for this channel?
+			while (detectors.size() <= channel) {
+				detectors.push_back(std::make_unique<q::pitch_detector>(50.0_Hz, 2000.0_Hz, static_cast<float>(detectorRate_) / static_cast<float>(decimation_), q::lin_to_db(0.0)));
+			}
+
+			// Feed the samples of this channel into the pitch detector
+			auto& detector = *detectors[channel];
+			const auto& samples = frame.decimated[channel];
+			for (size_t s = 0; s < static_cast<size_t>(frame.samples); s++) {
+				detector(samples[s]);
+			}
+			lastPitches[channel].store(detector.predict_frequency(), std::memory_order_release);
+		}
+		analysed_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static float rms(const float* samples, int numSamples) {
+		float sum = 0.0f;
+		for (int i = 0; i < numSamples; ++i) {
+			sum += samples[i] * samples[i];
+		}
+		return numSamples > 0 ? std::sqrt(sum / static_cast<float>(numSamples)) : 0.0f;
+	}
+
+	// About 10 ms of blocks, the tuner needs no more than the latest ones
+	static constexpr int queueCapacity = 4;
+
+	const int decimation_;
+	const float gate_;
+	std::atomic<bool> background_ { false };
+	QueueWakeup wakeup_; // Before queue_, which notifies it
+	BoundedSpscQueue<TunerFrame> queue_ { queueCapacity, &wakeup_ };
+	TunerFrame inlineFrame_;
+	std::array<float, SAMPLE_BUFFER_SIZE> scratch_ {};
+	std::array<IIRFilter, JAMMERNETZ_MAX_AUDIO_CHANNELS> filters_;
+	int filterRate_ { 0 };
+	int phase_ { 0 };
+	std::array<std::atomic<bool>, JAMMERNETZ_MAX_AUDIO_CHANNELS> enabled_;
 	std::vector<std::unique_ptr<q::pitch_detector>> detectors;
-	std::array<std::atomic<float>, 64> lastPitches;
+	int detectorRate_ { 0 };
+	std::array<std::atomic<float>, JAMMERNETZ_MAX_AUDIO_CHANNELS> lastPitches;
+	std::atomic<uint64_t> analysed_ { 0 };
+	std::atomic<uint64_t> skipped_ { 0 };
 };
 
-Tuner::Tuner()
+Tuner::Tuner(int decimation, float gateDecibels)
 {
-	impl = std::make_unique<TunerImpl>();
+	impl = std::make_unique<TunerImpl>(decimation, gateDecibels);
 }
 
 Tuner::~Tuner() = default;
 
-void Tuner::detectPitch(std::shared_ptr<AudioBuffer<float>> audioBuffer)
+void Tuner::start()
 {
-	impl->detectPitch(audioBuffer);
+	impl->start();
+}
+
+void Tuner::shutdown()
+{
+	impl->shutdown();
+}
+
+void Tuner::detectPitch(const float* const* channels, int numChannels, int numSamples, int sampleRate)
+{
+	impl->detectPitch(channels, numChannels, numSamples, sampleRate);
+}
+
+void Tuner::setChannelEnabled(size_t channel, bool enabled)
+{
+	impl->setChannelEnabled(channel, enabled);
 }
 
 float Tuner::getPitch(size_t channel) const
 {
 	return impl->getPitch(channel);
 }
+
+uint64_t Tuner::analysedBlocks() const noexcept
+{
+	return impl->analysedBlocks();
+}
+
+uint64_t Tuner::skippedBlocks() const noexcept
+{
+	return impl->skippedBlocks();
+}
@@ -11,12 +11,28 @@
 
 class Tuner {
 public:
-	Tuner();
+	// The detectors see every decimation-th sample after a low pass, 4 still covers 50 Hz to 2 kHz at 48 kHz
+	static constexpr int defaultDecimation = 4;
+	// Channels with a block RMS below this are silent or muted, they are not analysed and show no pitch
+	static constexpr float defaultGateDecibels = -60.0f;
+
+	explicit Tuner(int decimation = defaultDecimation, float gateDecibels = defaultGateDecibels);
 	~Tuner();
 
-	void detectPitch(std::shared_ptr<AudioBuffer<float>> audioBuffer);
+	// Moves the pitch detectors to a low priority thread. Without it, detectPitch() analyses on the calling thread.
+	void start();
+	void shutdown();
+
+	// Only gates and decimates when the tuner thread runs. Call from one thread at a time. The sample rate is
+	// that of the audio passed in, a change retunes the filters and starts new detectors.
+	void detectPitch(const float* const* channels, int numChannels, int numSamples, int sampleRate);
+	void setChannelEnabled(size_t channel, bool enabled);
 	float getPitch(size_t channel) const;
 
+	uint64_t analysedBlocks() const noexcept;
+	// Blocks the tuner thread was too busy for, they are skipped
+	uint64_t skippedBlocks() const noexcept;
+
 private:
 	// We might want to try different pitch detection libraries, therefore hide the implementation
 	class TunerImpl;
@@ -8,6 +8,7 @@
 
 #include "Encryption.h"
 #include "JammerNetzPluginEditor.h"
+#include "SampleRateConverter.h"
 #include "Settings.h"
 
 #include <array>
@@ -70,8 +71,9 @@ void JammerNetzPluginProcessor::prepareToPlay(double sampleRate, int maximumExpe
 		disconnectSession();
 	}
 	engine_.prepare(sampleRate, std::min(maximumExpectedSamplesPerBlock, JAMMERNETZ_MAX_CALLBACK_SAMPLES));
-	if (std::abs(sampleRate - static_cast<double>(SAMPLE_RATE)) > 0.5) {
-		setError("JammerNetz currently requires a 48 kHz host sample rate", ErrorSource::sampleRate);
+	// The engine converts other rates to the session's rate
+	if (!SampleRateConverter::supportsRate(sampleRate)) {
+		setError("JammerNetz can't convert a host sample rate of " + juce::String(sampleRate) + " Hz", ErrorSource::sampleRate);
 	} else {
 		clearError(ErrorSource::sampleRate);
 	}
@@ -224,6 +226,8 @@ void JammerNetzPluginProcessor::configureEngine(const JammerNetzPluginConfigurat
 	engine_.setMonitorBalance(1.0);
 	engine_.setMasterVolume(config.remoteGain);
 	engine_.setPlayoutBufferRange(config.minimumJitterFrames, config.maximumJitterFrames);
+	// The host's interface drifts against the server like the standalone client's
+	engine_.setDriftCompensation(true);
 	engine_.newServer();
 }
 
@@ -249,8 +253,8 @@ bool JammerNetzPluginProcessor::connectSession()
 	if (isSessionActive()) {
 		return true;
 	}
-	if (std::abs(preparedSampleRate_.load(std::memory_order_acquire) - static_cast<double>(SAMPLE_RATE)) > 0.5) {
-		setError("Set the host project to 48 kHz before connecting", ErrorSource::sampleRate);
+	if (!SampleRateConverter::supportsRate(preparedSampleRate_.load(std::memory_order_acquire))) {
+		setError("Set the host project to a sample rate between 22.05 and 192 kHz before connecting", ErrorSource::sampleRate);
 		return false;
 	}
 	const auto config = configuration();
@@ -273,7 +277,7 @@ bool JammerNetzPluginProcessor::connectSession()
 	configureEngine(config);
 	engine_.start(false);
 	const bool started = session_.start(
-		[this](std::shared_ptr<JammerNetzAudioData> audio) { engine_.enqueueRemoteAudio(std::move(audio)); },
+		[this](const JammerNetzAudioDataView& audio) { engine_.enqueueRemoteAudio(audio); },
 		sessionConfiguration);
 	if (!started) {
 		engine_.shutdown();
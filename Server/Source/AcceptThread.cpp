@@ -7,80 +7,133 @@
 #include "AcceptThread.h"
 
 #include "BuffersConfig.h"
+#include "LatencyTrace.h"
+#include "NetworkImpairment.h"
+#include "ServerControl.h"
 
 #include <algorithm>
 #include "ServerLogger.h"
 
+#if JUCE_LINUX
+#include <sys/socket.h>
+#endif
+
+namespace {
+
+// Only for log lines about packets that don't belong to a registered client
+std::string clientNameFor(const SocketAddress& sender)
+{
+	return sender.host().toStdString() + ":" + std::to_string(sender.port());
+}
+
+// Lets several sockets bind the same port, the kernel then hashes each sender's address to one of them.
+// JUCE's setEnablePortReuse() only sets SO_REUSEADDR on Linux, which hands all datagrams to one socket.
+bool enablePortSharing(DatagramSocket &socket)
+{
+#if JUCE_LINUX && defined(SO_REUSEPORT)
+	const int enabled = 1;
+	return setsockopt(socket.getRawSocketHandle(), SOL_SOCKET, SO_REUSEPORT, &enabled, sizeof(enabled)) == 0;
+#else
+	// Other systems either lack SO_REUSEPORT or deliver unicast datagrams to only one of the sockets
+	ignoreUnused(socket);
+	return false;
+#endif
+}
+
+} // namespace
+
 class PrintQualityTimer : public HighResolutionTimer {
 public:
-	PrintQualityTimer(TPacketStreamBundle &data) : data_(data) {
+	PrintQualityTimer(const ClientRegistry &data) : data_(data) {
 	}
 
 	virtual void hiResTimerCallback() override
 	{
-		for (auto &streamData : data_) {
+		const auto guard = data_.pin();
+		for (const auto &client : data_.registered()) {
 			JammerNetzStreamQualityInfo qualityInfo;
-			if (streamData.second && streamData.second->qualityInfo(qualityInfo)) {
-				ServerLogger::printStatistics(4, streamData.first, qualityInfo);
+			if (client->state->qualityInfo(qualityInfo)) {
+				ServerLogger::printStatistics(4, client->name, qualityInfo);
 			}
 		}
 	}
 
 private:
-	TPacketStreamBundle &data_;
+	const ClientRegistry &data_;
 };
 
 AcceptThread::AcceptThread(int serverPort, DatagramSocket &socket, CriticalSection& socketWriteLock,
-	TPacketStreamBundle &incomingData, TMessageQueue &wakeUpQueue, ServerBufferConfig bufferConfig,
-	void *keydata, int keysize, ValueTree serverConfiguration)
-	: Thread("ReceiverThread")
+	ClientRegistry &incomingData, TMessageQueue &wakeUpQueue, ServerBufferConfig bufferConfig,
+	void *keydata, int keysize, ServerSettings &serverSettings, int receiveThread, int receiveThreads, bool useIoUring)
+	: Thread(receiveThread == 0 ? String("ReceiverThread") : "ReceiverThread " + String(receiveThread))
     , receiveSocket_(socket)
 	, socketWriteLock_(socketWriteLock)
     , incomingData_(incomingData)
+    , clientIds_(incomingData)
     , wakeUpQueue_(wakeUpQueue)
-    , serverConfiguration_(serverConfiguration)
+    , serverSettings_(serverSettings)
     , bufferConfig_(bufferConfig)
+	, housekeeping_(receiveThread == 0)
 {
 	if (keydata) {
 		blowFish_ = std::make_unique<BlowFish>(keydata, keysize);
 	}
 
+	if (receiveThreads > 1 && !enablePortSharing(receiveSocket_)) {
+		ServerLogger::deinit();
+		std::cerr << "Failed to share port " << serverPort << " between receive threads, SO_REUSEPORT is not available" << std::endl;
+		exit(-1);
+	}
 	if (!receiveSocket_.bindToPort(serverPort)) {
 		ServerLogger::deinit();
 		std::cerr << "Failed to bind port to " << serverPort << std::endl;
 		exit(-1);
 	}
-	ServerLogger::printServerStatus(("Server listening on port " + String(serverPort)).toStdString());
-
-	qualityTimer_ = std::make_unique<PrintQualityTimer>(incomingData);
+	String ioStatus;
+	if (useIoUring) {
+		// Falls back to the blocking socket calls where the kernel can't do it
+		std::string error;
+		ioUring_ = IoUringReceiver::create(receiveSocket_.getRawSocketHandle(), MAXFRAMESIZE, error);
+		ioStatus = ioUring_ ? String(" using io_uring") : " without io_uring (" + String(error) + ")";
+	}
+	if (housekeeping_) {
+		ServerLogger::printServerStatus(("Server listening on port " + String(serverPort)
+			+ (receiveThreads > 1 ? " with " + String(receiveThreads) + " receive threads" : String()) + ioStatus).toStdString());
+		qualityTimer_ = std::make_unique<PrintQualityTimer>(incomingData);
+	}
 }
 
 AcceptThread::~AcceptThread()
 {
-	qualityTimer_->stopTimer();
+	if (qualityTimer_) {
+		qualityTimer_->stopTimer();
+	}
 }
 
-void AcceptThread::processControlMessage(std::shared_ptr<JammerNetzControlMessage> message,
-	const String& senderIPAddress, int senderPort, int receivedPayloadBytes)
+void AcceptThread::processControlMessage(const JammerNetzControlView& message,
+	const SocketAddress& sender, int receivedPayloadBytes)
 {
-    if (message)
+	// Parsed before the acknowledgement is serialized into the read buffer the view points to
+	const auto json = message.json();
+    if (json)
     {
-        if (message->json_.contains("FEC")) {
-            serverConfiguration_.setProperty("FEC", message->json_["FEC"].operator bool(), nullptr);
+        const auto request = parseServerControl(*json);
+        if (request.fec) {
+            serverSettings_.fec.store(*request.fec, std::memory_order_relaxed);
         }
-		if (message->json_.contains("mtu_probe_v1")) {
-			const auto& probe = message->json_["mtu_probe_v1"];
+		if (json->contains("mtu_probe_v1")) {
+			const auto& probe = (*json)["mtu_probe_v1"];
 			if (probe.is_object() && probe.contains("id") && probe["id"].is_number_unsigned()
 				&& probe.contains("size") && probe["size"].is_number_integer()
 				&& probe["size"] == receivedPayloadBytes) {
-				sendMtuAcknowledgement(senderIPAddress, senderPort,
+				sendMtuAcknowledgement(sender,
 					probe["id"].get<uint64>(), receivedPayloadBytes);
 			}
 		}
     }
 }
 
-void AcceptThread::sendMtuAcknowledgement(const String& senderIPAddress, int senderPort,
+void AcceptThread::sendMtuAcknowledgement(const SocketAddress& sender,
 	uint64 probeId, int receivedPayloadBytes)
 {
 	nlohmann::json acknowledgement;
@@ -96,50 +149,141 @@ void AcceptThread::sendMtuAcknowledgement(const String& senderIPAddress, int sen
 	}
 	if (wireBytes > 0) {
 		const ScopedLock socketLock(socketWriteLock_);
-		receiveSocket_.write(senderIPAddress, senderPort, readbuffer, wireBytes);
+		if (NetworkImpairment::instance().isEnabled()) {
+			NetworkImpairment::instance().write(receiveSocket_, sender.host(), sender.port(), readbuffer, wireBytes);
+		}
+		else {
+			sender.sendFrom(receiveSocket_, readbuffer, wireBytes);
+		}
 	}
 }
 
-void AcceptThread::processAudioMessage(std::shared_ptr<JammerNetzAudioData> audioData, std::string const& clientName)
+void AcceptThread::processAudioMessage(const JammerNetzAudioDataView& audioData,
+	const SocketAddress& sender)
 {
-    if (audioData) {
-		// Publish a fully constructed, stable value. Concurrent readers never observe
-		// an empty mapped smart pointer and never access queue ownership directly.
-		auto insertion = incomingData_.insert(
-			std::make_pair(clientName, std::make_shared<ClientState>(clientName)));
-		auto clientState = insertion.first->second;
-		const auto prefillCount = static_cast<std::size_t>(
-			std::max(0, bufferConfig_.serverBufferPrefillOnConnect));
-		const auto result = clientState->push(audioData, prefillCount);
-
-		switch (result.transition) {
-		case ClientConnectionTransition::InitialConnection:
-			ServerLogger::printClientStatus(4, clientName, "New client connected, first package received");
-			break;
-		case ClientConnectionTransition::GraceRecovery:
-			ServerLogger::printClientStatus(4, clientName, "Client recovered during disconnect grace period");
-			break;
-		case ClientConnectionTransition::Reconnection:
-			ServerLogger::printClientStatus(4, clientName, "Reconnected successfully and starts sending again");
-			break;
-		case ClientConnectionTransition::None:
-			break;
+	// Another receive thread may forget clients, the guard keeps this one valid until it has its packet
+	const auto guard = incomingData_.pin();
+	// Only audio makes a client, so probes and stray packets don't take a place in the registry
+	const auto id = clientIds_.idFor(sender);
+	if (!id) {
+		ServerLogger::printClientStatus(4, clientNameFor(sender), "Server is full, ignoring new client");
+		return;
+	}
+	const auto registered = incomingData_.find(*id);
+	if (!registered) {
+		// Forgotten by the housekeeping thread just now, the next packet registers it again
+		return;
+	}
+	const auto& client = *registered;
+	const auto& clientName = client.name;
+	auto& latencyTrace = LatencyTrace::instance();
+	if (latencyTrace.isSampled(audioData.messageCounter())) {
+		latencyTrace.stamp(client.streamId, audioData.messageCounter(), LatencyStage::ServerReceive, audioData.numSamples());
+	}
+	const auto prefillCount = static_cast<std::size_t>(
+		std::max(0, bufferConfig_.serverBufferPrefillOnConnect));
+	// Only now the samples are copied out of the receive buffer, packets of clients we can't take cost nothing
+	const auto result = client.state->push(audioData, prefillCount);
+
+	switch (result.transition) {
+	case ClientConnectionTransition::InitialConnection:
+		ServerLogger::printClientStatus(4, clientName, "New client connected, first package received");
+		break;
+	case ClientConnectionTransition::GraceRecovery:
+		ServerLogger::printClientStatus(4, clientName, "Client recovered during disconnect grace period");
+		break;
+	case ClientConnectionTransition::Reconnection:
+		ServerLogger::printClientStatus(4, clientName, "Reconnected successfully and starts sending again");
+		break;
+	case ClientConnectionTransition::None:
+		break;
+	}
+
+	if (result.queued) {
+		// Only if this was not a duplicate package do give the mixer thread a tick, else duplicates will cause queue drain
+		wakeUpQueue_.push(
+			1); // The value pushed is irrelevant, we just want to wake up the mixer thread which is in a blocking read on this queue
+	}
+}
+
+void AcceptThread::forgetDisconnectedClients()
+{
+	const auto now = ClientState::Clock::now();
+	if (now < nextCollection_) {
+		return;
+	}
+	nextCollection_ = now + std::chrono::seconds(1);
+	for (const auto& name : incomingData_.collect(now)) {
+		ServerLogger::printClientStatus(4, name, "Forgotten after being disconnected for a minute");
+		ServerLogger::removeClient(4, name);
+	}
+}
+
+void AcceptThread::processDatagram(uint8 *data, int dataRead, const SocketAddress& sender)
+{
+	if (dataRead == 0) {
+		ServerLogger::printClientStatus(4, clientNameFor(sender), "Got empty packet from client, ignoring");
+		return;
+	}
+	int messageLength = -1;
+	if (blowFish_ && dataRead > 0) {
+		messageLength = blowFish_->decrypt(data, (size_t) dataRead);
+		if (messageLength == -1) {
+			ServerLogger::printClientStatus(4, clientNameFor(sender), "Using wrong encryption key, can't connect");
+			return;
 		}
+	}
+	else {
+		// No encryption!
+		messageLength = dataRead;
+	}
 
-		if (result.queued) {
-			// Only if this was not a duplicate package do give the mixer thread a tick, else duplicates will cause queue drain
-			wakeUpQueue_.push(
-                    1); // The value pushed is irrelevant, we just want to wake up the mixer thread which is in a blocking read on this queue
+    if (messageLength > 0) {
+        const auto message = decodeJammerNetzMessage(data, (size_t) messageLength);
+        if (const auto audio = std::get_if<JammerNetzAudioDataView>(&message)) {
+            processAudioMessage(*audio, sender);
+        }
+        else if (const auto control = std::get_if<JammerNetzControlView>(&message)) {
+            processControlMessage(*control, sender, dataRead);
+        }
+#ifdef ALLOW_HELO
+        // Useful for debugging firewall problems, use ncat and send some bytes to this port to get the message back
+        else if (std::holds_alternative<JammerNetzDecodeError>(message)) {
+            // HELO
+            std::string helo("HELO");
+            receiveSocket_.write(sender.host(), sender.port(), helo.data(), (int)helo.size());
         }
+#endif
     }
 }
 
 void AcceptThread::run()
 {
-	// Start the timer that will frequently output quality data for each of the clients' connections
-	qualityTimer_->startTimer(500);
+	if (qualityTimer_) {
+		// Start the timer that will frequently output quality data for each of the clients' connections
+		qualityTimer_->startTimer(500);
+	}
 	while (!currentThreadShouldExit()) {
-		switch (receiveSocket_.waitUntilReady(true, 250)) {
+		if (housekeeping_) {
+			forgetDisconnectedClients();
+		}
+		if (ioUring_) {
+			// All datagrams that arrived meanwhile with one system call, decrypted and parsed right in the receive buffers
+			const int received = ioUring_->receive(250, [this](IoUringReceiver::Datagram &datagram) {
+				processDatagram(datagram.data, datagram.size, datagram.sender);
+			});
+			if (received == 0) {
+				// Timeout, wake up the MixerThread so it can check for termination as well
+				wakeUpQueue_.push(0);
+			}
+			else if (received == -1) {
+				ServerLogger::deinit();
+				std::cerr << "Error receiving with io_uring, abort! " << ioUring_->lastError() << std::endl;
+				exit(-1);
+			}
+			continue;
+		}
+		switch (NetworkImpairment::instance().waitUntilReady(receiveSocket_, true, 250)) {
 		case 0:
 			// Timeout, nothing to be done (no data received from any client), just check if we should terminate, also wake up the MixerThread so it can do the same
 			wakeUpQueue_.push(0);
@@ -148,60 +292,16 @@ void AcceptThread::run()
 			// Ready to read data from socket!
 			String senderIPAdress;
 			int senderPortNumber;
-			int dataRead = receiveSocket_.read(readbuffer, MAXFRAMESIZE, false, senderIPAdress, senderPortNumber);
+			int dataRead = NetworkImpairment::instance().read(receiveSocket_, readbuffer, MAXFRAMESIZE, false, senderIPAdress, senderPortNumber);
 			if (dataRead == -1) {
 				ServerLogger::deinit();
 				std::cerr << "Error reading data from socket, abort!" << std::endl;
 				exit(-1);
 			}
-
-			std::string clientName = senderIPAdress.toStdString() + ":" + String(senderPortNumber).toStdString();
-			if (dataRead == 0) {
-				ServerLogger::printClientStatus(4, clientName, "Got empty packet from client, ignoring");
-				continue;
-			}
-			int messageLength = -1;
-			if (blowFish_ && dataRead > 0) {
-				messageLength = blowFish_->decrypt(readbuffer, (size_t) dataRead);
-				if (messageLength == -1) {
-					ServerLogger::printClientStatus(4, clientName, "Using wrong encryption key, can't connect");
-					continue;
-				}
-			}
-			else {
-				// No encryption!
-				messageLength = dataRead;
+			// JUCE reports the sender as a numeric address, anything else can't be answered
+			if (const auto sender = SocketAddress::fromString(senderIPAdress, senderPortNumber)) {
+				processDatagram(readbuffer, dataRead, *sender);
 			}
-
-            if (messageLength > 0) {
-                auto message = JammerNetzMessage::deserialize(readbuffer, (size_t) messageLength);
-                if (message) {
-                    switch (message->getType()) {
-                        case JammerNetzMessage::MessageType::AUDIODATA:
-                            processAudioMessage(std::dynamic_pointer_cast<JammerNetzAudioData>(message), clientName);
-                            break;
-                        case JammerNetzMessage::MessageType::GENERIC_JSON:
-                            processControlMessage(std::dynamic_pointer_cast<JammerNetzControlMessage>(message),
-								senderIPAdress, senderPortNumber, dataRead);
-                            break;
-                        case JammerNetzMessage::MessageType::CLIENTINFO:
-                            // fall through
-                        case JammerNetzMessage::MessageType::SESSIONSETUP:
-                            // fall through
-                        default:
-                            // Ignoring Message
-                            break;
-                    }
-                }
-#ifdef ALLOW_HELO
-                // Useful for debugging firewall problems, use ncat and send some bytes to this port to get the message back
-                else {
-                    // HELO
-                    std::string helo("HELO");
-                    receiveSocket_.write(senderIPAdress, senderPortNumber, helo.data(), (int)helo.size());
-                }
-#endif
-            }
 			break;
 		}
 		case -1:
@@ -11,37 +11,57 @@
 #include "SharedServerTypes.h"
 #include "BuffersConfig.h"
 
-#include "JammerNetzPackage.h"
+#include "JammerNetzMessageView.h"
+#include "IoUringSocket.h"
+#include "ServerControl.h"
 
 class PrintQualityTimer;
 
+// Receives, decrypts and parses the datagrams of one socket. With more than one receive thread, each binds
+// its own socket to the server port with SO_REUSEPORT and the kernel spreads the clients over them by
+// address, so a client's packets still arrive in order on one thread. The first one also does the
+// housekeeping: statistics output and forgetting disconnected clients. With io_uring requested and
+// available, the socket is read through an IoUringReceiver instead of waitUntilReady and read.
 class AcceptThread : public Thread {
 public:
+	// More threads would not get a place to read the client registry in time
+	static constexpr int maximumReceiveThreads = 8;
+
 	AcceptThread(int serverPort, DatagramSocket &socket,
                  CriticalSection& socketWriteLock,
-                 TPacketStreamBundle &incomingData, TMessageQueue &wakeUpQueue,
+                 ClientRegistry &incomingData, TMessageQueue &wakeUpQueue,
                  ServerBufferConfig bufferConfig,
                  void *keydata,
                  int keysize,
-                 ValueTree serverConfiguration);
+                 ServerSettings &serverSettings,
+                 int receiveThread = 0,
+                 int receiveThreads = 1,
+                 bool useIoUring = false);
 	virtual ~AcceptThread() override;
 
 	virtual void run() override;
 
 private:
-    void processControlMessage(std::shared_ptr<JammerNetzControlMessage> message,
-		const String& senderIPAddress, int senderPort, int receivedPayloadBytes);
-	void sendMtuAcknowledgement(const String& senderIPAddress, int senderPort,
+    void processControlMessage(const JammerNetzControlView& message,
+		const SocketAddress& sender, int receivedPayloadBytes);
+	void sendMtuAcknowledgement(const SocketAddress& sender,
 		uint64 probeId, int receivedPayloadBytes);
-    void processAudioMessage(std::shared_ptr<JammerNetzAudioData> message, std::string const& clientName);
+    void processAudioMessage(const JammerNetzAudioDataView& message,
+		const SocketAddress& sender);
+	void processDatagram(uint8 *data, int dataRead, const SocketAddress& sender);
+	void forgetDisconnectedClients();
 
     DatagramSocket &receiveSocket_;
 	CriticalSection& socketWriteLock_;
-	TPacketStreamBundle &incomingData_;
+	ClientRegistry &incomingData_;
+	ClientRegistry::ReceiveCache clientIds_;
 	TMessageQueue &wakeUpQueue_;
-    ValueTree serverConfiguration_;
+	ServerSettings &serverSettings_;
 	uint8 readbuffer[MAXFRAMESIZE];
 	std::unique_ptr<PrintQualityTimer> qualityTimer_;
 	ServerBufferConfig bufferConfig_;
 	std::unique_ptr<BlowFish> blowFish_;
+	std::unique_ptr<IoUringReceiver> ioUring_;
+	bool housekeeping_;
+	ClientState::TimePoint nextCollection_ {};
 };
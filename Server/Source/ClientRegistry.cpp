@@ -0,0 +1,217 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "ClientRegistry.h"
+
+#include "LatencyTrace.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+// The largest generation that can't produce noClient
+constexpr ClientId maximumGeneration = ClientRegistry::noClient / ClientRegistry::maximumClients - 1;
+
+} // namespace
+
+ClientRegistry::ClientRegistry() : slots_(maximumClients)
+{
+	ids_.reserve(maximumClients);
+	freeSlots_.reserve(maximumClients);
+	retiredSlots_.reserve(maximumClients);
+	// Taken from the back, so the first client gets slot 0
+	for (std::size_t slot = maximumClients; slot > 0; --slot) {
+		freeSlots_.push_back(slot - 1);
+	}
+	publish(std::make_unique<ClientList>());
+}
+
+ClientRegistry::~ClientRegistry() = default;
+
+std::optional<ClientId> ClientRegistry::idFor(const juce::String& address, int port)
+{
+	Endpoint endpoint { address, port };
+	std::lock_guard<std::mutex> lock(writeLock_);
+	if (auto known = ids_.find(endpoint); known != ids_.end()) {
+		return known->second;
+	}
+	if (freeSlots_.empty()) {
+		reclaim();
+		if (freeSlots_.empty()) {
+			return std::nullopt;
+		}
+	}
+	const auto index = freeSlots_.back();
+	freeSlots_.pop_back();
+
+	auto& slot = slots_[index];
+	const ClientId id = slot.generation * maximumClients + static_cast<ClientId>(index);
+	slot.generation = slot.generation == maximumGeneration ? 0 : slot.generation + 1;
+	auto& client = slot.client;
+	client.id = id;
+	client.address = address;
+	client.port = port;
+	client.ipAddress = juce::IPAddress(address);
+	client.socketAddress = SocketAddress::fromString(address, port).value_or(SocketAddress {});
+	client.name = address.toStdString() + ":" + std::to_string(port);
+	client.streamId = LatencyTrace::streamId(client.name);
+	client.state = std::make_shared<ClientState>(client.name);
+	ids_.emplace(std::move(endpoint), id);
+
+	auto clients = std::make_unique<ClientList>(*current_);
+	clients->push_back(&client);
+	// The entry is complete before the id makes it visible to find()
+	slot.id.store(id);
+	publish(std::move(clients));
+	return id;
+}
+
+std::vector<std::string> ClientRegistry::collect(ClientState::TimePoint now)
+{
+	std::vector<std::string> forgotten;
+	std::lock_guard<std::mutex> lock(writeLock_);
+	const auto disconnectedBefore = now - retention;
+	for (const auto* client : *current_) {
+		if (client->state->disconnectedBefore(disconnectedBefore)) {
+			forgotten.push_back(client->name);
+		}
+	}
+	if (!forgotten.empty()) {
+		auto clients = std::make_unique<ClientList>();
+		clients->reserve(current_->size());
+		std::vector<std::size_t> unpublished;
+		for (const auto* client : *current_) {
+			if (!client->state->disconnectedBefore(disconnectedBefore)) {
+				clients->push_back(client);
+				continue;
+			}
+			ids_.erase(Endpoint { client->address, client->port });
+			const auto index = slotOf(client->id);
+			slots_[index].id.store(noClient);
+			unpublished.push_back(index);
+		}
+		publish(std::move(clients));
+		// Readers that started before this epoch might still see the forgotten clients
+		const auto retiredAt = epoch_.load();
+		for (const auto index : unpublished) {
+			slots_[index].retiredAt = retiredAt;
+			retiredSlots_.push_back(index);
+		}
+	}
+	reclaim();
+	return forgotten;
+}
+
+ClientRegistry::ReadGuard ClientRegistry::pin() const
+{
+	while (true) {
+		const auto epoch = epoch_.load();
+		for (auto& reader : readers_) {
+			std::uint64_t free = 0;
+			if (reader.compare_exchange_strong(free, epoch)) {
+				return ReadGuard(reader);
+			}
+		}
+		std::this_thread::yield();
+	}
+}
+
+ClientId ClientRegistry::size() const noexcept
+{
+	return static_cast<ClientId>(published_.load()->size());
+}
+
+const RegisteredClient* ClientRegistry::find(ClientId id) const noexcept
+{
+	const auto& slot = slots_[slotOf(id)];
+	return slot.id.load() == id ? &slot.client : nullptr;
+}
+
+std::span<const RegisteredClient* const> ClientRegistry::registered() const noexcept
+{
+	const auto* clients = published_.load();
+	return { clients->data(), clients->size() };
+}
+
+std::uint64_t ClientRegistry::version() const noexcept
+{
+	return version_.load(std::memory_order_relaxed);
+}
+
+void ClientRegistry::publish(std::unique_ptr<ClientList> clients)
+{
+	published_.store(clients.get());
+	if (current_) {
+		// A reader that loaded the old list started in an epoch before the new one
+		retiredLists_.push_back({ std::move(current_), epoch_.fetch_add(1) + 1 });
+	}
+	current_ = std::move(clients);
+	version_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::uint64_t ClientRegistry::oldestPinnedEpoch() const noexcept
+{
+	auto oldest = std::numeric_limits<std::uint64_t>::max();
+	for (const auto& reader : readers_) {
+		const auto epoch = reader.load();
+		if (epoch != 0) {
+			oldest = std::min(oldest, epoch);
+		}
+	}
+	return oldest;
+}
+
+void ClientRegistry::reclaim()
+{
+	if (retiredSlots_.empty() && retiredLists_.empty()) {
+		return;
+	}
+	const auto oldestPinned = oldestPinnedEpoch();
+	std::erase_if(retiredLists_, [oldestPinned](const RetiredList& retired) {
+		return retired.retiredAt <= oldestPinned;
+	});
+	std::erase_if(retiredSlots_, [this, oldestPinned](std::size_t index) {
+		auto& slot = slots_[index];
+		if (slot.retiredAt > oldestPinned) {
+			return false;
+		}
+		slot.client = RegisteredClient {};
+		freeSlots_.push_back(index);
+		return true;
+	});
+}
+
+ClientRegistry::ReceiveCache::ReceiveCache(ClientRegistry& registry) : registry_(registry)
+{
+	ids_.reserve(maximumClients);
+}
+
+std::optional<ClientId> ClientRegistry::ReceiveCache::idFor(const SocketAddress& address)
+{
+	// Drop what the registry forgot meanwhile, else this would keep every address ever seen
+	if (const auto version = registry_.version(); version != version_) {
+		version_ = version;
+		std::erase_if(ids_, [this](const auto& entry) { return registry_.find(entry.second) == nullptr; });
+	}
+	if (auto known = ids_.find(address); known != ids_.end()) {
+		if (registry_.find(known->second) != nullptr) {
+			return known->second;
+		}
+		// Forgotten since the check above, it registers again
+		ids_.erase(known);
+	}
+	const auto id = registry_.idFor(address.host(), address.port());
+	if (id) {
+		ids_.emplace(address, *id);
+	}
+	return id;
+}
+
+std::size_t ClientRegistry::EndpointHash::operator()(const Endpoint& endpoint) const noexcept
+{
+	return static_cast<std::size_t>(endpoint.address.hashCode64()) * 31u + static_cast<std::size_t>(endpoint.port);
+}
@@ -0,0 +1,157 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include "ClientState.h"
+#include "SocketAddress.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Identifies a client for as long as it is registered. The low part is the client's slot, threads keep
+// per client state in arrays indexed by ClientRegistry::slotOf(id) instead of maps keyed by the address.
+// The high part counts how often the slot was handed out, so the id of a forgotten client never names
+// the client that took over its slot.
+using ClientId = std::uint32_t;
+
+struct RegisteredClient {
+	ClientId id { 0 };
+	juce::String address;
+	int port { 0 };
+	juce::IPAddress ipAddress;
+	// Resolved once on registration, what the send thread sends to
+	SocketAddress socketAddress;
+	// "ip:port", only for logs and file names
+	std::string name;
+	uint64_t streamId { 0 };
+	std::shared_ptr<ClientState> state;
+};
+
+// Maps the address a datagram came from to the client's id. Only the receive threads register and
+// forget clients, taking turns on a mutex, every other thread reads under a ReadGuard. An entry never
+// changes while it is published, so readers need no lock. A client that stayed disconnected for the
+// retention period is unpublished by collect(), and its slot and state are only reused once no reader
+// that could still see it holds a guard (epoch based reclamation). That keeps memory and the cost of
+// iterating the clients proportional to the clients of the last minute, not to every address ever seen.
+class ClientRegistry {
+public:
+	static constexpr ClientId maximumClients = 256;
+	static constexpr ClientId noClient = std::numeric_limits<ClientId>::max();
+	// Threads reading at the same time, more have to wait for a free place
+	static constexpr std::size_t maximumReaders = 16;
+	static constexpr auto retention = std::chrono::seconds(60);
+
+	static constexpr std::size_t slotOf(ClientId id) noexcept { return id % maximumClients; }
+
+	// Keeps everything read from the registry valid until it goes out of scope. Hold it for one
+	// pass over the clients, not across a blocking wait, else nothing can be reclaimed.
+	class [[nodiscard]] ReadGuard {
+	public:
+		explicit ReadGuard(std::atomic<std::uint64_t>& reader) noexcept : reader_(reader) {}
+		~ReadGuard() { reader_.store(0); }
+		ReadGuard(const ReadGuard&) = delete;
+		ReadGuard& operator=(const ReadGuard&) = delete;
+
+	private:
+		std::atomic<std::uint64_t>& reader_;
+	};
+
+	class ReceiveCache;
+
+	ClientRegistry();
+	~ClientRegistry();
+
+	// Receive threads. The id of the client at that address, registered on first sight. Empty when full.
+	// With more than one receive thread, pin before and use the entry only while pinned, as another
+	// receive thread might forget the client meanwhile.
+	std::optional<ClientId> idFor(const juce::String& address, int port);
+	// Receive threads. Forgets the clients disconnected for longer than the retention period and reuses
+	// what no reader can see anymore. Returns the names of the forgotten clients.
+	std::vector<std::string> collect(ClientState::TimePoint now = ClientState::Clock::now());
+
+	// Any thread
+	ReadGuard pin() const;
+	// Only while pinned, except on a single receive thread
+	ClientId size() const noexcept;
+	// Null once the client was forgotten
+	const RegisteredClient* find(ClientId id) const noexcept;
+	std::span<const RegisteredClient* const> registered() const noexcept;
+	// Changes whenever a client is registered or forgotten, so readers with per client state know when to look for stale entries
+	std::uint64_t version() const noexcept;
+
+private:
+	using ClientList = std::vector<const RegisteredClient*>;
+
+	struct Endpoint {
+		juce::String address;
+		int port;
+		bool operator==(const Endpoint& other) const noexcept { return port == other.port && address == other.address; }
+	};
+	struct EndpointHash {
+		std::size_t operator()(const Endpoint& endpoint) const noexcept;
+	};
+	struct Slot {
+		std::atomic<ClientId> id { noClient };
+		RegisteredClient client;
+		ClientId generation { 0 };
+		std::uint64_t retiredAt { 0 };
+	};
+	struct RetiredList {
+		std::unique_ptr<const ClientList> list;
+		std::uint64_t retiredAt;
+	};
+
+	void publish(std::unique_ptr<ClientList> clients);
+	std::uint64_t oldestPinnedEpoch() const noexcept;
+	void reclaim();
+
+	std::vector<Slot> slots_;
+	std::atomic<const ClientList*> published_ { nullptr };
+	std::atomic<std::uint64_t> version_ { 0 };
+	std::atomic<std::uint64_t> epoch_ { 1 };
+	// The epoch each reader started in, 0 for a free place
+	mutable std::array<std::atomic<std::uint64_t>, maximumReaders> readers_ {};
+	// Everything below is only touched by the receive threads, under this lock
+	std::mutex writeLock_;
+	std::unordered_map<Endpoint, ClientId, EndpointHash> ids_;
+	std::unique_ptr<ClientList> current_;
+	std::vector<std::size_t> freeSlots_;
+	std::vector<std::size_t> retiredSlots_;
+	std::vector<RetiredList> retiredLists_;
+};
+
+// One per receive thread. Remembers the ids of the clients this thread has seen, so a packet of a known
+// client is looked up in a map of its own instead of under the registry's lock, which is only taken to
+// register a new client. Use it while pinned, like ClientRegistry::idFor().
+class ClientRegistry::ReceiveCache {
+public:
+	explicit ReceiveCache(ClientRegistry& registry);
+
+	// Compares and hashes the binary address, the registry builds its string only for a client it doesn't know yet
+	std::optional<ClientId> idFor(const SocketAddress& address);
+
+private:
+	struct AddressHash {
+		std::size_t operator()(const SocketAddress& address) const noexcept { return address.hash(); }
+	};
+
+	ClientRegistry& registry_;
+	std::unordered_map<SocketAddress, ClientId, AddressHash> ids_;
+	std::uint64_t version_ { 0 };
+};
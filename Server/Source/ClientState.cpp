@@ -6,20 +6,52 @@
 
 #include "ClientState.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <stack>
 #include <utility>
 
 ClientState::ClientState(std::string clientName) : clientName_(std::move(clientName)) {
+	packetPool_.reserve(packetPoolSize);
+}
+
+ClientPushResult ClientState::push(const JammerNetzAudioDataView &audioData,
+	std::size_t initialPrefillCount, TimePoint now) {
+	return push(pooledPacket(audioData), initialPrefillCount, now);
+}
+
+std::shared_ptr<JammerNetzAudioData> ClientState::pooledPacket(const JammerNetzAudioDataView &audioData) {
+	std::lock_guard<std::mutex> lock(poolMutex_);
+	for (std::size_t i = 0; i < packetPool_.size(); ++i) {
+		nextPooled_ = (nextPooled_ + 1) % packetPool_.size();
+		auto &candidate = packetPool_[nextPooled_];
+		if (candidate.use_count() == 1) {
+			// The queue, the mixer or the recorder let go of it on their thread. Releasing a shared_ptr is a release
+			// decrement, the fence makes their last reads happen before we overwrite the samples.
+			std::atomic_thread_fence(std::memory_order_acquire);
+			audioData.readInto(*candidate);
+			return candidate;
+		}
+	}
+	if (packetPool_.size() < packetPool_.capacity()) {
+		packetPool_.push_back(audioData.toMessage());
+		return packetPool_.back();
+	}
+	return audioData.toMessage();
 }
 
 ClientPushResult ClientState::push(std::shared_ptr<JammerNetzAudioData> packet,
-	std::size_t initialPrefillCount, TimePoint /*now*/) {
+	std::size_t initialPrefillCount, TimePoint now) {
 	std::lock_guard<std::mutex> lock(mutex_);
 
 	ClientConnectionTransition transition = ClientConnectionTransition::None;
 	const bool isInitialConnection = !hasConnected_;
 	if (!queue_) {
 		queue_ = std::make_shared<PacketStreamQueue>(clientName_);
+		// It might come back on another route
+		previousOffsetMinimum_.reset();
+		offsetsInWindow_ = 0;
 		transition = isInitialConnection ? ClientConnectionTransition::InitialConnection
 			: ClientConnectionTransition::Reconnection;
 	}
@@ -30,6 +62,7 @@ ClientPushResult ClientState::push(std::shared_ptr<JammerNetzAudioData> packet,
 	state_ = ClientConnectionState::Connected;
 	hasConnected_ = true;
 	++activityGeneration_;
+	observeArrival(packet->timestamp(), now);
 
 	// Preserve the existing behavior: only the first connection is prefixed with
 	// padding. A reconnect starts with the first real packet and a fresh queue.
@@ -91,6 +124,30 @@ bool ClientState::qualityInfo(JammerNetzStreamQualityInfo &qualityInfo) const {
 	return true;
 }
 
+std::optional<double> ClientState::captureOffsetMs() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (offsetsInWindow_ == 0) {
+		return previousOffsetMinimum_;
+	}
+	return previousOffsetMinimum_ ? std::min(*previousOffsetMinimum_, currentOffsetMinimum_) : currentOffsetMinimum_;
+}
+
+double ClientState::milliseconds(TimePoint time) {
+	return std::chrono::duration<double, std::milli>(time.time_since_epoch()).count();
+}
+
+void ClientState::observeArrival(double timestamp, TimePoint now) {
+	const double offset = milliseconds(now) - timestamp;
+	if (!std::isfinite(offset)) {
+		return;
+	}
+	currentOffsetMinimum_ = offsetsInWindow_ == 0 ? offset : std::min(currentOffsetMinimum_, offset);
+	if (++offsetsInWindow_ == captureOffsetWindow) {
+		previousOffsetMinimum_ = currentOffsetMinimum_;
+		offsetsInWindow_ = 0;
+	}
+}
+
 bool ClientState::markUnderrun(std::uint64_t observedActivityGeneration, TimePoint now) {
 	std::lock_guard<std::mutex> lock(mutex_);
 	if (state_ != ClientConnectionState::Connected || activityGeneration_ != observedActivityGeneration) {
@@ -107,6 +164,12 @@ bool ClientState::disconnectIfGraceExpired(TimePoint now) {
 		return false;
 	}
 	state_ = ClientConnectionState::Disconnected;
+	disconnectedAt_ = now;
 	queue_.reset();
 	return true;
 }
+
+bool ClientState::disconnectedBefore(TimePoint time) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return hasConnected_ && state_ == ClientConnectionState::Disconnected && disconnectedAt_ < time;
+}
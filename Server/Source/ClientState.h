@@ -7,12 +7,15 @@
 #pragma once
 
 #include "PacketStreamQueue.h"
+#include "JammerNetzMessageView.h"
 
 #include <chrono>
 #include <cstdint>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <vector>
 
 enum class ClientConnectionState {
 	Disconnected,
@@ -56,22 +59,51 @@ public:
 
 	ClientPushResult push(std::shared_ptr<JammerNetzAudioData> packet,
 		std::size_t initialPrefillCount, TimePoint now = Clock::now());
+	// Decodes into a packet of this client's pool, so a steady stream is queued without allocating
+	ClientPushResult push(const JammerNetzAudioDataView &audioData,
+		std::size_t initialPrefillCount, TimePoint now = Clock::now());
 	bool tryPop(std::shared_ptr<JammerNetzAudioData> &packet, bool &isFillIn,
 		std::uint64_t &observedActivityGeneration);
 	ClientQueuePressureResult applyQueuePressure(std::size_t maximumPacketCount,
 		std::size_t retainedPacketCount);
 	ClientQueueSnapshot snapshot() const;
 	bool qualityInfo(JammerNetzStreamQualityInfo &qualityInfo) const;
+	// Our clock in milliseconds minus the client's timestamp, for the least delayed of its recent packets.
+	// Maps the client's timestamps onto our clock, up to the network's minimum one-way delay.
+	std::optional<double> captureOffsetMs() const;
+
+	static double milliseconds(TimePoint time);
 
 	bool markUnderrun(std::uint64_t observedActivityGeneration, TimePoint now = Clock::now());
 	bool disconnectIfGraceExpired(TimePoint now = Clock::now());
+	// True if the client was connected once and has been disconnected since before that time
+	bool disconnectedBefore(TimePoint time) const;
 
 private:
+	// A new minimum after this many packets, so a route that got slower is followed within seconds
+	static constexpr std::size_t captureOffsetWindow = 512;
+
+	// Enough for the jitter buffer plus what the mixer and the recorder still hold. Beyond that packets are
+	// allocated and dropped as before.
+	static constexpr std::size_t packetPoolSize = 256;
+
+	void observeArrival(double timestamp, TimePoint now);
+	std::shared_ptr<JammerNetzAudioData> pooledPacket(const JammerNetzAudioDataView &audioData);
+
 	mutable std::mutex mutex_;
 	std::string clientName_;
 	ClientConnectionState state_{ClientConnectionState::Disconnected};
 	std::shared_ptr<PacketStreamQueue> queue_;
 	TimePoint disconnectDeadline_{};
+	TimePoint disconnectedAt_{};
 	std::uint64_t activityGeneration_{0};
 	bool hasConnected_{false};
+	std::optional<double> previousOffsetMinimum_;
+	double currentOffsetMinimum_{0.0};
+	std::size_t offsetsInWindow_{0};
+
+	// Only the receive thread decodes, but keep it off mutex_ so the mixer never waits for a decode
+	std::mutex poolMutex_;
+	std::vector<std::shared_ptr<JammerNetzAudioData>> packetPool_;
+	std::size_t nextPooled_{0};
 };
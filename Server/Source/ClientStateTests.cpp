@@ -1,13 +1,18 @@
+#include "AllocationCounter.h"
 #include "ClientState.h"
 #include "SharedServerTypes.h"
 
 #include "BuffersConfig.h"
+#include "JammerNetzMessageView.h"
+#include "LatencyTrace.h"
 
 #include "gtest/gtest.h"
 
 #include <atomic>
+#include <set>
 #include <string>
 #include <thread>
+#include <variant>
 #include <vector>
 
 namespace {
@@ -64,8 +69,58 @@ TEST(ClientStateTest, RejectsAnUnderrunDecisionMadeBeforeConcurrentPacketActivit
 	EXPECT_EQ(client.snapshot().state, ClientConnectionState::Connected);
 }
 
+TEST(ClientStateTest, QueuesReceivedPacketsWithoutAllocatingOnceItsPoolIsWarm) {
+	ClientState client("127.0.0.1:1234");
+	constexpr int packetCount = 600;
+	std::vector<std::vector<uint8>> datagrams;
+	for (int i = 0; i < packetCount; ++i) {
+		auto packet = makePacket(static_cast<std::uint64_t>(100 + i));
+		packet->audioBuffer()->clear();
+		packet->audioBuffer()->setSample(0, 0, 0.25f);
+		std::vector<uint8> datagram(MAXFRAMESIZE);
+		size_t bytes = 0;
+		packet->serialize(datagram.data(), bytes);
+		datagram.resize(bytes);
+		datagrams.push_back(std::move(datagram));
+	}
+
+	std::shared_ptr<JammerNetzAudioData> popped;
+	int queued = 0;
+	auto receiveAndMix = [&](int i) {
+		const auto decoded = decodeJammerNetzMessage(datagrams[static_cast<size_t>(i)].data(), datagrams[static_cast<size_t>(i)].size());
+		if (const auto *audio = std::get_if<JammerNetzAudioDataView>(&decoded)) {
+			queued += client.push(*audio, 0, ClientState::TimePoint{}).queued ? 1 : 0;
+		}
+		bool isFillIn = false;
+		std::uint64_t generation = 0;
+		client.tryPop(popped, isFillIn, generation);
+	};
+
+	// The first packets connect the client and fill the pool
+	for (int i = 0; i < packetCount / 2; ++i) {
+		receiveAndMix(i);
+	}
+	std::uint64_t allocations = 0;
+	{
+		jammernetz::test::AllocationCounter counter;
+		for (int i = packetCount / 2; i < packetCount; ++i) {
+			receiveAndMix(i);
+		}
+		allocations = counter.allocations();
+	}
+	EXPECT_EQ(queued, packetCount);
+	ASSERT_NE(popped, nullptr);
+	EXPECT_EQ(popped->messageCounter(), static_cast<std::uint64_t>(100 + packetCount - 1));
+	EXPECT_NEAR(popped->audioBuffer()->getSample(0, 0), 0.25f, 1e-3f);
+	EXPECT_EQ(popped->audioBuffer()->getSample(1, 0), 0.0f);
+	if (!jammernetz::test::AllocationCounter::enabled) {
+		GTEST_SKIP() << "Allocations are only counted with JAMMERNETZ_ALLOCATION_TESTS";
+	}
+	EXPECT_EQ(allocations, 0u);
+}
+
 TEST(ClientStateTest, SupportsConcurrentPublicationMixSendAndStatisticsAccess) {
-	TPacketStreamBundle clients;
+	ClientRegistry clients;
 	std::atomic<bool> accepting{true};
 	std::atomic<int> readersReady{0};
 	constexpr int clientCount = 16;
@@ -76,9 +131,8 @@ TEST(ClientStateTest, SupportsConcurrentPublicationMixSendAndStatisticsAccess) {
 			std::this_thread::yield();
 		}
 		for (int i = 0; i < packetCount; ++i) {
-			const auto name = "127.0.0.1:" + std::to_string(1000 + (i % clientCount));
-			auto insertion = clients.insert(std::make_pair(name, std::make_shared<ClientState>(name)));
-			insertion.first->second->push(
+			const auto id = clients.idFor("127.0.0.1", 1000 + (i % clientCount));
+			clients.find(*id)->state->push(
 				makePacket(static_cast<std::uint64_t>(100 + i / clientCount)), 0);
 		}
 		accepting = false;
@@ -87,14 +141,15 @@ TEST(ClientStateTest, SupportsConcurrentPublicationMixSendAndStatisticsAccess) {
 	std::thread mixThread([&] {
 		++readersReady;
 		while (accepting.load()) {
-			for (auto &entry : clients) {
+			const auto guard = clients.pin();
+			for (const auto &entry : clients.registered()) {
 				std::shared_ptr<JammerNetzAudioData> packet;
 				bool isFillIn = false;
 				std::uint64_t generation = 0;
-				if (!entry.second->tryPop(packet, isFillIn, generation)) {
-					entry.second->markUnderrun(generation);
+				if (!entry->state->tryPop(packet, isFillIn, generation)) {
+					entry->state->markUnderrun(generation);
 				}
-				entry.second->disconnectIfGraceExpired();
+				entry->state->disconnectIfGraceExpired();
 			}
 		}
 	});
@@ -102,11 +157,12 @@ TEST(ClientStateTest, SupportsConcurrentPublicationMixSendAndStatisticsAccess) {
 	auto inspectClients = [&] {
 		++readersReady;
 		while (accepting.load()) {
-			for (auto &entry : clients) {
-				const auto snapshot = entry.second->snapshot();
+			const auto guard = clients.pin();
+			for (const auto &entry : clients.registered()) {
+				const auto snapshot = entry->state->snapshot();
 				JammerNetzStreamQualityInfo qualityInfo;
 				if (snapshot.size > 0) {
-					entry.second->qualityInfo(qualityInfo);
+					entry->state->qualityInfo(qualityInfo);
 				}
 			}
 		}
@@ -119,10 +175,173 @@ TEST(ClientStateTest, SupportsConcurrentPublicationMixSendAndStatisticsAccess) {
 	sendThread.join();
 	statisticsThread.join();
 
-	EXPECT_EQ(clients.size(), static_cast<std::size_t>(clientCount));
-	for (const auto &entry : clients) {
-		EXPECT_NE(entry.second, nullptr);
+	EXPECT_EQ(clients.size(), static_cast<ClientId>(clientCount));
+	for (const auto &entry : clients.registered()) {
+		EXPECT_NE(entry->state, nullptr);
+	}
+}
+
+TEST(ClientRegistryTest, HandsOutDenseIdsPerAddress) {
+	ClientRegistry clients;
+	const auto first = clients.idFor("10.0.0.1", 1234);
+	const auto samePortOtherHost = clients.idFor("10.0.0.2", 1234);
+	const auto sameHostOtherPort = clients.idFor("10.0.0.1", 1235);
+	ASSERT_TRUE(first && samePortOtherHost && sameHostOtherPort);
+	EXPECT_EQ(*first, 0u);
+	EXPECT_EQ(*samePortOtherHost, 1u);
+	EXPECT_EQ(*sameHostOtherPort, 2u);
+	EXPECT_EQ(clients.idFor("10.0.0.1", 1234), first);
+	EXPECT_EQ(clients.size(), 3u);
+
+	const auto& client = *clients.find(*sameHostOtherPort);
+	EXPECT_EQ(client.name, "10.0.0.1:1235");
+	EXPECT_EQ(client.port, 1235);
+	EXPECT_EQ(client.ipAddress, IPAddress("10.0.0.1"));
+	EXPECT_EQ(client.streamId, LatencyTrace::streamId("10.0.0.1:1235"));
+}
+
+TEST(ClientRegistryTest, RefusesNewClientsWhenFull) {
+	ClientRegistry clients;
+	for (int port = 0; port < static_cast<int>(ClientRegistry::maximumClients); ++port) {
+		ASSERT_TRUE(clients.idFor("10.0.0.1", 1000 + port));
+	}
+	EXPECT_FALSE(clients.idFor("10.0.0.2", 1000));
+	// Known clients still find their place
+	EXPECT_EQ(clients.idFor("10.0.0.1", 1000), 0u);
+}
+
+TEST(ClientRegistryTest, RegistersClientsFromSeveralReceiveThreads) {
+	ClientRegistry clients;
+	constexpr int receiveThreads = 4;
+	constexpr int clientsPerThread = 16;
+	std::vector<std::vector<ClientId>> ids(receiveThreads);
+	std::vector<std::thread> threads;
+	for (int thread = 0; thread < receiveThreads; ++thread) {
+		threads.emplace_back([&clients, &ids, thread] {
+			// Like SO_REUSEPORT, every client always arrives on the same thread
+			for (int packet = 0; packet < 50; ++packet) {
+				for (int client = 0; client < clientsPerThread; ++client) {
+					const auto guard = clients.pin();
+					const auto id = clients.idFor("10.0.0." + String(thread + 1), 1000 + client);
+					ASSERT_TRUE(id);
+					clients.find(*id)->state->push(makePacket(static_cast<std::uint64_t>(100 + packet)), 0);
+					if (packet == 0) {
+						ids[static_cast<size_t>(thread)].push_back(*id);
+					}
+				}
+				if (thread == 0) {
+					clients.collect();
+				}
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	std::set<ClientId> distinct;
+	for (const auto &threadIds : ids) {
+		distinct.insert(threadIds.begin(), threadIds.end());
+	}
+	EXPECT_EQ(distinct.size(), static_cast<size_t>(receiveThreads * clientsPerThread));
+	EXPECT_EQ(clients.size(), static_cast<ClientId>(receiveThreads * clientsPerThread));
+	for (const auto id : distinct) {
+		EXPECT_EQ(clients.find(id)->state->snapshot().size, 50u);
+	}
+}
+
+void disconnect(ClientState& client, ClientState::TimePoint at) {
+	client.push(makePacket(1), 0, at);
+	ASSERT_TRUE(client.markUnderrun(client.snapshot().activityGeneration, at));
+	ASSERT_TRUE(client.disconnectIfGraceExpired(at + ClientState::DisconnectGracePeriod));
+}
+
+TEST(ClientRegistryTest, ForgetsClientsDisconnectedForTheRetentionPeriod) {
+	ClientRegistry clients;
+	const auto start = ClientState::TimePoint{};
+	const auto gone = *clients.idFor("10.0.0.1", 1234);
+	const auto staying = *clients.idFor("10.0.0.2", 1234);
+	disconnect(*clients.find(gone)->state, start);
+	clients.find(staying)->state->push(makePacket(1), 0, start);
+	const auto disconnectedAt = start + ClientState::DisconnectGracePeriod;
+
+	EXPECT_TRUE(clients.collect(disconnectedAt + ClientRegistry::retention).empty());
+	const auto version = clients.version();
+	const auto forgotten = clients.collect(disconnectedAt + ClientRegistry::retention + std::chrono::seconds(1));
+	ASSERT_EQ(forgotten.size(), 1u);
+	EXPECT_EQ(forgotten.front(), "10.0.0.1:1234");
+	EXPECT_NE(clients.version(), version);
+	EXPECT_EQ(clients.find(gone), nullptr);
+	ASSERT_EQ(clients.size(), 1u);
+	EXPECT_EQ(clients.registered().front()->id, staying);
+
+	// Coming back takes the old slot under a new id, so nobody mistakes it for the forgotten client
+	const auto back = *clients.idFor("10.0.0.1", 1234);
+	EXPECT_NE(back, gone);
+	EXPECT_EQ(ClientRegistry::slotOf(back), ClientRegistry::slotOf(gone));
+	EXPECT_EQ(clients.find(gone), nullptr);
+	EXPECT_EQ(clients.find(back)->name, "10.0.0.1:1234");
+	EXPECT_EQ(clients.find(back)->state->snapshot().state, ClientConnectionState::Disconnected);
+}
+
+TEST(ClientRegistryTest, ReceiveCacheFindsKnownClientsAndFollowsForgottenOnes) {
+	ClientRegistry clients;
+	ClientRegistry::ReceiveCache cache(clients);
+	const auto start = ClientState::TimePoint{};
+	const auto first = *SocketAddress::fromString("10.0.0.1", 1234);
+	const auto second = *SocketAddress::fromString("10.0.0.2", 1234);
+	const auto gone = cache.idFor(first);
+	const auto registeredElsewhere = *clients.idFor("10.0.0.2", 1234);
+	ASSERT_TRUE(gone);
+	EXPECT_EQ(cache.idFor(first), gone);
+	EXPECT_EQ(cache.idFor(second), registeredElsewhere);
+	EXPECT_EQ(clients.size(), 2u);
+
+	disconnect(*clients.find(*gone)->state, start);
+	ASSERT_EQ(clients.collect(start + ClientState::DisconnectGracePeriod + ClientRegistry::retention + std::chrono::seconds(1)).size(), 1u);
+	const auto back = cache.idFor(first);
+	ASSERT_TRUE(back);
+	EXPECT_NE(*back, *gone);
+	EXPECT_EQ(clients.find(*back)->name, "10.0.0.1:1234");
+	EXPECT_EQ(clients.idFor("10.0.0.1", 1234), back);
+}
+
+TEST(ClientRegistryTest, SocketAddressComparesTheEndpointOnly) {
+	const auto ipv4 = *SocketAddress::fromString("10.0.0.1", 1234);
+	EXPECT_EQ(ipv4, *SocketAddress::fromString("10.0.0.1", 1234));
+	EXPECT_EQ(ipv4.hash(), SocketAddress::fromString("10.0.0.1", 1234)->hash());
+	EXPECT_FALSE(ipv4 == *SocketAddress::fromString("10.0.0.1", 1235));
+	EXPECT_FALSE(ipv4 == *SocketAddress::fromString("10.0.0.2", 1234));
+	EXPECT_FALSE(ipv4 == *SocketAddress::fromString("::ffff:10.0.0.1", 1234));
+	EXPECT_EQ(SocketAddress::fromString("::1", 1234)->host(), "::1");
+	EXPECT_FALSE(SocketAddress::fromString("localhost", 1234));
+}
+
+TEST(ClientRegistryTest, KeepsForgottenClientsReadableWhileAReaderHoldsAGuard) {
+	ClientRegistry clients;
+	const auto start = ClientState::TimePoint{};
+	const auto gone = *clients.idFor("10.0.0.1", 1234);
+	disconnect(*clients.find(gone)->state, start);
+	const auto later = start + ClientState::DisconnectGracePeriod + ClientRegistry::retention + std::chrono::seconds(1);
+	{
+		const auto guard = clients.pin();
+		const auto* client = clients.find(gone);
+		const auto registered = clients.registered();
+		ASSERT_EQ(clients.collect(later).size(), 1u);
+		EXPECT_EQ(clients.find(gone), nullptr);
+		// Neither the entry nor the list the reader took are reused under its feet
+		EXPECT_EQ(client->name, "10.0.0.1:1234");
+		EXPECT_NE(client->state, nullptr);
+		ASSERT_EQ(registered.size(), 1u);
+		EXPECT_EQ(registered.front(), client);
+		for (int port = 0; port < static_cast<int>(ClientRegistry::maximumClients) - 1; ++port) {
+			ASSERT_TRUE(clients.idFor("10.0.0.2", 1000 + port));
+		}
+		EXPECT_FALSE(clients.idFor("10.0.0.3", 1000));
 	}
+	const auto reused = clients.idFor("10.0.0.3", 1000);
+	ASSERT_TRUE(reused);
+	EXPECT_EQ(ClientRegistry::slotOf(*reused), ClientRegistry::slotOf(gone));
 }
 
 } // namespace
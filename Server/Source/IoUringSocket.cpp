@@ -0,0 +1,529 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "IoUringSocket.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#if JUCE_LINUX && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+// Multishot receive came with Linux 6.0, older kernel headers can't build this path
+#if defined(IORING_RECV_MULTISHOT)
+#define JAMMERNETZ_IO_URING 1
+#endif
+#endif
+
+#if JAMMERNETZ_IO_URING
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if JAMMERNETZ_IO_URING
+
+namespace {
+
+constexpr uint64_t receiveTag = 1;
+constexpr uint16_t receiveBufferGroup = 0;
+
+std::string systemError(const std::string& what, int error)
+{
+	return what + " failed: " + std::strerror(error);
+}
+
+// Submission and completion queue shared with the kernel. This is the part liburing would provide, done
+// with the raw system calls to not depend on another library for an optional feature.
+class Ring {
+public:
+	Ring() = default;
+	Ring(const Ring&) = delete;
+	Ring& operator=(const Ring&) = delete;
+
+	~Ring()
+	{
+		if (sqes_ != MAP_FAILED) {
+			munmap(sqes_, sqesSize_);
+		}
+		if (rings_ != MAP_FAILED) {
+			munmap(rings_, ringsSize_);
+		}
+		if (fd_ >= 0) {
+			close(fd_);
+		}
+	}
+
+	bool setup(unsigned entries, unsigned completions, std::string& error)
+	{
+		io_uring_params parameters {};
+		parameters.flags = IORING_SETUP_CQSIZE;
+		parameters.cq_entries = completions;
+		fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &parameters));
+		if (fd_ < 0) {
+			error = systemError("io_uring_setup", errno);
+			return false;
+		}
+		if (!(parameters.features & IORING_FEAT_SINGLE_MMAP) || !(parameters.features & IORING_FEAT_EXT_ARG)) {
+			error = "io_uring of this kernel is too old";
+			return false;
+		}
+
+		ringsSize_ = std::max(parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned),
+			parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe));
+		rings_ = mmap(nullptr, ringsSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+		if (rings_ == MAP_FAILED) {
+			error = systemError("Mapping the io_uring", errno);
+			return false;
+		}
+		sqesSize_ = parameters.sq_entries * sizeof(io_uring_sqe);
+		sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+		if (sqes_ == MAP_FAILED) {
+			error = systemError("Mapping the io_uring submissions", errno);
+			return false;
+		}
+
+		auto* base = static_cast<char*>(rings_);
+		sqHead_ = reinterpret_cast<unsigned*>(base + parameters.sq_off.head);
+		sqTail_ = reinterpret_cast<unsigned*>(base + parameters.sq_off.tail);
+		sqArray_ = reinterpret_cast<unsigned*>(base + parameters.sq_off.array);
+		sqMask_ = *reinterpret_cast<unsigned*>(base + parameters.sq_off.ring_mask);
+		sqEntries_ = parameters.sq_entries;
+		cqHead_ = reinterpret_cast<unsigned*>(base + parameters.cq_off.head);
+		cqTail_ = reinterpret_cast<unsigned*>(base + parameters.cq_off.tail);
+		cqMask_ = *reinterpret_cast<unsigned*>(base + parameters.cq_off.ring_mask);
+		cqes_ = reinterpret_cast<io_uring_cqe*>(base + parameters.cq_off.cqes);
+		sqLocalTail_ = *sqTail_;
+		return true;
+	}
+
+	int fd() const noexcept { return fd_; }
+
+	// Null when the submission queue is full, submit first
+	io_uring_sqe* nextSubmission() noexcept
+	{
+		if (sqLocalTail_ - std::atomic_ref<unsigned>(*sqHead_).load(std::memory_order_acquire) >= sqEntries_) {
+			return nullptr;
+		}
+		const auto index = sqLocalTail_ & sqMask_;
+		sqArray_[index] = index;
+		auto* sqe = &static_cast<io_uring_sqe*>(sqes_)[index];
+		std::memset(sqe, 0, sizeof(*sqe));
+		++sqLocalTail_;
+		++toSubmit_;
+		return sqe;
+	}
+
+	// Submits what was queued and waits for waitFor completions, at most timeoutMilliseconds unless that is negative.
+	// False with errno set on failure, a timeout or signal is no failure.
+	bool enter(unsigned waitFor, int timeoutMilliseconds) noexcept
+	{
+		std::atomic_ref<unsigned>(*sqTail_).store(sqLocalTail_, std::memory_order_release);
+		unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+		__kernel_timespec timeout {};
+		io_uring_getevents_arg arguments {};
+		if (waitFor > 0 && timeoutMilliseconds >= 0) {
+			timeout.tv_sec = timeoutMilliseconds / 1000;
+			timeout.tv_nsec = (timeoutMilliseconds % 1000) * 1000000LL;
+			arguments.sigmask_sz = _NSIG / 8;
+			arguments.ts = reinterpret_cast<uint64_t>(&timeout);
+			flags |= IORING_ENTER_EXT_ARG;
+		}
+		const auto submitted = syscall(__NR_io_uring_enter, fd_, toSubmit_, waitFor, flags,
+			(flags & IORING_ENTER_EXT_ARG) ? &arguments : nullptr, (flags & IORING_ENTER_EXT_ARG) ? sizeof(arguments) : 0);
+		if (submitted < 0) {
+			return errno == ETIME || errno == EINTR || errno == EBUSY;
+		}
+		toSubmit_ -= std::min(toSubmit_, static_cast<unsigned>(submitted));
+		return true;
+	}
+
+	bool hasUnsubmitted() const noexcept { return toSubmit_ > 0; }
+
+	// Null when there is no completion, else call completionSeen() once done with it
+	const io_uring_cqe* nextCompletion() const noexcept
+	{
+		const auto head = std::atomic_ref<unsigned>(*cqHead_).load(std::memory_order_relaxed);
+		if (head == std::atomic_ref<unsigned>(*cqTail_).load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		return &cqes_[head & cqMask_];
+	}
+
+	void completionSeen() noexcept
+	{
+		std::atomic_ref<unsigned> head(*cqHead_);
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+private:
+	int fd_ { -1 };
+	void* rings_ { MAP_FAILED };
+	std::size_t ringsSize_ { 0 };
+	void* sqes_ { MAP_FAILED };
+	std::size_t sqesSize_ { 0 };
+	unsigned* sqHead_ { nullptr };
+	unsigned* sqTail_ { nullptr };
+	unsigned* sqArray_ { nullptr };
+	unsigned sqMask_ { 0 };
+	unsigned sqEntries_ { 0 };
+	unsigned* cqHead_ { nullptr };
+	unsigned* cqTail_ { nullptr };
+	unsigned cqMask_ { 0 };
+	io_uring_cqe* cqes_ { nullptr };
+	unsigned sqLocalTail_ { 0 };
+	unsigned toSubmit_ { 0 };
+};
+
+} // namespace
+
+struct IoUringReceiver::State {
+	Ring ring;
+	int socket { -1 };
+	// Each buffer holds the kernel's io_uring_recvmsg_out header, the sender address and the datagram
+	std::size_t bufferSize { 0 };
+	std::vector<uint8> memory;
+	io_uring_buf_ring* buffers { static_cast<io_uring_buf_ring*>(MAP_FAILED) };
+	std::size_t buffersSize { 0 };
+	uint16_t bufferTail { 0 };
+	msghdr header {};
+	bool armed { false };
+	std::string error;
+
+	~State()
+	{
+		if (buffers != MAP_FAILED) {
+			munmap(buffers, buffersSize);
+		}
+	}
+
+	bool setup(std::size_t maximumDatagramSize, std::string& setupError)
+	{
+		// A completion per datagram, so there has to be room for one per buffer
+		if (!ring.setup(8, 2 * bufferCount, setupError)) {
+			return false;
+		}
+		header.msg_namelen = sizeof(sockaddr_storage);
+		bufferSize = sizeof(io_uring_recvmsg_out) + header.msg_namelen + maximumDatagramSize;
+		memory.resize(bufferSize * bufferCount);
+
+		// The kernel wants the ring of buffer descriptors page aligned
+		buffersSize = sizeof(io_uring_buf) * bufferCount;
+		buffers = static_cast<io_uring_buf_ring*>(mmap(nullptr, buffersSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+		if (buffers == MAP_FAILED) {
+			setupError = systemError("Allocating the receive buffer ring", errno);
+			return false;
+		}
+		io_uring_buf_reg registration {};
+		registration.ring_addr = reinterpret_cast<uint64_t>(buffers);
+		registration.ring_entries = bufferCount;
+		registration.bgid = receiveBufferGroup;
+		if (syscall(__NR_io_uring_register, ring.fd(), IORING_REGISTER_PBUF_RING, &registration, 1) != 0) {
+			setupError = systemError("Registering the receive buffers", errno);
+			return false;
+		}
+		for (uint16_t buffer = 0; buffer < bufferCount; ++buffer) {
+			recycle(buffer);
+		}
+		publishBuffers();
+
+		// A kernel without multishot recvmsg rejects it right away, better find out now than in the receive loop
+		arm();
+		if (!ring.enter(0, 0)) {
+			setupError = systemError("Submitting the receive", errno);
+			return false;
+		}
+		if (const auto* completion = ring.nextCompletion(); completion && completion->res < 0 && !(completion->flags & IORING_CQE_F_MORE)) {
+			setupError = systemError("Multishot receive", -completion->res);
+			return false;
+		}
+		return true;
+	}
+
+	void arm()
+	{
+		auto* sqe = ring.nextSubmission();
+		sqe->opcode = IORING_OP_RECVMSG;
+		sqe->fd = socket;
+		sqe->addr = reinterpret_cast<uint64_t>(&header);
+		sqe->len = 1;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = receiveBufferGroup;
+		sqe->user_data = receiveTag;
+		armed = true;
+	}
+
+	void recycle(uint16_t buffer)
+	{
+		// Not buffers->bufs, in C++ the kernel header's flexible array macro puts it 8 bytes too far
+		auto& entry = reinterpret_cast<io_uring_buf*>(buffers)[bufferTail & (bufferCount - 1)];
+		entry.addr = reinterpret_cast<uint64_t>(memory.data() + buffer * bufferSize);
+		entry.len = static_cast<uint32_t>(bufferSize);
+		entry.bid = buffer;
+		++bufferTail;
+	}
+
+	void publishBuffers()
+	{
+		std::atomic_ref<uint16_t>(buffers->tail).store(bufferTail, std::memory_order_release);
+	}
+};
+
+static_assert((IoUringReceiver::bufferCount & (IoUringReceiver::bufferCount - 1)) == 0, "The kernel needs a power of two");
+
+std::unique_ptr<IoUringReceiver> IoUringReceiver::create(int socketHandle, std::size_t maximumDatagramSize, std::string& error)
+{
+	auto state = std::make_unique<State>();
+	state->socket = socketHandle;
+	if (!state->setup(maximumDatagramSize, error)) {
+		return nullptr;
+	}
+	return std::unique_ptr<IoUringReceiver>(new IoUringReceiver(std::move(state)));
+}
+
+int IoUringReceiver::receive(int timeoutMilliseconds, const std::function<void(Datagram&)>& onDatagram)
+{
+	auto& state = *state_;
+	if (!state.armed) {
+		state.arm();
+	}
+	if (!state.ring.enter(state.ring.nextCompletion() ? 0 : 1, timeoutMilliseconds)) {
+		state.error = systemError("Waiting for datagrams", errno);
+		return -1;
+	}
+
+	int received = 0;
+	while (const auto* completion = state.ring.nextCompletion()) {
+		const auto result = completion->res;
+		const auto flags = completion->flags;
+		state.ring.completionSeen();
+		if (!(flags & IORING_CQE_F_MORE)) {
+			// The kernel stopped the multishot receive, usually because all buffers were in use. Rearmed below.
+			state.armed = false;
+		}
+		if (result < 0) {
+			if (result == -ENOBUFS) {
+				continue;
+			}
+			state.error = systemError("Receiving", -result);
+			return -1;
+		}
+		if (!(flags & IORING_CQE_F_BUFFER)) {
+			continue;
+		}
+		const auto buffer = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+		auto* start = state.memory.data() + buffer * state.bufferSize;
+		io_uring_recvmsg_out out;
+		std::memcpy(&out, start, sizeof(out));
+		auto* name = start + sizeof(out);
+		auto* payload = name + state.header.msg_namelen + state.header.msg_controllen;
+		// A datagram larger than the buffer arrives truncated, as with a read into a buffer of that size
+		const auto available = state.bufferSize - static_cast<std::size_t>(payload - start);
+		// The sender stays binary, the registry only builds a string for clients it hasn't seen yet
+		if (const auto sender = SocketAddress::fromName(name, out.namelen)) {
+			Datagram datagram { payload, static_cast<int>(std::min<std::size_t>(out.payloadlen, available)), *sender };
+			onDatagram(datagram);
+			++received;
+		}
+		state.recycle(buffer);
+	}
+	state.publishBuffers();
+	if (!state.armed) {
+		state.arm();
+	}
+	return received;
+}
+
+struct IoUringSender::State {
+	struct Slot {
+		sockaddr_storage address {};
+		iovec data {};
+		msghdr header {};
+		std::vector<uint8> bytes;
+	};
+
+	Ring ring;
+	int socket { -1 };
+	std::vector<Slot> slots = std::vector<Slot>(slotCount);
+	std::vector<unsigned> freeSlots;
+	uint64_t failedSends { 0 };
+	std::string error;
+
+	~State()
+	{
+		// The kernel may still read from the slots, give it a moment to finish before they are freed
+		for (int attempt = 0; attempt < 10 && freeSlots.size() < slots.size(); ++attempt) {
+			if (!ring.enter(1, 10)) {
+				break;
+			}
+			reap();
+		}
+	}
+
+	bool setup(std::string& setupError)
+	{
+		if (!ring.setup(slotCount, 2 * slotCount, setupError)) {
+			return false;
+		}
+		freeSlots.reserve(slotCount);
+		for (unsigned slot = slotCount; slot > 0; --slot) {
+			freeSlots.push_back(slot - 1);
+		}
+		return true;
+	}
+
+	void reap()
+	{
+		while (const auto* completion = ring.nextCompletion()) {
+			if (completion->res < 0) {
+				++failedSends;
+			}
+			freeSlots.push_back(static_cast<unsigned>(completion->user_data));
+			ring.completionSeen();
+		}
+	}
+};
+
+std::unique_ptr<IoUringSender> IoUringSender::create(int socketHandle, std::string& error)
+{
+	auto state = std::make_unique<State>();
+	state->socket = socketHandle;
+	if (!state->setup(error)) {
+		return nullptr;
+	}
+	return std::unique_ptr<IoUringSender>(new IoUringSender(std::move(state)));
+}
+
+bool IoUringSender::queue(const SocketAddress& address, const void* data, int size)
+{
+	auto& state = *state_;
+	state.reap();
+	if (state.freeSlots.empty()) {
+		// Everything is in flight, wait for the kernel to send something
+		if (!state.ring.enter(1, 100)) {
+			state.error = systemError("Waiting for a send slot", errno);
+			return false;
+		}
+		state.reap();
+		if (state.freeSlots.empty()) {
+			state.error = "No send slot freed up";
+			return false;
+		}
+	}
+	const auto index = state.freeSlots.back();
+	auto& slot = state.slots[index];
+	if (size < 0 || !address.isValid()) {
+		state.error = "Can't send to " + address.host().toStdString();
+		return false;
+	}
+	std::memcpy(&slot.address, address.name(), static_cast<std::size_t>(address.length()));
+	state.freeSlots.pop_back();
+	slot.bytes.assign(static_cast<const uint8*>(data), static_cast<const uint8*>(data) + size);
+	slot.data = { slot.bytes.data(), slot.bytes.size() };
+	slot.header = {};
+	slot.header.msg_name = &slot.address;
+	slot.header.msg_namelen = address.length();
+	slot.header.msg_iov = &slot.data;
+	slot.header.msg_iovlen = 1;
+
+	// There are as many submission entries as slots, so a free slot always finds one
+	auto* sqe = state.ring.nextSubmission();
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = state.socket;
+	sqe->addr = reinterpret_cast<uint64_t>(&slot.header);
+	sqe->len = 1;
+	sqe->user_data = index;
+	return true;
+}
+
+bool IoUringSender::submit()
+{
+	auto& state = *state_;
+	if (state.ring.hasUnsubmitted() && !state.ring.enter(0, 0)) {
+		state.error = systemError("Submitting the sends", errno);
+		return false;
+	}
+	state.reap();
+	return true;
+}
+
+uint64_t IoUringSender::failedSends() const noexcept
+{
+	return state_->failedSends;
+}
+
+#else
+
+// Stands in where io_uring can't be built, create() then always reports why
+struct IoUringReceiver::State {
+	std::string error;
+};
+
+struct IoUringSender::State {
+	std::string error;
+};
+
+std::unique_ptr<IoUringReceiver> IoUringReceiver::create(int, std::size_t, std::string& error)
+{
+	error = "io_uring needs Linux 6.0 or newer";
+	return nullptr;
+}
+
+int IoUringReceiver::receive(int, const std::function<void(Datagram&)>&)
+{
+	return -1;
+}
+
+std::unique_ptr<IoUringSender> IoUringSender::create(int, std::string& error)
+{
+	error = "io_uring needs Linux 6.0 or newer";
+	return nullptr;
+}
+
+bool IoUringSender::queue(const String&, int, const void*, int)
+{
+	return false;
+}
+
+bool IoUringSender::submit()
+{
+	return false;
+}
+
+uint64_t IoUringSender::failedSends() const noexcept
+{
+	return 0;
+}
+
+#endif
+
+IoUringReceiver::IoUringReceiver(std::unique_ptr<State> state) : state_(std::move(state))
+{
+}
+
+IoUringReceiver::~IoUringReceiver() = default;
+
+std::string IoUringReceiver::lastError() const
+{
+	return state_->error;
+}
+
+IoUringSender::IoUringSender(std::unique_ptr<State> state) : state_(std::move(state))
+{
+}
+
+IoUringSender::~IoUringSender() = default;
+
+std::string IoUringSender::lastError() const
+{
+	return state_->error;
+}
@@ -0,0 +1,79 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include "SocketAddress.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Optional Linux io_uring path for the server's datagram socket, used instead of the blocking
+// waitUntilReady/read and write calls of juce::DatagramSocket. The socket itself stays a DatagramSocket,
+// bound as before, so the server falls back to it where io_uring is missing (older kernels, other
+// systems, containers whose seccomp profile blocks it). Each object belongs to one thread.
+
+// Receives with one multishot recvmsg into a ring of buffers registered with the kernel, so a burst of
+// datagrams costs one system call instead of two per datagram.
+class IoUringReceiver {
+public:
+	// Buffers the kernel can fill before the thread gets to them, more wait in the socket
+	static constexpr unsigned bufferCount = 64;
+
+	struct Datagram {
+		uint8* data; // Inside the ring, only valid during the callback. May be decrypted in place.
+		int size;
+		SocketAddress sender;
+	};
+
+	// Null with the reason in error if io_uring or multishot receive (Linux 6.0) is not available
+	static std::unique_ptr<IoUringReceiver> create(int socketHandle, std::size_t maximumDatagramSize, std::string& error);
+	~IoUringReceiver();
+
+	// Waits up to timeoutMilliseconds for datagrams and hands each to onDatagram.
+	// Returns the number of datagrams, 0 on timeout and -1 on error, see lastError().
+	int receive(int timeoutMilliseconds, const std::function<void(Datagram&)>& onDatagram);
+	std::string lastError() const;
+
+private:
+	struct State; // The ring and its buffers, only known where io_uring is compiled in
+
+	explicit IoUringReceiver(std::unique_ptr<State> state);
+
+	std::unique_ptr<State> state_;
+};
+
+// Queues datagrams in send slots and submits them together, so the packages of one mix round go out
+// with one system call. The slots stay untouched until the kernel reports them sent.
+class IoUringSender {
+public:
+	// More than one mix round for the largest room, queueing waits for a free slot beyond that
+	static constexpr unsigned slotCount = 512;
+
+	// Null with the reason in error if io_uring is not available
+	static std::unique_ptr<IoUringSender> create(int socketHandle, std::string& error);
+	~IoUringSender();
+
+	// Copies the datagram into a free slot. False if the address is not valid or no slot freed up.
+	bool queue(const SocketAddress& address, const void* data, int size);
+	// Hands everything queued to the kernel, and frees the slots of what was sent meanwhile
+	bool submit();
+	// Datagrams the kernel refused to send so far
+	uint64_t failedSends() const noexcept;
+	std::string lastError() const;
+
+private:
+	struct State;
+
+	explicit IoUringSender(std::unique_ptr<State> state);
+
+	std::unique_ptr<State> state_;
+};
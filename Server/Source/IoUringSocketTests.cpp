@@ -0,0 +1,60 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "IoUringSocket.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+TEST(IoUringSocketTest, SendsAndReceivesMoreDatagramsThanTheReceiveBuffersHold)
+{
+	DatagramSocket sender;
+	DatagramSocket receiver;
+	ASSERT_TRUE(sender.bindToPort(0, "127.0.0.1"));
+	ASSERT_TRUE(receiver.bindToPort(0, "127.0.0.1"));
+
+	std::string error;
+	auto send = IoUringSender::create(sender.getRawSocketHandle(), error);
+	auto receive = send ? IoUringReceiver::create(receiver.getRawSocketHandle(), 2048, error) : nullptr;
+	if (!send || !receive) {
+		// The server falls back to the socket calls then, nothing to test here
+		GTEST_SKIP() << error;
+	}
+
+	// Rounds larger than the receive buffers, so the kernel runs out of them and the receive is rearmed,
+	// but small enough for the default socket buffer
+	constexpr int round = 100;
+	constexpr int rounds = 8;
+	const auto target = SocketAddress::fromString("127.0.0.1", receiver.getBoundPort());
+	ASSERT_TRUE(target.has_value());
+	std::vector<int> sizes;
+	for (int first = 0; first < round * rounds; first += round) {
+		for (int datagram = first; datagram < first + round; ++datagram) {
+			std::vector<uint8> data(static_cast<size_t>(100 + datagram % 50), static_cast<uint8>(datagram));
+			ASSERT_TRUE(send->queue(*target, data.data(), static_cast<int>(data.size()))) << send->lastError();
+		}
+		ASSERT_TRUE(send->submit()) << send->lastError();
+
+		while (sizes.size() < static_cast<size_t>(first + round)) {
+			const int received = receive->receive(500, [&](IoUringReceiver::Datagram& datagram) {
+				EXPECT_EQ(datagram.sender.host(), "127.0.0.1");
+				EXPECT_EQ(datagram.sender.port(), sender.getBoundPort());
+				EXPECT_EQ(datagram.data[0], static_cast<uint8>(sizes.size()));
+				sizes.push_back(datagram.size);
+			});
+			ASSERT_GT(received, 0) << receive->lastError();
+		}
+	}
+	// Loopback neither loses nor reorders
+	ASSERT_EQ(sizes.size(), static_cast<size_t>(round * rounds));
+	for (size_t datagram = 0; datagram < sizes.size(); ++datagram) {
+		EXPECT_EQ(sizes[datagram], 100 + static_cast<int>(datagram % 50));
+	}
+	EXPECT_EQ(receive->receive(10, [](IoUringReceiver::Datagram&) {}), 0);
+	EXPECT_EQ(send->failedSends(), 0u);
+}
@@ -14,7 +14,9 @@
 #include "Encryption.h"
 
 #include "BuffersConfig.h"
-#include "Recorder.h"
+#include "LatencyTrace.h"
+#include "NetworkImpairment.h"
+#include "ThreadScheduling.h"
 #include "XPlatformUtils.h"
 
 #include "ServerLogger.h"
@@ -36,17 +38,29 @@ std::string getServerVersion();
 #undef MOUSE_MOVED
 #include <curses.h>
 
+// Scheduling of the threads on the audio path, applied once they run
+struct ServerScheduling {
+	ThreadSchedulingConfig receive;
+	ThreadSchedulingConfig mixer;
+	ThreadSchedulingConfig send;
+	std::string memoryStatus; // Empty unless locking the memory was requested
+
+	bool isDefault() const { return receive.isDefault() && mixer.isDefault() && send.isDefault() && memoryStatus.empty(); }
+};
+
 class Server {
 public:
-	Server(std::shared_ptr<MemoryBlock> cryptoKey, ServerBufferConfig bufferConfig, int serverPort, bool useFEC) :
-    clientRecorder_(File(), "input", RecordingType::AIFF)
-    , mixdownRecorder_(File::getCurrentWorkingDirectory(), "mixdown", RecordingType::FLAC)
-    , mixdownSetup_(false, { JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Left), JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Right) }) // Setup standard mix down setup - two channels only in stereo
-    , serverConfiguration_("SERVER_CONFIG")
+	Server(std::shared_ptr<MemoryBlock> cryptoKey, ServerBufferConfig bufferConfig, int sampleBufferSize, int sampleRate, int serverPort, int receiveThreads, bool useIoUring, bool useFEC, File latencyTraceFile, File recordingDirectory, RecordingType recordingType, ServerScheduling scheduling) :
+    mixdownSetup_(false, { JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Left), JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Right) }) // Setup standard mix down setup - two channels only in stereo
+	, scheduling_(std::move(scheduling))
 	{
-		// Start the recorder of the mix down
-		//mixdownRecorder_.updateChannelInfo(48000, mixdownSetup_);
-        serverConfiguration_.setProperty("FEC", useFEC, nullptr);
+		// Optionally record every client's input and the room mixdown
+		if (recordingDirectory != File()) {
+			recorder_ = std::make_unique<ServerRecordingWorker>(incomingStreams_, recordingDirectory, sampleRate, recordingType,
+				[](const String& message) { ServerLogger::errorln(message); });
+			recorder_->start();
+		}
+		serverSettings_.fec.store(useFEC);
 
 		// optional crypto key
 		void* cryptoData = nullptr;
@@ -56,28 +70,51 @@ public:
 			cipherLength = static_cast<int>(cryptoKey->getSize());
 		}
 
-		acceptThread_ = std::make_unique<AcceptThread>(serverPort, socket_, socketWriteLock_, incomingStreams_, wakeUpQueue_, bufferConfig, cryptoData, cipherLength, serverConfiguration_);
-		sendThread_ = std::make_unique <SendThread>(socket_, socketWriteLock_, sendQueue_, incomingStreams_, cryptoData, cipherLength, serverConfiguration_);
-		mixerThread_ = std::make_unique<MixerThread>(incomingStreams_, mixdownSetup_, sendQueue_, wakeUpQueue_, bufferConfig);
+		// One socket per receive thread, all bound to the server port. Replies go out through the first one, which has the same address.
+		for (int receiveThread = 0; receiveThread < receiveThreads; ++receiveThread) {
+			sockets_.push_back(std::make_unique<DatagramSocket>());
+			acceptThreads_.push_back(std::make_unique<AcceptThread>(serverPort, *sockets_.back(), socketWriteLock_, incomingStreams_, wakeUpQueue_, bufferConfig, cryptoData, cipherLength, serverSettings_, receiveThread, receiveThreads, useIoUring));
+		}
+		sendThread_ = std::make_unique <SendThread>(*sockets_.front(), socketWriteLock_, sendQueue_, incomingStreams_, cryptoData, cipherLength, serverSettings_, useIoUring);
+		mixerThread_ = std::make_unique<MixerThread>(incomingStreams_, mixdownSetup_, sendQueue_, wakeUpQueue_, recorder_.get(), bufferConfig, sampleBufferSize, sampleRate);
 
 		sendQueue_.set_capacity(128); // This is an arbitrary number only to prevent memory overflow should the sender thread somehow die (i.e. no network or something)
+
+		if (latencyTraceFile != File()) {
+			latencyTraceWriter_ = std::make_unique<LatencyTraceWriter>(latencyTraceFile);
+		}
 	}
 
 	~Server() {
 		sendThread_->signalThreadShouldExit();
 		mixerThread_->signalThreadShouldExit();
-		acceptThread_->signalThreadShouldExit();
-		acceptThread_->stopThread(1000);
+		for (auto &acceptThread : acceptThreads_) {
+			acceptThread->signalThreadShouldExit();
+		}
+		for (auto &acceptThread : acceptThreads_) {
+			acceptThread->stopThread(1000);
+		}
 		mixerThread_->stopThread(1000);
 		sendThread_->stopThread(1000);
+		if (recorder_) {
+			// Only after the mixer has stopped producing, this finalizes the files
+			recorder_->shutdown();
+		}
 
-		socket_.shutdown();
+		// The impairment sender thread may still hold delayed packets for our socket
+		NetworkImpairment::instance().disable();
+		for (auto &socket : sockets_) {
+			socket->shutdown();
+		}
 	}
 
 	void launchServer() {
-		acceptThread_->startThread();
+		for (auto &acceptThread : acceptThreads_) {
+			acceptThread->startThread();
+		}
 		sendThread_->startThread();
 		mixerThread_->startThread();
+		applyScheduling();
 #ifdef WIN32
 		ServerLogger::printAtPosition(0, 0, String("Starting JammerNetz server version " + getServerVersion() + ", press any key to stop").toRawUTF8());
 		ServerLogger::printColumnHeader(2);
@@ -88,36 +125,73 @@ public:
 		while (true) {
 #endif
 			Thread::sleep(1000);
+			if (latencyTraceWriter_) {
+				latencyTraceWriter_->flush();
+			}
+			if (recorder_ && recorder_->droppedBlocks() != reportedRecordingDrops_) {
+				reportedRecordingDrops_ = recorder_->droppedBlocks();
+				ServerLogger::errorln("Recording could not keep up, " + String(reportedRecordingDrops_) + " blocks lost so far");
+			}
 		}
 	}
 
 private:
-	DatagramSocket socket_;
+	void applyScheduling() {
+		if (scheduling_.isDefault()) {
+			return;
+		}
+		// Report what each thread was granted, as a missing capability only shows here
+		StringArray report;
+		auto apply = [&report](Thread &thread, const ThreadSchedulingConfig &config) {
+			report.add(thread.getThreadName() + " " + String(applyThreadScheduling(thread.getThreadId(), config).description));
+		};
+		for (auto &acceptThread : acceptThreads_) {
+			apply(*acceptThread, scheduling_.receive);
+		}
+		apply(*mixerThread_, scheduling_.mixer);
+		apply(*sendThread_, scheduling_.send);
+		if (!scheduling_.memoryStatus.empty()) {
+			report.add(scheduling_.memoryStatus);
+		}
+		ServerLogger::printSchedulingStatus(report.joinIntoString(", ").toStdString());
+	}
+
+	std::vector<std::unique_ptr<DatagramSocket>> sockets_;
 	CriticalSection socketWriteLock_;
-	std::unique_ptr<AcceptThread> acceptThread_;
+	std::vector<std::unique_ptr<AcceptThread>> acceptThreads_;
 	std::unique_ptr<SendThread> sendThread_;
 	std::unique_ptr<MixerThread> mixerThread_;
+	std::unique_ptr<LatencyTraceWriter> latencyTraceWriter_;
 
-	TPacketStreamBundle incomingStreams_;
+	ClientRegistry incomingStreams_;
 	TOutgoingQueue sendQueue_;
 	TMessageQueue wakeUpQueue_;
 
-	Recorder clientRecorder_; // Later I need one per client
-	Recorder mixdownRecorder_;
+	std::unique_ptr<ServerRecordingWorker> recorder_;
+	uint64_t reportedRecordingDrops_ { 0 };
 	JammerNetzChannelSetup mixdownSetup_; // This is the same for everybody
 
-    ValueTree serverConfiguration_; // This is used to share the overall server configuration across the Threads
+	ServerSettings serverSettings_; // Shared by the receive and send threads
+	ServerScheduling scheduling_;
 };
 
 int main(int argc, char *argv[])
 {
 	int serverPort = 7777;
+	int receiveThreads = 1;
+	bool useIoUring = false;
 	bool useFEC = false;
+	int sampleBufferSize = SAMPLE_BUFFER_SIZE;
+	int sampleRate = SAMPLE_RATE;
 	ServerBufferConfig bufferConfig;
 	bufferConfig.serverIncomingJitterBuffer = SERVER_INCOMING_JITTER_BUFFER;
 	bufferConfig.serverIncomingMaximumBuffer = SERVER_INCOMING_MAXIMUM_BUFFER;
 	bufferConfig.serverBufferPrefillOnConnect = BUFFER_PREFILL_ON_CONNECT;
 	std::shared_ptr<MemoryBlock> cryptoKey;
+	File latencyTraceFile;
+	File recordingDirectory;
+	RecordingType recordingType = RecordingType::WAV;
+	ServerScheduling scheduling;
 
 	// Parse command line arguments
 	ArgumentList arguments(argc, argv);
@@ -128,7 +202,7 @@ int main(int argc, char *argv[])
 
 	// Specify commands
 	ConsoleApplication app;
-	app.addHelpCommand("--help|-h", "This is the JammerNetzServer " + String(getServerVersion()) + "\n\n  " + shortExeName + " --key=<key file> [--port=<port>|-P <port>] [--fec|-F] [--buffer=<buffer count>] [--wait=<buffer count>] [--prefill=<buffer count>]\n\n" +
+	app.addHelpCommand("--help|-h", "This is the JammerNetzServer " + String(getServerVersion()) + "\n\n  " + shortExeName + " --key=<key file> [--port=<port>|-P <port>] [--receive-threads=<count>] [--io-uring] [--fec|-F] [--block-size=32|64|128|256] [--sample-rate=44100|48000|88200|96000] [--buffer=<buffer count>] [--wait=<buffer count>] [--prefill=<buffer count>] [--align=<buffer count>] [--latency-trace=<jsonl file>] [--trace-interval=<packets>] [--impair=<spec>] [--record=<directory>|-R <directory>] [--record-format=wav|log] [--receive-scheduling=<spec>] [--mixer-scheduling=<spec>] [--send-scheduling=<spec>] [--lock-memory]\n\n" +
 		"or\n\n  " + shortExeName + " -k <key file> [-b <buffer count>] [-w <buffer count>] [-p <buffer count>]\n\n", true);
 	app.addVersionCommand("--version|-v", "JammerNetzServer " + String(getServerVersion()));
 	app.addDefaultCommand({ "launch", "-k <key file>", "Launch the JammerNetzServer", "Use this to launch the server in the foreground", [&](const auto &args) {
@@ -148,9 +222,43 @@ int main(int argc, char *argv[])
 				app.fail("Invalid server port '" + portValue + "'. Use --port=<port> or -P <port> with a value from 1 to 65535.", -1);
 			}
 		}
+		if (args.containsOption("--receive-threads|-r")) {
+			// Decrypting and parsing every datagram is the first thing to saturate in big rooms
+			receiveThreads = args.getValueForOption("--receive-threads|-r").getIntValue();
+			if (receiveThreads < 1 || receiveThreads > AcceptThread::maximumReceiveThreads) {
+				app.fail("Invalid number of receive threads, use --receive-threads=1 to " + String(AcceptThread::maximumReceiveThreads), -1);
+			}
+#if !JUCE_LINUX
+			if (receiveThreads > 1) {
+				app.fail("More than one receive thread needs the SO_REUSEPORT load balancing of Linux", -1);
+			}
+#endif
+		}
+		if (args.containsOption("--io-uring")) {
+			// Batched network I/O on Linux 6.0 or newer, the server falls back to the plain socket calls elsewhere
+			useIoUring = true;
+		}
 		if (args.containsOption("--fec|-F")) {
 			useFEC = true;
 		}
+		if (args.containsOption("--block-size|-s")) {
+			// Samples per packet for the whole session
+			sampleBufferSize = args.getValueForOption("--block-size|-s").getIntValue();
+			if (!isSupportedSampleBufferSize(sampleBufferSize)) {
+				app.fail("Invalid block size, use --block-size=32, 64, 128 or 256", -1);
+			}
+		}
+		if (args.containsOption("--sample-rate")) {
+			// Clients with devices at other rates convert to this one
+			sampleRate = args.getValueForOption("--sample-rate").getIntValue();
+			if (!isSupportedSampleRate(sampleRate)) {
+				app.fail("Invalid sample rate, use --sample-rate=44100, 48000, 88200 or 96000", -1);
+			}
+		}
+		// The buffer defaults keep their length in milliseconds
+		bufferConfig.serverIncomingJitterBuffer = blocksForSampleBufferSize(SERVER_INCOMING_JITTER_BUFFER, sampleBufferSize, sampleRate);
+		bufferConfig.serverIncomingMaximumBuffer = blocksForSampleBufferSize(SERVER_INCOMING_MAXIMUM_BUFFER, sampleBufferSize, sampleRate);
+		bufferConfig.serverBufferPrefillOnConnect = blocksForSampleBufferSize(BUFFER_PREFILL_ON_CONNECT, sampleBufferSize, sampleRate);
 		if (args.containsOption("--buffer|-b")) { //, "block count", "Length of buffer in blocks", "Specify the length of the incoming jitter buffer in blocks", [&](const ArgumentList &args) {
 			bufferConfig.serverIncomingJitterBuffer = args.getValueForOption("--buffer|-b").getIntValue();
 		}
@@ -160,12 +268,83 @@ int main(int argc, char *argv[])
 		if (args.containsOption("--prefill|-p")) { //, "block count", "Length of prefill buffer in blocks", "Specify the number of packets a client needs to send before becoming part of the mix (minimum queue length)", [&](const ArgumentList &args) {
 			bufferConfig.serverBufferPrefillOnConnect = args.getValueForOption("--prefill|-p").getIntValue();
 		}
+		// Mix what was played at the same time, a little behind the jitter buffer so early clients can be held back
+		bufferConfig.serverAlignmentTarget = bufferConfig.serverIncomingJitterBuffer + 1;
+		if (args.containsOption("--align|-a")) {
+			bufferConfig.serverAlignmentTarget = args.getValueForOption("--align|-a").getIntValue();
+			if (bufferConfig.serverAlignmentTarget < 0) {
+				app.fail("Invalid alignment, use --align=<buffer count> or --align=0 to mix whatever arrived first", -1);
+			}
+		}
+
+		if (args.containsOption("--latency-trace|-L")) {
+			latencyTraceFile = args.getFileForOption("--latency-trace|-L");
+			uint64_t interval = LatencyTrace::defaultSampleInterval;
+			if (args.containsOption("--trace-interval")) {
+				const int requested = args.getValueForOption("--trace-interval").getIntValue();
+				if (requested <= 0) {
+					app.fail("Invalid trace interval, use --trace-interval=<packets> with a positive value", -1);
+				}
+				interval = static_cast<uint64_t>(requested);
+			}
+			LatencyTrace::instance().enable(interval);
+		}
+
+		if (args.containsOption("--record|-R")) {
+			recordingDirectory = args.getFileForOption("--record|-R");
+			if (recordingDirectory.existsAsFile() || !recordingDirectory.createDirectory()) {
+				app.fail("Can't record into " + recordingDirectory.getFullPathName() + ", please specify a directory", -1);
+			}
+		}
+		if (args.containsOption("--record-format")) {
+			// The log survives a crash of the server, convert it with JammerNetzRecordingTool afterwards
+			const String format = args.getValueForOption("--record-format");
+			if (format == "log") {
+				recordingType = RecordingType::CrashSafeLog;
+			}
+			else if (format != "wav") {
+				app.fail("Invalid recording format '" + format + "', use --record-format=wav or --record-format=log", -1);
+			}
+		}
+
+		if (args.containsOption("--impair")) {
+			// Simulated bad network for reproducing field problems, e.g. --impair=seed=7,ge=0.01/0.3/0/0.5,delay=20,jitter=5:pareto
+			std::string error;
+			const auto impairment = NetworkImpairmentConfig::parse(args.getValueForOption("--impair").toStdString(), error);
+			if (!impairment) {
+				app.fail("Invalid network impairment: " + String(error), -1);
+			}
+			NetworkImpairment::instance().enable(*impairment);
+			if (useIoUring) {
+				app.fail("The network impairment only works on the socket path, don't combine --impair with --io-uring", -1);
+			}
+		}
+
+		// Real-time scheduling and cpu pinning of the audio path, e.g. --mixer-scheduling=policy=fifo,priority=80,cpus=2
+		auto parseScheduling = [&](const String &option, ThreadSchedulingConfig &config) {
+			if (args.containsOption(option)) {
+				std::string error;
+				const auto parsed = ThreadSchedulingConfig::parse(args.getValueForOption(option).toStdString(), error);
+				if (!parsed) {
+					app.fail("Invalid " + option + ": " + String(error), -1);
+				}
+				config = *parsed;
+			}
+		};
+		parseScheduling("--receive-scheduling", scheduling.receive);
+		parseScheduling("--mixer-scheduling", scheduling.mixer);
+		parseScheduling("--send-scheduling", scheduling.send);
+		if (args.containsOption("--lock-memory")) {
+			// Before the server allocates its threads and buffers, so they are faulted in right away
+			std::string error;
+			scheduling.memoryStatus = lockProcessMemory(error) ? "memory locked" : "memory not locked (" + error + ")";
+		}
 
 		// Try to open screen
 		ServerLogger::init();
 
 		// Create Server
-		Server server(cryptoKey, bufferConfig, serverPort, useFEC);
+		Server server(cryptoKey, bufferConfig, sampleBufferSize, sampleRate, serverPort, receiveThreads, useIoUring, useFEC, latencyTraceFile, recordingDirectory, recordingType, scheduling);
 		server.launchServer();
 
 		// Close screen
@@ -11,13 +11,23 @@
 
 #include <utility>
 
-MixerThread::MixerThread(TPacketStreamBundle &incoming, JammerNetzChannelSetup mixdownSetup, TOutgoingQueue &outgoing, TMessageQueue &wakeUpQueue/*, Recorder &recorder*/, ServerBufferConfig bufferConfig) :
+namespace {
+
+std::string nameOf(const ClientRegistry& clients, ClientId id)
+{
+	const auto client = clients.find(id);
+	return client ? client->name : "client " + std::to_string(id);
+}
+
+} // namespace
+
+MixerThread::MixerThread(const ClientRegistry &incoming, JammerNetzChannelSetup mixdownSetup, TOutgoingQueue &outgoing, TMessageQueue &wakeUpQueue, ServerRecordingWorker *recorder, ServerBufferConfig bufferConfig, int sampleBufferSize, int sampleRate) :
     Thread("MixerThread")
         , incoming_(incoming)
         , outgoing_(outgoing)
         , wakeUpQueue_(wakeUpQueue)
-        , mixScheduler_(std::move(mixdownSetup), bufferConfig)
-        /*, recorder_(recorder) */
+        , mixScheduler_(std::move(mixdownSetup), bufferConfig, sampleBufferSize, sampleRate)
+        , recorder_(recorder)
 {
 }
 
@@ -32,11 +42,12 @@ void MixerThread::run() {
 		if (result.shouldWakeAgain) {
 			wakeUpQueue_.push(0);
 		}
+		const auto guard = incoming_.pin();
 		for (const auto& client : result.disconnectedClients) {
-			ServerLogger::printClientStatus(4, client, "Disconnect grace period expired");
+			ServerLogger::printClientStatus(4, nameOf(incoming_, client), "Disconnect grace period expired");
 		}
 		for (const auto& client : result.underrunClients) {
-			ServerLogger::printClientStatus(4, client,
+			ServerLogger::printClientStatus(4, nameOf(incoming_, client),
 				"Jitter queue underrun, starting disconnect grace period");
 		}
 		for (const auto& [client, fastForward] : result.fastForwardedClients) {
@@ -46,7 +57,12 @@ void MixerThread::run() {
 				statusMessage += ", retained counter "
 					+ std::to_string(*fastForward.oldestRetainedCounter) + " onward";
 			}
-			ServerLogger::printClientStatus(4, client, statusMessage);
+			ServerLogger::printClientStatus(4, nameOf(incoming_, client), statusMessage);
+		}
+		for (const auto& [client, correction] : result.alignedClients) {
+			ServerLogger::printClientStatus(4, nameOf(incoming_, client), correction == StreamAlignmentCorrection::Held
+				? "Early against the room, delayed by one block"
+				: "Late against the room, skipped one block");
 		}
 		if (!result.incoming.empty()) {
 			for (const auto& diagnostic : result.mix.diagnostics) {
@@ -58,6 +74,10 @@ void MixerThread::run() {
 					exit(-1);
 				}
 			}
+			if (recorder_) {
+				// Hands the input packets over, a full recording queue only costs the recording this block
+				recorder_->enqueue(result.mix.serverTime, result.incoming);
+			}
 		}
 	}
 
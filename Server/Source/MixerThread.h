@@ -12,21 +12,24 @@
 #include "JammerNetzPackage.h"
 #include "BuffersConfig.h"
 
-#include "Recorder.h"
 #include "ServerMixScheduler.h"
+#include "ServerRecordingWorker.h"
 
 class MixerThread : public Thread {
 public:
-	MixerThread(TPacketStreamBundle &incoming, JammerNetzChannelSetup mixdownSetup, TOutgoingQueue &outgoing, TMessageQueue &wakeUpQueue
-                /*, Recorder &recorder*/
-                , ServerBufferConfig bufferConfig);
+	// The recorder is optional, pass nullptr when the session is not recorded
+	MixerThread(const ClientRegistry &incoming, JammerNetzChannelSetup mixdownSetup, TOutgoingQueue &outgoing, TMessageQueue &wakeUpQueue
+                , ServerRecordingWorker *recorder
+                , ServerBufferConfig bufferConfig
+                , int sampleBufferSize = SAMPLE_BUFFER_SIZE
+                , int sampleRate = SAMPLE_RATE);
 
 	virtual void run() override;
 
 private:
-	TPacketStreamBundle &incoming_;
+	const ClientRegistry &incoming_;
 	TOutgoingQueue &outgoing_;
 	TMessageQueue &wakeUpQueue_;
 	ServerMixScheduler mixScheduler_;
-	//Recorder &recorder_;
+	ServerRecordingWorker *recorder_;
 };
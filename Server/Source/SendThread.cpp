@@ -7,42 +7,47 @@
 #include "SendThread.h"
 
 #include "BuffersConfig.h"
+#include "LatencyTrace.h"
+#include "NetworkImpairment.h"
 #include "XPlatformUtils.h"
 #include "ServerLogger.h"
 
 SendThread::SendThread(DatagramSocket& socket, CriticalSection& socketWriteLock,
-	TOutgoingQueue &sendQueue, TPacketStreamBundle &incomingData,
-	void *keydata, int keysize, ValueTree serverConfiguration)
+	TOutgoingQueue &sendQueue, const ClientRegistry &incomingData,
+	void *keydata, int keysize, ServerSettings &serverSettings, bool useIoUring)
 	: Thread("SenderThread")
     , sendQueue_(sendQueue)
     , incomingData_(incomingData)
     , sendSocket_(socket)
 	, socketWriteLock_(socketWriteLock)
-    , serverConfiguration_(serverConfiguration)
+    , serverSettings_(serverSettings)
+	, clients_(ClientRegistry::maximumClients)
 {
 	if (keydata) {
 		blowFish_ = std::make_unique<BlowFish>(keydata, keysize);
 	}
+	if (useIoUring) {
+		std::string error;
+		ioUring_ = IoUringSender::create(socket.getRawSocketHandle(), error);
+		if (!ioUring_) {
+			ServerLogger::errorln("Sending without io_uring: " + String(error));
+		}
+	}
 }
 
-void SendThread::determineTargetIP(std::string const &targetAddress, String &ipAddress, int &portNumber) {
-	ipAddress = targetAddress.substr(0, targetAddress.find(':'));
-	portNumber = atoi(targetAddress.substr(targetAddress.find(':') + 1).c_str());
-}
-
-void SendThread::sendAudioBlock(OutgoingPackage const &package) {
-	const auto &targetAddress = package.targetAddress;
-	if (fecData_.find(targetAddress) == fecData_.end()) {
-		// First time we send a package to this address, create a ring buffer!
-		fecData_.emplace(targetAddress, FEC_RINGBUFFER_SIZE);
+void SendThread::sendAudioBlock(const RegisteredClient &target, OutgoingPackage const &package) {
+	auto &fecRing = clients_[ClientRegistry::slotOf(target.id)].fecData;
+	if (!fecRing) {
+		// First time we send a package to this client, create a ring buffer!
+		fecRing = std::make_unique<RingOfAudioBuffers<AudioBlock>>(FEC_RINGBUFFER_SIZE);
 	}
 
 	std::shared_ptr<AudioBlock> fecBlock;
-    bool useFEC = serverConfiguration_.getProperty("FEC").operator bool();
-	if (useFEC && !fecData_.find(targetAddress)->second.isEmpty()) {
+    bool useFEC = serverSettings_.fec.load(std::memory_order_relaxed);
+	if (useFEC && !fecRing->isEmpty()) {
 		// Send FEC data
-		fecBlock = fecData_.find(targetAddress)->second.getLast();
-		//dataForClient.serialize(writebuffer_, bytesWritten, fecData_.find(targetAddress)->second.getLast(), SAMPLE_RATE, FEC_SAMPLERATE_REDUCTION);
+		fecBlock = fecRing->getLast();
+		//dataForClient.serialize(writebuffer_, bytesWritten, fecRing->getLast(), SAMPLE_RATE, FEC_SAMPLERATE_REDUCTION);
 	}
 
 	JammerNetzAudioData dataForClient(package.audioBlock, fecBlock);
@@ -54,28 +59,25 @@ void SendThread::sendAudioBlock(OutgoingPackage const &package) {
 
 	// Store the package sent in the FEC buffer for the next package to go out
 	auto redundancyData = std::make_shared<AudioBlock>(package.audioBlock);
-	fecData_.find(targetAddress)->second.push(redundancyData);
-
-	String ipAddress;
-	int port;
-	determineTargetIP(targetAddress, ipAddress, port);
+	fecRing->push(redundancyData);
 
-	sendWriteBuffer(ipAddress, port, bytesWritten);
+	sendWriteBuffer(target, bytesWritten);
+	auto& latencyTrace = LatencyTrace::instance();
+	if (latencyTrace.isSampled(package.audioBlock.messageCounter)) {
+		latencyTrace.stamp(target.streamId, package.audioBlock.messageCounter, LatencyStage::ServerSend);
+	}
 }
 
 
-void SendThread::sendClientInfoPackage(std::string const &targetAddress)
+void SendThread::sendClientInfoPackage(const RegisteredClient &target)
 {
 	// Loop over the incoming data streams and add them to our statistics package we are going to send to the client
 	JammerNetzClientInfoMessage clientInfoPackage;
 	clientInfoPackage.addCapability(JammerNetzCapability::MtuProbeV1);
-	for (auto &incoming : incomingData_) {
+	for (const auto &incoming : incomingData_.registered()) {
 		JammerNetzStreamQualityInfo qualityInfo;
-		if (incoming.second && incoming.second->snapshot().size > 0 && incoming.second->qualityInfo(qualityInfo)) {
-			String ipAddress;
-			int port;
-			determineTargetIP(incoming.first, ipAddress, port);
-			clientInfoPackage.addClientInfo(IPAddress(ipAddress), port, qualityInfo);
+		if (incoming->state->snapshot().size > 0 && incoming->state->qualityInfo(qualityInfo)) {
+			clientInfoPackage.addClientInfo(incoming->ipAddress, incoming->port, qualityInfo);
 		}
 	}
 	if (clientInfoPackage.getNumClients() == 0) {
@@ -84,14 +86,10 @@ void SendThread::sendClientInfoPackage(std::string const &targetAddress)
 
 	size_t bytesWritten = 0;
 	clientInfoPackage.serialize(writebuffer_, bytesWritten);
-
-	String ipAddress;
-	int port;
-	determineTargetIP(targetAddress, ipAddress, port);
-	sendWriteBuffer(ipAddress, port, bytesWritten);
+	sendWriteBuffer(target, bytesWritten);
 }
 
-void SendThread::sendSessionInfoPackage(std::string const &targetAddress, JammerNetzChannelSetup &sessionSetup)
+void SendThread::sendSessionInfoPackage(const RegisteredClient &target, JammerNetzChannelSetup &sessionSetup)
 {
     // Loop over the incoming data streams and add them to our statistics package we are going to send to the client
         JammerNetzSessionInfoMessage sessionInfoMessage;
@@ -100,14 +98,10 @@ void SendThread::sendSessionInfoPackage(std::string const &targetAddress, Jammer
 
     size_t bytesWritten = 0;
     sessionInfoMessage.serialize(writebuffer_, bytesWritten);
-
-    String ipAddress;
-    int port;
-    determineTargetIP(targetAddress, ipAddress, port);
-    sendWriteBuffer(ipAddress, port, bytesWritten);
+    sendWriteBuffer(target, bytesWritten);
 }
 
-void SendThread::sendWriteBuffer(String ipAddress, int port, size_t size) {
+void SendThread::sendWriteBuffer(const RegisteredClient &target, size_t size) {
 	if (sizet_is_safe_as_int(size)) {
 		int cipherLength = static_cast<int>(size);
 		if (blowFish_) {
@@ -120,16 +114,69 @@ void SendThread::sendWriteBuffer(String ipAddress, int port, size_t size) {
 			}
 		}
 
-		// Now, back to the client! This will block when not ready to send yet, but that's ok.
-		{
+		if (ioUring_) {
+			// Goes out with the rest of this round in run()
+			if (!ioUring_->queue(target.socketAddress, writebuffer_, cipherLength)) {
+				++failedQueues_;
+			}
+		}
+		else {
+			// Now, back to the client! This will block when not ready to send yet, but that's ok.
 			const ScopedLock socketLock(socketWriteLock_);
-			sendSocket_.write(ipAddress, port, writebuffer_, cipherLength);
+			if (NetworkImpairment::instance().isEnabled() || !target.socketAddress.isValid()) {
+				// The impairment shim queues by host name, it is only for tests
+				NetworkImpairment::instance().write(sendSocket_, target.address, target.port, writebuffer_, cipherLength);
+			}
+			else {
+				target.socketAddress.sendFrom(sendSocket_, writebuffer_, cipherLength);
+			}
 		}
 
 		ServerLogger::printServerStatistics(4, ("Packet length: " + String(cipherLength)).toStdString());
 	}
 }
 
+void SendThread::forgetStaleClients()
+{
+	// Frees the FEC buffers of clients the registry has forgotten, so they don't pile up over weeks
+	registryVersion_ = incomingData_.version();
+	for (auto &client : clients_) {
+		if (client.client != ClientRegistry::noClient && !incomingData_.find(client.client)) {
+			client = ClientSendState {};
+		}
+	}
+}
+
+void SendThread::sendPackage(OutgoingPackage const &package)
+{
+	const auto guard = incomingData_.pin();
+	if (incomingData_.version() != registryVersion_) {
+		forgetStaleClients();
+	}
+	const auto target = incomingData_.find(package.target);
+	if (!target) {
+		// The client was forgotten while its mix waited in the queue
+		return;
+	}
+	auto &client = clients_[ClientRegistry::slotOf(target->id)];
+	if (client.client != target->id) {
+		client = ClientSendState { target->id, nullptr, 0 };
+	}
+
+	// Now serialize the buffer and create the datagram to send back to the client
+	sendAudioBlock(*target, package);
+
+	// Check if we want to send a statistics package to that client (every nth data package)
+	auto &packageCounter = client.packageCounter;
+	if (packageCounter % 100 == 0) {
+		sendClientInfoPackage(*target);
+		if (JammerNetzProtocol::supportsSplitSessionInfo(package.receiverProtocolVersion)) {
+			sendSessionInfoPackage(*target, package.sessionSetup);
+		}
+	}
+	packageCounter++;
+}
+
 void SendThread::run()
 {
 	OutgoingPackage nextBlock;
@@ -141,20 +188,23 @@ void SendThread::run()
 		if (currentThreadShouldExit())
 			return;
 
-		// Now serialize the buffer and create the datagram to send back to the client
-		sendAudioBlock(nextBlock);
-
-		// Check if we want to send a statistics package to that client (every nth data package)
-		if (packageCounters_.find(nextBlock.targetAddress) == packageCounters_.end()) {
-			// First time we send a package to this address!
-			packageCounters_.emplace(nextBlock.targetAddress, 0);
-		}
-		if (packageCounters_[nextBlock.targetAddress] % 100 == 0) {
-			sendClientInfoPackage(nextBlock.targetAddress);
-			if (JammerNetzProtocol::supportsSplitSessionInfo(nextBlock.receiverProtocolVersion)) {
-				sendSessionInfoPackage(nextBlock.targetAddress, nextBlock.sessionSetup);
+		sendPackage(nextBlock);
+		if (ioUring_) {
+			// The mixer queues a round's packages right after each other, collect what is there already and submit it together
+			while (!currentThreadShouldExit() && sendQueue_.try_pop(nextBlock)) {
+				sendPackage(nextBlock);
+			}
+			if (failedQueues_ > 0) {
+				ServerLogger::errorln("Failed to queue " + String(failedQueues_) + " packages for io_uring: " + String(ioUring_->lastError()));
+				failedQueues_ = 0;
+			}
+			if (!ioUring_->submit()) {
+				ServerLogger::errorln("Failed to send with io_uring: " + String(ioUring_->lastError()));
+			}
+			if (ioUring_->failedSends() != reportedFailedSends_) {
+				reportedFailedSends_ = ioUring_->failedSends();
+				ServerLogger::errorln("io_uring could not send " + String(reportedFailedSends_) + " packages so far");
 			}
 		}
-		packageCounters_[nextBlock.targetAddress]++;
 	}
 }
@@ -11,29 +11,48 @@
 #include "SharedServerTypes.h"
 #include "JammerNetzPackage.h"
 #include "RingOfAudioBuffers.h"
+#include "IoUringSocket.h"
+#include "ServerControl.h"
 
+#include <memory>
+#include <vector>
+
+// Sends the mixes the MixerThread queues. With io_uring, everything queued at once (a mix round's packages
+// for all clients) is handed to the kernel with one system call instead of one blocking write each.
 class SendThread : public Thread {
 public:
 	SendThread(DatagramSocket& socket, CriticalSection& socketWriteLock,
-		TOutgoingQueue &sendQueue, TPacketStreamBundle &incomingData,
-		void *keydata, int keysize, ValueTree serverConfiguration);
+		TOutgoingQueue &sendQueue, const ClientRegistry &incomingData,
+		void *keydata, int keysize, ServerSettings &serverSettings, bool useIoUring = false);
 
 	virtual void run() override;
 
 private:
-	void determineTargetIP(std::string const &targetAddress, String &ipAddress, int &portNumber);
-	void sendWriteBuffer(String ipAddress, int port, size_t size);
-    void sendSessionInfoPackage(std::string const &targetAddress, JammerNetzChannelSetup &sessionSetup);
-    void sendClientInfoPackage(std::string const &targetAddress);
-	void sendAudioBlock(OutgoingPackage const &package);
+	void sendWriteBuffer(const RegisteredClient &target, size_t size);
+    void sendSessionInfoPackage(const RegisteredClient &target, JammerNetzChannelSetup &sessionSetup);
+    void sendClientInfoPackage(const RegisteredClient &target);
+	void sendAudioBlock(const RegisteredClient &target, OutgoingPackage const &package);
+	void sendPackage(OutgoingPackage const &package);
+	void forgetStaleClients();
+
+	struct ClientSendState {
+		ClientId client { ClientRegistry::noClient };
+		std::unique_ptr<RingOfAudioBuffers<AudioBlock>> fecData;
+		uint64_t packageCounter { 0 };
+	};
 
 	TOutgoingQueue& sendQueue_;
-	TPacketStreamBundle &incomingData_;
+	const ClientRegistry &incomingData_;
 	DatagramSocket& sendSocket_;
 	CriticalSection& socketWriteLock_;
-    ValueTree serverConfiguration_;
+	ServerSettings &serverSettings_;
 	uint8 writebuffer_[MAXFRAMESIZE];
-	std::map<std::string, RingOfAudioBuffers<AudioBlock>> fecData_;
-	std::map<std::string, uint64_t> packageCounters_;
+	// Indexed by the client's slot
+	std::vector<ClientSendState> clients_;
+	uint64_t registryVersion_ { 0 };
 	std::unique_ptr<BlowFish> blowFish_;
+	std::unique_ptr<IoUringSender> ioUring_;
+	uint64_t reportedFailedSends_ { 0 };
+	// Packages that found no io_uring slot this round, reported once per round
+	uint64_t failedQueues_ { 0 };
 };
@@ -0,0 +1,19 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "ServerControl.h"
+
+ServerControlRequest parseServerControl(nlohmann::json const &json)
+{
+	ServerControlRequest request;
+	if (json.is_object()) {
+		const auto fec = json.find("FEC");
+		if (fec != json.end() && fec->is_boolean()) {
+			request.fec = fec->get<bool>();
+		}
+	}
+	return request;
+}
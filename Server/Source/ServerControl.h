@@ -0,0 +1,25 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "nlohmann/json.hpp"
+
+#include <atomic>
+#include <optional>
+
+// Shared by the receive threads, which apply the clients' control messages, and the send thread
+struct ServerSettings {
+	std::atomic<bool> fec { false };
+};
+
+// The server settings a client can change with a control message. The JSON comes from the network, a setting
+// of the wrong type is ignored instead of throwing on the receive thread.
+struct ServerControlRequest {
+	std::optional<bool> fec;
+};
+
+ServerControlRequest parseServerControl(nlohmann::json const &json);
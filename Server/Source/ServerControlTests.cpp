@@ -0,0 +1,26 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "ServerControl.h"
+
+#include <gtest/gtest.h>
+
+TEST(ServerControlTest, ReadsTheFecSwitch)
+{
+	EXPECT_EQ(parseServerControl(nlohmann::json::parse(R"({"FEC": true})")).fec, true);
+	EXPECT_EQ(parseServerControl(nlohmann::json::parse(R"({"FEC": false})")).fec, false);
+	EXPECT_FALSE(parseServerControl(nlohmann::json::parse(R"({"mtu_probe_v1": {"id": 1, "size": 1200}})")).fec.has_value());
+}
+
+TEST(ServerControlTest, IgnoresAFecSwitchThatIsNotABoolean)
+{
+	for (const auto *text : { R"({"FEC": 1})", R"({"FEC": "yes"})", R"({"FEC": null})", R"({"FEC": {}})", R"([true])", R"(true)" }) {
+		SCOPED_TRACE(text);
+		const auto json = nlohmann::json::parse(text);
+		EXPECT_NO_THROW(parseServerControl(json));
+		EXPECT_FALSE(parseServerControl(json).fec.has_value());
+	}
+}
@@ -9,6 +9,7 @@
 #include <curses.h>
 #include <cstdio>
 #include <cstdlib>
+#include <set>
 
 #if defined(_WIN32)
 #include <io.h>
@@ -50,6 +51,7 @@ void ServerLogger::init()
 }
 
 void ServerLogger::deinit() {
+	const ScopedLock scopedLock(lock);
 	if (terminal) {
 		endwin();
 		delscreen(terminal);
@@ -59,6 +61,7 @@ void ServerLogger::deinit() {
 
 void ServerLogger::errorln(String const &message)
 {
+	const ScopedLock scopedLock(lock);
 	if (message != lastMessage) {
 		std::cerr << message << std::endl;
 		lastMessage = message;
@@ -67,6 +70,7 @@ void ServerLogger::errorln(String const &message)
 
 void ServerLogger::printAtPosition(int x, int y, std::string text)
 {
+	const ScopedLock scopedLock(lock);
 	if (terminal) {
 		move(x, y);
 		printw(text.c_str());
@@ -81,16 +85,25 @@ std::vector<std::pair<int, std::string>> kColumnHeaders = { {0, "Client"}, {20,
 	{70, "Jitter ms"}, { 80, "Jitter SD" } };
 
 std::map<std::string, int> sClientRows;
+std::set<int> sFreeRows;
 int kRowsInTable = 0;
 
+// Only call with ServerLogger::lock held
 static int yForClient(std::string const &clientID) {
 	if (sClientRows.find(clientID) == sClientRows.end()) {
-		sClientRows[clientID] = kRowsInTable++;
+		if (sFreeRows.empty()) {
+			sClientRows[clientID] = kRowsInTable++;
+		}
+		else {
+			sClientRows[clientID] = *sFreeRows.begin();
+			sFreeRows.erase(sFreeRows.begin());
+		}
 	}
 	return sClientRows[clientID];
 }
 
 void ServerLogger::printColumnHeader(int row) {
+	const ScopedLock scopedLock(lock);
 	if (terminal) {
 		int y = row;
 		for (const auto& col : kColumnHeaders) {
@@ -103,6 +116,7 @@ void ServerLogger::printColumnHeader(int row) {
 }
 
 void ServerLogger::printStatistics(int row, std::string const &clientID, JammerNetzStreamQualityInfo quality) {
+	const ScopedLock scopedLock(lock);
 	if (terminal) {
 		// Find y
 		int y = row + yForClient(clientID);
@@ -139,6 +153,7 @@ void ServerLogger::printStatistics(int row, std::string const &clientID, JammerN
 
 void ServerLogger::printServerStatus(std::string const &text)
 {
+	const ScopedLock scopedLock(lock);
 	if (terminal) {
 		move(1, 0);
 		clrtoeol();
@@ -153,19 +168,35 @@ void ServerLogger::printServerStatus(std::string const &text)
 
 void ServerLogger::printServerStatistics(int row, std::string const &text)
 {
+	const ScopedLock scopedLock(lock);
 	if (terminal) {
 		if (((counter++) % 500) == 0) {
-			int y = row + (int) sClientRows.size() + 2;
+			int y = row + kRowsInTable + 2;
 			move(y, 0);
 			clrtoeol();
 			printw(text.c_str());
+			if (!schedulingStatus.empty()) {
+				printw(", ");
+				printw(schedulingStatus.c_str());
+			}
 			refresh();
 		}
 	}
 }
 
+void ServerLogger::printSchedulingStatus(std::string const &text)
+{
+	const ScopedLock scopedLock(lock);
+	schedulingStatus = text;
+	if (!terminal) {
+		// There are no statistics lines without a terminal, log it once
+		std::cout << text << std::endl;
+	}
+}
+
 void ServerLogger::printClientStatus(int row, std::string const &clientID, std::string const &text)
 {
+	const ScopedLock scopedLock(lock);
 	if (terminal) {
 		int y = row + yForClient(clientID);
 		move(y, kColumnHeaders[0].first);
@@ -181,10 +212,30 @@ void ServerLogger::printClientStatus(int row, std::string const &clientID, std::
 	}
 }
 
+void ServerLogger::removeClient(int row, std::string const &clientID)
+{
+	const ScopedLock scopedLock(lock);
+	auto client = sClientRows.find(clientID);
+	if (client == sClientRows.end()) {
+		return;
+	}
+	if (terminal) {
+		move(row + client->second, 0);
+		clrtoeol();
+		refresh();
+	}
+	sFreeRows.insert(client->second);
+	sClientRows.erase(client);
+}
+
 juce::String ServerLogger::lastMessage;
 
 long long ServerLogger::counter = 0;
 
+std::string ServerLogger::schedulingStatus;
+
+CriticalSection ServerLogger::lock;
+
 #ifdef __GNUC__
 #pragma GCC diagnostic pop
 #endif
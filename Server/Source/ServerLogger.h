@@ -20,9 +20,17 @@ public:
 	static void printStatistics(int row, std::string const &clientID, JammerNetzStreamQualityInfo quality);
 	static void printServerStatus(std::string const &text);
 	static void printServerStatistics(int row, std::string const &text);
+	// What the server's threads were granted, shown with the server statistics from then on
+	static void printSchedulingStatus(std::string const &text);
 	static void printClientStatus(int row, std::string const &clientID, std::string const &text);
+	// Frees the client's line in the table for the next new client
+	static void removeClient(int row, std::string const &clientID);
 
 private:
 	static String lastMessage;
 	static long long counter;
+	static std::string schedulingStatus;
+	// The mixer, send and receive threads and the quality timer all log. This guards curses, the client table
+	// and the fields above.
+	static CriticalSection lock;
 };
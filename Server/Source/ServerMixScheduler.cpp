@@ -6,6 +6,8 @@
 
 #include "ServerMixScheduler.h"
 
+#include "LatencyTrace.h"
+
 #include <algorithm>
 #include <utility>
 
@@ -19,42 +21,44 @@ ServerQueueObservation observe(const ClientQueueSnapshot& snapshot)
 } // namespace
 
 ServerMixScheduler::ServerMixScheduler(JammerNetzChannelSetup mixdownSetup,
-	const ServerBufferConfig bufferConfig)
-	: mixerCore_(std::move(mixdownSetup))
+	const ServerBufferConfig bufferConfig, const int sampleBufferSize, const int sampleRate)
+	: mixerCore_(std::move(mixdownSetup), sampleBufferSize, sampleRate)
 	, bufferConfig_(bufferConfig)
+	, aligners_(ClientRegistry::maximumClients)
 {
 }
 
-ServerScheduledMixResult ServerMixScheduler::process(TPacketStreamBundle& clients,
+ServerScheduledMixResult ServerMixScheduler::process(const ClientRegistry& clients,
 	const ClientState::TimePoint now)
 {
 	ServerScheduledMixResult result;
 	int clientCount = 0;
 	int available = 0;
-	std::map<std::string, ServerQueueObservation> queuesAfterFastForward;
+	std::map<ClientId, ServerQueueObservation> queuesAfterFastForward;
 	const auto maximumQueueDepth = static_cast<std::size_t>(
 		std::max(0, bufferConfig_.serverIncomingMaximumBuffer));
 	const auto targetQueueDepth = std::min(maximumQueueDepth,
 		static_cast<std::size_t>(std::max(0, bufferConfig_.serverIncomingJitterBuffer)));
+	const auto guard = clients.pin();
+	// Clients registering meanwhile join with the next mix
+	const auto registered = clients.registered();
 
-	for (auto& client : clients) {
-		if (!client.second) {
-			continue;
-		}
-		if (client.second->disconnectIfGraceExpired(now)) {
-			result.disconnectedClients.push_back(client.first);
+	for (const auto& client : registered) {
+		if (client->state->disconnectIfGraceExpired(now)) {
+			result.disconnectedClients.push_back(client->id);
 		}
-		auto pressure = client.second->applyQueuePressure(maximumQueueDepth, targetQueueDepth);
-		result.queuesBefore.emplace(client.first, observe(pressure.before));
+		auto pressure = client->state->applyQueuePressure(maximumQueueDepth, targetQueueDepth);
+		result.queuesBefore.emplace(client->id, observe(pressure.before));
 		auto snapshot = pressure.after;
 		if (snapshot.state == ClientConnectionState::Disconnected) {
-			queuesAfterFastForward.emplace(client.first, observe(snapshot));
+			queuesAfterFastForward.emplace(client->id, observe(snapshot));
+			aligners_[ClientRegistry::slotOf(client->id)].aligner.reset();
 			continue;
 		}
 		if (pressure.fastForward.discardedPackets > 0) {
-			result.fastForwardedClients.emplace(client.first, std::move(pressure.fastForward));
+			result.fastForwardedClients.emplace(client->id, std::move(pressure.fastForward));
 		}
-		queuesAfterFastForward.emplace(client.first, observe(snapshot));
+		queuesAfterFastForward.emplace(client->id, observe(snapshot));
 		++clientCount;
 		if (static_cast<int>(snapshot.size) > bufferConfig_.serverIncomingJitterBuffer) {
 			++available;
@@ -74,38 +78,95 @@ ServerScheduledMixResult ServerMixScheduler::process(TPacketStreamBundle& client
 		result.trigger = ServerMixTrigger::AllClientsReady;
 	}
 
-	std::map<std::string, std::uint64_t> observedActivity;
-	for (auto& client : clients) {
-		if (!client.second) {
-			continue;
-		}
+	auto& latencyTrace = LatencyTrace::instance();
+	std::map<ClientId, std::uint64_t> observedActivity;
+	// The stream and counter of the packets to stamp once mixed
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> sampled;
+	for (const auto& client : registered) {
 		std::shared_ptr<JammerNetzAudioData> popped;
 		bool isFillIn = false;
 		std::uint64_t activityGeneration = 0;
-		if (client.second->tryPop(popped, isFillIn, activityGeneration)) {
-			result.incoming.emplace(client.first, std::move(popped));
-			if (isFillIn) {
-				result.fillInClients.push_back(client.first);
-				result.shouldWakeAgain = true;
+		if (popPacket(*client, popped, isFillIn, activityGeneration, result)) {
+			if (bufferConfig_.serverAlignmentTarget > 0) {
+				popped = align(*client, std::move(popped), isFillIn, clientCount > 1, now, result);
+			}
+			if (popped && latencyTrace.isSampled(popped->messageCounter())) {
+				sampled.emplace_back(client->streamId, popped->messageCounter());
 			}
+			result.incoming.emplace(client->id, std::move(popped));
 		}
-		else if (client.second->snapshot().state != ClientConnectionState::Disconnected) {
-			observedActivity.emplace(client.first, activityGeneration);
+		else if (client->state->snapshot().state != ClientConnectionState::Disconnected) {
+			observedActivity.emplace(client->id, activityGeneration);
 		}
 	}
 
-	for (auto& client : clients) {
-		if (!client.second) {
-			continue;
-		}
-		const auto observation = observedActivity.find(client.first);
+	for (const auto& client : registered) {
+		const auto observation = observedActivity.find(client->id);
 		if (observation != observedActivity.end()
-			&& client.second->markUnderrun(observation->second, now)) {
-			result.underrunClients.push_back(client.first);
+			&& client->state->markUnderrun(observation->second, now)) {
+			result.underrunClients.push_back(client->id);
 		}
-		result.queuesAfter.emplace(client.first, observe(client.second->snapshot()));
+		result.queuesAfter.emplace(client->id, observe(client->state->snapshot()));
 	}
 
 	result.mix = mixerCore_.mix(result.incoming);
+	for (const auto& [streamId, messageCounter] : sampled) {
+		latencyTrace.stamp(streamId, messageCounter, LatencyStage::ServerMix);
+	}
 	return result;
 }
+
+bool ServerMixScheduler::popPacket(const RegisteredClient& client, std::shared_ptr<JammerNetzAudioData>& popped, bool& isFillIn,
+	std::uint64_t& activityGeneration, ServerScheduledMixResult& result)
+{
+	if (!client.state->tryPop(popped, isFillIn, activityGeneration)) {
+		return false;
+	}
+	auto& latencyTrace = LatencyTrace::instance();
+	if (!isFillIn && popped && latencyTrace.isSampled(popped->messageCounter())) {
+		latencyTrace.stamp(client.streamId, popped->messageCounter(), LatencyStage::ServerQueuePop);
+	}
+	if (isFillIn) {
+		result.fillInClients.push_back(client.id);
+		result.shouldWakeAgain = true;
+	}
+	return true;
+}
+
+std::shared_ptr<JammerNetzAudioData> ServerMixScheduler::align(const RegisteredClient& client,
+	std::shared_ptr<JammerNetzAudioData> popped, const bool isFillIn, const bool hasRoom, const ClientState::TimePoint now,
+	ServerScheduledMixResult& result)
+{
+	const double blockMilliseconds = 1000.0 * mixerCore_.sampleBufferSize() / mixerCore_.sampleRate();
+	auto& slot = aligners_[ClientRegistry::slotOf(client.id)];
+	if (slot.client != client.id) {
+		// The slot's previous client was forgotten
+		slot.client = client.id;
+		slot.aligner.reset();
+	}
+	if (!slot.aligner) {
+		slot.aligner.emplace(blockMilliseconds);
+	}
+	auto& aligner = *slot.aligner;
+	auto correction = StreamAlignmentCorrection::None;
+	const auto captureOffset = client.state->captureOffsetMs();
+	if (popped && !isFillIn && captureOffset) {
+		const double captureAgeMs = ClientState::milliseconds(now) - (popped->timestamp() + *captureOffset);
+		// Alone there is nobody to align with, only give back what was held for the others
+		const double targetMs = hasRoom ? bufferConfig_.serverAlignmentTarget * blockMilliseconds : 0.0;
+		correction = aligner.observe(captureAgeMs, targetMs, hasRoom && client.state->snapshot().size > 0);
+		if (correction == StreamAlignmentCorrection::Shifted && aligner.heldBlocks() == 0) {
+			std::shared_ptr<JammerNetzAudioData> next;
+			bool nextIsFillIn = false;
+			std::uint64_t activityGeneration = 0;
+			// Popped like any other packet, so it is stamped and a fill-in is counted
+			if (popPacket(client, next, nextIsFillIn, activityGeneration, result)) {
+				popped = std::move(next);
+			}
+		}
+		if (correction != StreamAlignmentCorrection::None) {
+			result.alignedClients.emplace(client.id, correction);
+		}
+	}
+	return aligner.delay(std::move(popped), correction);
+}
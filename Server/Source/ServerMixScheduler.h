@@ -9,10 +9,11 @@
 #include "BuffersConfig.h"
 #include "ServerMixerCore.h"
 #include "SharedServerTypes.h"
+#include "StreamAligner.h"
 
 #include <cstdint>
 #include <map>
-#include <string>
+#include <optional>
 #include <vector>
 
 enum class ServerMixTrigger {
@@ -32,12 +33,13 @@ struct ServerQueueObservation {
 struct ServerScheduledMixResult {
 	ServerMixTrigger trigger { ServerMixTrigger::None };
 	bool shouldWakeAgain { false };
-	std::map<std::string, ServerQueueObservation> queuesBefore;
-	std::map<std::string, ServerQueueObservation> queuesAfter;
-	std::vector<std::string> disconnectedClients;
-	std::vector<std::string> underrunClients;
-	std::vector<std::string> fillInClients;
-	std::map<std::string, PacketStreamQueueFastForwardResult> fastForwardedClients;
+	std::map<ClientId, ServerQueueObservation> queuesBefore;
+	std::map<ClientId, ServerQueueObservation> queuesAfter;
+	std::vector<ClientId> disconnectedClients;
+	std::vector<ClientId> underrunClients;
+	std::vector<ClientId> fillInClients;
+	std::map<ClientId, PacketStreamQueueFastForwardResult> fastForwardedClients;
+	std::map<ClientId, StreamAlignmentCorrection> alignedClients;
 	ServerInputPackets incoming;
 	ServerMixStepResult mix;
 };
@@ -46,12 +48,28 @@ struct ServerScheduledMixResult {
 // forwards the result; deterministic tests can drive this class directly.
 class ServerMixScheduler {
 public:
-	ServerMixScheduler(JammerNetzChannelSetup mixdownSetup, ServerBufferConfig bufferConfig);
+	ServerMixScheduler(JammerNetzChannelSetup mixdownSetup, ServerBufferConfig bufferConfig,
+		int sampleBufferSize = SAMPLE_BUFFER_SIZE, int sampleRate = SAMPLE_RATE);
 
-	ServerScheduledMixResult process(TPacketStreamBundle& clients,
+	// Pins the registry for the duration of the call
+	ServerScheduledMixResult process(const ClientRegistry& clients,
 		ClientState::TimePoint now = ClientState::Clock::now());
 
 private:
+	// Pops the client's next packet, stamps its latency and notes a fill-in in the result
+	bool popPacket(const RegisteredClient& client, std::shared_ptr<JammerNetzAudioData>& popped, bool& isFillIn,
+		std::uint64_t& activityGeneration, ServerScheduledMixResult& result);
+	std::shared_ptr<JammerNetzAudioData> align(const RegisteredClient& client,
+		std::shared_ptr<JammerNetzAudioData> popped, bool isFillIn, bool hasRoom, ClientState::TimePoint now,
+		ServerScheduledMixResult& result);
+
+	struct ClientAligner {
+		ClientId client { ClientRegistry::noClient };
+		std::optional<StreamAligner> aligner;
+	};
+
 	ServerMixerCore mixerCore_;
 	ServerBufferConfig bufferConfig_;
+	// Indexed by the client's slot
+	std::vector<ClientAligner> aligners_;
 };
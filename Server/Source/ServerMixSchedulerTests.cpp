@@ -8,7 +8,9 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
 #include <memory>
+#include <optional>
 #include <string>
 
 namespace {
@@ -23,6 +25,20 @@ std::shared_ptr<JammerNetzAudioData> makeSchedulerPacket(const std::uint64_t cou
 		SAMPLE_RATE, 0.0f, MidiSignal_None, std::move(buffer), nullptr);
 }
 
+// Audio filled with the block's capture index, so the test can see what was played at the same time
+std::shared_ptr<JammerNetzAudioData> makeCapturedPacket(const std::uint64_t counter, const int captureIndex, const double blockMilliseconds)
+{
+	auto buffer = std::make_shared<AudioBuffer<float>>(1, SAMPLE_BUFFER_SIZE);
+	buffer->clear();
+	for (int sample = 0; sample < SAMPLE_BUFFER_SIZE; ++sample) {
+		buffer->setSample(0, sample, static_cast<float>(captureIndex));
+	}
+	JammerNetzChannelSetup setup(true);
+	setup.channels.push_back(JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Mono));
+	return std::make_shared<JammerNetzAudioData>(counter, captureIndex * blockMilliseconds, setup,
+		SAMPLE_RATE, 0.0f, MidiSignal_None, std::move(buffer), nullptr);
+}
+
 JammerNetzChannelSetup stereoMixdown()
 {
 	return JammerNetzChannelSetup(false, {
@@ -33,11 +49,11 @@ JammerNetzChannelSetup stereoMixdown()
 
 TEST(ServerMixSchedulerTest, WaitsUntilEveryClientExceedsTheJitterThreshold)
 {
-	TPacketStreamBundle clients;
-	auto clientA = std::make_shared<ClientState>("a");
-	auto clientB = std::make_shared<ClientState>("b");
-	clients.emplace("a", clientA);
-	clients.emplace("b", clientB);
+	ClientRegistry clients;
+	const auto a = *clients.idFor("10.0.0.1", 1001);
+	const auto b = *clients.idFor("10.0.0.2", 1002);
+	auto clientA = clients.find(a)->state;
+	auto clientB = clients.find(b)->state;
 	ServerMixScheduler scheduler(stereoMixdown(), { 1, 3, 0 });
 
 	clientA->push(makeSchedulerPacket(10), 0);
@@ -52,17 +68,17 @@ TEST(ServerMixSchedulerTest, WaitsUntilEveryClientExceedsTheJitterThreshold)
 	EXPECT_EQ(mixed.trigger, ServerMixTrigger::AllClientsReady);
 	EXPECT_EQ(mixed.incoming.size(), 2U);
 	EXPECT_EQ(mixed.mix.outgoing.size(), 2U);
-	EXPECT_EQ(mixed.queuesAfter.at("a").size, 1U);
-	EXPECT_EQ(mixed.queuesAfter.at("b").size, 1U);
+	EXPECT_EQ(mixed.queuesAfter.at(a).size, 1U);
+	EXPECT_EQ(mixed.queuesAfter.at(b).size, 1U);
 }
 
 TEST(ServerMixSchedulerTest, MaximumBufferPressureFastForwardsOnlyTheOverfullClient)
 {
-	TPacketStreamBundle clients;
-	auto clientA = std::make_shared<ClientState>("a");
-	auto clientB = std::make_shared<ClientState>("b");
-	clients.emplace("a", clientA);
-	clients.emplace("b", clientB);
+	ClientRegistry clients;
+	const auto a = *clients.idFor("10.0.0.1", 1001);
+	const auto b = *clients.idFor("10.0.0.2", 1002);
+	auto clientA = clients.find(a)->state;
+	auto clientB = clients.find(b)->state;
 	ServerMixScheduler scheduler(stereoMixdown(), { 1, 3, 0 });
 	clientA->push(makeSchedulerPacket(10), 0);
 	clientB->push(makeSchedulerPacket(10), 0);
@@ -79,21 +95,21 @@ TEST(ServerMixSchedulerTest, MaximumBufferPressureFastForwardsOnlyTheOverfullCli
 	EXPECT_TRUE(pressured.incoming.empty());
 	EXPECT_TRUE(pressured.underrunClients.empty());
 	ASSERT_EQ(pressured.fastForwardedClients.size(), 1U);
-	EXPECT_EQ(pressured.fastForwardedClients.at("a").discardedPackets, 4U);
-	ASSERT_TRUE(pressured.fastForwardedClients.at("a").oldestRetainedCounter.has_value());
-	EXPECT_EQ(*pressured.fastForwardedClients.at("a").oldestRetainedCounter, 15U);
-	EXPECT_EQ(pressured.queuesAfter.at("a").size, 1U);
-	EXPECT_EQ(pressured.queuesAfter.at("b").size, 1U);
-	EXPECT_EQ(pressured.queuesAfter.at("b").state, ClientConnectionState::Connected);
+	EXPECT_EQ(pressured.fastForwardedClients.at(a).discardedPackets, 4U);
+	ASSERT_TRUE(pressured.fastForwardedClients.at(a).oldestRetainedCounter.has_value());
+	EXPECT_EQ(*pressured.fastForwardedClients.at(a).oldestRetainedCounter, 15U);
+	EXPECT_EQ(pressured.queuesAfter.at(a).size, 1U);
+	EXPECT_EQ(pressured.queuesAfter.at(b).size, 1U);
+	EXPECT_EQ(pressured.queuesAfter.at(b).state, ClientConnectionState::Connected);
 }
 
 TEST(ServerMixSchedulerTest, SustainedFasterStreamStaysBoundedWithoutDrainingTheSlowerStream)
 {
-	TPacketStreamBundle clients;
-	auto faster = std::make_shared<ClientState>("faster");
-	auto slower = std::make_shared<ClientState>("slower");
-	clients.emplace("faster", faster);
-	clients.emplace("slower", slower);
+	ClientRegistry clients;
+	const auto fasterId = *clients.idFor("10.0.0.1", 1001);
+	const auto slowerId = *clients.idFor("10.0.0.2", 1002);
+	auto faster = clients.find(fasterId)->state;
+	auto slower = clients.find(slowerId)->state;
 	ServerMixScheduler scheduler(stereoMixdown(), { 2, 4, 0 });
 
 	for (std::uint64_t counter = 100; counter <= 102; ++counter) {
@@ -113,8 +129,8 @@ TEST(ServerMixSchedulerTest, SustainedFasterStreamStaysBoundedWithoutDrainingThe
 			EXPECT_TRUE(step.underrunClients.empty());
 			EXPECT_TRUE(step.fillInClients.empty());
 			EXPECT_TRUE(step.incoming.empty() || step.incoming.size() == 2U);
-			EXPECT_LE(step.queuesAfter.at("faster").size, 4U);
-			EXPECT_GE(step.queuesAfter.at("slower").size, 2U);
+			EXPECT_LE(step.queuesAfter.at(fasterId).size, 4U);
+			EXPECT_GE(step.queuesAfter.at(slowerId).size, 2U);
 		}
 
 		slower->push(makeSchedulerPacket(slowerCounter++), 0);
@@ -123,12 +139,72 @@ TEST(ServerMixSchedulerTest, SustainedFasterStreamStaysBoundedWithoutDrainingThe
 		EXPECT_TRUE(step.underrunClients.empty());
 		EXPECT_TRUE(step.fillInClients.empty());
 		EXPECT_TRUE(step.incoming.empty() || step.incoming.size() == 2U);
-		EXPECT_LE(step.queuesAfter.at("faster").size, 4U);
-		EXPECT_GE(step.queuesAfter.at("slower").size, 2U);
+		EXPECT_LE(step.queuesAfter.at(fasterId).size, 4U);
+		EXPECT_GE(step.queuesAfter.at(slowerId).size, 2U);
 	}
 
 	EXPECT_GT(fastForwardEvents, 0U);
 	EXPECT_EQ(slower->snapshot().state, ClientConnectionState::Connected);
 }
 
+TEST(ServerMixSchedulerTest, AlignsClientsByCaptureTime)
+{
+	ClientRegistry clients;
+	const auto earlyId = *clients.idFor("10.0.0.1", 1001);
+	const auto lateId = *clients.idFor("10.0.0.2", 1002);
+	auto early = clients.find(earlyId)->state;
+	auto late = clients.find(lateId)->state;
+	ServerMixScheduler scheduler(stereoMixdown(), { 1, 40, 0, 2 });
+	const double blockMilliseconds = 1000.0 * SAMPLE_BUFFER_SIZE / SAMPLE_RATE;
+	const auto start = ClientState::TimePoint(std::chrono::seconds(1000));
+	auto tickTime = [&](const int tick) {
+		return start + std::chrono::duration_cast<ClientState::Clock::duration>(
+			std::chrono::duration<double, std::milli>(tick * blockMilliseconds));
+	};
+
+	// Both capture the same music, but three blocks of the late one's stream are already waiting
+	for (int captureIndex = -3; captureIndex < 0; ++captureIndex) {
+		late->push(makeCapturedPacket(static_cast<std::uint64_t>(captureIndex + 3), captureIndex, blockMilliseconds), 0, tickTime(0));
+	}
+	std::size_t held = 0;
+	std::size_t shifted = 0;
+	std::optional<std::uint64_t> lastEarlyCounter;
+	float earlyValue = 0.0f;
+	float lateValue = 0.0f;
+	for (int tick = 0; tick < 400; ++tick) {
+		early->push(makeCapturedPacket(static_cast<std::uint64_t>(tick), tick, blockMilliseconds), 0, tickTime(tick));
+		late->push(makeCapturedPacket(static_cast<std::uint64_t>(tick + 3), tick, blockMilliseconds), 0, tickTime(tick));
+		const auto step = scheduler.process(clients, tickTime(tick));
+		EXPECT_TRUE(step.underrunClients.empty());
+		for (const auto& [client, correction] : step.alignedClients) {
+			if (client == earlyId && correction == StreamAlignmentCorrection::Held) {
+				++held;
+				// Held back by repeating a block, not by a block of silence
+				EXPECT_NE(step.incoming.at(earlyId)->audioBuffer()->getSample(0, 0), 0.0f);
+			}
+			else if (client == lateId && correction == StreamAlignmentCorrection::Shifted) {
+				++shifted;
+			}
+			else {
+				ADD_FAILURE() << clients.find(client)->name << " was moved the wrong way";
+			}
+		}
+		if (step.incoming.size() == 2U) {
+			// The early client hears no gap while it is held back
+			const auto counter = step.incoming.at(earlyId)->messageCounter();
+			if (lastEarlyCounter) {
+				EXPECT_EQ(counter, *lastEarlyCounter + 1);
+			}
+			lastEarlyCounter = counter;
+			earlyValue = step.incoming.at(earlyId)->audioBuffer()->getSample(0, 0);
+			lateValue = step.incoming.at(lateId)->audioBuffer()->getSample(0, 0);
+		}
+	}
+
+	EXPECT_EQ(held, 1U);
+	EXPECT_EQ(shifted, 2U);
+	EXPECT_GT(earlyValue, 300.0f);
+	EXPECT_FLOAT_EQ(earlyValue, lateValue);
+}
+
 } // namespace
@@ -12,8 +12,8 @@
 #include <iterator>
 #include <utility>
 
-ServerMixerCore::ServerMixerCore(JammerNetzChannelSetup mixdownSetup)
-	: mixdownSetup_(std::move(mixdownSetup))
+ServerMixerCore::ServerMixerCore(JammerNetzChannelSetup mixdownSetup, int sampleBufferSize, int sampleRate)
+	: mixdownSetup_(std::move(mixdownSetup)), sampleBufferSize_(sampleBufferSize), sampleRate_(sampleRate)
 {
 }
 
@@ -25,8 +25,7 @@ ServerMixStepResult ServerMixerCore::mix(const ServerInputPackets& incoming)
 		return result;
 	}
 
-	const auto firstAudio = incoming.begin()->second->audioBuffer();
-	const int bufferLength = firstAudio->getNumSamples();
+	const int bufferLength = sampleBufferSize_;
 	serverTime_ += static_cast<uint64>(bufferLength);
 	result.serverTime = serverTime_;
 	result.outgoing.reserve(incoming.size());
@@ -39,7 +38,7 @@ ServerMixStepResult ServerMixerCore::mix(const ServerInputPackets& incoming)
 		MidiSignal midiSignal = MidiSignal_None;
 
 		for (const auto& client : incoming) {
-			bufferMixdown(*output, *client.second, client.first == receiver.first, result.diagnostics);
+			bufferMixdown(*output, *client.second, sampleRate_, client.first == receiver.first, result.diagnostics);
 			if (client.first != receiver.first) {
 				const auto setup = client.second->channelSetup();
 				std::copy(setup.channels.cbegin(), setup.channels.cend(),
@@ -63,7 +62,7 @@ ServerMixStepResult ServerMixerCore::mix(const ServerInputPackets& incoming)
 			serverTime_,
 			lastBpm_,
 			midiSignal,
-			SAMPLE_RATE,
+			sampleRate_,
 			mixdownSetup_,
 			std::move(output)),
 			std::move(sessionSetup),
@@ -73,8 +72,15 @@ ServerMixStepResult ServerMixerCore::mix(const ServerInputPackets& incoming)
 	return result;
 }
 
+void ServerMixerCore::addToRoomMixdown(AudioBuffer<float>& output, const JammerNetzAudioData& audioData, int sampleRate,
+	std::vector<std::string>& diagnostics)
+{
+	bufferMixdown(output, audioData, sampleRate, false, diagnostics);
+}
+
 void ServerMixerCore::bufferMixdown(AudioBuffer<float>& output,
 	const JammerNetzAudioData& audioData,
+	const int sampleRate,
 	const bool isForSender,
 	std::vector<std::string>& diagnostics)
 {
@@ -88,6 +94,12 @@ void ServerMixerCore::bufferMixdown(AudioBuffer<float>& output,
 			+ std::to_string(output.getNumSamples()));
 		return;
 	}
+	if (audioData.sampleRate() != sampleRate) {
+		diagnostics.emplace_back("Error: A client uses wrong sample rate of "
+			+ std::to_string(audioData.sampleRate()) + " Hz instead of "
+			+ std::to_string(sampleRate) + " Hz");
+		return;
+	}
 
 	const auto channelSetup = audioData.channelSetup();
 	const bool wantsEcho = !channelSetup.isLocalMonitoringDontSendEcho;
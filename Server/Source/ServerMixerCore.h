@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include "BuffersConfig.h"
 #include "SharedServerTypes.h"
 
 #include <map>
@@ -13,7 +14,7 @@
 #include <string>
 #include <vector>
 
-using ServerInputPackets = std::map<std::string, std::shared_ptr<JammerNetzAudioData>>;
+using ServerInputPackets = std::map<ClientId, std::shared_ptr<JammerNetzAudioData>>;
 
 struct ServerMixStepResult {
 	uint64 serverTime { 0 };
@@ -25,17 +26,30 @@ struct ServerMixStepResult {
 // transitions remain owned by MixerThread; this class has no threads or sockets.
 class ServerMixerCore {
 public:
-	explicit ServerMixerCore(JammerNetzChannelSetup mixdownSetup);
+	// Every mix has sampleBufferSize samples at sampleRate. Clients sending another size or rate are left out
+	// of the mix, but still receive it and switch over to the session's size and rate.
+	explicit ServerMixerCore(JammerNetzChannelSetup mixdownSetup, int sampleBufferSize = SAMPLE_BUFFER_SIZE,
+		int sampleRate = SAMPLE_RATE);
+
+	int sampleBufferSize() const noexcept { return sampleBufferSize_; }
+	int sampleRate() const noexcept { return sampleRate_; }
 
 	ServerMixStepResult mix(const ServerInputPackets& incoming);
 
+	// The mix a listener who is not part of the session would hear, used for the room recording.
+	static void addToRoomMixdown(AudioBuffer<float>& output, const JammerNetzAudioData& audioData, int sampleRate,
+		std::vector<std::string>& diagnostics);
+
 private:
 	static void bufferMixdown(AudioBuffer<float>& output,
 		const JammerNetzAudioData& audioData,
+		int sampleRate,
 		bool isForSender,
 		std::vector<std::string>& diagnostics);
 
 	uint64 serverTime_ { 0 };
 	float lastBpm_ { 120.0f };
 	JammerNetzChannelSetup mixdownSetup_;
+	int sampleBufferSize_;
+	int sampleRate_;
 };
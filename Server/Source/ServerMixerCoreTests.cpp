@@ -48,10 +48,13 @@ std::shared_ptr<JammerNetzAudioData> packet(const std::string& channelName,
 		SAMPLE_RATE, bpm, midiSignal, std::move(audio), nullptr);
 }
 
-const OutgoingPackage& outputFor(const ServerMixStepResult& result, const std::string& address)
+constexpr ClientId clientA = 0;
+constexpr ClientId clientB = 1;
+
+const OutgoingPackage& outputFor(const ServerMixStepResult& result, const ClientId target)
 {
 	const auto found = std::find_if(result.outgoing.begin(), result.outgoing.end(),
-		[&address](const OutgoingPackage& output) { return output.targetAddress == address; });
+		[target](const OutgoingPackage& output) { return output.target == target; });
 	EXPECT_NE(found, result.outgoing.end());
 	return found != result.outgoing.end() ? *found : result.outgoing.front();
 }
@@ -92,16 +95,16 @@ TEST(ServerMixerCoreTest, PreservesRoutingVolumeAndReceiverSpecificEcho)
 			SCOPED_TRACE(suppressEcho);
 			ServerMixerCore mixer(stereoOutputSetup());
 			ServerInputPackets inputs;
-			inputs.emplace("client-a", packet("a", target, suppressEcho, 0.8f, 0.25f, 11));
-			inputs.emplace("client-b", packet("b", Mute, true, 0.0f, 1.0f, 22));
+			inputs.emplace(clientA, packet("a", target, suppressEcho, 0.8f, 0.25f, 11));
+			inputs.emplace(clientB, packet("b", Mute, true, 0.0f, 1.0f, 22));
 
 			const auto result = mixer.mix(inputs);
 			ASSERT_EQ(result.outgoing.size(), 2U);
 			EXPECT_TRUE(result.diagnostics.empty());
 			const auto senderExpected = routedValue(target, true, suppressEcho, 0.2f);
 			const auto remoteExpected = routedValue(target, false, suppressEcho, 0.2f);
-			const auto& sender = outputFor(result, "client-a").audioBlock;
-			const auto& remote = outputFor(result, "client-b").audioBlock;
+			const auto& sender = outputFor(result, clientA).audioBlock;
+			const auto& remote = outputFor(result, clientB).audioBlock;
 			EXPECT_FLOAT_EQ(sender.audioBuffer->getSample(0, 0), senderExpected[0]);
 			EXPECT_FLOAT_EQ(sender.audioBuffer->getSample(1, 0), senderExpected[1]);
 			EXPECT_FLOAT_EQ(remote.audioBuffer->getSample(0, 0), remoteExpected[0]);
@@ -114,14 +117,14 @@ TEST(ServerMixerCoreTest, PreservesAddressingSessionMetadataClockAndControlSelec
 {
 	ServerMixerCore mixer(stereoOutputSetup());
 	ServerInputPackets firstInputs;
-	firstInputs.emplace("10.0.0.1:1001", packet("guitar", Left, true, 0.1f, 1.0f, 31, 100.0f, MidiSignal_Start));
-	firstInputs.emplace("10.0.0.2:1002", packet("drums", Right, true, 0.2f, 1.0f, 47, 140.0f, MidiSignal_Stop));
+	firstInputs.emplace(clientA, packet("guitar", Left, true, 0.1f, 1.0f, 31, 100.0f, MidiSignal_Start));
+	firstInputs.emplace(clientB, packet("drums", Right, true, 0.2f, 1.0f, 47, 140.0f, MidiSignal_Stop));
 
 	const auto first = mixer.mix(firstInputs);
 	ASSERT_EQ(first.outgoing.size(), 2U);
 	EXPECT_EQ(first.serverTime, SAMPLE_BUFFER_SIZE);
-	EXPECT_EQ(first.outgoing[0].targetAddress, "10.0.0.1:1001");
-	EXPECT_EQ(first.outgoing[1].targetAddress, "10.0.0.2:1002");
+	EXPECT_EQ(first.outgoing[0].target, clientA);
+	EXPECT_EQ(first.outgoing[1].target, clientB);
 	for (const auto& output : first.outgoing) {
 		EXPECT_EQ(output.audioBlock.serverTime, SAMPLE_BUFFER_SIZE);
 		EXPECT_FLOAT_EQ(output.audioBlock.bpm, 140.0f);
@@ -134,8 +137,8 @@ TEST(ServerMixerCoreTest, PreservesAddressingSessionMetadataClockAndControlSelec
 	EXPECT_EQ(first.outgoing[1].sessionSetup.channels.front().name, "guitar");
 
 	ServerInputPackets secondInputs;
-	secondInputs.emplace("10.0.0.1:1001", packet("guitar", Left, true, 0.1f, 1.0f, 32));
-	secondInputs.emplace("10.0.0.2:1002", packet("drums", Right, true, 0.2f, 1.0f, 48));
+	secondInputs.emplace(clientA, packet("guitar", Left, true, 0.1f, 1.0f, 32));
+	secondInputs.emplace(clientB, packet("drums", Right, true, 0.2f, 1.0f, 48));
 	const auto second = mixer.mix(secondInputs);
 	EXPECT_EQ(second.serverTime, 2 * SAMPLE_BUFFER_SIZE);
 	for (const auto& output : second.outgoing) {
@@ -154,7 +157,7 @@ TEST(ServerMixerCoreTest, IgnoresAudioChannelsWithoutMatchingChannelSetup)
 	JammerNetzChannelSetup setup(false);
 	setup.channels.emplace_back(JammerNetzChannelTarget::Left);
 	ServerInputPackets inputs;
-	inputs.emplace("malformed-client", std::make_shared<JammerNetzAudioData>(
+	inputs.emplace(clientA, std::make_shared<JammerNetzAudioData>(
 		1, 0.0, setup, SAMPLE_RATE, 0.0f, MidiSignal_None, std::move(audio), nullptr));
 
 	const auto result = mixer.mix(inputs);
@@ -167,4 +170,59 @@ TEST(ServerMixerCoreTest, IgnoresAudioChannelsWithoutMatchingChannelSetup)
 	EXPECT_FLOAT_EQ(result.outgoing.front().audioBlock.audioBuffer->getSample(1, 0), 0.0f);
 }
 
+TEST(ServerMixerCoreTest, MixesAtTheSessionBlockSizeAndSkipsOtherSizes)
+{
+	constexpr int blockSize = 64;
+	ServerMixerCore mixer(stereoOutputSetup(), blockSize);
+	EXPECT_EQ(mixer.sampleBufferSize(), blockSize);
+	auto audio = std::make_shared<AudioBuffer<float>>(1, blockSize);
+	juce::FloatVectorOperations::fill(audio->getWritePointer(0), 0.25f, blockSize);
+	JammerNetzChannelSetup setup(false);
+	setup.channels.emplace_back(JammerNetzChannelTarget::Mono);
+	ServerInputPackets inputs;
+	inputs.emplace(clientA, std::make_shared<JammerNetzAudioData>(
+		1, 0.0, setup, SAMPLE_RATE, 0.0f, MidiSignal_None, std::move(audio), nullptr));
+	inputs.emplace(clientB, packet("b", Mono, false, 0.5f, 1.0f, 1));
+
+	const auto result = mixer.mix(inputs);
+
+	EXPECT_EQ(result.serverTime, static_cast<uint64>(blockSize));
+	// Once for every mix it was left out of
+	ASSERT_EQ(result.diagnostics.size(), 2U);
+	EXPECT_NE(result.diagnostics.front().find("wrong buffer size of 128 instead of 64"), std::string::npos);
+	ASSERT_EQ(result.outgoing.size(), 2U);
+	for (const auto& output : result.outgoing) {
+		ASSERT_EQ(output.audioBlock.audioBuffer->getNumSamples(), blockSize);
+	}
+	// The client sending 128 samples still hears the session, but is not part of it
+	EXPECT_FLOAT_EQ(outputFor(result, clientB).audioBlock.audioBuffer->getSample(0, blockSize - 1), 0.25f);
+	EXPECT_FLOAT_EQ(outputFor(result, clientA).audioBlock.audioBuffer->getSample(0, blockSize - 1), 0.25f);
+}
+
+TEST(ServerMixerCoreTest, StampsTheSessionRateAndSkipsClientsAtAnotherRate)
+{
+	constexpr int sessionRate = 96000;
+	ServerMixerCore mixer(stereoOutputSetup(), SAMPLE_BUFFER_SIZE, sessionRate);
+	EXPECT_EQ(mixer.sampleRate(), sessionRate);
+	auto audio = std::make_shared<AudioBuffer<float>>(1, SAMPLE_BUFFER_SIZE);
+	juce::FloatVectorOperations::fill(audio->getWritePointer(0), 0.25f, SAMPLE_BUFFER_SIZE);
+	JammerNetzChannelSetup setup(false);
+	setup.channels.emplace_back(JammerNetzChannelTarget::Mono);
+	ServerInputPackets inputs;
+	inputs.emplace(clientA, std::make_shared<JammerNetzAudioData>(
+		1, 0.0, setup, sessionRate, 0.0f, MidiSignal_None, std::move(audio), nullptr));
+	// Still at the default rate, it hasn't heard from the server yet
+	inputs.emplace(clientB, packet("b", Mono, false, 0.5f, 1.0f, 1));
+
+	const auto result = mixer.mix(inputs);
+
+	ASSERT_EQ(result.diagnostics.size(), 2U);
+	EXPECT_NE(result.diagnostics.front().find("wrong sample rate of 48000 Hz instead of 96000 Hz"), std::string::npos);
+	ASSERT_EQ(result.outgoing.size(), 2U);
+	for (const auto& output : result.outgoing) {
+		EXPECT_EQ(output.audioBlock.sampleRate, sessionRate);
+		EXPECT_FLOAT_EQ(output.audioBlock.audioBuffer->getSample(0, 0), 0.25f);
+	}
+}
+
 } // namespace
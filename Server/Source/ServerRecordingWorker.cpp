@@ -0,0 +1,247 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "ServerRecordingWorker.h"
+
+#include "RecordingLog.h"
+
+#include <algorithm>
+
+namespace {
+
+juce::String fileNameFor(const std::string& clientName)
+{
+	// "ip:port" is not a valid file name on every platform
+	return juce::File::createLegalFileName(juce::String(clientName).replaceCharacter(':', '_'));
+}
+
+} // namespace
+
+ServerRecordingWorker::ServerRecordingWorker(const ClientRegistry& clients, juce::File directory, int sampleRate, RecordingType recordingType, ErrorHandler onError)
+	: juce::Thread("ServerRecordingWriter")
+	, clients_(clients)
+	, directory_(std::move(directory))
+	, sampleRate_(sampleRate)
+	, maximumSilenceFillSamples_(static_cast<uint64>(maximumSilenceFillSeconds) * static_cast<uint64>(std::max(0, sampleRate)))
+	, recordingType_(recordingType)
+	, onError_(std::move(onError))
+	, sessionName_("jam" + juce::Time::getCurrentTime().formatted("-%Y-%m-%d-%H-%M-%S"))
+	, mixdownBuffer_(2, SAMPLE_BUFFER_SIZE)
+	, silence_(maximumChannels, SAMPLE_BUFFER_SIZE)
+{
+	silence_.clear();
+}
+
+ServerRecordingWorker::~ServerRecordingWorker()
+{
+	shutdown();
+}
+
+void ServerRecordingWorker::start()
+{
+	directory_.createDirectory();
+	if (!isThreadRunning()) {
+		startThread();
+	}
+}
+
+void ServerRecordingWorker::shutdown()
+{
+	signalThreadShouldExit();
+	wakeup_.wakeUp();
+	stopThread(5000);
+	closeAllStems();
+	// The mixer thread is stopped before the recorder, so nobody produces anymore
+	queue_.reset();
+}
+
+bool ServerRecordingWorker::enqueue(uint64 serverTime, ServerInputPackets& inputs) noexcept
+{
+	if (inputs.empty()) {
+		return true;
+	}
+	const bool queued = queue_.tryWrite([&](ServerRecordingBlock& block) {
+		block.serverTime = serverTime;
+		// The slot was emptied by the writer, so this move neither allocates nor frees on the mixer thread
+		block.inputs.swap(inputs);
+	});
+	if (!queued) {
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+	}
+	return queued;
+}
+
+juce::File ServerRecordingWorker::directory() const
+{
+	return directory_;
+}
+
+uint64_t ServerRecordingWorker::writtenBlocks() const noexcept
+{
+	return written_.load(std::memory_order_relaxed);
+}
+
+uint64_t ServerRecordingWorker::droppedBlocks() const noexcept
+{
+	return dropped_.load(std::memory_order_relaxed);
+}
+
+int ServerRecordingWorker::openStems() const noexcept
+{
+	return openStems_.load(std::memory_order_relaxed);
+}
+
+void ServerRecordingWorker::run()
+{
+	ServerRecordingBlock block;
+	while (!threadShouldExit() || queue_.size() > 0) {
+		const bool hadBlock = queue_.tryRead([&block](ServerRecordingBlock& slot) {
+			block.serverTime = slot.serverTime;
+			block.inputs.swap(slot.inputs);
+		});
+		if (!hadBlock) {
+			wakeup_.wait([this]() { return threadShouldExit() || queue_.size() > 0; });
+			continue;
+		}
+		writeBlock(block);
+		// Release the packets here and not on the mixer thread
+		block.inputs.clear();
+		written_.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void ServerRecordingWorker::writeBlock(ServerRecordingBlock& block)
+{
+	const int numSamples = block.inputs.begin()->second->audioBuffer()->getNumSamples();
+	if (numSamples <= 0 || static_cast<uint64>(numSamples) > block.serverTime) {
+		return;
+	}
+	const uint64 blockStart = block.serverTime - static_cast<uint64>(numSamples);
+
+	if (mixdownBuffer_.getNumSamples() != numSamples) {
+		mixdownBuffer_.setSize(2, numSamples, false, false, true);
+	}
+	mixdownBuffer_.clear();
+	diagnostics_.clear();
+	const auto guard = clients_.pin();
+	if (clients_.version() != registryVersion_) {
+		closeForgottenStems();
+	}
+	for (const auto& [client, audioData] : block.inputs) {
+		const auto audio = audioData->audioBuffer();
+		if (audio->getNumSamples() != numSamples || audioData->sampleRate() != sampleRate_) {
+			continue;
+		}
+		// A client forgotten while its block was queued still belongs in the mixdown
+		if (const auto registered = clients_.find(client)) {
+			writeToStem(registered->name, stems_[client], blockStart, *audio);
+		}
+		ServerMixerCore::addToRoomMixdown(mixdownBuffer_, *audioData, sampleRate_, diagnostics_);
+	}
+	writeToStem("mixdown", mixdown_, blockStart, mixdownBuffer_);
+}
+
+void ServerRecordingWorker::writeToStem(const std::string& name, Stem& stem, uint64 blockStart, const juce::AudioBuffer<float>& audio)
+{
+	const int channels = audio.getNumChannels();
+	if (channels <= 0) {
+		return;
+	}
+	// A changed channel count, a reconnect after a long pause or a server time
+	// going backwards all need a new file, WAV cannot express them.
+	const bool needsNewFile = !stem.writer || stem.channels != channels || blockStart < stem.nextServerTime
+		|| blockStart - stem.nextServerTime > maximumSilenceFillSamples_;
+	if (needsNewFile && !openStem(name, stem, blockStart, channels)) {
+		return;
+	}
+	// Fill short gaps, e.g. a client that missed a mixer cycle, so the stem stays aligned
+	while (stem.nextServerTime < blockStart) {
+		const int gap = static_cast<int>(std::min<uint64>(blockStart - stem.nextServerTime, static_cast<uint64>(silence_.getNumSamples())));
+		stem.writer->writeFromFloatArrays(silence_.getArrayOfReadPointers(), std::min(channels, silence_.getNumChannels()), gap);
+		stem.nextServerTime += static_cast<uint64>(gap);
+	}
+	stem.writer->writeFromFloatArrays(audio.getArrayOfReadPointers(), channels, audio.getNumSamples());
+	stem.nextServerTime += static_cast<uint64>(audio.getNumSamples());
+}
+
+bool ServerRecordingWorker::openStem(const std::string& name, Stem& stem, uint64 startServerTime, int channels)
+{
+	if (stem.writer) {
+		stem.writer.reset();
+		openStems_.fetch_sub(1, std::memory_order_relaxed);
+	}
+	stem.channels = 0;
+	if (channels > silence_.getNumChannels()) {
+		reportError("Recording: client " + juce::String(name) + " sends more channels than can be recorded");
+		return false;
+	}
+
+	const bool crashSafe = recordingType_ == RecordingType::CrashSafeLog;
+	stem.file = directory_.getNonexistentChildFile(sessionName_ + "-" + fileNameFor(name), crashSafe ? RecordingLog::fileExtension : ".wav", false);
+	auto outStream = std::make_unique<juce::FileOutputStream>(stem.file, writeBufferBytes);
+	if (!outStream->openedOk()) {
+		reportError("Recording: could not create " + stem.file.getFullPathName());
+		return false;
+	}
+	std::unique_ptr<juce::OutputStream> stream = std::move(outStream);
+	if (crashSafe) {
+		stem.writer = RecordingLog::createWriter(stream, sampleRate_, channels, bitsPerSample, static_cast<juce::int64>(startServerTime), "JammerNetz " + juce::String(name));
+	}
+	else {
+		// The time reference places the file at its server time in a DAW
+		const auto metadata = juce::WavAudioFormat::createBWAVMetadata("JammerNetz " + juce::String(name), "JammerNetzServer",
+			sessionName_, juce::Time::getCurrentTime(), static_cast<juce::int64>(startServerTime), {});
+		const auto writerOptions = juce::AudioFormatWriterOptions{}
+			.withSampleRate(sampleRate_)
+			.withNumChannels(channels)
+			.withBitsPerSample(bitsPerSample)
+			.withMetadataValues(metadata);
+		stem.writer = juce::WavAudioFormat().createWriterFor(stream, writerOptions);
+	}
+	if (!stem.writer) {
+		reportError("Recording: could not create writer for " + stem.file.getFullPathName());
+		return false;
+	}
+	stem.channels = channels;
+	stem.nextServerTime = startServerTime;
+	openStems_.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void ServerRecordingWorker::reportError(const juce::String& message) const
+{
+	if (onError_) {
+		onError_(message);
+	}
+	else {
+		juce::Logger::writeToLog(message);
+	}
+}
+
+void ServerRecordingWorker::closeAllStems()
+{
+	// Destroying the writers finalizes the WAV headers or writes the last checkpoint of a log
+	for (auto& [client, stem] : stems_) {
+		stem.writer.reset();
+	}
+	stems_.clear();
+	mixdown_.writer.reset();
+	openStems_.store(0, std::memory_order_relaxed);
+}
+
+void ServerRecordingWorker::closeForgottenStems()
+{
+	registryVersion_ = clients_.version();
+	std::erase_if(stems_, [this](const auto& entry) {
+		if (clients_.find(entry.first)) {
+			return false;
+		}
+		if (entry.second.writer) {
+			openStems_.fetch_sub(1, std::memory_order_relaxed);
+		}
+		return true;
+	});
+}
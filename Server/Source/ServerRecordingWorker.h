@@ -0,0 +1,100 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include "BoundedSpscQueue.h"
+#include "BuffersConfig.h"
+#include "Recorder.h"
+#include "ServerMixerCore.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+// One mixer cycle as handed to the disk writer.
+struct ServerRecordingBlock {
+	uint64 serverTime { 0 }; // Sample position at the end of the block, as in ServerMixStepResult
+	ServerInputPackets inputs;
+};
+
+// Records the raw input of every client plus the room mixdown on its own
+// thread. The mixer thread swaps the map of packets it already holds into a
+// preallocated queue and never waits for the disk. The map nodes themselves are
+// still allocated by the mixer every cycle, the writer thread frees them. Each stem is a WAV file
+// whose BWF time reference is the server time of its first sample, so a DAW
+// lines all stems of a session up sample-accurately. With RecordingType::CrashSafeLog
+// the stems are recording logs instead, which survive a server crash and carry the
+// same time reference into the WAV files made by JammerNetzRecordingTool.
+class ServerRecordingWorker final : private juce::Thread {
+public:
+	// About three seconds of mixer cycles
+	static constexpr int queueCapacity = 1024;
+	// Gaps in a client's stream are filled with silence up to this length, longer gaps start a new file
+	static constexpr int maximumSilenceFillSeconds = 10;
+	static constexpr int maximumChannels = 64;
+	static constexpr int bitsPerSample = 24;
+	static constexpr int writeBufferBytes = 1 << 20;
+
+	// Called on the writer thread when a stem can't be written
+	using ErrorHandler = std::function<void(const juce::String&)>;
+
+	// Supports RecordingType::WAV and RecordingType::CrashSafeLog. The stems are named after the clients in the registry.
+	// Without an error handler, errors go to the JUCE logger.
+	ServerRecordingWorker(const ClientRegistry& clients, juce::File directory, int sampleRate, RecordingType recordingType = RecordingType::WAV,
+		ErrorHandler onError = {});
+	~ServerRecordingWorker() override;
+
+	void start();
+	void shutdown();
+
+	// Mixer thread. Takes the packets if there is room, otherwise counts a dropped block.
+	bool enqueue(uint64 serverTime, ServerInputPackets& inputs) noexcept;
+
+	juce::File directory() const;
+	uint64_t writtenBlocks() const noexcept;
+	uint64_t droppedBlocks() const noexcept;
+	int openStems() const noexcept;
+
+private:
+	struct Stem {
+		std::unique_ptr<juce::AudioFormatWriter> writer;
+		juce::File file;
+		int channels { 0 };
+		uint64 nextServerTime { 0 }; // Server time the next written sample belongs to
+	};
+
+	void run() override;
+	void writeBlock(ServerRecordingBlock& block);
+	void writeToStem(const std::string& name, Stem& stem, uint64 blockStart, const juce::AudioBuffer<float>& audio);
+	bool openStem(const std::string& name, Stem& stem, uint64 startServerTime, int channels);
+	void reportError(const juce::String& message) const;
+	void closeAllStems();
+	void closeForgottenStems();
+
+	const ClientRegistry& clients_;
+	juce::File directory_;
+	int sampleRate_;
+	uint64 maximumSilenceFillSamples_;
+	RecordingType recordingType_;
+	ErrorHandler onError_;
+	juce::String sessionName_;
+	QueueWakeup wakeup_; // Before queue_, which notifies it
+	BoundedSpscQueue<ServerRecordingBlock> queue_ { queueCapacity, &wakeup_ };
+	std::map<ClientId, Stem> stems_;
+	uint64_t registryVersion_ { 0 };
+	Stem mixdown_;
+	juce::AudioBuffer<float> mixdownBuffer_;
+	juce::AudioBuffer<float> silence_;
+	std::vector<std::string> diagnostics_;
+	std::atomic<uint64_t> written_ { 0 };
+	std::atomic<uint64_t> dropped_ { 0 };
+	std::atomic<int> openStems_ { 0 };
+};
@@ -0,0 +1,109 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "ServerRecordingWorker.h"
+
+#include "BuffersConfig.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+namespace {
+
+std::shared_ptr<JammerNetzAudioData> monoPacket(const JammerNetzChannelTarget target, const float value, const uint64 counter)
+{
+	auto audio = std::make_shared<AudioBuffer<float>>(1, SAMPLE_BUFFER_SIZE);
+	for (int sample = 0; sample < SAMPLE_BUFFER_SIZE; ++sample) {
+		audio->setSample(0, sample, value);
+	}
+	JammerNetzChannelSetup setup(false);
+	setup.channels.push_back(JammerNetzSingleChannelSetup(static_cast<uint8>(target)));
+	return std::make_shared<JammerNetzAudioData>(counter, static_cast<double>(counter), setup,
+		SAMPLE_RATE, 0.0f, MidiSignal_None, std::move(audio), nullptr);
+}
+
+std::unique_ptr<AudioFormatReader> readerFor(const File& directory, const String& pattern)
+{
+	const auto files = directory.findChildFiles(File::findFiles, false, pattern);
+	EXPECT_EQ(files.size(), 1) << pattern;
+	if (files.isEmpty()) {
+		return nullptr;
+	}
+	return std::unique_ptr<AudioFormatReader>(WavAudioFormat().createReaderFor(files[0].createInputStream().release(), true));
+}
+
+} // namespace
+
+TEST(ServerRecordingWorkerTest, WritesAlignedStemsAndRoomMixdown)
+{
+	TemporaryFile temporary;
+	const File directory = temporary.getFile();
+	ClientRegistry clients;
+	const auto first = *clients.idFor("10.0.0.1", 8888);
+	const auto second = *clients.idFor("10.0.0.2", 8888);
+	{
+		ServerRecordingWorker recorder(clients, directory, SAMPLE_RATE);
+		recorder.start();
+		uint64 serverTime = 10 * SAMPLE_BUFFER_SIZE;
+		for (uint64 block = 0; block < 8; ++block) {
+			serverTime += SAMPLE_BUFFER_SIZE;
+			ServerInputPackets inputs;
+			inputs.emplace(first, monoPacket(JammerNetzChannelTarget::Left, 0.25f, block));
+			// The second client joins late and misses block 5
+			if (block >= 2 && block != 5) {
+				inputs.emplace(second, monoPacket(JammerNetzChannelTarget::Right, 0.5f, block));
+			}
+			ASSERT_TRUE(recorder.enqueue(serverTime, inputs));
+			EXPECT_TRUE(inputs.empty());
+		}
+		recorder.shutdown();
+		EXPECT_EQ(recorder.writtenBlocks(), 8u);
+		EXPECT_EQ(recorder.droppedBlocks(), 0u);
+	}
+
+	const auto firstStem = readerFor(directory, "*10.0.0.1_8888*.wav");
+	const auto secondStem = readerFor(directory, "*10.0.0.2_8888*.wav");
+	const auto mixdown = readerFor(directory, "*mixdown*.wav");
+	ASSERT_TRUE(firstStem && secondStem && mixdown);
+
+	EXPECT_EQ(firstStem->lengthInSamples, 8 * SAMPLE_BUFFER_SIZE);
+	EXPECT_EQ(firstStem->metadataValues[WavAudioFormat::bwavTimeReference], String(10 * SAMPLE_BUFFER_SIZE));
+	// The late client starts two blocks later, the missed block is silence so the stem stays aligned
+	EXPECT_EQ(secondStem->lengthInSamples, 6 * SAMPLE_BUFFER_SIZE);
+	EXPECT_EQ(secondStem->metadataValues[WavAudioFormat::bwavTimeReference], String(12 * SAMPLE_BUFFER_SIZE));
+	AudioBuffer<float> secondAudio(1, 6 * SAMPLE_BUFFER_SIZE);
+	secondStem->read(&secondAudio, 0, secondAudio.getNumSamples(), 0, true, false);
+	EXPECT_NEAR(secondAudio.getSample(0, 2 * SAMPLE_BUFFER_SIZE), 0.5f, 1.0e-4f);
+	EXPECT_NEAR(secondAudio.getSample(0, 3 * SAMPLE_BUFFER_SIZE), 0.0f, 1.0e-4f);
+
+	ASSERT_EQ(mixdown->numChannels, 2u);
+	AudioBuffer<float> mixdownAudio(2, 8 * SAMPLE_BUFFER_SIZE);
+	mixdown->read(&mixdownAudio, 0, mixdownAudio.getNumSamples(), 0, true, true);
+	EXPECT_NEAR(mixdownAudio.getSample(0, 0), 0.25f, 1.0e-4f);
+	EXPECT_NEAR(mixdownAudio.getSample(1, 0), 0.0f, 1.0e-4f);
+	EXPECT_NEAR(mixdownAudio.getSample(1, 2 * SAMPLE_BUFFER_SIZE), 0.5f, 1.0e-4f);
+	directory.deleteRecursively();
+}
+
+TEST(ServerRecordingWorkerTest, CountsDroppedBlocksWhenTheQueueIsFull)
+{
+	TemporaryFile temporary;
+	ClientRegistry clients;
+	const auto client = *clients.idFor("10.0.0.1", 8888);
+	ServerRecordingWorker recorder(clients, temporary.getFile(), SAMPLE_RATE);
+	// Not started, so nothing drains the queue
+	uint64 serverTime = 0;
+	for (int block = 0; block < ServerRecordingWorker::queueCapacity + 3; ++block) {
+		serverTime += SAMPLE_BUFFER_SIZE;
+		ServerInputPackets inputs;
+		inputs.emplace(client, monoPacket(JammerNetzChannelTarget::Left, 0.25f, static_cast<uint64>(block)));
+		recorder.enqueue(serverTime, inputs);
+	}
+	EXPECT_EQ(recorder.droppedBlocks(), 3u);
+	temporary.getFile().deleteRecursively();
+}
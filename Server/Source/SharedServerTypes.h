@@ -9,7 +9,7 @@
 #include "JuceHeader.h"
 
 #include "JammerNetzPackage.h"
-#include "ClientState.h"
+#include "ClientRegistry.h"
 
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -18,7 +18,6 @@
 #pragma GCC diagnostic ignored "-Wfloat-equal"
 #endif
 #include "tbb/concurrent_queue.h"
-#include "tbb/concurrent_unordered_map.h"
 #ifdef __GNUC__
 #pragma GCC diagnostic pop
 #endif
@@ -27,13 +26,13 @@
 
 class OutgoingPackage {
 public:
-	OutgoingPackage() : targetAddress(""), audioBlock(), sessionSetup(false), receiverProtocolVersion(JammerNetzProtocol::Current) {}
+	OutgoingPackage() : target(0), audioBlock(), sessionSetup(false), receiverProtocolVersion(JammerNetzProtocol::Current) {}
 
-	OutgoingPackage(std::string const &targetAddress_, AudioBlock const &audioBlock_, JammerNetzChannelSetup sessionSetup_, uint16 receiverProtocolVersion_) :
-		targetAddress(targetAddress_), audioBlock(audioBlock_), sessionSetup(sessionSetup_), receiverProtocolVersion(receiverProtocolVersion_) {
+	OutgoingPackage(ClientId target_, AudioBlock const &audioBlock_, JammerNetzChannelSetup sessionSetup_, uint16 receiverProtocolVersion_) :
+		target(target_), audioBlock(audioBlock_), sessionSetup(sessionSetup_), receiverProtocolVersion(receiverProtocolVersion_) {
 	}
 
-	std::string targetAddress;
+	ClientId target;
 	AudioBlock audioBlock;
     JammerNetzChannelSetup sessionSetup;
 	uint16 receiverProtocolVersion;
@@ -43,7 +42,6 @@ public:
 #pragma warning( push )
 #pragma warning( disable : 4996 ) // Disable deprecated warning for now, as it is inside TBB
 #endif
-typedef tbb::concurrent_unordered_map<std::string, std::shared_ptr<ClientState>> TPacketStreamBundle;
 typedef tbb::concurrent_bounded_queue < OutgoingPackage > TOutgoingQueue;
 typedef tbb::concurrent_bounded_queue<int> TMessageQueue;
 #if WIN32
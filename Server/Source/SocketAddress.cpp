@@ -0,0 +1,121 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "SocketAddress.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if !JUCE_WINDOWS
+#include <arpa/inet.h>
+#endif
+
+std::optional<SocketAddress> SocketAddress::fromString(const juce::String& address, int port)
+{
+	SocketAddress result;
+	auto& ipv4 = reinterpret_cast<sockaddr_in&>(result.storage_);
+	if (inet_pton(AF_INET, address.toRawUTF8(), &ipv4.sin_addr) == 1) {
+		ipv4.sin_family = AF_INET;
+		ipv4.sin_port = htons(static_cast<uint16_t>(port));
+		result.length_ = sizeof(sockaddr_in);
+		return result;
+	}
+	result.storage_ = {};
+	auto& ipv6 = reinterpret_cast<sockaddr_in6&>(result.storage_);
+	if (inet_pton(AF_INET6, address.toRawUTF8(), &ipv6.sin6_addr) == 1) {
+		ipv6.sin6_family = AF_INET6;
+		ipv6.sin6_port = htons(static_cast<uint16_t>(port));
+		result.length_ = sizeof(sockaddr_in6);
+		return result;
+	}
+	return std::nullopt;
+}
+
+std::optional<SocketAddress> SocketAddress::fromName(const void* name, std::size_t length)
+{
+	SocketAddress result;
+	std::memcpy(&result.storage_, name, std::min(length, sizeof(result.storage_)));
+	if (result.storage_.ss_family == AF_INET && length >= sizeof(sockaddr_in)) {
+		result.length_ = sizeof(sockaddr_in);
+		return result;
+	}
+	if (result.storage_.ss_family == AF_INET6 && length >= sizeof(sockaddr_in6)) {
+		result.length_ = sizeof(sockaddr_in6);
+		return result;
+	}
+	return std::nullopt;
+}
+
+int SocketAddress::port() const noexcept
+{
+	if (storage_.ss_family == AF_INET6) {
+		return ntohs(reinterpret_cast<const sockaddr_in6&>(storage_).sin6_port);
+	}
+	return ntohs(reinterpret_cast<const sockaddr_in&>(storage_).sin_port);
+}
+
+juce::String SocketAddress::host() const
+{
+	char text[INET6_ADDRSTRLEN] = {};
+	if (storage_.ss_family == AF_INET) {
+		inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in&>(storage_).sin_addr, text, sizeof(text));
+	}
+	else if (storage_.ss_family == AF_INET6) {
+		inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6&>(storage_).sin6_addr, text, sizeof(text));
+	}
+	return juce::String(text);
+}
+
+int SocketAddress::sendFrom(juce::DatagramSocket& socket, const void* data, int size) const noexcept
+{
+	if (!isValid() || size < 0) {
+		return -1;
+	}
+#if JUCE_WINDOWS
+	return ::sendto(static_cast<SOCKET>(socket.getRawSocketHandle()), static_cast<const char*>(data), size, 0, name(), length_);
+#else
+	return static_cast<int>(::sendto(socket.getRawSocketHandle(), data, static_cast<size_t>(size), 0, name(), length_));
+#endif
+}
+
+bool SocketAddress::operator==(const SocketAddress& other) const noexcept
+{
+	if (storage_.ss_family != other.storage_.ss_family || port() != other.port()) {
+		return false;
+	}
+	if (storage_.ss_family == AF_INET) {
+		const auto& a = reinterpret_cast<const sockaddr_in&>(storage_).sin_addr;
+		const auto& b = reinterpret_cast<const sockaddr_in&>(other.storage_).sin_addr;
+		return std::memcmp(&a, &b, sizeof(a)) == 0;
+	}
+	if (storage_.ss_family == AF_INET6) {
+		const auto& a = reinterpret_cast<const sockaddr_in6&>(storage_).sin6_addr;
+		const auto& b = reinterpret_cast<const sockaddr_in6&>(other.storage_).sin6_addr;
+		return std::memcmp(&a, &b, sizeof(a)) == 0;
+	}
+	return false;
+}
+
+std::size_t SocketAddress::hash() const noexcept
+{
+	// FNV-1a over the address bytes and the port
+	const unsigned char* bytes = nullptr;
+	std::size_t size = 0;
+	if (storage_.ss_family == AF_INET) {
+		bytes = reinterpret_cast<const unsigned char*>(&reinterpret_cast<const sockaddr_in&>(storage_).sin_addr);
+		size = sizeof(in_addr);
+	}
+	else if (storage_.ss_family == AF_INET6) {
+		bytes = reinterpret_cast<const unsigned char*>(&reinterpret_cast<const sockaddr_in6&>(storage_).sin6_addr);
+		size = sizeof(in6_addr);
+	}
+	std::uint64_t hash = 14695981039346656037ull;
+	for (std::size_t i = 0; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	hash = (hash ^ static_cast<std::uint64_t>(port())) * 1099511628211ull;
+	return static_cast<std::size_t>(hash);
+}
@@ -0,0 +1,53 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#if JUCE_WINDOWS
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#include <cstddef>
+#include <optional>
+
+// A numeric IPv4 or IPv6 address and port in the form the socket calls take. The registry resolves it once
+// per client, so sending a packet needs no lookup and receiving one no string.
+class SocketAddress {
+public:
+	SocketAddress() = default;
+
+	// Empty unless address is a numeric IPv4 or IPv6 address, as sockets report their peers
+	static std::optional<SocketAddress> fromString(const juce::String& address, int port);
+	// From the name a receive call filled in, empty for other address families
+	static std::optional<SocketAddress> fromName(const void* name, std::size_t length);
+
+	bool isValid() const noexcept { return length_ > 0; }
+	const sockaddr* name() const noexcept { return reinterpret_cast<const sockaddr*>(&storage_); }
+	socklen_t length() const noexcept { return length_; }
+	int port() const noexcept;
+	// Allocates, for registering a client and for logs
+	juce::String host() const;
+
+	// Sends one datagram without the lookup of juce::DatagramSocket::write(). Returns the bytes sent or -1.
+	int sendFrom(juce::DatagramSocket& socket, const void* data, int size) const noexcept;
+
+	// Family, address and port only, the rest of the name is not part of the endpoint
+	bool operator==(const SocketAddress& other) const noexcept;
+	std::size_t hash() const noexcept;
+
+private:
+	sockaddr_storage storage_ {};
+	socklen_t length_ { 0 };
+};
@@ -0,0 +1,76 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "StreamAligner.h"
+
+#include <utility>
+
+StreamAligner::StreamAligner(double blockMilliseconds) : blockMilliseconds_(blockMilliseconds)
+{
+}
+
+StreamAlignmentCorrection StreamAligner::observe(double captureAgeMs, double targetMs, bool mayDropQueued) noexcept
+{
+	// What is mixed now is older by the blocks held back
+	const double ageMs = captureAgeMs + static_cast<double>(held_.size()) * blockMilliseconds_;
+	smoothedAgeMs_ = smoothedAgeMs_ ? *smoothedAgeMs_ + smoothing * (ageMs - *smoothedAgeMs_) : ageMs;
+	if (++mixesSinceCorrection_ < settleMixes) {
+		return StreamAlignmentCorrection::None;
+	}
+
+	const double error = *smoothedAgeMs_ - targetMs;
+	const double tolerance = toleranceBlocks * blockMilliseconds_;
+	if (error > tolerance && (!held_.empty() || mayDropQueued)) {
+		*smoothedAgeMs_ -= blockMilliseconds_;
+		mixesSinceCorrection_ = 0;
+		return StreamAlignmentCorrection::Shifted;
+	}
+	if (error < -tolerance && held_.size() < maximumHeldBlocks) {
+		*smoothedAgeMs_ += blockMilliseconds_;
+		mixesSinceCorrection_ = 0;
+		return StreamAlignmentCorrection::Held;
+	}
+	return StreamAlignmentCorrection::None;
+}
+
+std::shared_ptr<JammerNetzAudioData> StreamAligner::delay(std::shared_ptr<JammerNetzAudioData> popped, StreamAlignmentCorrection correction)
+{
+	if (!popped) {
+		return popped;
+	}
+	switch (correction) {
+	case StreamAlignmentCorrection::Held:
+		// Played now and again with the next packet's counter, like the queue repeats a block to fill a gap.
+		// A block of silence would be a hole in the music.
+		held_.push_back(popped);
+		return popped;
+	case StreamAlignmentCorrection::Shifted:
+		if (!held_.empty()) {
+			held_.pop_front();
+		}
+		break;
+	case StreamAlignmentCorrection::None:
+		break;
+	}
+	if (held_.empty()) {
+		return popped;
+	}
+	auto earlier = std::move(held_.front());
+	held_.pop_front();
+	auto restamped = popped->withAudioFrom(*earlier);
+	held_.push_back(std::move(popped));
+	return restamped;
+}
+
+std::size_t StreamAligner::heldBlocks() const noexcept
+{
+	return held_.size();
+}
+
+double StreamAligner::blockMilliseconds() const noexcept
+{
+	return blockMilliseconds_;
+}
@@ -0,0 +1,54 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JammerNetzPackage.h"
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <optional>
+
+enum class StreamAlignmentCorrection {
+	None,
+	// The stream was early against the room, it plays one block twice and is delayed by a block from now on
+	Held,
+	// The stream was late, one block of it is skipped
+	Shifted
+};
+
+// Moves one client's stream so its packets are mixed a steady time after they were captured, the same for
+// everybody in the room. The capture time is the packet's timestamp mapped onto our clock by the client's
+// capture offset. Holding delays the stream in a short line of blocks, restamped with the counters of the
+// packets popped meanwhile, so the client never sees a gap for it.
+class StreamAligner {
+public:
+	static constexpr std::size_t maximumHeldBlocks = 16;
+
+	explicit StreamAligner(double blockMilliseconds);
+
+	// Observes the age of the packet popped for this mix and decides whether the stream has to move.
+	// Shifting from an empty delay line drops a queued packet, which the caller does when allowed.
+	StreamAlignmentCorrection observe(double captureAgeMs, double targetMs, bool mayDropQueued) noexcept;
+	// Returns what to mix for the popped packet, after the correction observe() asked for
+	std::shared_ptr<JammerNetzAudioData> delay(std::shared_ptr<JammerNetzAudioData> popped, StreamAlignmentCorrection correction);
+
+	std::size_t heldBlocks() const noexcept;
+	double blockMilliseconds() const noexcept;
+
+private:
+	// Mixes to average the age over before correcting, and to settle after a correction
+	static constexpr int settleMixes = 64;
+	static constexpr double smoothing = 1.0 / 16.0;
+	// Hysteresis, a correction must bring the stream closer to the target
+	static constexpr double toleranceBlocks = 0.75;
+
+	double blockMilliseconds_;
+	std::optional<double> smoothedAgeMs_;
+	int mixesSinceCorrection_ { 0 };
+	std::deque<std::shared_ptr<JammerNetzAudioData>> held_;
+};
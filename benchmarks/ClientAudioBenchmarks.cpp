@@ -0,0 +1,107 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "RingBuffer.h"
+#include "SampleRateConverter.h"
+#include "Tuner.h"
+
+#include "BuffersConfig.h"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+void BM_TunerDetectPitch(benchmark::State& state)
+{
+	const auto channels = static_cast<size_t>(state.range(0));
+	// A 220 Hz tone, precomputed for as many blocks as it takes to repeat, so cycling through them keeps the
+	// phase continuous and the detector sees a real periodic signal without generating it in the timed loop
+	constexpr int frequency = 220;
+	const auto ringSamples = static_cast<size_t>(std::lcm(SAMPLE_RATE / std::gcd(SAMPLE_RATE, frequency), SAMPLE_BUFFER_SIZE));
+	constexpr auto blockSize = static_cast<size_t>(SAMPLE_BUFFER_SIZE);
+	const auto blocks = ringSamples / blockSize;
+	std::vector<float> tone(ringSamples);
+	for (size_t sample = 0; sample < ringSamples; ++sample) {
+		tone[sample] = static_cast<float>(0.5 * std::sin(2.0 * 3.14159265358979323846 * frequency * static_cast<double>(sample) / SAMPLE_RATE));
+	}
+	std::vector<std::vector<const float*>> ring(blocks, std::vector<const float*>(channels));
+	for (size_t block = 0; block < blocks; ++block) {
+		for (auto& channel : ring[block]) {
+			channel = tone.data() + block * blockSize;
+		}
+	}
+	Tuner tuner;
+	size_t block = 0;
+	for (auto _ : state) {
+		tuner.detectPitch(ring[block].data(), static_cast<int>(channels), SAMPLE_BUFFER_SIZE, SAMPLE_RATE);
+		block = (block + 1) % blocks;
+	}
+	benchmark::DoNotOptimize(tuner.getPitch(0));
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(channels) * SAMPLE_BUFFER_SIZE);
+}
+BENCHMARK(BM_TunerDetectPitch)->Arg(1)->Arg(2)->Arg(8)->Arg(16);
+
+// Writes and reads back one callback block, the pattern of the ingest and playout rings.
+void BM_RingBufferWriteRead(benchmark::State& state)
+{
+	const auto channels = static_cast<int>(state.range(0));
+	const auto blockSize = static_cast<int>(state.range(1));
+	RingBuffer ring(channels, INGEST_RINGBUFFER_SIZE);
+	std::vector<std::vector<float>> source(static_cast<size_t>(channels), std::vector<float>(static_cast<size_t>(blockSize), 0.25f));
+	std::vector<std::vector<float>> destination(static_cast<size_t>(channels), std::vector<float>(static_cast<size_t>(blockSize)));
+	std::vector<float*> sourcePointers;
+	std::vector<float*> destinationPointers;
+	for (int channel = 0; channel < channels; ++channel) {
+		sourcePointers.push_back(source[static_cast<size_t>(channel)].data());
+		destinationPointers.push_back(destination[static_cast<size_t>(channel)].data());
+	}
+	for (auto _ : state) {
+		ring.write(sourcePointers.data(), channels, blockSize);
+		ring.read(destinationPointers.data(), channels, blockSize);
+		benchmark::DoNotOptimize(destinationPointers[0][0]);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * channels * blockSize
+		* static_cast<int64_t>(sizeof(float)) * 2);
+}
+BENCHMARK(BM_RingBufferWriteRead)
+	->ArgNames({ "channels", "samples" })
+	->ArgsProduct({ { 2, 16 }, { 64, SAMPLE_BUFFER_SIZE, 512 } });
+
+// One callback block from the device rate to the session rate, as the engine converts the input
+void BM_SampleRateConverter(benchmark::State& state)
+{
+	const auto channels = static_cast<int>(state.range(0));
+	const auto deviceRate = static_cast<int>(state.range(1));
+	constexpr int blockSize = SAMPLE_BUFFER_SIZE;
+	SampleRateConverter converter;
+	converter.prepare(channels, blockSize);
+	converter.setRates(deviceRate, SAMPLE_RATE);
+	const auto outputSamples = static_cast<size_t>(SampleRateConverter::maximumOutputSamples(blockSize));
+	std::vector<std::vector<float>> source(static_cast<size_t>(channels), std::vector<float>(static_cast<size_t>(blockSize), 0.25f));
+	std::vector<std::vector<float>> destination(static_cast<size_t>(channels), std::vector<float>(outputSamples));
+	std::vector<const float*> sourcePointers;
+	std::vector<float*> destinationPointers;
+	for (int channel = 0; channel < channels; ++channel) {
+		sourcePointers.push_back(source[static_cast<size_t>(channel)].data());
+		destinationPointers.push_back(destination[static_cast<size_t>(channel)].data());
+	}
+	for (auto _ : state) {
+		const int written = converter.process(sourcePointers.data(), channels, blockSize, destinationPointers.data(), static_cast<int>(outputSamples));
+		benchmark::DoNotOptimize(written);
+		benchmark::DoNotOptimize(destinationPointers[0][0]);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * channels * blockSize);
+}
+BENCHMARK(BM_SampleRateConverter)
+	->ArgNames({ "channels", "deviceRate" })
+	->ArgsProduct({ { 1, 2, 8 }, { 44100, 96000 } });
+
+} // namespace
@@ -0,0 +1,168 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "JammerNetzPackage.h"
+#include "JammerNetzMessageView.h"
+#include "PacketStreamQueue.h"
+
+#include "BuffersConfig.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::shared_ptr<JammerNetzAudioData> makePacket(uint64 counter, int channels, int samples = SAMPLE_BUFFER_SIZE)
+{
+	auto audio = std::make_shared<AudioBuffer<float>>(channels, samples);
+	for (int channel = 0; channel < channels; ++channel) {
+		for (int sample = 0; sample < samples; ++sample) {
+			audio->setSample(channel, sample, std::sin(static_cast<float>(sample + channel) * 0.05f) * 0.5f);
+		}
+	}
+	JammerNetzChannelSetup setup(false);
+	for (int channel = 0; channel < channels; ++channel) {
+		JammerNetzSingleChannelSetup single(JammerNetzChannelTarget::Mono);
+		single.name = "Channel " + std::to_string(channel);
+		setup.channels.push_back(single);
+	}
+	return std::make_shared<JammerNetzAudioData>(counter, static_cast<double>(counter), setup,
+		SAMPLE_RATE, 120.0f, MidiSignal_None, std::move(audio), nullptr);
+}
+
+void BM_AudioDataSerialize(benchmark::State& state)
+{
+	const auto packet = makePacket(1, static_cast<int>(state.range(0)));
+	std::vector<uint8> buffer(MAXFRAMESIZE);
+	size_t bytes = 0;
+	for (auto _ : state) {
+		packet->serialize(buffer.data(), bytes);
+		benchmark::DoNotOptimize(buffer.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(bytes));
+	state.counters["packet_bytes"] = static_cast<double>(bytes);
+}
+BENCHMARK(BM_AudioDataSerialize)->Arg(1)->Arg(2)->Arg(8)->Arg(16);
+
+// What one client puts on the wire per second at each session block size, smaller blocks pay more header overhead
+void BM_AudioDataBlockSize(benchmark::State& state)
+{
+	const auto samples = static_cast<int>(state.range(0));
+	const auto packet = makePacket(1, 2, samples);
+	std::vector<uint8> buffer(MAXFRAMESIZE);
+	size_t bytes = 0;
+	for (auto _ : state) {
+		packet->serialize(buffer.data(), bytes);
+		benchmark::DoNotOptimize(buffer.data());
+		benchmark::ClobberMemory();
+	}
+	const double packetsPerSecond = static_cast<double>(SAMPLE_RATE) / static_cast<double>(samples);
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * samples);
+	state.counters["packet_bytes"] = static_cast<double>(bytes);
+	state.counters["packets_per_second"] = packetsPerSecond;
+	state.counters["wire_bytes_per_second"] = packetsPerSecond * static_cast<double>(bytes);
+}
+BENCHMARK(BM_AudioDataBlockSize)->RangeMultiplier(2)->Range(MINIMUM_SAMPLE_BUFFER_SIZE, MAXIMUM_SAMPLE_BUFFER_SIZE);
+
+void BM_AudioDataDeserialize(benchmark::State& state)
+{
+	const auto packet = makePacket(1, static_cast<int>(state.range(0)));
+	std::vector<uint8> buffer(MAXFRAMESIZE);
+	size_t bytes = 0;
+	packet->serialize(buffer.data(), bytes);
+	for (auto _ : state) {
+		auto message = JammerNetzMessage::deserialize(buffer.data(), bytes);
+		benchmark::DoNotOptimize(message);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_AudioDataDeserialize)->Arg(1)->Arg(2)->Arg(8)->Arg(16);
+
+// What the receive threads pay before they decide to keep a packet: verification, no copy of the samples
+void BM_AudioDataDecode(benchmark::State& state)
+{
+	const auto packet = makePacket(1, static_cast<int>(state.range(0)));
+	std::vector<uint8> buffer(MAXFRAMESIZE);
+	size_t bytes = 0;
+	packet->serialize(buffer.data(), bytes);
+	for (auto _ : state) {
+		auto message = decodeJammerNetzMessage(buffer.data(), bytes);
+		benchmark::DoNotOptimize(message);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_AudioDataDecode)->Arg(1)->Arg(2)->Arg(8)->Arg(16);
+
+// Pushes a window of packets in shuffled order, then drains it. range(0) is the
+// reorder window: 1 means in order, larger values mean a wider reorder span.
+void BM_PacketStreamQueueReorder(benchmark::State& state)
+{
+	const auto window = static_cast<size_t>(state.range(0));
+	constexpr size_t packetsPerIteration = 64;
+	std::vector<std::shared_ptr<JammerNetzAudioData>> packets;
+	for (uint64 counter = 0; counter < 1024 * packetsPerIteration; ++counter) {
+		packets.push_back(makePacket(counter, 2));
+	}
+	std::mt19937 random(42);
+	for (size_t start = 0; start + window <= packets.size(); start += window) {
+		std::shuffle(packets.begin() + static_cast<std::ptrdiff_t>(start),
+			packets.begin() + static_cast<std::ptrdiff_t>(start + window), random);
+	}
+
+	PacketStreamQueue queue("benchmark");
+	size_t next = 0;
+	std::shared_ptr<JammerNetzAudioData> popped;
+	bool isFillIn = false;
+	for (auto _ : state) {
+		if (next + packetsPerIteration > packets.size()) {
+			state.PauseTiming();
+			queue.reset();
+			next = 0;
+			state.ResumeTiming();
+		}
+		for (size_t i = 0; i < packetsPerIteration; ++i) {
+			queue.push(packets[next++]);
+		}
+		while (queue.size() > window) {
+			queue.try_pop(popped, isFillIn);
+		}
+		benchmark::DoNotOptimize(popped);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(packetsPerIteration));
+}
+BENCHMARK(BM_PacketStreamQueueReorder)->Arg(1)->Arg(4)->Arg(16);
+
+void BM_BlowFishEncryptDecrypt(benchmark::State& state)
+{
+	std::array<uint8, 72> key {};
+	for (size_t i = 0; i < key.size(); ++i) {
+		key[i] = static_cast<uint8>(i * 7 + 3);
+	}
+	BlowFish blowFish(key.data(), static_cast<int>(key.size()));
+
+	const auto packet = makePacket(1, static_cast<int>(state.range(0)));
+	std::vector<uint8> plain(MAXFRAMESIZE);
+	size_t bytes = 0;
+	packet->serialize(plain.data(), bytes);
+	std::vector<uint8> buffer(MAXFRAMESIZE);
+	for (auto _ : state) {
+		std::copy(plain.begin(), plain.begin() + static_cast<std::ptrdiff_t>(bytes), buffer.begin());
+		const int encrypted = blowFish.encrypt(buffer.data(), bytes, MAXFRAMESIZE);
+		const int decrypted = blowFish.decrypt(buffer.data(), static_cast<size_t>(encrypted));
+		benchmark::DoNotOptimize(decrypted);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_BlowFishEncryptDecrypt)->Arg(2)->Arg(16);
+
+} // namespace
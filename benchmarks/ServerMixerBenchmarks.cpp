@@ -0,0 +1,66 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "ServerMixerCore.h"
+
+#include "BuffersConfig.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+
+namespace {
+
+std::shared_ptr<JammerNetzAudioData> clientPacket(int client, int channels, uint64 counter)
+{
+	auto audio = std::make_shared<AudioBuffer<float>>(channels, SAMPLE_BUFFER_SIZE);
+	for (int channel = 0; channel < channels; ++channel) {
+		for (int sample = 0; sample < SAMPLE_BUFFER_SIZE; ++sample) {
+			audio->setSample(channel, sample, 0.01f * static_cast<float>(client + channel + 1));
+		}
+	}
+	JammerNetzChannelSetup setup(false);
+	for (int channel = 0; channel < channels; ++channel) {
+		// Spread the inputs over the routing targets the mixer treats differently
+		const auto target = static_cast<uint8>(channel % 3 == 0 ? JammerNetzChannelTarget::Mono
+			: channel % 3 == 1 ? JammerNetzChannelTarget::Left : JammerNetzChannelTarget::Right);
+		JammerNetzSingleChannelSetup single(target);
+		single.name = "Client " + std::to_string(client) + " channel " + std::to_string(channel);
+		setup.channels.push_back(single);
+	}
+	return std::make_shared<JammerNetzAudioData>(counter, static_cast<double>(counter), setup,
+		SAMPLE_RATE, 120.0f, MidiSignal_None, std::move(audio), nullptr);
+}
+
+// range(0) is the number of connected clients, range(1) the channels each client sends.
+// One mix cycle has to finish well within the 2.67 ms a 128 sample block lasts at 48 kHz.
+void BM_ServerMixerCoreMix(benchmark::State& state)
+{
+	const auto clients = static_cast<int>(state.range(0));
+	const auto channels = static_cast<int>(state.range(1));
+	ServerMixerCore mixer(JammerNetzChannelSetup(false, {
+		JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Left),
+		JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Right)
+	}));
+	ServerInputPackets incoming;
+	for (int client = 0; client < clients; ++client) {
+		incoming.emplace(static_cast<ClientId>(client), clientPacket(client, channels, 1));
+	}
+	for (auto _ : state) {
+		auto result = mixer.mix(incoming);
+		benchmark::DoNotOptimize(result.outgoing.data());
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * clients);
+	state.counters["clients"] = clients;
+	state.counters["channels_per_client"] = channels;
+}
+BENCHMARK(BM_ServerMixerCoreMix)
+	->ArgNames({ "clients", "channels" })
+	->ArgsProduct({ { 2, 4, 8, 16, 32 }, { 1, 2, 4, 8, 16 } })
+	->Unit(benchmark::kMicrosecond);
+
+} // namespace
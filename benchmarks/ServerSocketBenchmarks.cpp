@@ -0,0 +1,79 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "IoUringSocket.h"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// About the size of a stereo mix package for one client
+constexpr int datagramBytes = 600;
+
+// range(0) is the number of clients, each gets one datagram per mix round. Nobody reads the receiving socket,
+// loopback drops what does not fit its buffer, so only the sending side is measured.
+void BM_DatagramSocketSendRound(benchmark::State& state)
+{
+	const auto clients = static_cast<int>(state.range(0));
+	DatagramSocket sender;
+	DatagramSocket receiver;
+	if (!sender.bindToPort(0, "127.0.0.1") || !receiver.bindToPort(0, "127.0.0.1")) {
+		state.SkipWithError("Could not bind to loopback");
+		return;
+	}
+	// Resolved once, as the registry does for every client
+	const auto target = *SocketAddress::fromString("127.0.0.1", receiver.getBoundPort());
+	const std::vector<uint8> datagram(datagramBytes, 0x5a);
+	for (auto _ : state) {
+		for (int client = 0; client < clients; ++client) {
+			benchmark::DoNotOptimize(target.sendFrom(sender, datagram.data(), datagramBytes));
+		}
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * clients);
+	state.counters["clients"] = clients;
+}
+BENCHMARK(BM_DatagramSocketSendRound)->Arg(1)->Arg(8)->Arg(32)->Arg(128);
+
+// The same round queued in the io_uring send slots and submitted with one system call, as the SendThread does
+void BM_IoUringSendRound(benchmark::State& state)
+{
+	const auto clients = static_cast<int>(state.range(0));
+	DatagramSocket sender;
+	DatagramSocket receiver;
+	if (!sender.bindToPort(0, "127.0.0.1") || !receiver.bindToPort(0, "127.0.0.1")) {
+		state.SkipWithError("Could not bind to loopback");
+		return;
+	}
+	std::string error;
+	auto ioUring = IoUringSender::create(sender.getRawSocketHandle(), error);
+	if (!ioUring) {
+		state.SkipWithError(error.c_str());
+		return;
+	}
+	const auto target = *SocketAddress::fromString("127.0.0.1", receiver.getBoundPort());
+	const std::vector<uint8> datagram(datagramBytes, 0x5a);
+	for (auto _ : state) {
+		for (int client = 0; client < clients; ++client) {
+			if (!ioUring->queue(target, datagram.data(), datagramBytes)) {
+				state.SkipWithError(ioUring->lastError().c_str());
+				return;
+			}
+		}
+		if (!ioUring->submit()) {
+			state.SkipWithError(ioUring->lastError().c_str());
+			return;
+		}
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * clients);
+	state.counters["clients"] = clients;
+	state.counters["failed_sends"] = static_cast<double>(ioUring->failedSends());
+}
+BENCHMARK(BM_IoUringSendRound)->Arg(1)->Arg(8)->Arg(32)->Arg(128);
+
+} // namespace
@@ -0,0 +1,197 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <Availability.h>
+// std::atomic wait/notify need macOS 11, older deployment targets park on a condition variable instead
+#if __MAC_OS_X_VERSION_MIN_REQUIRED < 110000
+#define JAMMERNETZ_QUEUE_WAKEUP_CONDITION_VARIABLE 1
+#endif
+#endif
+
+#if JAMMERNETZ_QUEUE_WAKEUP_CONDITION_VARIABLE
+#include <condition_variable>
+#include <mutex>
+#endif
+
+// Lets one consumer thread block until a producer has done something, instead of polling.
+// notify() is real-time safe: it is an atomic load, plus a futex wake (WaitOnAddress on
+// Windows) only when the consumer is actually parked. Builds for macOS before 11 take a
+// mutex there instead.
+class QueueWakeup {
+public:
+	// Returns once ready() is true or after a notify(). Spurious returns are possible, so call
+	// it in a loop and put everything the consumer waits for, including exit, into ready().
+	template <typename Ready>
+	void wait(Ready&& ready)
+	{
+		const auto seen = wakeups_.load(std::memory_order_acquire);
+		parked_.store(true, std::memory_order_relaxed);
+		// Pairs with the fence in notify(): either the producer sees the consumer parked,
+		// or the consumer sees what the producer did before it notified.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!ready()) {
+#if JAMMERNETZ_QUEUE_WAKEUP_CONDITION_VARIABLE
+			std::unique_lock<std::mutex> lock(mutex_);
+			woken_.wait(lock, [this, seen] { return wakeups_.load(std::memory_order_acquire) != seen; });
+#else
+			wakeups_.wait(seen, std::memory_order_acquire);
+#endif
+		}
+		parked_.store(false, std::memory_order_relaxed);
+	}
+
+	void notify() noexcept
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (parked_.load(std::memory_order_relaxed)) {
+			wakeUp();
+		}
+	}
+
+	// Unconditional, for state the consumer checks that has no notify of its own, e.g. call after
+	// signalThreadShouldExit() so a parked worker sees it
+	void wakeUp() noexcept
+	{
+#if JAMMERNETZ_QUEUE_WAKEUP_CONDITION_VARIABLE
+		{
+			// Under the lock, so the count can't change between the consumer's check and its wait
+			std::lock_guard<std::mutex> lock(mutex_);
+			wakeups_.fetch_add(1, std::memory_order_release);
+		}
+		woken_.notify_all();
+#else
+		wakeups_.fetch_add(1, std::memory_order_release);
+		wakeups_.notify_all();
+#endif
+	}
+
+private:
+	std::atomic<uint32_t> wakeups_ { 0 };
+	std::atomic<bool> parked_ { false };
+#if JAMMERNETZ_QUEUE_WAKEUP_CONDITION_VARIABLE
+	std::mutex mutex_;
+	std::condition_variable woken_;
+#endif
+};
+
+// Fixed-capacity single-producer/single-consumer storage. Slots are allocated
+// during construction and are filled in place, so enqueue/dequeue never allocates.
+template <typename Item>
+class BoundedSpscQueue {
+public:
+	// AbstractFifo keeps one backing slot empty to distinguish full from empty,
+	// so allocate one extra slot to make this wrapper's capacity exact.
+	//
+	// Optionally notifies a consumer waiting on dataWakeup after each write, and a producer
+	// waiting for space on spaceWakeup after each read. Several queues may share one wakeup.
+	//
+	// Writers and readers taking a second size_t argument also get the index of the slot, from
+	// 0 to slotCount() - 1, so an item can use storage kept beside the queue.
+	explicit BoundedSpscQueue(int capacity, QueueWakeup* dataWakeup = nullptr, QueueWakeup* spaceWakeup = nullptr)
+		: fifo_(capacity + 1), slots_(static_cast<size_t>(capacity + 1)), dataWakeup_(dataWakeup), spaceWakeup_(spaceWakeup) {}
+
+	template <typename Writer>
+	bool tryWrite(Writer&& writer)
+	{
+		int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+		fifo_.prepareToWrite(1, start1, size1, start2, size2);
+		juce::ignoreUnused(start2, size2);
+		if (size1 == 0) {
+			return false;
+		}
+		invoke(writer, static_cast<size_t>(start1));
+		fifo_.finishedWrite(1);
+		if (dataWakeup_ != nullptr) {
+			dataWakeup_->notify();
+		}
+		return true;
+	}
+
+	template <typename Reader>
+	bool tryRead(Reader&& reader)
+	{
+		int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+		fifo_.prepareToRead(1, start1, size1, start2, size2);
+		juce::ignoreUnused(start2, size2);
+		if (size1 == 0) {
+			return false;
+		}
+		invoke(reader, static_cast<size_t>(start1));
+		fifo_.finishedRead(1);
+		if (spaceWakeup_ != nullptr) {
+			spaceWakeup_->notify();
+		}
+		return true;
+	}
+
+	// Consumer side, for items read in place over several calls: the index-th oldest item, or nullptr
+	// when no more than index items are ready. It stays queued until discard() hands it back.
+	Item* peek(int index) noexcept
+	{
+		int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+		fifo_.prepareToRead(index + 1, start1, size1, start2, size2);
+		if (size1 + size2 <= index) {
+			return nullptr;
+		}
+		return &slots_[static_cast<size_t>(index < size1 ? start1 + index : start2 + index - size1)];
+	}
+
+	// Consumer side, hands the oldest count items back to the producer
+	void discard(int count) noexcept
+	{
+		count = std::min(count, fifo_.getNumReady());
+		if (count <= 0) {
+			return;
+		}
+		fifo_.finishedRead(count);
+		if (spaceWakeup_ != nullptr) {
+			spaceWakeup_->notify();
+		}
+	}
+
+	int size() const noexcept { return fifo_.getNumReady(); }
+	int freeSpace() const noexcept { return fifo_.getFreeSpace(); }
+	int slotCount() const noexcept { return static_cast<int>(slots_.size()); }
+
+	// AbstractFifo::reset() is not synchronised with prepare/finished calls.
+	// The owner must stop both the producer and consumer before calling reset().
+	// Clearing the backing slots also releases resources retained by consumed or
+	// abandoned items, such as shared_ptr payloads.
+	void reset()
+	{
+		fifo_.reset();
+		const auto slotCount = slots_.size();
+		slots_.clear();
+		slots_.resize(slotCount);
+	}
+
+private:
+	template <typename Callback>
+	void invoke(Callback& callback, size_t slot)
+	{
+		if constexpr (std::is_invocable_v<Callback&, Item&, size_t>) {
+			callback(slots_[slot], slot);
+		} else {
+			callback(slots_[slot]);
+		}
+	}
+
+	juce::AbstractFifo fifo_;
+	std::vector<Item> slots_;
+	QueueWakeup* dataWakeup_;
+	QueueWakeup* spaceWakeup_;
+};
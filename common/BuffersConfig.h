@@ -15,6 +15,39 @@ const int SAMPLE_BUFFER_SIZE = 128;
 const int SAMPLE_RATE = 48000;
 const int SAMPLES_PER_MILLISECOND = 48000 / 1000;
 
+// The sample rate is a property of the session as well, SAMPLE_RATE is the default. Clients whose device runs at
+// another rate convert to and from the session rate.
+constexpr int SUPPORTED_SAMPLE_RATES[] = { 44100, 48000, 88200, 96000 };
+
+constexpr bool isSupportedSampleRate(int sampleRate)
+{
+	for (const int supported : SUPPORTED_SAMPLE_RATES) {
+		if (sampleRate == supported) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// The block size is a property of the session. The server mixes at the size it was started with, and the clients
+// send what they receive. 128 is the default, 32 and 64 save packetization latency on a LAN, 256 halves the packet rate on bad links.
+const int MINIMUM_SAMPLE_BUFFER_SIZE = 32;
+const int MAXIMUM_SAMPLE_BUFFER_SIZE = 256;
+
+constexpr bool isSupportedSampleBufferSize(int samples)
+{
+	return samples >= MINIMUM_SAMPLE_BUFFER_SIZE && samples <= MAXIMUM_SAMPLE_BUFFER_SIZE && (samples & (samples - 1)) == 0;
+}
+
+// The buffer lengths below count SAMPLE_BUFFER_SIZE blocks at SAMPLE_RATE. This is the number of blocks of another size
+// and rate covering the same time.
+constexpr int blocksForSampleBufferSize(int blocks, int sampleBufferSize, int sampleRate = SAMPLE_RATE)
+{
+	const long long samples = static_cast<long long>(blocks) * SAMPLE_BUFFER_SIZE * sampleRate;
+	const long long blockSamples = static_cast<long long>(sampleBufferSize) * SAMPLE_RATE;
+	return static_cast<int>((samples + blockSamples - 1) / blockSamples);
+}
+
 // The mixer only mixes when at least that amount of packages is available. This is the amount of package delta between different clients sending
 // 20 ms sever jitter buffer
 const int SERVER_INCOMING_JITTER_BUFFER = 10 * SAMPLES_PER_MILLISECOND / SAMPLE_BUFFER_SIZE;
@@ -46,4 +79,6 @@ struct ServerBufferConfig {
 	int serverIncomingJitterBuffer;
 	int serverIncomingMaximumBuffer;
 	int serverBufferPrefillOnConnect;
+	// Blocks between a packet's capture and its mix, the same for every client in the room. 0 mixes whatever is at the front of the queues.
+	int serverAlignmentTarget { 0 };
 };
@@ -1,6 +1,13 @@
 #include "JammerNetzPackage.h"
 #include "JammerNetzClientInfoMessage.h"
+#include "JammerNetzMessageView.h"
 #include "PacketStreamQueue.h"
+#include "LatencyTrace.h"
+#include "NetworkImpairment.h"
+#include "RecordingLog.h"
+#include "Recorder.h"
+#include "ParallelFlacWriter.h"
+#include "ThreadScheduling.h"
 
 #include "BuffersConfig.h"
 
@@ -97,6 +104,52 @@ const JammerNetzPNPAudioData *audioRoot(uint8 const *packet)
 	return GetJammerNetzPNPAudioData(packet + sizeof(JammerNetzHeader));
 }
 
+int recordingLogSample(int channel, uint64_t frame)
+{
+	// 16 bit values, left justified as JUCE passes them to a writer
+	return (static_cast<int>((frame * 7 + static_cast<uint64_t>(channel) * 1000) % 60000) - 30000) * 65536;
+}
+
+void writeRecordingLog(File const& file, int frames, int64 timeReference)
+{
+	std::unique_ptr<OutputStream> stream = file.createOutputStream();
+	auto writer = RecordingLog::createWriter(stream, SAMPLE_RATE, 2, 16, timeReference, "test");
+	ASSERT_NE(writer, nullptr);
+	std::vector<int> left(1000), right(1000);
+	for (int position = 0; position < frames; position += 1000) {
+		const int count = std::min(1000, frames - position);
+		for (int i = 0; i < count; ++i) {
+			left[static_cast<size_t>(i)] = recordingLogSample(0, static_cast<uint64_t>(position + i));
+			right[static_cast<size_t>(i)] = recordingLogSample(1, static_cast<uint64_t>(position + i));
+		}
+		const int* channels[] = { left.data(), right.data(), nullptr };
+		ASSERT_TRUE(writer->write(channels, count));
+	}
+}
+
+// Counts frames that differ from what writeRecordingLog() wrote, silent frames are counted separately
+int recordingLogMismatches(RecordingLogReader& reader, int& silentFrames)
+{
+	std::vector<int> left(4096), right(4096);
+	int* channels[] = { left.data(), right.data() };
+	int mismatches = 0;
+	silentFrames = 0;
+	for (uint64_t position = 0; position < reader.getLengthInFrames(); position += left.size()) {
+		const int count = static_cast<int>(std::min<uint64_t>(left.size(), reader.getLengthInFrames() - position));
+		EXPECT_TRUE(reader.read(channels, 2, position, count));
+		for (int i = 0; i < count; ++i) {
+			const auto index = static_cast<size_t>(i);
+			if (left[index] == 0 && right[index] == 0) {
+				++silentFrames;
+			}
+			else if (left[index] != recordingLogSample(0, position + index) || right[index] != recordingLogSample(1, position + index)) {
+				++mismatches;
+			}
+		}
+	}
+	return mismatches;
+}
+
 }
 
 TEST(TestSerialization, TestAudioData) {
@@ -133,6 +186,149 @@ TEST(TestSerialization, TestAudioData) {
 
 }
 
+TEST(TestSerialization, RoundTripsEverySupportedBlockSize)
+{
+	auto setup = makeChannelSetup();
+	std::vector<uint8> stream(MAXFRAMESIZE);
+	for (int blockSize = MINIMUM_SAMPLE_BUFFER_SIZE; blockSize <= MAXIMUM_SAMPLE_BUFFER_SIZE; blockSize *= 2) {
+		auto buffer = std::make_shared<AudioBuffer<float>>(2, blockSize);
+		for (int channel = 0; channel < 2; ++channel) {
+			juce::FloatVectorOperations::fill(buffer->getWritePointer(channel), 0.5f, blockSize);
+		}
+		JammerNetzAudioData message(1, 1234.0, setup, SAMPLE_RATE, 0.0f, MidiSignal_None, buffer, nullptr);
+		size_t size = 0;
+		message.serialize(stream.data(), size);
+
+		auto loaded = std::dynamic_pointer_cast<JammerNetzAudioData>(JammerNetzMessage::deserialize(stream.data(), size));
+		ASSERT_NE(loaded, nullptr);
+		ASSERT_EQ(loaded->audioBuffer()->getNumSamples(), blockSize);
+		EXPECT_NEAR(loaded->audioBuffer()->getSample(1, blockSize - 1), 0.5f, 0.0001f);
+	}
+}
+
+TEST(TestSerialization, RejectsBlockSizesTheMixerCannotTake)
+{
+	auto setup = makeChannelSetup();
+	std::vector<uint8> stream(MAXFRAMESIZE);
+	for (int blockSize : { 100, 512 }) {
+		auto buffer = std::make_shared<AudioBuffer<float>>(2, blockSize);
+		buffer->clear();
+		JammerNetzAudioData message(1, 1234.0, setup, SAMPLE_RATE, 0.0f, MidiSignal_None, buffer, nullptr);
+		size_t size = 0;
+		message.serialize(stream.data(), size);
+		EXPECT_EQ(JammerNetzMessage::deserialize(stream.data(), size), nullptr);
+	}
+}
+
+TEST(TestSerialization, RoundTripsTheSessionSampleRate)
+{
+	auto buffer = makeAudioBuffer();
+	std::vector<uint8> stream(MAXFRAMESIZE);
+	for (int sampleRate : { 44100, 48000, 88200, 96000 }) {
+		JammerNetzAudioData message(1, 1234.0, makeChannelSetup(), sampleRate, 0.0f, MidiSignal_None, buffer, nullptr);
+		size_t size = 0;
+		message.serialize(stream.data(), size);
+
+		auto loaded = std::dynamic_pointer_cast<JammerNetzAudioData>(JammerNetzMessage::deserialize(stream.data(), size));
+		ASSERT_NE(loaded, nullptr);
+		EXPECT_EQ(loaded->sampleRate(), sampleRate);
+		EXPECT_EQ(loaded->audioBuffer()->getNumSamples(), buffer->getNumSamples());
+	}
+
+	// Nobody could convert this one
+	JammerNetzAudioData message(1, 1234.0, makeChannelSetup(), 12345, 0.0f, MidiSignal_None, buffer, nullptr);
+	size_t size = 0;
+	message.serialize(stream.data(), size);
+	EXPECT_EQ(JammerNetzMessage::deserialize(stream.data(), size), nullptr);
+}
+
+TEST(TestSerialization, DecodeTellsWhyAPacketWasDropped)
+{
+	auto buffer = makeAudioBuffer();
+	JammerNetzAudioData message(1, 1234.0, makeChannelSetup(), SAMPLE_RATE, 0.0f, MidiSignal_None, buffer, nullptr);
+	std::vector<uint8> stream(MAXFRAMESIZE);
+	size_t size = 0;
+	message.serialize(stream.data(), size);
+
+	auto errorOf = [](const JammerNetzDecodedMessage& decoded) {
+		const auto error = std::get_if<JammerNetzDecodeError>(&decoded);
+		return error ? std::optional<JammerNetzDecodeError>(*error) : std::nullopt;
+	};
+	EXPECT_EQ(errorOf(decodeJammerNetzMessage(stream.data(), 3)), JammerNetzDecodeError::TooShort);
+	EXPECT_EQ(errorOf(decodeJammerNetzMessage(stream.data(), size / 2)), JammerNetzDecodeError::Malformed);
+
+	auto garbage = stream;
+	std::fill(garbage.begin() + sizeof(JammerNetzHeader), garbage.begin() + static_cast<std::ptrdiff_t>(size), uint8(0xAA));
+	EXPECT_EQ(errorOf(decodeJammerNetzMessage(garbage.data(), size)), JammerNetzDecodeError::Malformed);
+	garbage[3] = 99;
+	EXPECT_EQ(errorOf(decodeJammerNetzMessage(garbage.data(), size)), JammerNetzDecodeError::UnknownType);
+	garbage[0] = 'X';
+	EXPECT_EQ(errorOf(decodeJammerNetzMessage(garbage.data(), size)), JammerNetzDecodeError::NotJammerNetz);
+
+	// A block size the mixer can't take is as bad as a broken packet
+	JammerNetzAudioData unmixable(1, 1234.0, makeChannelSetup(), SAMPLE_RATE, 0.0f, MidiSignal_None, std::make_shared<AudioBuffer<float>>(2, 100), nullptr);
+	unmixable.serialize(stream.data(), size);
+	EXPECT_EQ(errorOf(decodeJammerNetzMessage(stream.data(), size)), JammerNetzDecodeError::Malformed);
+}
+
+TEST(TestSerialization, AudioViewReadsTheReceiveBuffer)
+{
+	auto buffer = makeAudioBuffer();
+	auto fec = std::make_shared<AudioBlock>(1000.0, 6, 0, 0.0f, MidiSignal_None, SAMPLE_RATE, makeChannelSetup(), buffer);
+	JammerNetzAudioData message(7, 1234.0, makeChannelSetup(), SAMPLE_RATE, 0.0f, MidiSignal_None, buffer, fec);
+	std::vector<uint8> stream(MAXFRAMESIZE);
+	size_t size = 0;
+	message.serialize(stream.data(), size);
+
+	const auto decoded = decodeJammerNetzMessage(stream.data(), size);
+	const auto view = std::get_if<JammerNetzAudioDataView>(&decoded);
+	ASSERT_NE(view, nullptr);
+	EXPECT_EQ(view->messageCounter(), 7u);
+	EXPECT_EQ(view->timestamp(), 1234.0);
+	EXPECT_EQ(view->protocolVersion(), JammerNetzProtocol::Current);
+
+	const auto loaded = view->toMessage();
+	EXPECT_EQ(loaded->messageCounter(), 7u);
+	ASSERT_NE(loaded->fecBlock(), nullptr);
+	EXPECT_EQ(loaded->fecBlock()->messageCounter, 6u);
+	EXPECT_EQ(loaded->audioBuffer()->getNumSamples(), buffer->getNumSamples());
+}
+
+TEST(TestSerialization, ControlMessageWithBrokenJsonIsDropped)
+{
+	flatbuffers::FlatBufferBuilder fbb;
+	fbb.Finish(CreateJammerNetzControlInfo(fbb, fbb.CreateString("{\"mtu_probe_v1\": ")));
+	std::vector<uint8> packet = { '1', '2', '3', JammerNetzMessage::GENERIC_JSON };
+	packet.insert(packet.end(), fbb.GetBufferPointer(), fbb.GetBufferPointer() + fbb.GetSize());
+
+	const auto decoded = decodeJammerNetzMessage(packet.data(), packet.size());
+	const auto control = std::get_if<JammerNetzControlView>(&decoded);
+	ASSERT_NE(control, nullptr);
+	EXPECT_EQ(control->text(), "{\"mtu_probe_v1\": ");
+	EXPECT_FALSE(control->json().has_value());
+	EXPECT_EQ(JammerNetzMessage::deserialize(packet.data(), packet.size()), nullptr);
+}
+
+TEST(TestSerialization, AudioSerializerWritesTheSameBytesAsAudioData)
+{
+	auto buffer = makeAudioBuffer();
+	auto setup = makeChannelSetup("Guitar");
+	JammerNetzAudioSerializer serializer;
+	std::vector<uint8> serialized(MAXFRAMESIZE);
+	for (uint64 counter : { 17u, 18u }) {
+		// The second packet reuses the builder of the first
+		JammerNetzAudioData message(counter, 1234.0, setup, SAMPLE_RATE, 120.0f, MidiSignal_Start, buffer, nullptr);
+		std::vector<uint8> expected(MAXFRAMESIZE);
+		size_t expectedSize = 0;
+		message.serialize(expected.data(), expectedSize);
+
+		const auto size = serializer.serialize(serialized.data(), counter, 1234.0, setup, 120.0f, MidiSignal_Start,
+			buffer->getArrayOfReadPointers(), buffer->getNumChannels(), buffer->getNumSamples(), SAMPLE_RATE);
+		ASSERT_EQ(size, expectedSize);
+		EXPECT_EQ(std::memcmp(serialized.data(), expected.data(), size), 0);
+	}
+}
+
 TEST(TestProtocolCompatibility, CurrentPacketsAdvertiseSplitSessionProtocol)
 {
 	JammerNetzAudioData message(0, 1234.0, makeChannelSetup(), SAMPLE_RATE, 0.0f, MidiSignal_None, makeAudioBuffer(), nullptr);
@@ -412,3 +608,375 @@ TEST(SessionInfoTest, RoundTripsServerCapabilities)
 	ASSERT_NE(decoded, nullptr);
 	EXPECT_TRUE(decoded->supportsCapability(JammerNetzCapability::MtuProbeV1));
 }
+
+TEST(LatencyTraceTest, StampsOnlySampledPacketsWhileEnabled)
+{
+	LatencyTrace trace;
+	trace.stampAt(0, 64, LatencyStage::Capture, 1.0);
+	trace.enable(64);
+	trace.stampAt(0, 63, LatencyStage::Capture, 2.0);
+	trace.stampAt(0, 128, LatencyStage::Capture, 3.0);
+	trace.stampAt(0, 128, LatencyStage::Send, 4.5);
+
+	std::vector<LatencyTraceEvent> events;
+	ASSERT_EQ(trace.drain(events), 2u);
+	EXPECT_EQ(events[0].packet, 128u);
+	EXPECT_EQ(events[0].stage, LatencyStage::Capture);
+	EXPECT_EQ(events[1].stage, LatencyStage::Send);
+	EXPECT_DOUBLE_EQ(events[1].timeMs, 4.5);
+	EXPECT_EQ(trace.drain(events), 0u);
+}
+
+TEST(LatencyTraceTest, DropsEventsWhenTheBufferIsFull)
+{
+	LatencyTrace trace;
+	trace.enable(1);
+	for (size_t i = 0; i < LatencyTrace::capacity + 3; ++i) {
+		trace.stampAt(0, i, LatencyStage::Capture, 0.0);
+	}
+	EXPECT_EQ(trace.droppedEvents(), 3u);
+
+	std::vector<LatencyTraceEvent> events;
+	EXPECT_EQ(trace.drain(events), LatencyTrace::capacity);
+	trace.stampAt(0, 1, LatencyStage::Send, 0.0);
+	EXPECT_EQ(trace.drain(events), 1u);
+}
+
+TEST(LatencyTraceTest, BreakdownUsesScenarioTraceSchema)
+{
+	LatencyBreakdownCollector collector;
+	collector.add({ 0, 4, LatencyStage::Capture, 100.0, 256 });
+	collector.add({ 0, 4, LatencyStage::Send, 101.5, 0 });
+	collector.add({ 0, 8, LatencyStage::Capture, 102.0, 256 });
+	EXPECT_TRUE(collector.takeBreakdowns(false).empty());
+
+	collector.add({ 0, 4, LatencyStage::Playout, 130.0, 0 });
+	const auto breakdowns = collector.takeBreakdowns(false);
+	ASSERT_EQ(breakdowns.size(), 1u);
+	const auto& line = breakdowns.front();
+	// At the block size stamped on capture, not the default one
+	EXPECT_EQ(line["virtual_sample"].get<uint64_t>(), 4u * 256u);
+	EXPECT_EQ(line["kind"], "latency_breakdown");
+	EXPECT_TRUE(line.contains("sequence"));
+	const auto& details = line["details"];
+	EXPECT_TRUE(details["complete"].get<bool>());
+	EXPECT_DOUBLE_EQ(details["total_ms"].get<double>(), 30.0);
+	ASSERT_EQ(details["stages"].size(), 3u);
+	EXPECT_EQ(details["stages"][1]["stage"], "send");
+	EXPECT_DOUBLE_EQ(details["stages"][2]["since_previous_ms"].get<double>(), 28.5);
+
+	EXPECT_EQ(collector.pendingPackets(), 1u);
+	const auto flushed = collector.takeBreakdowns(true);
+	ASSERT_EQ(flushed.size(), 1u);
+	EXPECT_FALSE(flushed.front()["details"]["complete"].get<bool>());
+}
+
+TEST(NetworkImpairmentTest, ParsesSpec)
+{
+	std::string error;
+	const auto config = NetworkImpairmentConfig::parse("seed=7,ge=0.01/0.3/0/0.5,delay=20,jitter=5:pareto,duplicate=0.01,rate=2000,direction=both", error);
+	ASSERT_TRUE(config.has_value()) << error;
+	EXPECT_EQ(config->seed, 7u);
+	EXPECT_DOUBLE_EQ(config->goodToBad, 0.01);
+	EXPECT_DOUBLE_EQ(config->badToGood, 0.3);
+	EXPECT_DOUBLE_EQ(config->lossInBad, 0.5);
+	EXPECT_DOUBLE_EQ(config->delayMs, 20.0);
+	EXPECT_EQ(config->jitterDistribution, JitterDistribution::Pareto);
+	EXPECT_DOUBLE_EQ(config->rateKbps, 2000.0);
+	EXPECT_TRUE(config->impairOutgoing);
+	EXPECT_TRUE(config->impairIncoming);
+
+	EXPECT_FALSE(NetworkImpairmentConfig::parse("loss=1.5", error).has_value());
+	EXPECT_FALSE(NetworkImpairmentConfig::parse("ge=0.1/0.2", error).has_value());
+	EXPECT_FALSE(NetworkImpairmentConfig::parse("bogus=1", error).has_value());
+}
+
+TEST(ThreadSchedulingTest, ParsesSpec)
+{
+	std::string error;
+	const auto config = ThreadSchedulingConfig::parse("policy=fifo,priority=80,cpus=2/4-5", error);
+	ASSERT_TRUE(config.has_value()) << error;
+	EXPECT_EQ(config->policy, SchedulingPolicy::Fifo);
+	EXPECT_EQ(config->priority, 80);
+	EXPECT_EQ(config->cpus, (std::vector<int> { 2, 4, 5 }));
+	EXPECT_FALSE(config->isDefault());
+	EXPECT_TRUE(ThreadSchedulingConfig::parse("", error)->isDefault());
+
+	EXPECT_FALSE(ThreadSchedulingConfig::parse("policy=idle", error).has_value());
+	EXPECT_FALSE(ThreadSchedulingConfig::parse("priority=100", error).has_value());
+	EXPECT_FALSE(ThreadSchedulingConfig::parse("cpus=5-4", error).has_value());
+	EXPECT_FALSE(ThreadSchedulingConfig::parse("cpus=", error).has_value());
+	EXPECT_FALSE(ThreadSchedulingConfig::parse("fifo", error).has_value());
+}
+
+TEST(ThreadSchedulingTest, ReportsNormalSchedulingWhenNothingIsRequested)
+{
+	const auto result = applyThreadScheduling(Thread::getCurrentThreadId(), ThreadSchedulingConfig {});
+	EXPECT_FALSE(result.realtime);
+	EXPECT_FALSE(result.pinned);
+	EXPECT_EQ(result.description, "normal priority");
+}
+
+TEST(NetworkImpairmentTest, SameSeedGivesSameDecisions)
+{
+	std::string error;
+	const auto config = NetworkImpairmentConfig::parse("seed=42,ge=0.05/0.2/0.01/0.6,jitter=4:normal,duplicate=0.05", error);
+	ASSERT_TRUE(config.has_value()) << error;
+	NetworkImpairmentModel first(*config, config->seed);
+	NetworkImpairmentModel second(*config, config->seed);
+	for (int packet = 0; packet < 1000; ++packet) {
+		const double nowMs = packet * 2.6667;
+		const auto a = first.decide(400, nowMs);
+		const auto b = second.decide(400, nowMs);
+		ASSERT_EQ(a.copies, b.copies);
+		for (int copy = 0; copy < a.copies; ++copy) {
+			EXPECT_DOUBLE_EQ(a.deliveryMs[static_cast<size_t>(copy)], b.deliveryMs[static_cast<size_t>(copy)]);
+		}
+	}
+}
+
+TEST(NetworkImpairmentTest, GilbertElliottLossIsBursty)
+{
+	NetworkImpairmentConfig config;
+	config.goodToBad = 0.02;
+	config.badToGood = 0.25;
+	config.lossInBad = 1.0;
+	NetworkImpairmentModel model(config, 3);
+	int lost = 0;
+	int bursts = 0;
+	bool previousLost = false;
+	constexpr int packets = 100000;
+	for (int packet = 0; packet < packets; ++packet) {
+		const bool isLost = model.decide(400, packet).copies == 0;
+		lost += isLost ? 1 : 0;
+		bursts += isLost && !previousLost ? 1 : 0;
+		previousLost = isLost;
+	}
+	// Stationary loss p / (p + r) = 7.4 %, mean burst length 1 / r = 4 packets
+	EXPECT_NEAR(static_cast<double>(lost) / packets, 0.074, 0.01);
+	EXPECT_NEAR(static_cast<double>(lost) / bursts, 4.0, 0.5);
+}
+
+TEST(NetworkImpairmentTest, RateCapQueuesAndTailDrops)
+{
+	NetworkImpairmentConfig config;
+	config.rateKbps = 800.0; // 100 bytes take 1 ms
+	config.queueLimitMs = 10.0;
+	NetworkImpairmentModel model(config, 1);
+	double lastDeliveryMs = 0.0;
+	int dropped = 0;
+	for (int packet = 0; packet < 20; ++packet) {
+		const auto decision = model.decide(100, 0.0);
+		if (decision.rateDropped) {
+			++dropped;
+		}
+		else {
+			EXPECT_GT(decision.deliveryMs[0], lastDeliveryMs);
+			lastDeliveryMs = decision.deliveryMs[0];
+		}
+	}
+	EXPECT_DOUBLE_EQ(lastDeliveryMs, 11.0);
+	EXPECT_EQ(dropped, 9);
+}
+
+TEST(NetworkImpairmentTest, EveryRemoteEndpointHasItsOwnLink)
+{
+	NetworkImpairmentConfig config;
+	config.rateKbps = 80.0; // 100 bytes take 10 ms
+	config.queueLimitMs = 15.0;
+	NetworkImpairment::instance().enable(config);
+	DatagramSocket socket;
+	const std::array<uint8_t, 100> packet {};
+	// The third packet to one endpoint waits 20 ms and is dropped. A link shared by both would also drop the second endpoint's.
+	for (int port : { 9, 10 }) {
+		for (int i = 0; i < 3; ++i) {
+			NetworkImpairment::instance().write(socket, "127.0.0.1", port, packet.data(), static_cast<int>(packet.size()));
+		}
+	}
+	const auto stats = NetworkImpairment::instance().outgoingStats();
+	NetworkImpairment::instance().forget(socket);
+	NetworkImpairment::instance().disable();
+	EXPECT_EQ(stats.packets, 6u);
+	EXPECT_EQ(stats.rateDropped, 2u);
+}
+
+TEST(RecordingLogTest, RecoversEverythingBeforeATornRecord)
+{
+	TemporaryFile temporary(RecordingLog::fileExtension);
+	const File file = temporary.getFile();
+	writeRecordingLog(file, 3 * SAMPLE_RATE, 4711);
+
+	// A crash in the middle of writing the last chunk
+	MemoryBlock data;
+	ASSERT_TRUE(file.loadFileAsData(data));
+	ASSERT_EQ(data.getSize() % RecordingLog::blockSize, 0u);
+	ASSERT_TRUE(file.replaceWithData(data.getData(), data.getSize() - RecordingLog::blockSize - 20000));
+
+	RecordingLogReader reader(file);
+	ASSERT_TRUE(reader.openedOk()) << reader.getError();
+	EXPECT_EQ(reader.getSampleRate(), SAMPLE_RATE);
+	EXPECT_EQ(reader.getNumChannels(), 2);
+	EXPECT_EQ(reader.getTimeReference(), 4711);
+	EXPECT_EQ(reader.getDescription(), "test");
+	// The two complete chunks survive, nothing was synced by a checkpoint yet
+	const uint64_t framesPerChunk = (RecordingLog::targetRecordBytes - RecordingLog::recordHeaderBytes) / 4;
+	EXPECT_EQ(reader.getLengthInFrames(), 2 * framesPerChunk);
+	EXPECT_EQ(reader.getNumCheckpoints(), 0u);
+	EXPECT_EQ(reader.getFramesAfterLastCheckpoint(), 2 * framesPerChunk);
+	EXPECT_GT(reader.getDamagedBytes(), 0);
+	int silentFrames = 0;
+	EXPECT_EQ(recordingLogMismatches(reader, silentFrames), 0);
+	EXPECT_EQ(silentFrames, 0);
+	EXPECT_EQ(reader.getFramesMissing(), 0u);
+}
+
+TEST(RecordingLogTest, DamagedChunksReadAsSilence)
+{
+	TemporaryFile temporary(RecordingLog::fileExtension);
+	const File file = temporary.getFile();
+	writeRecordingLog(file, 3 * SAMPLE_RATE, 0);
+
+	MemoryBlock data;
+	ASSERT_TRUE(file.loadFileAsData(data));
+	const size_t firstChunk = RecordingLog::blockSize;
+	const size_t secondChunk = firstChunk + RecordingLog::targetRecordBytes;
+	// One flipped bit in the audio of the first chunk, and the header of the second one destroyed
+	data[firstChunk + RecordingLog::recordHeaderBytes + 100] ^= 0x01;
+	data[secondChunk + 3] ^= 0x01;
+	ASSERT_TRUE(file.replaceWithData(data.getData(), data.getSize()));
+
+	RecordingLogReader reader(file);
+	ASSERT_TRUE(reader.openedOk()) << reader.getError();
+	const uint64_t framesPerChunk = (RecordingLog::targetRecordBytes - RecordingLog::recordHeaderBytes) / 4;
+	// The reader resynchronised on the third chunk, so the file keeps its length
+	EXPECT_EQ(reader.getLengthInFrames(), static_cast<uint64_t>(3 * SAMPLE_RATE));
+	EXPECT_EQ(reader.getNumChunks(), 2u);
+	EXPECT_EQ(reader.getNumCheckpoints(), 1u);
+	EXPECT_EQ(reader.getDamagedBytes(), RecordingLog::targetRecordBytes);
+	int silentFrames = 0;
+	EXPECT_EQ(recordingLogMismatches(reader, silentFrames), 0);
+	EXPECT_EQ(static_cast<uint64_t>(silentFrames), 2 * framesPerChunk);
+	EXPECT_EQ(reader.getFramesMissing(), 2 * framesPerChunk);
+}
+
+TEST(RecordingLogTest, ConvertsToWavKeepingTheTimeReference)
+{
+	TemporaryFile source(RecordingLog::fileExtension);
+	TemporaryFile target(".wav");
+	writeRecordingLog(source.getFile(), SAMPLE_RATE, 12345);
+
+	const auto result = RecordingLog::convert(source.getFile(), target.getFile());
+	ASSERT_TRUE(result.ok) << result.error;
+	EXPECT_EQ(result.framesWritten, SAMPLE_RATE);
+	EXPECT_EQ(result.framesMissing, 0);
+
+	std::unique_ptr<AudioFormatReader> wav(WavAudioFormat().createReaderFor(target.getFile().createInputStream().release(), true));
+	ASSERT_NE(wav, nullptr);
+	EXPECT_EQ(wav->lengthInSamples, SAMPLE_RATE);
+	EXPECT_EQ(wav->bitsPerSample, 16u);
+	EXPECT_EQ(wav->metadataValues[WavAudioFormat::bwavTimeReference], "12345");
+	AudioBuffer<float> audio(2, 100);
+	wav->read(&audio, 0, 100, 1000, true, true);
+	EXPECT_FLOAT_EQ(audio.getSample(1, 0), static_cast<float>(recordingLogSample(1, 1000)) / 2147483648.0f);
+}
+
+TEST(RecorderTest, RecordsLostAudioAsDropoutAndKeepsTheTiming)
+{
+	const File directory = File::createTempFile("recorder");
+	ASSERT_TRUE(directory.createDirectory());
+	{
+		JammerNetzChannelSetup setup(false);
+		setup.channels.push_back(JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Left));
+		setup.channels.push_back(JammerNetzSingleChannelSetup(JammerNetzChannelTarget::Right));
+		Recorder recorder(directory, "test", RecordingType::CrashSafeLog, 1.0);
+		recorder.setChannelInfo(SAMPLE_RATE, setup);
+		recorder.setRecording(true);
+		ASSERT_TRUE(recorder.isRecording());
+
+		AudioBuffer<float> block(2, 128);
+		block.clear();
+		block.setSample(0, 0, 0.5f);
+		for (int i = 0; i < 100; ++i) {
+			recorder.saveBlock(block.getArrayOfReadPointers(), block.getNumSamples());
+		}
+		recorder.saveDropout(1000);
+		for (int i = 0; i < 100; ++i) {
+			recorder.saveBlock(block.getArrayOfReadPointers(), block.getNumSamples());
+		}
+		recorder.setRecording(false);
+
+		const auto statistics = recorder.getStatistics();
+		EXPECT_EQ(statistics.bufferCapacityFrames, SAMPLE_RATE);
+		EXPECT_EQ(statistics.framesRecorded, 26600u);
+		EXPECT_EQ(statistics.framesWritten, 25600u);
+		EXPECT_EQ(statistics.framesDropped, 1000u);
+		EXPECT_EQ(statistics.dropouts, 1u);
+
+		RecordingLogReader reader(recorder.getFile());
+		ASSERT_TRUE(reader.openedOk()) << reader.getError();
+		EXPECT_EQ(reader.getLengthInFrames(), 26600u);
+		// One second of buffer holds everything, so the only gap is the one reported
+		ASSERT_EQ(reader.getDropouts().size(), 1u);
+		EXPECT_EQ(reader.getDropouts().front().position, 12800u);
+		EXPECT_EQ(reader.getDropouts().front().frames, 1000u);
+	}
+	directory.deleteRecursively();
+}
+
+TEST(ParallelFlacWriterTest, StitchesSegmentsIntoOneFlacFile)
+{
+	TemporaryFile temporary(".flac");
+	// Two and a half segments, so frames have to be renumbered and the last frame is short
+	const int frames = 2 * ParallelFlacWriter::segmentFrames + ParallelFlacWriter::segmentFrames / 2 + 77;
+	{
+		ParallelFlacWriter writer(temporary.getFile().createOutputStream().release(), SAMPLE_RATE, 2, 16, 1, 3);
+		std::vector<int> left(1000), right(1000);
+		for (int position = 0; position < frames;) {
+			const int block = std::min(1000, frames - position);
+			for (int i = 0; i < block; ++i) {
+				left[static_cast<size_t>(i)] = recordingLogSample(0, static_cast<uint64_t>(position + i));
+				right[static_cast<size_t>(i)] = recordingLogSample(1, static_cast<uint64_t>(position + i));
+			}
+			const int* channels[] = { left.data(), right.data(), nullptr };
+			ASSERT_TRUE(writer.write(channels, block));
+			position += block;
+		}
+	}
+
+	std::unique_ptr<AudioFormatReader> flac(FlacAudioFormat().createReaderFor(temporary.getFile().createInputStream().release(), true));
+	ASSERT_NE(flac, nullptr);
+	EXPECT_EQ(flac->lengthInSamples, frames);
+	EXPECT_EQ(flac->numChannels, 2u);
+	EXPECT_EQ(flac->bitsPerSample, 16u);
+	std::vector<int> left(static_cast<size_t>(frames)), right(static_cast<size_t>(frames));
+	int* channels[] = { left.data(), right.data() };
+	ASSERT_TRUE(flac->read(channels, 2, 0, frames, false));
+	int mismatches = 0;
+	for (int i = 0; i < frames; ++i) {
+		if (left[static_cast<size_t>(i)] != recordingLogSample(0, static_cast<uint64_t>(i)) || right[static_cast<size_t>(i)] != recordingLogSample(1, static_cast<uint64_t>(i))) {
+			++mismatches;
+		}
+	}
+	EXPECT_EQ(mismatches, 0);
+}
+
+TEST(ParallelFlacWriterTest, IsReadableBeforeItIsClosed)
+{
+	TemporaryFile temporary(".flac");
+	ParallelFlacWriter writer(temporary.getFile().createOutputStream().release(), SAMPLE_RATE, 2, 16, 1, 1);
+	std::vector<int> left(ParallelFlacWriter::segmentFrames), right(ParallelFlacWriter::segmentFrames);
+	for (size_t i = 0; i < left.size(); ++i) {
+		left[i] = recordingLogSample(0, i);
+		right[i] = recordingLogSample(1, i);
+	}
+	const int* channels[] = { left.data(), right.data(), nullptr };
+	ASSERT_TRUE(writer.write(channels, ParallelFlacWriter::segmentFrames));
+	ASSERT_TRUE(writer.flush());
+
+	// What is left after a crash, the stream info does not know the length yet
+	std::unique_ptr<AudioFormatReader> flac(FlacAudioFormat().createReaderFor(temporary.getFile().createInputStream().release(), true));
+	ASSERT_NE(flac, nullptr);
+	EXPECT_EQ(flac->sampleRate, SAMPLE_RATE);
+	EXPECT_EQ(flac->numChannels, 2u);
+	EXPECT_EQ(flac->bitsPerSample, 16u);
+}
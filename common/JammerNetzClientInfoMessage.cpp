@@ -4,42 +4,35 @@
 #include "JammerNetzPackages_generated.h"
 
 // Deserializing constructor
-JammerNetzClientInfoMessage::JammerNetzClientInfoMessage(uint8 *data, size_t bytes)
+JammerNetzClientInfoMessage::JammerNetzClientInfoMessage(JammerNetzPNPClientInfoPackage const &decoded)
 {
-	flatbuffers::Verifier verifier(data + sizeof(JammerNetzHeader), bytes);
-	if (VerifyJammerNetzPNPClientInfoPackageBuffer(verifier)) {
-		auto root = GetJammerNetzPNPClientInfoPackage(data + sizeof(JammerNetzHeader));
-		if (const auto capabilities = root->capabilities()) {
-			for (const auto capability : *capabilities) {
-				capabilities_.push_back(capability->str());
-			}
+	if (const auto capabilities = decoded.capabilities()) {
+		for (const auto capability : *capabilities) {
+			capabilities_.push_back(capability->str());
 		}
-		auto infos = root->clientInfos();
+	}
+	if (const auto infos = decoded.clientInfos()) {
 		for (auto info = infos->cbegin(); info != infos->cend(); info++) {
 			auto ipData = info->ipAddress();
-			jassert(ipData->size() == 16);
-			if (ipData->size() == 16) {
+			if (ipData && ipData->size() == 16) {
 				IPAddress ipAddress(ipData->data(), info->isIPV6());
 				JammerNetzStreamQualityInfo qualityInfo;
-				auto qi = info->qualityInfo();
-
-				qualityInfo.tooLateOrDuplicate = qi->tooLateOrDuplicate();
-				qualityInfo.droppedPacketCounter = qi->droppedPacketCounter();
-				qualityInfo.outOfOrderPacketCounter = qi->outOfOrderPacketCounter();
-				qualityInfo.duplicatePacketCounter = qi->duplicatePacketCounter();
-				qualityInfo.dropsHealed = qi->dropsHealed();
-				qualityInfo.packagesPushed = qi->packagesPushed();
-				qualityInfo.packagesPopped = qi->packagesPopped();
-				qualityInfo.maxLengthOfGap = qi->maxLengthOfGap();
-				qualityInfo.maxWrongOrderSpan = qi->maxWrongOrderSpan();
+				if (auto qi = info->qualityInfo()) {
+					qualityInfo.tooLateOrDuplicate = qi->tooLateOrDuplicate();
+					qualityInfo.droppedPacketCounter = qi->droppedPacketCounter();
+					qualityInfo.outOfOrderPacketCounter = qi->outOfOrderPacketCounter();
+					qualityInfo.duplicatePacketCounter = qi->duplicatePacketCounter();
+					qualityInfo.dropsHealed = qi->dropsHealed();
+					qualityInfo.packagesPushed = qi->packagesPushed();
+					qualityInfo.packagesPopped = qi->packagesPopped();
+					qualityInfo.maxLengthOfGap = qi->maxLengthOfGap();
+					qualityInfo.maxWrongOrderSpan = qi->maxWrongOrderSpan();
+				}
 
 				clientInfos_.emplace_back(ipAddress, info->portNumber(), qualityInfo);
 			}
 		}
 	}
-	else {
-		jassert(false);
-	}
 }
 
 JammerNetzClientInfoMessage::JammerNetzClientInfoMessage()
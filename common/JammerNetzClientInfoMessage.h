@@ -10,6 +10,8 @@
 
 #include <vector>
 
+struct JammerNetzPNPClientInfoPackage;
+
 /*
   | CLIENTINFO type message - these are sent only by the server to the clients
   | JammerNetzClientInfoMessage
@@ -61,8 +63,8 @@ public:
 	String getIPAddress(uint8 clientNo) const;
 	JammerNetzStreamQualityInfo getStreamQuality(uint8 clientNo) const;
 
-	// Deserializing constructor, used by JammerNetzMessage::deserialize()
-	JammerNetzClientInfoMessage(uint8 *data, size_t bytes);
+	// Deserializing constructor, the package has been verified by decodeJammerNetzMessage()
+	explicit JammerNetzClientInfoMessage(JammerNetzPNPClientInfoPackage const &decoded);
 
 	// Implementing the serialization interface
 	virtual void serialize(uint8 *output, size_t &byteswritten) const override;
@@ -0,0 +1,171 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "JammerNetzMessageView.h"
+
+#include "JammerNetzPackages_generated.h"
+
+namespace {
+
+std::string_view viewOf(flatbuffers::String const *text) noexcept
+{
+	return text ? std::string_view(text->c_str(), text->size()) : std::string_view();
+}
+
+bool containsCapability(flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>> const *capabilities, std::string_view capability) noexcept
+{
+	if (capabilities) {
+		for (const auto candidate : *capabilities) {
+			if (viewOf(candidate) == capability) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+} // namespace
+
+uint64 JammerNetzAudioDataView::messageCounter() const noexcept
+{
+	return decoded_->audioBlocks()->Get(0)->messageCounter();
+}
+
+double JammerNetzAudioDataView::timestamp() const noexcept
+{
+	return decoded_->audioBlocks()->Get(0)->timestamp();
+}
+
+uint64 JammerNetzAudioDataView::serverTime() const noexcept
+{
+	return decoded_->audioBlocks()->Get(0)->serverTime();
+}
+
+int JammerNetzAudioDataView::sampleRate() const noexcept
+{
+	return static_cast<int>(decoded_->audioBlocks()->Get(0)->sampleRateHz());
+}
+
+int JammerNetzAudioDataView::numSamples() const noexcept
+{
+	return JammerNetzAudioData::numSamples(*decoded_->audioBlocks()->Get(0));
+}
+
+uint16 JammerNetzAudioDataView::protocolVersion() const noexcept
+{
+	return decoded_->protocolVersion();
+}
+
+int JammerNetzAudioDataView::blockCount() const noexcept
+{
+	return static_cast<int>(decoded_->audioBlocks()->size());
+}
+
+JammerNetzPNPAudioBlock const &JammerNetzAudioDataView::block(int index) const noexcept
+{
+	return *decoded_->audioBlocks()->Get(static_cast<flatbuffers::uoffset_t>(index));
+}
+
+std::optional<JammerNetzChannelSetup> JammerNetzAudioDataView::legacySessionSetup() const
+{
+	if (decoded_->audioBlocks()->Get(0)->allChannels() == nullptr) {
+		return {};
+	}
+	// Rare enough to not bother with a separate reader
+	return JammerNetzAudioData(*decoded_).legacySessionSetup();
+}
+
+std::shared_ptr<JammerNetzAudioData> JammerNetzAudioDataView::toMessage() const
+{
+	return std::make_shared<JammerNetzAudioData>(*decoded_);
+}
+
+void JammerNetzAudioDataView::readInto(JammerNetzAudioData &message) const
+{
+	message.assign(*decoded_);
+}
+
+bool JammerNetzClientInfoView::supportsCapability(std::string_view capability) const noexcept
+{
+	return containsCapability(decoded_->capabilities(), capability);
+}
+
+std::shared_ptr<JammerNetzClientInfoMessage> JammerNetzClientInfoView::toMessage() const
+{
+	return std::make_shared<JammerNetzClientInfoMessage>(*decoded_);
+}
+
+bool JammerNetzSessionInfoView::supportsCapability(std::string_view capability) const noexcept
+{
+	return containsCapability(decoded_->capabilities(), capability);
+}
+
+std::shared_ptr<JammerNetzSessionInfoMessage> JammerNetzSessionInfoView::toMessage() const
+{
+	return std::make_shared<JammerNetzSessionInfoMessage>(*decoded_);
+}
+
+std::string_view JammerNetzControlView::text() const noexcept
+{
+	return viewOf(decoded_->control_message_json());
+}
+
+std::optional<nlohmann::json> JammerNetzControlView::json() const
+{
+	const auto content = text();
+	auto parsed = nlohmann::json::parse(content.begin(), content.end(), nullptr, false);
+	if (parsed.is_discarded()) {
+		return {};
+	}
+	return parsed;
+}
+
+std::shared_ptr<JammerNetzControlMessage> JammerNetzControlView::toMessage() const
+{
+	auto parsed = json();
+	return parsed ? std::make_shared<JammerNetzControlMessage>(*parsed) : nullptr;
+}
+
+JammerNetzDecodedMessage decodeJammerNetzMessage(const uint8 *data, size_t bytes) noexcept
+{
+	if (bytes < sizeof(JammerNetzHeader)) {
+		return JammerNetzDecodeError::TooShort;
+	}
+	auto header = reinterpret_cast<const JammerNetzHeader *>(data);
+	if (header->magic0 != '1' || header->magic1 != '2' || header->magic2 != '3') {
+		return JammerNetzDecodeError::NotJammerNetz;
+	}
+
+	const uint8 *payload = data + sizeof(JammerNetzHeader);
+	flatbuffers::Verifier verifier(payload, bytes - sizeof(JammerNetzHeader));
+	switch (header->messageType) {
+	case JammerNetzMessage::AUDIODATA:
+		if (bytes >= sizeof(JammerNetzAudioHeader) && VerifyJammerNetzPNPAudioDataBuffer(verifier)) {
+			const auto audio = GetJammerNetzPNPAudioData(payload);
+			if (JammerNetzAudioData::canDecode(*audio)) {
+				return JammerNetzAudioDataView(*audio);
+			}
+		}
+		return JammerNetzDecodeError::Malformed;
+	case JammerNetzMessage::CLIENTINFO:
+		if (VerifyJammerNetzPNPClientInfoPackageBuffer(verifier)) {
+			return JammerNetzClientInfoView(*GetJammerNetzPNPClientInfoPackage(payload));
+		}
+		return JammerNetzDecodeError::Malformed;
+	case JammerNetzMessage::SESSIONSETUP:
+		if (VerifyJammerNetzSessionInfoBuffer(verifier)) {
+			return JammerNetzSessionInfoView(*GetJammerNetzSessionInfo(payload));
+		}
+		return JammerNetzDecodeError::Malformed;
+	case JammerNetzMessage::GENERIC_JSON:
+		if (VerifyJammerNetzControlInfoBuffer(verifier) && GetJammerNetzControlInfo(payload)->control_message_json() != nullptr) {
+			return JammerNetzControlView(*GetJammerNetzControlInfo(payload));
+		}
+		return JammerNetzDecodeError::Malformed;
+	default:
+		return JammerNetzDecodeError::UnknownType;
+	}
+}
@@ -0,0 +1,98 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JammerNetzPackage.h"
+#include "JammerNetzClientInfoMessage.h"
+
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <variant>
+
+struct JammerNetzPNPClientInfoPackage;
+
+// Why a received datagram was not decoded. Nothing is thrown or allocated for these, so a flood of garbage
+// costs the receive thread no more than the verification.
+enum class JammerNetzDecodeError : uint8 {
+	TooShort, // Not even a header
+	NotJammerNetz, // Wrong magic, e.g. a port scanner or a client with another key
+	UnknownType, // A message type of a newer version
+	Malformed // Failed flatbuffer verification, or audio we can't mix
+};
+
+// The views below point into the receive buffer and must not outlive it. The package has been verified when
+// they are created, so reading from them and turning them into messages can't fail.
+
+class JammerNetzAudioDataView {
+public:
+	explicit JammerNetzAudioDataView(JammerNetzPNPAudioData const &decoded) noexcept : decoded_(&decoded) {}
+
+	// Of the active block
+	uint64 messageCounter() const noexcept;
+	double timestamp() const noexcept;
+	uint64 serverTime() const noexcept;
+	int sampleRate() const noexcept;
+	int numSamples() const noexcept;
+	uint16 protocolVersion() const noexcept;
+
+	// The active block first, then the FEC block if the sender appended one
+	int blockCount() const noexcept;
+	JammerNetzPNPAudioBlock const &block(int index) const noexcept;
+	// Only sent by servers speaking the legacy protocol, then allocates
+	std::optional<JammerNetzChannelSetup> legacySessionSetup() const;
+
+	// Copies the samples out of the receive buffer, for the jitter buffer or the player
+	std::shared_ptr<JammerNetzAudioData> toMessage() const;
+	// The same into a message that is recycled, see JammerNetzAudioData::assign()
+	void readInto(JammerNetzAudioData &message) const;
+
+private:
+	JammerNetzPNPAudioData const *decoded_;
+};
+
+class JammerNetzClientInfoView {
+public:
+	explicit JammerNetzClientInfoView(JammerNetzPNPClientInfoPackage const &decoded) noexcept : decoded_(&decoded) {}
+
+	bool supportsCapability(std::string_view capability) const noexcept;
+	std::shared_ptr<JammerNetzClientInfoMessage> toMessage() const;
+
+private:
+	JammerNetzPNPClientInfoPackage const *decoded_;
+};
+
+class JammerNetzSessionInfoView {
+public:
+	explicit JammerNetzSessionInfoView(JammerNetzSessionInfo const &decoded) noexcept : decoded_(&decoded) {}
+
+	bool supportsCapability(std::string_view capability) const noexcept;
+	std::shared_ptr<JammerNetzSessionInfoMessage> toMessage() const;
+
+private:
+	JammerNetzSessionInfo const *decoded_;
+};
+
+class JammerNetzControlView {
+public:
+	explicit JammerNetzControlView(JammerNetzControlInfo const &decoded) noexcept : decoded_(&decoded) {}
+
+	std::string_view text() const noexcept;
+	// Empty if the text is not valid JSON
+	std::optional<nlohmann::json> json() const;
+	std::shared_ptr<JammerNetzControlMessage> toMessage() const;
+
+private:
+	JammerNetzControlInfo const *decoded_;
+};
+
+using JammerNetzDecodedMessage = std::variant<JammerNetzDecodeError, JammerNetzAudioDataView, JammerNetzClientInfoView,
+	JammerNetzSessionInfoView, JammerNetzControlView>;
+
+// Checks the header, verifies the flatbuffer and hands out a view of the message, without allocating or throwing.
+// The receive threads branch on the alternative and only copy out what they keep.
+JammerNetzDecodedMessage decodeJammerNetzMessage(const uint8 *data, size_t bytes) noexcept;
@@ -8,9 +8,21 @@
 
 #include "BuffersConfig.h"
 
-#include "JammerNetzClientInfoMessage.h"
+#include "JammerNetzMessageView.h"
 
 #include <limits>
+#include <type_traits>
+#include <variant>
+
+namespace {
+
+// The FEC block is sent at a reduced rate and stretched back to the session rate when reading
+size_t upsampleRateOf(JammerNetzPNPAudioBlock const &block) noexcept
+{
+	return block.sampleRate() != 0 ? 48000 / block.sampleRate() : 48000;
+}
+
+} // namespace
 
 JammerNetzSingleChannelSetup::JammerNetzSingleChannelSetup() :
 	target(JammerNetzChannelTarget::Mono), volume(1.0f), mag(0.0f), rms(0.0f), pitch(0.0f), name("")
@@ -52,7 +64,7 @@ bool JammerNetzChannelSetup::isEqualEnough(const JammerNetzChannelSetup &other)
 	return true;
 }
 
-AudioBlock::AudioBlock(double timestamp_, uint64 messageCounter_, uint64 serverTime_, float bpm_, MidiSignal midiSignal_, uint16 sampleRate_, JammerNetzChannelSetup const &channelSetup_,
+AudioBlock::AudioBlock(double timestamp_, uint64 messageCounter_, uint64 serverTime_, float bpm_, MidiSignal midiSignal_, int sampleRate_, JammerNetzChannelSetup const &channelSetup_,
                        std::shared_ptr<AudioBuffer<float>> audioBuffer_) :
 	timestamp(timestamp_), messageCounter(messageCounter_), serverTime(serverTime_), bpm(bpm_), midiSignal(midiSignal_), sampleRate(sampleRate_), channelSetup(channelSetup_), audioBuffer(audioBuffer_)
 {
@@ -60,35 +72,21 @@ AudioBlock::AudioBlock(double timestamp_, uint64 messageCounter_, uint64 serverT
 
 std::shared_ptr<JammerNetzMessage> JammerNetzMessage::deserialize(uint8 *data, size_t bytes)
 {
-	if (bytes >= sizeof(JammerNetzHeader)) {
-		auto header = reinterpret_cast<JammerNetzHeader*>(data);
-
-		try {
-			// Check the magic
-			if (header->magic0 == '1' && header->magic1 == '2' && header->magic2 == '3') {
-				switch (header->messageType) {
-				case AUDIODATA:
-					return std::make_shared<JammerNetzAudioData>(data, bytes);
-				case CLIENTINFO:
-					return std::make_shared<JammerNetzClientInfoMessage>(data, bytes);
-                case SESSIONSETUP:
-                    return std::make_shared<JammerNetzSessionInfoMessage>(data, bytes);
-                case GENERIC_JSON:
-                    return std::make_shared<JammerNetzControlMessage>(data, bytes);
-				default:
-					std::cerr << "Unknown message type received, ignoring it" << std::endl;
-				}
+	return std::visit([](auto const &decoded) -> std::shared_ptr<JammerNetzMessage> {
+		if constexpr (std::is_same_v<std::decay_t<decltype(decoded)>, JammerNetzDecodeError>) {
+			if (decoded == JammerNetzDecodeError::UnknownType) {
+				std::cerr << "Unknown message type received, ignoring it" << std::endl;
 			}
-		}
-		catch (JammerNetzMessageParseException &) {
 			// Invalid, probably tampered with or old 1.0 package
 			return nullptr;
 		}
-	}
-	return nullptr;;
+		else {
+			return decoded.toMessage();
+		}
+	}, decodeJammerNetzMessage(data, bytes));
 }
 
-size_t JammerNetzMessage::writeHeader(uint8 *output, uint8 messageType) const
+size_t JammerNetzMessage::writeHeader(uint8 *output, uint8 messageType)
 {
 	JammerNetzHeader *header = reinterpret_cast<JammerNetzHeader*>(output);
 	header->magic0 = '1';
@@ -99,37 +97,34 @@ size_t JammerNetzMessage::writeHeader(uint8 *output, uint8 messageType) const
 }
 
 // Deserializing constructor
-JammerNetzAudioData::JammerNetzAudioData(uint8 *data, size_t bytes) {
-	if (bytes < sizeof(JammerNetzAudioHeader)) {
-		throw JammerNetzMessageParseException();
-		return;
-	}
+JammerNetzAudioData::JammerNetzAudioData(JammerNetzPNPAudioData const &decoded)
+{
+	assign(decoded);
+}
 
-	flatbuffers::Verifier verifier(data + sizeof(JammerNetzHeader), bytes - sizeof(JammerNetzHeader));
-	if (VerifyJammerNetzPNPAudioDataBuffer(verifier)) {
-		auto root = GetJammerNetzPNPAudioData(data + sizeof(JammerNetzHeader));
-		protocolVersion_ = root->protocolVersion();
-		int blockNo = 0;
-		for (auto block = root->audioBlocks()->cbegin(); block != root->audioBlocks()->cend(); block++) {
-			if (blockNo == 0) {
-				audioBlock_ = readAudioHeaderAndBytes(*block);
-				activeBlock_ = audioBlock_;
-				if ((*block)->allChannels() != nullptr) {
-					legacySessionSetup_ = readChannelSetup((*block)->allChannels());
-				}
-			}
-			else if (blockNo == 1) {
-				fecBlock_ = readAudioHeaderAndBytes(*block);
-			}
-			else {
-				jassertfalse;
-				throw JammerNetzMessageParseException();
-			}
-			blockNo++;
+void JammerNetzAudioData::assign(JammerNetzPNPAudioData const &decoded)
+{
+	jassert(canDecode(decoded));
+	protocolVersion_ = decoded.protocolVersion();
+	const auto blocks = decoded.audioBlocks();
+	// Only audioBlock_ counts as a reference of its own below
+	activeBlock_.reset();
+	readAudioHeaderAndBytes(*blocks->Get(0), audioBlock_);
+	activeBlock_ = audioBlock_;
+	if (blocks->Get(0)->allChannels() != nullptr) {
+		if (!legacySessionSetup_.has_value()) {
+			legacySessionSetup_.emplace(false);
 		}
+		readChannelSetup(blocks->Get(0)->allChannels(), *legacySessionSetup_);
+	}
+	else {
+		legacySessionSetup_.reset();
+	}
+	if (blocks->size() > 1) {
+		readAudioHeaderAndBytes(*blocks->Get(1), fecBlock_);
 	}
 	else {
-		throw JammerNetzMessageParseException();
+		fecBlock_.reset();
 	}
 }
 
@@ -142,7 +137,7 @@ JammerNetzAudioData::JammerNetzAudioData(uint64 messageCounter, double timestamp
 	audioBlock_->messageCounter = messageCounter;
 	audioBlock_->timestamp = timestamp;
 	audioBlock_->serverTime = 0;
-	audioBlock_->sampleRate = (uint16) sampleRate; // What about 96kHz?
+	audioBlock_->sampleRate = sampleRate;
 	audioBlock_->bpm = 0.0f;
 	if (bpm.has_value()) {
 		audioBlock_->bpm = *bpm;
@@ -197,7 +192,7 @@ std::shared_ptr<JammerNetzAudioData> JammerNetzAudioData::createPrePaddingPackag
 	auto silence = std::make_shared<AudioBuffer<float>>();
 	*silence = *audioBlock_->audioBuffer; // Deep copy
 	silence->clear();
-	auto result = std::make_shared<JammerNetzAudioData>(audioBlock_->messageCounter - 1, audioBlock_->timestamp, audioBlock_->channelSetup, SAMPLE_RATE, std::optional<float>(),
+	auto result = std::make_shared<JammerNetzAudioData>(audioBlock_->messageCounter - 1, audioBlock_->timestamp, audioBlock_->channelSetup, audioBlock_->sampleRate, std::optional<float>(),
 		MidiSignal_None,
 	    silence, nullptr);
 	result->protocolVersion_ = protocolVersion_;
@@ -205,11 +200,58 @@ std::shared_ptr<JammerNetzAudioData> JammerNetzAudioData::createPrePaddingPackag
 	return result;
 }
 
+std::shared_ptr<JammerNetzAudioData> JammerNetzAudioData::withAudioFrom(JammerNetzAudioData const &earlier) const
+{
+	auto result = std::make_shared<JammerNetzAudioData>(activeBlock_->messageCounter, activeBlock_->timestamp, earlier.channelSetup(), earlier.sampleRate(),
+		activeBlock_->bpm, activeBlock_->midiSignal, earlier.audioBuffer(), nullptr);
+	result->protocolVersion_ = protocolVersion_;
+	result->legacySessionSetup_ = legacySessionSetup_;
+	return result;
+}
+
 JammerNetzMessage::MessageType JammerNetzAudioData::getType() const
 {
 	return AUDIODATA;
 }
 
+bool JammerNetzAudioData::canDecode(JammerNetzPNPAudioData const &verified) noexcept
+{
+	const auto blocks = verified.audioBlocks();
+	if (blocks == nullptr || blocks->size() < 1 || blocks->size() > 2) {
+		return false;
+	}
+	for (const auto block : *blocks) {
+		if (!canDecode(*block)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool JammerNetzAudioData::canDecode(JammerNetzPNPAudioBlock const &block) noexcept
+{
+	// A session at a rate we can't convert from is as good as a broken packet
+	if (!isSupportedSampleRate(static_cast<int>(block.sampleRateHz()))) {
+		return false;
+	}
+	// The block size is chosen per session, but it has to be one we can mix
+	const size_t upsampleRate = upsampleRateOf(block);
+	const size_t numSamples = block.numberOfSamples() * upsampleRate;
+	if (!isSupportedSampleBufferSize(static_cast<int>(numSamples))) {
+		return false;
+	}
+	const auto channels = block.channels();
+	if (channels == nullptr || channels->size() > block.numChannels()) {
+		return false;
+	}
+	for (const auto channel : *channels) {
+		if (channel->audioSamples() == nullptr || channel->audioSamples()->size() * upsampleRate > numSamples) {
+			return false;
+		}
+	}
+	return true;
+}
+
 void JammerNetzAudioData::serialize(uint8 *output, size_t &byteswritten) const {
 	jassert(audioBlock_);
 	byteswritten = writeHeader(output, AUDIODATA);
@@ -219,9 +261,9 @@ void JammerNetzAudioData::serialize(uint8 *output, size_t &byteswritten) const {
 	const JammerNetzChannelSetup emptyLegacySession(false);
 	const auto &legacySessionSetup = legacySessionSetup_.has_value() ? *legacySessionSetup_ : emptyLegacySession;
 
-	audioBlocks.push_back(serializeAudioBlock(fbb, audioBlock_, 48000, 1, legacySessionSetup));
+	audioBlocks.push_back(serializeAudioBlock(fbb, audioBlock_, 1, legacySessionSetup));
 	if (fecBlock_) {
-		audioBlocks.push_back(serializeAudioBlock(fbb, fecBlock_, 48000, FEC_SAMPLERATE_REDUCTION, legacySessionSetup));
+		audioBlocks.push_back(serializeAudioBlock(fbb, fecBlock_, FEC_SAMPLERATE_REDUCTION, legacySessionSetup));
 	}
 
 	auto blockVec = fbb.CreateVector(audioBlocks);
@@ -234,7 +276,7 @@ void JammerNetzAudioData::serialize(uint8 *output, size_t &byteswritten) const {
 	byteswritten += fbb.GetSize();
 }
 
-flatbuffers::Offset<JammerNetzPNPAudioBlock> JammerNetzAudioData::serializeAudioBlock(flatbuffers::FlatBufferBuilder &fbb, std::shared_ptr<AudioBlock> src, uint16 sampleRate, uint16 reductionFactor, JammerNetzChannelSetup const &legacySessionSetup) const
+flatbuffers::Offset<JammerNetzPNPAudioBlock> JammerNetzAudioData::serializeAudioBlock(flatbuffers::FlatBufferBuilder &fbb, std::shared_ptr<AudioBlock> src, uint16 reductionFactor, JammerNetzChannelSetup const &legacySessionSetup) const
 {
 	std::vector<flatbuffers::Offset<JammerNetzPNPChannelSetup>> channelSetup;
 	for (const auto& channel : src->channelSetup.channels) {
@@ -258,7 +300,8 @@ flatbuffers::Offset<JammerNetzPNPAudioBlock> JammerNetzAudioData::serializeAudio
 	audioBlock.add_midiSignal(src->midiSignal);
 	audioBlock.add_numberOfSamples((uint16)src->audioBuffer->getNumSamples() / reductionFactor);
 	audioBlock.add_numChannels((uint8)src->audioBuffer->getNumChannels());
-	audioBlock.add_sampleRate(sampleRate / reductionFactor);
+	audioBlock.add_sampleRate(static_cast<uint16>(48000 / reductionFactor));
+	audioBlock.add_sampleRateHz(static_cast<uint32_t>(src->sampleRate));
 	audioBlock.add_channelSetup(channelSetupVector);
 	audioBlock.add_channels(audioSamples);
 	audioBlock.add_allChannels(legacySessionVector);
@@ -328,11 +371,21 @@ MidiSignal JammerNetzAudioData::midiSignal() const
 	return activeBlock_->midiSignal;
 }
 
+int JammerNetzAudioData::sampleRate() const
+{
+	return activeBlock_->sampleRate;
+}
+
 JammerNetzChannelSetup JammerNetzAudioData::channelSetup() const
 {
 	return activeBlock_->channelSetup;
 }
 
+std::shared_ptr<AudioBlock> JammerNetzAudioData::fecBlock() const
+{
+	return fecBlock_;
+}
+
 uint16 JammerNetzAudioData::protocolVersion() const
 {
 	return protocolVersion_;
@@ -348,79 +401,151 @@ void JammerNetzAudioData::setLegacySessionSetup(JammerNetzChannelSetup const &se
 	legacySessionSetup_ = sessionSetup;
 }
 
-JammerNetzChannelSetup JammerNetzAudioData::readChannelSetup(flatbuffers::Vector<flatbuffers::Offset<JammerNetzPNPChannelSetup>> const *channels)
+void JammerNetzAudioData::readChannelSetup(flatbuffers::Vector<flatbuffers::Offset<JammerNetzPNPChannelSetup>> const *channels, JammerNetzChannelSetup &into)
 {
-	JammerNetzChannelSetup result(false);
-	if (channels == nullptr) {
-		return result;
-	}
-	for (const auto channel : *channels) {
-		JammerNetzSingleChannelSetup setup(channel->target());
+	// Overwritten in place, a client's setup rarely changes so the names keep their storage
+	into.isLocalMonitoringDontSendEcho = false;
+	into.channels.resize(channels != nullptr ? channels->size() : 0);
+	for (size_t i = 0; i < into.channels.size(); i++) {
+		const auto channel = channels->Get(static_cast<flatbuffers::uoffset_t>(i));
+		auto &setup = into.channels[i];
+		setup.target = channel->target();
 		setup.volume = channel->volume();
 		setup.mag = channel->mag();
 		setup.rms = channel->rms();
 		setup.pitch = channel->pitch();
 		if (const auto *name = channel->name()) {
-			setup.name = name->str();
+			setup.name.assign(name->c_str(), name->size());
+		}
+		else {
+			setup.name.clear();
 		}
-		result.channels.push_back(setup);
 	}
-	return result;
 }
 
-std::shared_ptr<AudioBlock> JammerNetzAudioData::readAudioHeaderAndBytes(JammerNetzPNPAudioBlock const *block) {
-	auto result = std::make_shared<AudioBlock>();
-
-	result->messageCounter = block->messageCounter();
-	result->serverTime = block->serverTime();
-	result->bpm = block->bpm();
-	result->midiSignal = block->midiSignal();
-	result->timestamp = block->timestamp();
-	result->channelSetup = readChannelSetup(block->channelSetup());
+void JammerNetzAudioData::readAudioHeaderAndBytes(JammerNetzPNPAudioBlock const &block, std::shared_ptr<AudioBlock> &into) {
+	// A fill-in or a delayed packet might still share the block or its buffer, those must not change under it
+	if (!into || into.use_count() > 1) {
+		into = std::make_shared<AudioBlock>();
+	}
+	auto &result = *into;
+	result.messageCounter = block.messageCounter();
+	result.serverTime = block.serverTime();
+	result.bpm = block.bpm();
+	result.midiSignal = block.midiSignal();
+	result.timestamp = block.timestamp();
+	readChannelSetup(block.channelSetup(), result.channelSetup);
+
+	result.sampleRate = static_cast<int>(block.sampleRateHz());
+	const int numChannels = static_cast<int>(block.numChannels());
+	if (!result.audioBuffer || result.audioBuffer.use_count() > 1) {
+		result.audioBuffer = std::make_shared<AudioBuffer<float>>(numChannels, numSamples(block));
+	}
+	else {
+		result.audioBuffer->setSize(numChannels, numSamples(block), false, false, true);
+	}
+	readSamples(block, result.audioBuffer->getArrayOfWritePointers(), numChannels);
+}
 
-	result->sampleRate = 48000;
-	size_t upsampleRate = block->sampleRate() != 0 ? 48000 / block->sampleRate() : 48000;
-	jassert(block->numberOfSamples() * upsampleRate == SAMPLE_BUFFER_SIZE);
-	result->audioBuffer = std::make_shared<AudioBuffer<float>>((int) block->numChannels(), (int) (block->numberOfSamples() * upsampleRate));
-	readAudioBytes(block->channels(), result->audioBuffer, upsampleRate);
-	return result;
+int JammerNetzAudioData::numSamples(JammerNetzPNPAudioBlock const &block) noexcept
+{
+	return static_cast<int>(block.numberOfSamples() * upsampleRateOf(block));
 }
 
-void JammerNetzAudioData::readAudioBytes(flatbuffers::Vector<flatbuffers::Offset<JammerNetzPNPAudioSamples>> const *samples, std::shared_ptr<AudioBuffer<float>> destBuffer, size_t upsampleRate) {
+void JammerNetzAudioData::readSamples(JammerNetzPNPAudioBlock const &block, float *const *channels, int numChannels) noexcept
+{
+	const size_t upsampleRate = upsampleRateOf(block);
+	const int samplesPerChannel = numSamples(block);
 	int c = 0;
-	for (auto channel = samples->cbegin(); channel != samples->cend(); channel++) {
-		//TODO we might not have enough bytes in the package for this operation
-		if (upsampleRate == 1) {
-
-			AudioData::Pointer <AudioData::Int16,
-				AudioData::LittleEndian,
-				AudioData::NonInterleaved,
-				AudioData::Const> src_pointer(channel->audioSamples()->data());
-			AudioData::Pointer<AudioData::Float32,
-				AudioData::LittleEndian,
-				AudioData::NonInterleaved,
-				AudioData::NonConst> dst_pointer(destBuffer->getWritePointer(c));
-			dst_pointer.convertSamples(src_pointer, (int) channel->audioSamples()->size());
+	// canDecode() made sure the samples fit into the buffer
+	for (const auto channel : *block.channels()) {
+		if (c >= numChannels) {
+			break;
 		}
-		else {
-			float tempBuffer[MAXFRAMESIZE];
-			AudioData::Pointer <AudioData::Int16,
-				AudioData::LittleEndian,
-				AudioData::NonInterleaved,
-				AudioData::Const> src_pointer(channel->audioSamples()->data());
-			AudioData::Pointer<AudioData::Float32,
-				AudioData::LittleEndian,
-				AudioData::NonInterleaved,
-				AudioData::NonConst> dst_pointer(tempBuffer);
-			dst_pointer.convertSamples(src_pointer, (int) channel->audioSamples()->size());
-
-			auto write = destBuffer->getWritePointer(c);
-			for (size_t i = 0; i < channel->audioSamples()->size(); i++) {
+		const auto received = channel->audioSamples();
+		AudioData::Pointer <AudioData::Int16,
+			AudioData::LittleEndian,
+			AudioData::NonInterleaved,
+			AudioData::Const> src_pointer(received->data());
+		AudioData::Pointer<AudioData::Float32,
+			AudioData::LittleEndian,
+			AudioData::NonInterleaved,
+			AudioData::NonConst> dst_pointer(channels[c]);
+		dst_pointer.convertSamples(src_pointer, (int) received->size());
+
+		auto write = channels[c];
+		if (upsampleRate > 1) {
+			// Stretch in place from the back, so every sample is read before it is overwritten
+			for (size_t i = received->size(); i-- > 0;) {
+				const float sample = write[i];
 				for (size_t j = 0; j < upsampleRate; j++) {
-					write[i * upsampleRate + j] = tempBuffer[i];
+					write[i * upsampleRate + j] = sample;
 				}
 			}
 		}
+		const int written = static_cast<int>(received->size() * upsampleRate);
+		if (written < samplesPerChannel) {
+			FloatVectorOperations::clear(write + written, samplesPerChannel - written);
+		}
 		c++;
 	}
+	for (; c < numChannels; c++) {
+		FloatVectorOperations::clear(channels[c], samplesPerChannel);
+	}
+}
+
+JammerNetzAudioSerializer::JammerNetzAudioSerializer() : fbb_(MAXFRAMESIZE)
+{
+	channelSetup_.reserve(64);
+	channels_.reserve(64);
+}
+
+size_t JammerNetzAudioSerializer::serialize(uint8 *output, uint64 messageCounter, double timestamp, JammerNetzChannelSetup const &channelSetup,
+	float bpm, MidiSignal midiSignal, const float* const* channels, int numChannels, int numSamples, int sampleRate)
+{
+	// Same order of creation as JammerNetzAudioData, so the bytes on the wire are the same
+	fbb_.Clear();
+	channelSetup_.clear();
+	channels_.clear();
+	for (const auto& channel : channelSetup.channels) {
+		auto fb_name = fbb_.CreateString(channel.name);
+		channelSetup_.push_back(CreateJammerNetzPNPChannelSetup(fbb_, channel.target, channel.volume, channel.mag, channel.rms, channel.pitch, fb_name));
+	}
+	auto channelSetupVector = fbb_.CreateVector(channelSetup_);
+	auto legacySessionVector = fbb_.CreateVector(static_cast<const flatbuffers::Offset<JammerNetzPNPChannelSetup>*>(nullptr), 0);
+	for (int inputChannel = 0; inputChannel < numChannels; inputChannel++) {
+		AudioData::Pointer<AudioData::Float32, AudioData::LittleEndian, AudioData::NonInterleaved, AudioData::Const> inputData(channels[inputChannel]);
+		uint16 *outputBuffer;
+		auto singleChannelVector = fbb_.CreateUninitializedVector((size_t) numSamples, &outputBuffer);
+		AudioData::Pointer<AudioData::Int16, AudioData::LittleEndian, AudioData::NonInterleaved, AudioData::NonConst> dataToSend(outputBuffer);
+		dataToSend.convertSamples(inputData, numSamples);
+		channels_.push_back(CreateJammerNetzPNPAudioSamples(fbb_, singleChannelVector));
+	}
+	auto audioSamples = fbb_.CreateVector(channels_);
+
+	JammerNetzPNPAudioBlockBuilder audioBlock(fbb_);
+	audioBlock.add_timestamp(timestamp);
+	audioBlock.add_messageCounter(messageCounter);
+	audioBlock.add_serverTime(0);
+	audioBlock.add_bpm(bpm);
+	audioBlock.add_midiSignal(midiSignal);
+	audioBlock.add_numberOfSamples((uint16)numSamples);
+	audioBlock.add_numChannels((uint8)numChannels);
+	audioBlock.add_sampleRate(48000);
+	audioBlock.add_sampleRateHz(static_cast<uint32_t>(sampleRate));
+	audioBlock.add_channelSetup(channelSetupVector);
+	audioBlock.add_channels(audioSamples);
+	audioBlock.add_allChannels(legacySessionVector);
+	audioBlock.add_wantEcho(!channelSetup.isLocalMonitoringDontSendEcho);
+	const auto block = audioBlock.Finish();
+
+	auto blockVec = fbb_.CreateVector(&block, 1);
+	JammerNetzPNPAudioDataBuilder audioData(fbb_);
+	audioData.add_audioBlocks(blockVec);
+	audioData.add_protocolVersion(JammerNetzProtocol::Current);
+	fbb_.Finish(audioData.Finish());
+
+	size_t byteswritten = JammerNetzMessage::writeHeader(output, JammerNetzMessage::AUDIODATA);
+	memcpy(output + byteswritten, fbb_.GetBufferPointer(), fbb_.GetSize());
+	return byteswritten + fbb_.GetSize();
 }
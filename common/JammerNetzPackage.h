@@ -116,25 +116,18 @@ struct AudioBlock {
 	}
 
 	//AudioBlock(AudioBlock const &other) = default;
-	AudioBlock(double timestamp, uint64 messageCounter, uint64 serverTime, float bpm, MidiSignal midiSignal, uint16 sampleRate, JammerNetzChannelSetup const &channelSetup, std::shared_ptr<AudioBuffer<float>> audioBuffer);
+	AudioBlock(double timestamp, uint64 messageCounter, uint64 serverTime, float bpm, MidiSignal midiSignal, int sampleRate, JammerNetzChannelSetup const &channelSetup, std::shared_ptr<AudioBuffer<float>> audioBuffer);
 	double timestamp; // Using JUCE's high resolution timer
 	juce::uint64 messageCounter;
 	juce::uint64 serverTime;
 	juce::uint64 serverTimeSampleBased;
 	float bpm;
 	MidiSignal midiSignal;
-	uint16 sampleRate;
+	int sampleRate;
 	JammerNetzChannelSetup channelSetup;
 	std::shared_ptr<AudioBuffer<float>> audioBuffer;
 };
 
-struct JammerNetzMessageParseException : public std::exception {
-	[[nodiscard]] const char *what() const noexcept
-	{
-		return "JammerNetz Message Parse Error";
-	}
-};
-
 class JammerNetzMessage {
 public:
 	enum MessageType {
@@ -151,10 +144,13 @@ public:
     [[nodiscard]] virtual MessageType getType() const = 0;
 
 	virtual void serialize(uint8 *output, size_t &byteswritten) const = 0;
+	// Copies a received package into a message object, nullptr if it is invalid. The receive threads use
+	// decodeJammerNetzMessage() from JammerNetzMessageView.h instead, which doesn't allocate for what they drop.
 	static std::shared_ptr<JammerNetzMessage> deserialize(uint8 *data, size_t bytes);
 
 protected:
-	size_t writeHeader(uint8 *output, uint8 messageType) const;
+	friend class JammerNetzAudioSerializer;
+	static size_t writeHeader(uint8 *output, uint8 messageType);
 };
 
 template<JammerNetzMessage::MessageType ID>
@@ -162,13 +158,6 @@ class JammerNetzFlatbufferMessage : public JammerNetzMessage {
 public:
     JammerNetzFlatbufferMessage() = default;
 
-    // Generic deserialization constructor
-    JammerNetzFlatbufferMessage(size_t size) {
-        if (size < sizeof(JammerNetzHeader)) {
-            throw JammerNetzMessageParseException();
-        }
-    }
-
     void serialize(uint8 *output, size_t &byteswritten) const override
     {
         byteswritten = writeHeader(output, static_cast<uint8>(getType()));
@@ -193,20 +182,6 @@ public:
     {
     }
 
-    JammerNetzControlMessage(uint8 *data, size_t size) : JammerNetzFlatbufferMessage<JammerNetzMessage::MessageType::GENERIC_JSON>(size) {
-        uint8* dataStart = data + sizeof(JammerNetzHeader);
-        flatbuffers::Verifier verifier(dataStart, size - sizeof(JammerNetzHeader));
-        if (VerifyJammerNetzControlInfoBuffer(verifier)) {
-            auto buffer = GetJammerNetzControlInfo(dataStart);
-            try {
-                json_ = nlohmann::json::parse(buffer->control_message_json()->str());
-            }
-            catch (nlohmann::json::parse_error &) {
-                throw JammerNetzMessageParseException();
-            }
-        }
-    }
-
     void serializeToFlatbuffer(flatbuffers::FlatBufferBuilder &fbb) const override {
         auto fb_json = fbb.CreateString(json_.dump());
         fbb.Finish(CreateJammerNetzControlInfo(fbb, fb_json));
@@ -222,27 +197,26 @@ public:
     {
     }
 
-    JammerNetzSessionInfoMessage(uint8 *data, size_t size) : JammerNetzFlatbufferMessage<JammerNetzMessage::MessageType::SESSIONSETUP>(size), channels_(false) {
-        uint8* dataStart = data + sizeof(JammerNetzHeader);
-        flatbuffers::Verifier verifier(dataStart, size - sizeof(JammerNetzHeader));
-        if (VerifyJammerNetzSessionInfoBuffer(verifier)) {
-            auto package = GetJammerNetzSessionInfo(dataStart);
-			if (const auto capabilities = package->capabilities()) {
-				for (const auto capability : *capabilities) {
-					capabilities_.push_back(capability->str());
+    // Deserializing constructor, the package has been verified by decodeJammerNetzMessage()
+    explicit JammerNetzSessionInfoMessage(JammerNetzSessionInfo const &decoded) : channels_(false) {
+		if (const auto capabilities = decoded.capabilities()) {
+			for (const auto capability : *capabilities) {
+				capabilities_.push_back(capability->str());
+			}
+		}
+		if (const auto allChannels = decoded.allChannels()) {
+			for (const auto channel : *allChannels) {
+				JammerNetzSingleChannelSetup setup(channel->target());
+				setup.volume = channel->volume();
+				setup.mag = channel->mag();
+				setup.rms = channel->rms();
+				setup.pitch = channel->pitch();
+				if (const auto name = channel->name()) {
+					setup.name = name->str();
 				}
+				channels_.channels.push_back(setup);
 			}
-            channels_.channels.clear();
-            for (auto channel = package->allChannels()->cbegin(); channel != package->allChannels()->cend(); channel++) {
-                JammerNetzSingleChannelSetup setup(channel->target());
-                setup.volume = channel->volume();
-                setup.mag = channel->mag();
-                setup.rms = channel->rms();
-                setup.pitch = channel->pitch();
-                setup.name = channel->name()->str();
-                channels_.channels.push_back(setup);
-            }
-        }
+		}
     }
 
     void serializeToFlatbuffer(flatbuffers::FlatBufferBuilder &fbb) const override
@@ -276,17 +250,34 @@ public:
 
 class JammerNetzAudioData : public JammerNetzMessage {
 public:
-	JammerNetzAudioData(uint8 *data, size_t bytes);
+	// Deserializing constructor, only for packages canDecode() accepted
+	explicit JammerNetzAudioData(JammerNetzPNPAudioData const &decoded);
 	JammerNetzAudioData(uint64 messageCounter, double timestamp, JammerNetzChannelSetup const &channelSetup, int sampleRate, std::optional<float> bpm, MidiSignal midiSignal, std::shared_ptr<AudioBuffer<float>> audioBuffer, std::shared_ptr<AudioBlock> fecBlock);
 	JammerNetzAudioData(AudioBlock const &audioBlock, std::shared_ptr<AudioBlock> fecBlock);
 
 	std::shared_ptr<JammerNetzAudioData> createFillInPackage(uint64 messageNumber, bool &outHadFEC) const;
 	std::shared_ptr<JammerNetzAudioData> createPrePaddingPackage() const;
+	// Keeps this packet's counter, timestamp and controls but carries the audio of an earlier one. The server delays
+	// a stream like this without the client seeing a gap in the counters.
+	std::shared_ptr<JammerNetzAudioData> withAudioFrom(JammerNetzAudioData const &earlier) const;
 
 	virtual MessageType getType() const override;
 
 	virtual void serialize(uint8 *output, size_t &byteswritten) const override;
 
+	// True if a verified package can be turned into audio without reading out of bounds: one active and at most
+	// one FEC block, at a sample rate and block size we can mix, with no more samples than the block announces.
+	static bool canDecode(JammerNetzPNPAudioData const &verified) noexcept;
+	// Samples per channel of a block canDecode() accepted, after stretching a rate reduced FEC block
+	static int numSamples(JammerNetzPNPAudioBlock const &block) noexcept;
+	// Converts the block to float into numChannels channels of numSamples(block) each. Channels the block doesn't carry
+	// are cleared. Does not allocate, so the client can decode straight into its jitter buffer.
+	static void readSamples(JammerNetzPNPAudioBlock const &block, float *const *channels, int numChannels) noexcept;
+
+	// Reads a package canDecode() accepted into this message. Blocks and buffers nobody else holds are reused, so a
+	// pooled message can be refilled without allocating once its buffers are big enough.
+	void assign(JammerNetzPNPAudioData const &decoded);
+
 	// Read access, those use the "active block"
 	std::shared_ptr<AudioBuffer<float>> audioBuffer() const;
 	uint64 messageCounter() const;
@@ -294,17 +285,20 @@ public:
 	uint64 serverTime() const;
 	float bpm() const;
 	MidiSignal midiSignal() const;
+	int sampleRate() const;
 	JammerNetzChannelSetup channelSetup() const;
+	// The redundant copy of an earlier packet the sender appended, if any
+	std::shared_ptr<AudioBlock> fecBlock() const;
 	uint16 protocolVersion() const;
 	std::optional<JammerNetzChannelSetup> legacySessionSetup() const;
 	void setLegacySessionSetup(JammerNetzChannelSetup const &sessionSetup);
 
 private:
-	flatbuffers::Offset<JammerNetzPNPAudioBlock> serializeAudioBlock(flatbuffers::FlatBufferBuilder &fbb, std::shared_ptr<AudioBlock> src, uint16 sampleRate, uint16 reductionFactor, JammerNetzChannelSetup const &legacySessionSetup) const;
+	flatbuffers::Offset<JammerNetzPNPAudioBlock> serializeAudioBlock(flatbuffers::FlatBufferBuilder &fbb, std::shared_ptr<AudioBlock> src, uint16 reductionFactor, JammerNetzChannelSetup const &legacySessionSetup) const;
 	flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<JammerNetzPNPAudioSamples>>> appendAudioBuffer(flatbuffers::FlatBufferBuilder &fbb, AudioBuffer<float> &buffer, uint16 reductionFactor) const;
-	std::shared_ptr<AudioBlock> readAudioHeaderAndBytes(JammerNetzPNPAudioBlock const *block);
-	static JammerNetzChannelSetup readChannelSetup(flatbuffers::Vector<flatbuffers::Offset<JammerNetzPNPChannelSetup>> const *channels);
-	void readAudioBytes(flatbuffers::Vector<flatbuffers::Offset<JammerNetzPNPAudioSamples >> const *samples, std::shared_ptr<AudioBuffer<float>> destBuffer, size_t upsampleRate);
+	static bool canDecode(JammerNetzPNPAudioBlock const &block) noexcept;
+	static void readAudioHeaderAndBytes(JammerNetzPNPAudioBlock const &block, std::shared_ptr<AudioBlock> &into);
+	static void readChannelSetup(flatbuffers::Vector<flatbuffers::Offset<JammerNetzPNPChannelSetup>> const *channels, JammerNetzChannelSetup &into);
 
 	std::shared_ptr<AudioBlock> audioBlock_;
 	std::shared_ptr<AudioBlock> fecBlock_;
@@ -313,6 +307,23 @@ private:
 	std::optional<JammerNetzChannelSetup> legacySessionSetup_;
 };
 
+// Serializes an outgoing audio packet exactly like JammerNetzAudioData::serialize() without FEC, but straight from
+// channel pointers. The builder and its scratch vectors are kept, so once they have grown to the largest packet
+// serializing does not allocate anymore and can run on the audio thread.
+class JammerNetzAudioSerializer {
+public:
+	JammerNetzAudioSerializer();
+
+	// output must hold MAXFRAMESIZE bytes. Returns the bytes written.
+	size_t serialize(uint8 *output, uint64 messageCounter, double timestamp, JammerNetzChannelSetup const &channelSetup,
+		float bpm, MidiSignal midiSignal, const float* const* channels, int numChannels, int numSamples, int sampleRate);
+
+private:
+	flatbuffers::FlatBufferBuilder fbb_;
+	std::vector<flatbuffers::Offset<JammerNetzPNPChannelSetup>> channelSetup_;
+	std::vector<flatbuffers::Offset<JammerNetzPNPAudioSamples>> channels_;
+};
+
 class JammerNetzAudioOrder {
 public:
 	bool operator() (std::shared_ptr<JammerNetzAudioData> const &data1, std::shared_ptr<JammerNetzAudioData> const &data2) {
@@ -0,0 +1,244 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "LatencyTrace.h"
+
+#include "BuffersConfig.h"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+
+const char* latencyStageName(LatencyStage stage) noexcept
+{
+	switch (stage) {
+	case LatencyStage::Capture: return "capture";
+	case LatencyStage::TransmitEnqueue: return "transmit_enqueue";
+	case LatencyStage::Send: return "send";
+	case LatencyStage::ServerReceive: return "server_receive";
+	case LatencyStage::ServerQueuePop: return "server_queue_pop";
+	case LatencyStage::ServerMix: return "server_mix";
+	case LatencyStage::ServerSend: return "server_send";
+	case LatencyStage::ClientReceive: return "client_receive";
+	case LatencyStage::PlayoutWrite: return "playout_write";
+	case LatencyStage::Playout: return "playout";
+	}
+	return "unknown";
+}
+
+LatencyTrace& LatencyTrace::instance()
+{
+	static LatencyTrace trace;
+	return trace;
+}
+
+uint64_t LatencyTrace::streamId(const std::string& streamName) noexcept
+{
+	return static_cast<uint64_t>(std::hash<std::string>{}(streamName));
+}
+
+LatencyTrace::LatencyTrace() : slots_(std::make_unique<std::array<Slot, capacity>>())
+{
+	for (size_t i = 0; i < capacity; ++i) {
+		(*slots_)[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+void LatencyTrace::enable(uint64_t sampleInterval) noexcept
+{
+	sampleInterval_.store(std::max<uint64_t>(1, sampleInterval), std::memory_order_release);
+}
+
+void LatencyTrace::disable() noexcept
+{
+	sampleInterval_.store(0, std::memory_order_release);
+}
+
+bool LatencyTrace::isEnabled() const noexcept
+{
+	return sampleInterval_.load(std::memory_order_relaxed) != 0;
+}
+
+bool LatencyTrace::isSampled(uint64_t packet) const noexcept
+{
+	const auto interval = sampleInterval_.load(std::memory_order_relaxed);
+	return interval != 0 && packet % interval == 0;
+}
+
+void LatencyTrace::stamp(uint64_t stream, uint64_t packet, LatencyStage stage, int samples) noexcept
+{
+	if (isSampled(packet)) {
+		stampAt(stream, packet, stage, Time::getMillisecondCounterHiRes(), samples);
+	}
+}
+
+void LatencyTrace::stampAt(uint64_t stream, uint64_t packet, LatencyStage stage, double timeMs, int samples) noexcept
+{
+	if (!isSampled(packet)) {
+		return;
+	}
+	// Bounded multi-producer ring: a slot is free for position p when its
+	// sequence equals p, and published for the reader when it equals p + 1.
+	auto position = writePosition_.load(std::memory_order_relaxed);
+	for (;;) {
+		auto& slot = (*slots_)[position % capacity];
+		const auto sequence = slot.sequence.load(std::memory_order_acquire);
+		const auto difference = static_cast<int64_t>(sequence - position);
+		if (difference == 0) {
+			if (writePosition_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				slot.event = { stream, packet, stage, timeMs, samples };
+				slot.sequence.store(position + 1, std::memory_order_release);
+				return;
+			}
+		}
+		else if (difference < 0) {
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else {
+			position = writePosition_.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+size_t LatencyTrace::drain(std::vector<LatencyTraceEvent>& events)
+{
+	size_t taken = 0;
+	for (;;) {
+		auto& slot = (*slots_)[readPosition_ % capacity];
+		if (slot.sequence.load(std::memory_order_acquire) != readPosition_ + 1) {
+			return taken;
+		}
+		events.push_back(slot.event);
+		slot.sequence.store(readPosition_ + capacity, std::memory_order_release);
+		++readPosition_;
+		++taken;
+	}
+}
+
+uint64_t LatencyTrace::droppedEvents() const noexcept
+{
+	return dropped_.load(std::memory_order_relaxed);
+}
+
+void LatencyBreakdownCollector::add(const LatencyTraceEvent& event)
+{
+	const auto stageIndex = static_cast<size_t>(event.stage);
+	if (stageIndex >= latencyStageCount) {
+		return;
+	}
+	auto [entry, inserted] = pending_.try_emplace({ event.stream, event.packet });
+	auto& pending = entry->second;
+	if (inserted) {
+		pending.firstSeenMs = event.timeMs;
+	}
+	// Keep the first stamp of a stage, e.g. the first playout of a packet the
+	// server repeated as FEC fill-in.
+	if (!pending.seen[stageIndex]) {
+		pending.seen[stageIndex] = true;
+		pending.stampsMs[stageIndex] = event.timeMs;
+	}
+	if (event.samples > 0) {
+		pending.samples = event.samples;
+	}
+	newestMs_ = std::max(newestMs_, event.timeMs);
+}
+
+std::vector<nlohmann::json> LatencyBreakdownCollector::takeBreakdowns(bool flushIncomplete)
+{
+	std::vector<nlohmann::json> result;
+	for (auto it = pending_.begin(); it != pending_.end();) {
+		const auto& pending = it->second;
+		// Client traces end with playout, server traces with the mix sent back.
+		const bool complete = pending.seen[static_cast<size_t>(LatencyStage::Playout)]
+			|| pending.seen[static_cast<size_t>(LatencyStage::ServerSend)];
+		const bool expired = newestMs_ - pending.firstSeenMs > incompleteTimeoutMs;
+		if (complete || expired || flushIncomplete) {
+			result.push_back(breakdown(it->first.first, it->first.second, pending));
+			it = pending_.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	return result;
+}
+
+size_t LatencyBreakdownCollector::pendingPackets() const noexcept
+{
+	return pending_.size();
+}
+
+nlohmann::json LatencyBreakdownCollector::breakdown(uint64_t stream, uint64_t packet, const PendingPacket& pending)
+{
+	auto stages = nlohmann::json::array();
+	std::optional<double> first;
+	std::optional<double> previous;
+	for (size_t stage = 0; stage < latencyStageCount; ++stage) {
+		if (!pending.seen[stage]) {
+			continue;
+		}
+		const double timeMs = pending.stampsMs[stage];
+		// Client and server clocks are unrelated, so only differences within one process are meaningful.
+		stages.push_back({
+			{ "stage", latencyStageName(static_cast<LatencyStage>(stage)) },
+			{ "time_ms", timeMs },
+			{ "since_previous_ms", previous ? timeMs - *previous : 0.0 }
+		});
+		if (!first) {
+			first = timeMs;
+		}
+		previous = timeMs;
+	}
+	const bool complete = pending.seen[static_cast<size_t>(LatencyStage::Playout)]
+		|| pending.seen[static_cast<size_t>(LatencyStage::ServerSend)];
+	return {
+		// The block size of the packet, the default only for traces without a stamp where the audio entered
+		{ "virtual_sample", packet * static_cast<uint64_t>(pending.samples > 0 ? pending.samples : SAMPLE_BUFFER_SIZE) },
+		{ "sequence", sequence_++ },
+		{ "kind", "latency_breakdown" },
+		{ "details", {
+			{ "stream", stream },
+			{ "packet", packet },
+			{ "complete", complete },
+			{ "total_ms", first && previous ? *previous - *first : 0.0 },
+			{ "stages", stages }
+		} }
+	};
+}
+
+LatencyTraceWriter::LatencyTraceWriter(juce::File path) : path_(std::move(path))
+{
+	path_.deleteFile();
+}
+
+LatencyTraceWriter::~LatencyTraceWriter()
+{
+	flush(true);
+}
+
+void LatencyTraceWriter::flush(bool final)
+{
+	events_.clear();
+	LatencyTrace::instance().drain(events_);
+	for (const auto& event : events_) {
+		collector_.add(event);
+	}
+	const auto breakdowns = collector_.takeBreakdowns(final);
+	if (breakdowns.empty()) {
+		return;
+	}
+	std::string contents;
+	for (const auto& document : breakdowns) {
+		contents += document.dump();
+		contents.push_back('\n');
+	}
+	juce::FileOutputStream output(path_);
+	if (output.openedOk()) {
+		output.write(contents.data(), contents.size());
+		output.flush();
+	}
+}
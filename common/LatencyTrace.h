@@ -0,0 +1,132 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include "nlohmann/json.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Stages a traced audio packet passes on its way from the client's input to
+// the client's output. The client's messageCounter identifies the packet along
+// the whole path, because the server echoes it in the mix it sends back.
+enum class LatencyStage : uint8_t {
+	Capture,
+	TransmitEnqueue,
+	Send,
+	ServerReceive,
+	ServerQueuePop,
+	ServerMix,
+	ServerSend,
+	ClientReceive,
+	PlayoutWrite,
+	Playout
+};
+
+constexpr size_t latencyStageCount = static_cast<size_t>(LatencyStage::Playout) + 1;
+
+const char* latencyStageName(LatencyStage stage) noexcept;
+
+struct LatencyTraceEvent {
+	uint64_t stream { 0 };
+	uint64_t packet { 0 };
+	LatencyStage stage { LatencyStage::Capture };
+	double timeMs { 0.0 }; // Time::getMillisecondCounterHiRes() of the recording process
+	int samples { 0 }; // Block size of the packet, only stamped where the audio enters a process
+};
+
+// Process-wide, opt-in packet latency tracer. Only every n-th packet (by client
+// messageCounter) is stamped. stamp() is lock-free and allocation-free, so it
+// may be called from the audio callback; events that do not fit into the
+// bounded buffer are counted and dropped.
+class LatencyTrace {
+public:
+	static constexpr size_t capacity = 8192;
+	static constexpr uint64_t defaultSampleInterval = 64;
+
+	static LatencyTrace& instance();
+	// Stable id for a server-side stream key such as "ip:port". Clients trace their own stream as 0.
+	static uint64_t streamId(const std::string& streamName) noexcept;
+
+	void enable(uint64_t sampleInterval = defaultSampleInterval) noexcept;
+	void disable() noexcept;
+	bool isEnabled() const noexcept;
+	bool isSampled(uint64_t packet) const noexcept;
+
+	void stamp(uint64_t stream, uint64_t packet, LatencyStage stage, int samples = 0) noexcept;
+	// For a stage that happened earlier, timeMs is its Time::getMillisecondCounterHiRes()
+	void stampAt(uint64_t stream, uint64_t packet, LatencyStage stage, double timeMs, int samples = 0) noexcept;
+
+	// Single consumer. Appends all currently published events and returns how many were taken.
+	size_t drain(std::vector<LatencyTraceEvent>& events);
+	uint64_t droppedEvents() const noexcept;
+
+	LatencyTrace();
+
+private:
+	struct Slot {
+		std::atomic<uint64_t> sequence { 0 };
+		LatencyTraceEvent event;
+	};
+
+	std::atomic<uint64_t> sampleInterval_ { 0 };
+	std::unique_ptr<std::array<Slot, capacity>> slots_;
+	std::atomic<uint64_t> writePosition_ { 0 };
+	uint64_t readPosition_ { 0 };
+	std::atomic<uint64_t> dropped_ { 0 };
+};
+
+// Groups traced stage events into one per-packet breakdown line. The JSONL
+// schema matches ScenarioTrace::writeJsonLines, so latency traces can be read by
+// the same tooling as the deterministic test scenarios.
+class LatencyBreakdownCollector {
+public:
+	// Packets whose last stage has not been seen within this window are emitted incomplete.
+	static constexpr double incompleteTimeoutMs = 5000.0;
+
+	void add(const LatencyTraceEvent& event);
+	// Moves finished packets out as ScenarioTrace style documents.
+	std::vector<nlohmann::json> takeBreakdowns(bool flushIncomplete);
+	size_t pendingPackets() const noexcept;
+
+private:
+	struct PendingPacket {
+		std::array<double, latencyStageCount> stampsMs {};
+		std::array<bool, latencyStageCount> seen {};
+		double firstSeenMs { 0.0 };
+		int samples { 0 };
+	};
+
+	nlohmann::json breakdown(uint64_t stream, uint64_t packet, const PendingPacket& pending);
+
+	std::map<std::pair<uint64_t, uint64_t>, PendingPacket> pending_;
+	double newestMs_ { 0.0 };
+	uint64_t sequence_ { 0 };
+};
+
+// Periodically drains LatencyTrace::instance() into a JSONL file. Not real-time safe;
+// call from a timer or housekeeping thread.
+class LatencyTraceWriter {
+public:
+	explicit LatencyTraceWriter(juce::File path);
+	~LatencyTraceWriter();
+
+	void flush(bool final = false);
+
+private:
+	juce::File path_;
+	LatencyBreakdownCollector collector_;
+	std::vector<LatencyTraceEvent> events_;
+};
@@ -0,0 +1,473 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "NetworkImpairment.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+namespace {
+
+constexpr double paretoShape = 2.5;
+
+std::vector<std::string> split(const std::string& text, char separator)
+{
+	std::vector<std::string> parts;
+	std::stringstream stream(text);
+	std::string part;
+	while (std::getline(stream, part, separator)) {
+		parts.push_back(part);
+	}
+	return parts;
+}
+
+bool parseNumber(const std::string& text, double& value)
+{
+	try {
+		size_t consumed = 0;
+		value = std::stod(text, &consumed);
+		return consumed == text.size() && std::isfinite(value);
+	}
+	catch (const std::exception&) {
+		return false;
+	}
+}
+
+bool isProbability(double value)
+{
+	return value >= 0.0 && value <= 1.0;
+}
+
+// Derive a different but reproducible sequence for the other direction
+constexpr uint32_t incomingSeed = 0x9e3779b9u;
+
+// FNV-1a, unlike std::hash the same on every platform, so a seed replays the same per endpoint everywhere
+uint32_t endpointHash(const std::string& endpoint)
+{
+	uint32_t hash = 2166136261u;
+	for (const char c : endpoint) {
+		hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+	}
+	return hash;
+}
+
+} // namespace
+
+bool NetworkImpairmentConfig::isNeutral() const noexcept
+{
+	return goodToBad == 0.0 && lossInGood == 0.0 && delayMs == 0.0 && jitterMs == 0.0
+		&& duplicateProbability == 0.0 && rateKbps == 0.0;
+}
+
+std::optional<NetworkImpairmentConfig> NetworkImpairmentConfig::parse(const std::string& spec, std::string& error)
+{
+	NetworkImpairmentConfig config;
+	for (const auto& entry : split(spec, ',')) {
+		if (entry.empty()) {
+			continue;
+		}
+		const auto equals = entry.find('=');
+		if (equals == std::string::npos) {
+			error = "Impairment setting '" + entry + "' needs a value, e.g. delay=20";
+			return {};
+		}
+		const auto key = entry.substr(0, equals);
+		const auto value = entry.substr(equals + 1);
+		double number = 0.0;
+		if (key == "seed") {
+			if (!parseNumber(value, number) || number < 0.0 || number > std::numeric_limits<uint32_t>::max()) {
+				error = "Invalid impairment seed '" + value + "'";
+				return {};
+			}
+			config.seed = static_cast<uint32_t>(number);
+		}
+		else if (key == "loss") {
+			if (!parseNumber(value, number) || !isProbability(number)) {
+				error = "Invalid loss probability '" + value + "', use a value from 0 to 1";
+				return {};
+			}
+			config.goodToBad = 0.0;
+			config.lossInGood = number;
+		}
+		else if (key == "ge") {
+			const auto parameters = split(value, '/');
+			std::array<double, 4> probabilities {};
+			bool valid = parameters.size() == probabilities.size();
+			for (size_t i = 0; valid && i < probabilities.size(); ++i) {
+				valid = parseNumber(parameters[i], probabilities[i]) && isProbability(probabilities[i]);
+			}
+			if (!valid) {
+				error = "Invalid Gilbert-Elliott parameters '" + value + "', use ge=<p good to bad>/<r bad to good>/<loss in good>/<loss in bad>";
+				return {};
+			}
+			config.goodToBad = probabilities[0];
+			config.badToGood = probabilities[1];
+			config.lossInGood = probabilities[2];
+			config.lossInBad = probabilities[3];
+		}
+		else if (key == "delay" || key == "rate" || key == "queue") {
+			if (!parseNumber(value, number) || number < 0.0) {
+				error = "Invalid " + key + " '" + value + "', use a non-negative number";
+				return {};
+			}
+			(key == "delay" ? config.delayMs : key == "rate" ? config.rateKbps : config.queueLimitMs) = number;
+		}
+		else if (key == "jitter") {
+			const auto parts = split(value, ':');
+			if (parts.empty() || parts.size() > 2 || !parseNumber(parts[0], number) || number < 0.0) {
+				error = "Invalid jitter '" + value + "', use jitter=<ms>[:uniform|normal|pareto]";
+				return {};
+			}
+			config.jitterMs = number;
+			if (parts.size() == 2) {
+				if (parts[1] == "uniform") {
+					config.jitterDistribution = JitterDistribution::Uniform;
+				}
+				else if (parts[1] == "normal") {
+					config.jitterDistribution = JitterDistribution::Normal;
+				}
+				else if (parts[1] == "pareto") {
+					config.jitterDistribution = JitterDistribution::Pareto;
+				}
+				else {
+					error = "Unknown jitter distribution '" + parts[1] + "', use uniform, normal or pareto";
+					return {};
+				}
+			}
+		}
+		else if (key == "duplicate") {
+			if (!parseNumber(value, number) || !isProbability(number)) {
+				error = "Invalid duplicate probability '" + value + "', use a value from 0 to 1";
+				return {};
+			}
+			config.duplicateProbability = number;
+		}
+		else if (key == "direction") {
+			if (value != "out" && value != "in" && value != "both") {
+				error = "Invalid direction '" + value + "', use out, in or both";
+				return {};
+			}
+			config.impairOutgoing = value != "in";
+			config.impairIncoming = value != "out";
+		}
+		else {
+			error = "Unknown impairment setting '" + key + "'";
+			return {};
+		}
+	}
+	return config;
+}
+
+NetworkImpairmentModel::NetworkImpairmentModel(const NetworkImpairmentConfig& config, uint32_t streamSeed) :
+	config_(config), random_(streamSeed)
+{
+}
+
+ImpairmentDecision NetworkImpairmentModel::decide(int bytes, double nowMs)
+{
+	// Always draw the same amount of random numbers per packet, so one decision
+	// does not shift the random sequence of all later packets.
+	const double transition = uniform_(random_);
+	const double loss = uniform_(random_);
+	const double duplicate = uniform_(random_);
+	const double firstJitterMs = drawJitterMs();
+	const double secondJitterMs = drawJitterMs();
+
+	ImpairmentDecision decision;
+	double departureMs = nowMs;
+	if (config_.rateKbps > 0.0) {
+		const double startMs = std::max(nowMs, linkFreeAtMs_);
+		if (startMs - nowMs > config_.queueLimitMs) {
+			decision.copies = 0;
+			decision.rateDropped = true;
+			return decision;
+		}
+		// kbit/s is the same as bit/ms
+		linkFreeAtMs_ = startMs + 8.0 * bytes / config_.rateKbps;
+		departureMs = linkFreeAtMs_;
+	}
+
+	bad_ = bad_ ? transition >= config_.badToGood : transition < config_.goodToBad;
+	if (loss < (bad_ ? config_.lossInBad : config_.lossInGood)) {
+		decision.copies = 0;
+		return decision;
+	}
+	decision.deliveryMs[0] = departureMs + config_.delayMs + firstJitterMs;
+	if (duplicate < config_.duplicateProbability) {
+		decision.copies = 2;
+		decision.deliveryMs[1] = departureMs + config_.delayMs + secondJitterMs;
+	}
+	return decision;
+}
+
+double NetworkImpairmentModel::drawJitterMs()
+{
+	const double u = uniform_(random_);
+	const double n = normal_(random_);
+	if (config_.jitterMs <= 0.0) {
+		return 0.0;
+	}
+	switch (config_.jitterDistribution) {
+	case JitterDistribution::Uniform:
+		return u * config_.jitterMs;
+	case JitterDistribution::Normal:
+		return std::abs(n) * config_.jitterMs;
+	case JitterDistribution::Pareto: {
+		// Pareto shifted to start at 0, its mean scale / (shape - 1) is the configured jitter
+		const double scale = config_.jitterMs * (paretoShape - 1.0);
+		return scale / std::pow(1.0 - u, 1.0 / paretoShape) - scale;
+	}
+	}
+	return 0.0;
+}
+
+class NetworkImpairment::SenderThread final : public juce::Thread {
+public:
+	explicit SenderThread(NetworkImpairment& owner) : juce::Thread("NetworkImpairmentSender"), owner_(owner)
+	{
+	}
+
+	void run() override
+	{
+		while (!threadShouldExit()) {
+			owner_.sendDue();
+			const double waitMs = owner_.nextOutgoingDueMs() - Time::getMillisecondCounterHiRes();
+			wake_.wait(static_cast<int>(std::clamp(std::ceil(waitMs), 1.0, 100.0)));
+		}
+	}
+
+	void wake()
+	{
+		wake_.signal();
+	}
+
+private:
+	NetworkImpairment& owner_;
+	juce::WaitableEvent wake_;
+};
+
+NetworkImpairment& NetworkImpairment::instance()
+{
+	static NetworkImpairment impairment;
+	return impairment;
+}
+
+NetworkImpairment::~NetworkImpairment()
+{
+	disable();
+}
+
+void NetworkImpairment::enable(const NetworkImpairmentConfig& config)
+{
+	disable();
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		config_ = config;
+		outgoingLinks_.clear();
+		incomingLinks_.clear();
+		outgoingStats_ = {};
+		incomingStats_ = {};
+	}
+	sender_ = std::make_unique<SenderThread>(*this);
+	sender_->startThread(juce::Thread::Priority::high);
+	enabled_.store(true, std::memory_order_release);
+}
+
+void NetworkImpairment::disable()
+{
+	enabled_.store(false, std::memory_order_release);
+	if (sender_) {
+		sender_->signalThreadShouldExit();
+		sender_->wake();
+		sender_->stopThread(1000);
+		sender_.reset();
+	}
+	std::lock_guard<std::mutex> guard(lock_);
+	outgoing_ = {};
+	incoming_.clear();
+}
+
+bool NetworkImpairment::isEnabled() const noexcept
+{
+	return enabled_.load(std::memory_order_acquire);
+}
+
+int NetworkImpairment::write(juce::DatagramSocket& socket, const juce::String& remoteHostname, int remotePort, const void* data, int numBytes)
+{
+	if (!isEnabled() || !config_.impairOutgoing || numBytes <= 0) {
+		return socket.write(remoteHostname, remotePort, data, numBytes);
+	}
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		enqueue(outgoing_, linkTo(outgoingLinks_, remoteHostname, remotePort, 0), outgoingStats_, &socket, remoteHostname, remotePort, data, numBytes);
+	}
+	sender_->wake();
+	// The link accepted the packet, whatever happens to it later
+	return numBytes;
+}
+
+int NetworkImpairment::waitUntilReady(juce::DatagramSocket& socket, bool readyForReading, int timeoutMsecs)
+{
+	if (!isEnabled() || !config_.impairIncoming || !readyForReading) {
+		return socket.waitUntilReady(readyForReading, timeoutMsecs);
+	}
+	const double deadlineMs = timeoutMsecs < 0 ? std::numeric_limits<double>::max() : Time::getMillisecondCounterHiRes() + timeoutMsecs;
+	for (;;) {
+		const double nowMs = Time::getMillisecondCounterHiRes();
+		double nextDueMs = deadlineMs;
+		{
+			std::lock_guard<std::mutex> guard(lock_);
+			if (hasDueIncoming(socket, nowMs, nextDueMs)) {
+				return 1;
+			}
+		}
+		if (nowMs >= deadlineMs) {
+			return 0;
+		}
+		// Wake up at least once a second, the caller's timeout may be infinite
+		const double waitMs = std::clamp(std::ceil(std::min(deadlineMs, nextDueMs) - nowMs), 0.0, 1000.0);
+		const int ready = socket.waitUntilReady(true, static_cast<int>(waitMs));
+		if (ready < 0) {
+			return ready;
+		}
+		if (ready == 0) {
+			continue;
+		}
+		// Take the datagram off the real socket and put it on the simulated link
+		std::lock_guard<std::mutex> guard(lock_);
+		auto& line = incoming_[&socket];
+		juce::String senderAddress;
+		int senderPort = 0;
+		const int bytesRead = socket.read(line.buffer.data(), static_cast<int>(line.buffer.size()), false, senderAddress, senderPort);
+		if (bytesRead < 0) {
+			return bytesRead;
+		}
+		if (bytesRead > 0) {
+			enqueue(line.pending, linkTo(incomingLinks_, senderAddress, senderPort, incomingSeed), incomingStats_, &socket, senderAddress, senderPort,
+				line.buffer.data(), bytesRead);
+		}
+	}
+}
+
+int NetworkImpairment::read(juce::DatagramSocket& socket, void* destBuffer, int maxBytesToRead, bool shouldBlock, juce::String& senderIPAddress, int& senderPortNumber)
+{
+	if (!isEnabled() || !config_.impairIncoming) {
+		return socket.read(destBuffer, maxBytesToRead, shouldBlock, senderIPAddress, senderPortNumber);
+	}
+	if (shouldBlock && waitUntilReady(socket, true, -1) != 1) {
+		return -1;
+	}
+	std::lock_guard<std::mutex> guard(lock_);
+	double nextDueMs = 0.0;
+	if (!hasDueIncoming(socket, Time::getMillisecondCounterHiRes(), nextDueMs)) {
+		return 0;
+	}
+	auto& pending = incoming_[&socket].pending;
+	const auto& datagram = pending.top();
+	const int bytes = std::min(maxBytesToRead, static_cast<int>(datagram.data.size()));
+	std::memcpy(destBuffer, datagram.data.data(), static_cast<size_t>(bytes));
+	senderIPAddress = datagram.host;
+	senderPortNumber = datagram.port;
+	pending.pop();
+	return bytes;
+}
+
+void NetworkImpairment::forget(juce::DatagramSocket& socket)
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	incoming_.erase(&socket);
+	DelayLine remaining;
+	while (!outgoing_.empty()) {
+		if (outgoing_.top().socket != &socket) {
+			remaining.push(outgoing_.top());
+		}
+		outgoing_.pop();
+	}
+	outgoing_ = std::move(remaining);
+}
+
+NetworkImpairmentStats NetworkImpairment::outgoingStats() const
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	return outgoingStats_;
+}
+
+NetworkImpairmentStats NetworkImpairment::incomingStats() const
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	return incomingStats_;
+}
+
+NetworkImpairmentModel& NetworkImpairment::linkTo(Links& links, const juce::String& host, int port, uint32_t directionSeed)
+{
+	const auto endpoint = host.toStdString() + ":" + std::to_string(port);
+	auto link = links.find(endpoint);
+	if (link == links.end()) {
+		link = links.try_emplace(endpoint, config_, config_.seed ^ directionSeed ^ endpointHash(endpoint)).first;
+	}
+	return link->second;
+}
+
+void NetworkImpairment::enqueue(DelayLine& line, NetworkImpairmentModel& model, NetworkImpairmentStats& stats, juce::DatagramSocket* socket,
+	const juce::String& host, int port, const void* data, int numBytes)
+{
+	const auto decision = model.decide(numBytes, Time::getMillisecondCounterHiRes());
+	count(stats, decision);
+	const auto* bytes = static_cast<const uint8_t*>(data);
+	for (int copy = 0; copy < decision.copies; ++copy) {
+		line.push({ decision.deliveryMs[static_cast<size_t>(copy)], sequence_++, socket, host, port,
+			std::vector<uint8_t>(bytes, bytes + numBytes) });
+	}
+}
+
+void NetworkImpairment::sendDue()
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	const double nowMs = Time::getMillisecondCounterHiRes();
+	while (!outgoing_.empty() && outgoing_.top().dueMs <= nowMs) {
+		// Written under the lock, so forget() cannot remove the socket in the middle of a write
+		const auto& datagram = outgoing_.top();
+		datagram.socket->write(datagram.host, datagram.port, datagram.data.data(), static_cast<int>(datagram.data.size()));
+		outgoing_.pop();
+	}
+}
+
+double NetworkImpairment::nextOutgoingDueMs()
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	return outgoing_.empty() ? std::numeric_limits<double>::max() : outgoing_.top().dueMs;
+}
+
+bool NetworkImpairment::hasDueIncoming(juce::DatagramSocket& socket, double nowMs, double& nextDueMs)
+{
+	const auto line = incoming_.find(&socket);
+	if (line == incoming_.end() || line->second.pending.empty()) {
+		return false;
+	}
+	const double dueMs = line->second.pending.top().dueMs;
+	if (dueMs <= nowMs) {
+		return true;
+	}
+	nextDueMs = std::min(nextDueMs, dueMs);
+	return false;
+}
+
+void NetworkImpairment::count(NetworkImpairmentStats& stats, const ImpairmentDecision& decision)
+{
+	++stats.packets;
+	if (decision.rateDropped) {
+		++stats.rateDropped;
+	}
+	else if (decision.copies == 0) {
+		++stats.lost;
+	}
+	else if (decision.copies == 2) {
+		++stats.duplicated;
+	}
+}
@@ -0,0 +1,159 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+enum class JitterDistribution : uint8_t {
+	Uniform, // 0 .. jitter
+	Normal, // |N(0, jitter)|
+	Pareto // Heavy tail with mean jitter, like a congested uplink
+};
+
+// Parameters of the simulated link. Probabilities are per packet.
+struct NetworkImpairmentConfig {
+	uint32_t seed { 1 };
+	// Gilbert-Elliott loss: a two-state Markov chain, packets are lost with
+	// lossInGood or lossInBad depending on the state the chain is in.
+	double goodToBad { 0.0 };
+	double badToGood { 1.0 };
+	double lossInGood { 0.0 };
+	double lossInBad { 0.0 };
+	double delayMs { 0.0 };
+	double jitterMs { 0.0 };
+	JitterDistribution jitterDistribution { JitterDistribution::Uniform };
+	double duplicateProbability { 0.0 };
+	double rateKbps { 0.0 }; // 0 means unlimited
+	double queueLimitMs { 200.0 }; // Tail drop once the rate limited queue holds more than this
+	bool impairOutgoing { true };
+	bool impairIncoming { false };
+
+	bool isNeutral() const noexcept;
+
+	// Parses a comma separated spec such as "seed=7,ge=0.01/0.3/0/0.5,delay=20,jitter=5:pareto,duplicate=0.01,rate=2000,direction=both".
+	// Keys: seed, loss (independent loss), ge (p/r/lossInGood/lossInBad), delay, jitter (ms[:uniform|normal|pareto]),
+	// duplicate, rate (kbit/s), queue (ms), direction (out|in|both).
+	static std::optional<NetworkImpairmentConfig> parse(const std::string& spec, std::string& error);
+};
+
+// What the link does with one packet.
+struct ImpairmentDecision {
+	int copies { 1 }; // 0 = lost, 2 = duplicated
+	bool rateDropped { false }; // Lost because the rate limited queue was full
+	std::array<double, 2> deliveryMs {}; // Delivery time of each copy
+};
+
+// The deterministic part of the shim: the same seed and the same packet sizes
+// and send times give the same decisions, so a field problem can be replayed.
+class NetworkImpairmentModel {
+public:
+	explicit NetworkImpairmentModel(const NetworkImpairmentConfig& config, uint32_t streamSeed);
+
+	ImpairmentDecision decide(int bytes, double nowMs);
+
+	bool inBadState() const noexcept { return bad_; }
+
+private:
+	double drawJitterMs();
+
+	NetworkImpairmentConfig config_;
+	std::mt19937 random_;
+	std::uniform_real_distribution<double> uniform_ { 0.0, 1.0 };
+	std::normal_distribution<double> normal_ { 0.0, 1.0 };
+	bool bad_ { false };
+	double linkFreeAtMs_ { 0.0 };
+};
+
+struct NetworkImpairmentStats {
+	uint64_t packets { 0 };
+	uint64_t lost { 0 };
+	uint64_t duplicated { 0 };
+	uint64_t rateDropped { 0 };
+};
+
+// Process-wide, opt-in layer between the JammerNetz socket users and their
+// juce::DatagramSocket. While disabled every call is forwarded unchanged.
+// Enabled, outgoing packets are queued on a delay line and written by one
+// sender thread, and incoming packets are held back in waitUntilReady() until
+// they are due, so the callers keep their usual read loop. Every remote endpoint
+// has its own link per direction, so one client's burst loss or rate limit
+// doesn't spill over to the others on a server.
+class NetworkImpairment {
+public:
+	static NetworkImpairment& instance();
+	~NetworkImpairment();
+
+	void enable(const NetworkImpairmentConfig& config);
+	void disable();
+	bool isEnabled() const noexcept;
+
+	int write(juce::DatagramSocket& socket, const juce::String& remoteHostname, int remotePort, const void* data, int numBytes);
+	int waitUntilReady(juce::DatagramSocket& socket, bool readyForReading, int timeoutMsecs);
+	int read(juce::DatagramSocket& socket, void* destBuffer, int maxBytesToRead, bool shouldBlock, juce::String& senderIPAddress, int& senderPortNumber);
+
+	// Drops all packets still queued for or from the socket. Call before destroying it.
+	void forget(juce::DatagramSocket& socket);
+
+	NetworkImpairmentStats outgoingStats() const;
+	NetworkImpairmentStats incomingStats() const;
+
+private:
+	NetworkImpairment() = default;
+
+	struct QueuedDatagram {
+		double dueMs;
+		uint64_t sequence; // Keeps packets with the same due time in send order
+		juce::DatagramSocket* socket;
+		juce::String host;
+		int port;
+		std::vector<uint8_t> data;
+
+		bool operator>(const QueuedDatagram& other) const { return dueMs != other.dueMs ? dueMs > other.dueMs : sequence > other.sequence; }
+	};
+	using DelayLine = std::priority_queue<QueuedDatagram, std::vector<QueuedDatagram>, std::greater<>>;
+
+	struct IncomingLine {
+		DelayLine pending;
+		std::vector<uint8_t> buffer = std::vector<uint8_t>(65536); // One datagram read from the real socket
+	};
+
+	class SenderThread;
+
+	using Links = std::map<std::string, NetworkImpairmentModel>;
+
+	NetworkImpairmentModel& linkTo(Links& links, const juce::String& host, int port, uint32_t directionSeed);
+	void enqueue(DelayLine& line, NetworkImpairmentModel& model, NetworkImpairmentStats& stats, juce::DatagramSocket* socket,
+		const juce::String& host, int port, const void* data, int numBytes);
+	void sendDue();
+	double nextOutgoingDueMs();
+	bool hasDueIncoming(juce::DatagramSocket& socket, double nowMs, double& nextDueMs);
+	static void count(NetworkImpairmentStats& stats, const ImpairmentDecision& decision);
+
+	mutable std::mutex lock_;
+	std::atomic<bool> enabled_ { false };
+	NetworkImpairmentConfig config_;
+	Links outgoingLinks_; // By destination
+	Links incomingLinks_; // By sender
+	NetworkImpairmentStats outgoingStats_;
+	NetworkImpairmentStats incomingStats_;
+	DelayLine outgoing_;
+	std::map<juce::DatagramSocket*, IncomingLine> incoming_;
+	uint64_t sequence_ { 0 };
+	std::unique_ptr<SenderThread> sender_;
+};
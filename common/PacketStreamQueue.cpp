@@ -6,18 +6,45 @@
 
 #include "PacketStreamQueue.h"
 
+#include <algorithm>
+
+void JitterMeter::measure(double timestamp, StreamQualityData &qualityData)
+{
+	// Jitter is the difference between the running mean of clock delta and this packages clock delta
+	double clockDelta = Time::getMillisecondCounterHiRes() - timestamp;
+	if (runningMeanClockDelta_.NumDataValues() > 0) {
+		double jitter = fabs(clockDelta - runningMeanClockDelta_.Mean());
+		runningMeanJitter_.Push(jitter);
+		qualityData.jitterMeanMillis = runningMeanJitter_.Mean();
+		qualityData.jitterSDMillis = runningMeanJitter_.StandardDeviation();
+	}
+	runningMeanClockDelta_.Push(clockDelta);
+
+	// Every 30 seconds forget the rolling mean. Well, at 48000 KHz and 128 buffer size
+	if (runningMeanClockDelta_.NumDataValues() > 1875 * 6) {
+		reset();
+	}
+}
+
+void JitterMeter::reset()
+{
+	runningMeanClockDelta_.Clear();
+	runningMeanJitter_.Clear();
+}
+
 PacketStreamQueue::PacketStreamQueue(std::string const &streamName) :
     lastPushedMessage_(0)
     , lastPoppedMessage_(0)
     , currentGap_(0)
 {
 	qualityData_.streamName = streamName;
+	reset();
 }
 
 bool PacketStreamQueue::push(std::shared_ptr<JammerNetzAudioData> packet)
 {
 	if (!hasBeenPushedBefore(packet)) {
-		currentlyInQueue_.insert(packet->messageCounter());
+		currentlyInQueue_.push_back(packet->messageCounter());
 		qualityData_.packagesPushed++;
 		packetQueue_.push(packet);
 		if (packet->messageCounter() < lastPushedMessage_) {
@@ -28,23 +55,7 @@ bool PacketStreamQueue::push(std::shared_ptr<JammerNetzAudioData> packet)
 		lastPushedMessage_ = packet->messageCounter();
 
 		// Calculate the jitter in this queue!
-		double now = Time::getMillisecondCounterHiRes();
-
-		// Jitter is the difference between the running mean of clock delta and this packages clock delta
-		double clockDelta = now - packet->timestamp();
-		if (runningMeanClockDelta_.NumDataValues() > 0) {
-			double jitter = fabs(clockDelta - runningMeanClockDelta_.Mean());
-			runningMeanJitter_.Push(jitter);
-			qualityData_.jitterMeanMillis = runningMeanJitter_.Mean();
-			qualityData_.jitterSDMillis = runningMeanJitter_.StandardDeviation();
-		}
-		runningMeanClockDelta_.Push(clockDelta);
-
-		// Every 30 seconds forget the rolling mean. Well, at 48000 KHz and 128 buffer size
-		if (runningMeanClockDelta_.NumDataValues() > 1875 * 6) {
-			runningMeanClockDelta_.Clear();
-			runningMeanJitter_.Clear();
-		}
+		jitter_.measure(packet->timestamp(), qualityData_);
 		return true;
 	}
 	return false;
@@ -71,7 +82,7 @@ bool PacketStreamQueue::try_pop(std::shared_ptr<JammerNetzAudioData> &element, b
 		// Great, no gap, and the correct data has been retrieved. Happy to continue!
 		lastPoppedMessage_ = packet->messageCounter();
 		lastPoppedMessageData_ = packet;
-		currentlyInQueue_.erase(lastPoppedMessage_);
+		forgetQueued(lastPoppedMessage_);
 		element = packet;
 		currentGap_ = 0;
 		outIsFillIn = false;
@@ -115,7 +126,7 @@ PacketStreamQueueFastForwardResult PacketStreamQueue::fastForwardToSize(
 	while (packetQueue_.size() > retainedPacketCount) {
 		const auto discarded = packetQueue_.top();
 		packetQueue_.pop();
-		currentlyInQueue_.erase(discarded->messageCounter());
+		forgetQueued(discarded->messageCounter());
 		newestDiscardedCounter = discarded->messageCounter();
 		++result.discardedPackets;
 	}
@@ -148,25 +159,17 @@ PacketStreamQueueFastForwardResult PacketStreamQueue::fastForwardToSize(
 
 void PacketStreamQueue::reset()
 {
-	packetQueue_ = {};
+	std::vector<std::shared_ptr<JammerNetzAudioData>> storage;
+	storage.reserve(expectedQueueLength);
+	packetQueue_ = decltype(packetQueue_)(JammerNetzAudioOrder(), std::move(storage));
 	currentlyInQueue_.clear();
+	currentlyInQueue_.reserve(expectedQueueLength);
 	lastPushedMessage_.store(0, std::memory_order_relaxed);
 	lastPoppedMessage_.store(0, std::memory_order_relaxed);
 	lastPoppedMessageData_.reset();
 	currentGap_.store(0, std::memory_order_relaxed);
-	runningMeanClockDelta_.Clear();
-	runningMeanJitter_.Clear();
-	qualityData_.tooLateOrDuplicate.store(0, std::memory_order_relaxed);
-	qualityData_.droppedPacketCounter.store(0, std::memory_order_relaxed);
-	qualityData_.outOfOrderPacketCounter.store(0, std::memory_order_relaxed);
-	qualityData_.duplicatePacketCounter.store(0, std::memory_order_relaxed);
-	qualityData_.dropsHealed.store(0, std::memory_order_relaxed);
-	qualityData_.packagesPushed.store(0, std::memory_order_relaxed);
-	qualityData_.packagesPopped.store(0, std::memory_order_relaxed);
-	qualityData_.maxLengthOfGap.store(0, std::memory_order_relaxed);
-	qualityData_.maxWrongOrderSpan.store(0, std::memory_order_relaxed);
-	qualityData_.jitterMeanMillis.store(0.0, std::memory_order_relaxed);
-	qualityData_.jitterSDMillis.store(0.0, std::memory_order_relaxed);
+	jitter_.reset();
+	qualityData_.reset();
 }
 
 size_t PacketStreamQueue::size() const
@@ -193,14 +196,23 @@ bool PacketStreamQueue::hasBeenPushedBefore(std::shared_ptr<JammerNetzAudioData>
 		qualityData_.tooLateOrDuplicate++;
 		return true;
 	}
-	// Else we rely on the set<> that tracks the messages we have pushed into the queue but not popped
-	if (currentlyInQueue_.find(packet->messageCounter()) != currentlyInQueue_.end()) {
+	// Else we rely on the list that tracks the messages we have pushed into the queue but not popped
+	if (std::find(currentlyInQueue_.begin(), currentlyInQueue_.end(), packet->messageCounter()) != currentlyInQueue_.end()) {
 		qualityData_.duplicatePacketCounter++;
 		return true;
 	}
 	return false;
 }
 
+void PacketStreamQueue::forgetQueued(std::uint64_t messageCounter)
+{
+	auto found = std::find(currentlyInQueue_.begin(), currentlyInQueue_.end(), messageCounter);
+	if (found != currentlyInQueue_.end()) {
+		*found = currentlyInQueue_.back();
+		currentlyInQueue_.pop_back();
+	}
+}
+
 StreamQualityData::StreamQualityData()
 {
 	tooLateOrDuplicate = 0;
@@ -216,6 +228,21 @@ StreamQualityData::StreamQualityData()
 	jitterSDMillis = 0.0;
 }
 
+void StreamQualityData::reset()
+{
+	tooLateOrDuplicate.store(0, std::memory_order_relaxed);
+	droppedPacketCounter.store(0, std::memory_order_relaxed);
+	outOfOrderPacketCounter.store(0, std::memory_order_relaxed);
+	duplicatePacketCounter.store(0, std::memory_order_relaxed);
+	dropsHealed.store(0, std::memory_order_relaxed);
+	packagesPushed.store(0, std::memory_order_relaxed);
+	packagesPopped.store(0, std::memory_order_relaxed);
+	maxLengthOfGap.store(0, std::memory_order_relaxed);
+	maxWrongOrderSpan.store(0, std::memory_order_relaxed);
+	jitterMeanMillis.store(0.0, std::memory_order_relaxed);
+	jitterSDMillis.store(0.0, std::memory_order_relaxed);
+}
+
 std::string StreamQualityData::qualityStatement() const {
 	const auto droppedPackets = droppedPacketCounter.load();
 	const auto poppedPackets = packagesPopped.load();
@@ -16,7 +16,6 @@
 #include <cstdint>
 #include <optional>
 #include <queue>
-#include <unordered_set>
 #include <vector>
 
 struct StreamQualityData {
@@ -43,11 +42,25 @@ struct StreamQualityData {
 
 	std::string streamName;
 
+	// Zeroes the counters, keeps the name
+	void reset();
 	std::string qualityStatement() const;
 	JammerNetzStreamQualityInfo qualityInfoPackage() const;
 
 };
 
+// The jitter of a stream's arrival times, shared by the server's and the client's queue
+class JitterMeter {
+public:
+	// Call for every packet pushed, with the sender's timestamp
+	void measure(double timestamp, StreamQualityData &qualityData);
+	void reset();
+
+private:
+	RunningStats runningMeanClockDelta_;
+	RunningStats runningMeanJitter_;
+};
+
 struct PacketStreamQueueFastForwardResult {
 	std::size_t discardedPackets { 0 };
 	std::optional<std::uint64_t> oldestRetainedCounter;
@@ -67,7 +80,11 @@ public:
 	JammerNetzStreamQualityInfo qualityInfoPackage() const;
 
 private:
+	// Longer queues still work, they just allocate while growing
+	static constexpr std::size_t expectedQueueLength = 256;
+
 	bool hasBeenPushedBefore(std::shared_ptr<JammerNetzAudioData> packet);
+	void forgetQueued(std::uint64_t messageCounter);
 
 	std::priority_queue<
 		std::shared_ptr<JammerNetzAudioData>,
@@ -80,8 +97,8 @@ private:
 #endif
 	std::atomic_uint64_t currentGap_;
 	std::shared_ptr<JammerNetzAudioData> lastPoppedMessageData_;
-	RunningStats runningMeanClockDelta_;
-	RunningStats runningMeanJitter_;
+	JitterMeter jitter_;
 	StreamQualityData qualityData_;
-	std::unordered_set<std::uint64_t> currentlyInQueue_;
+	// A short vector instead of a set, searching a few dozen counters is cheaper than allocating a node per packet
+	std::vector<std::uint64_t> currentlyInQueue_;
 };
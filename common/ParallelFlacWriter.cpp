@@ -0,0 +1,432 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "ParallelFlacWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr int streamInfoBytes = 34;
+constexpr int flacHeaderBytes = 4 + 4 + streamInfoBytes;
+constexpr int maximumWorkers = 4;
+
+struct FrameHeader {
+	size_t bytes { 0 }; // Including the CRC-8
+	size_t numberEnd { 0 }; // Offset behind the coded frame number
+	int blockSize { 0 };
+	uint64_t number { 0 };
+};
+
+constexpr std::array<uint8_t, 256> makeCrc8Table()
+{
+	std::array<uint8_t, 256> table {};
+	for (int i = 0; i < 256; ++i) {
+		uint8_t crc = static_cast<uint8_t>(i);
+		for (int bit = 0; bit < 8; ++bit) {
+			crc = static_cast<uint8_t>((crc & 0x80u) ? (crc << 1) ^ 0x07u : crc << 1);
+		}
+		table[static_cast<size_t>(i)] = crc;
+	}
+	return table;
+}
+
+constexpr std::array<uint16_t, 256> makeCrc16Table()
+{
+	std::array<uint16_t, 256> table {};
+	for (int i = 0; i < 256; ++i) {
+		uint16_t crc = static_cast<uint16_t>(i << 8);
+		for (int bit = 0; bit < 8; ++bit) {
+			crc = static_cast<uint16_t>((crc & 0x8000u) ? (crc << 1) ^ 0x8005u : crc << 1);
+		}
+		table[static_cast<size_t>(i)] = crc;
+	}
+	return table;
+}
+
+constexpr auto crc8Table = makeCrc8Table();
+constexpr auto crc16Table = makeCrc16Table();
+
+// The checksums of the FLAC frame header and frame
+uint8_t crc8(const uint8_t* data, size_t bytes)
+{
+	uint8_t crc = 0;
+	for (size_t i = 0; i < bytes; ++i) {
+		crc = crc8Table[crc ^ data[i]];
+	}
+	return crc;
+}
+
+uint16_t crc16(const uint8_t* data, size_t bytes)
+{
+	uint16_t crc = 0;
+	for (size_t i = 0; i < bytes; ++i) {
+		crc = static_cast<uint16_t>((crc << 8) ^ crc16Table[(crc >> 8) ^ data[i]]);
+	}
+	return crc;
+}
+
+// Returns the offset of the first frame and the block size from the stream info, or 0 if this is not a FLAC stream
+size_t skipMetadata(const uint8_t* data, size_t size, int& blockSize)
+{
+	if (size < flacHeaderBytes || std::memcmp(data, "fLaC", 4) != 0) {
+		return 0;
+	}
+	size_t position = 4;
+	while (position + 4 <= size) {
+		const bool last = (data[position] & 0x80u) != 0;
+		const int type = data[position] & 0x7f;
+		const size_t length = (static_cast<size_t>(data[position + 1]) << 16) | (static_cast<size_t>(data[position + 2]) << 8) | data[position + 3];
+		if (type == 0 && length == streamInfoBytes && position + 4 + length <= size) {
+			blockSize = (data[position + 6] << 8) | data[position + 7];
+		}
+		position += 4 + length;
+		if (last) {
+			return position <= size ? position : 0;
+		}
+	}
+	return 0;
+}
+
+// Frames with a fixed block size only, which is all libFLAC writes
+bool parseFrameHeader(const uint8_t* data, size_t size, size_t position, FrameHeader& header)
+{
+	const uint8_t* in = data + position;
+	const size_t available = size - position;
+	if (available < 6 || in[0] != 0xff || in[1] != 0xf8) {
+		return false;
+	}
+	const int blockCode = in[2] >> 4;
+	const int rateCode = in[2] & 0x0f;
+	const int channelCode = in[3] >> 4;
+	const int sampleSizeCode = (in[3] >> 1) & 0x07;
+	if (blockCode == 0 || rateCode == 15 || channelCode > 10 || sampleSizeCode == 3 || (in[3] & 0x01) != 0) {
+		return false;
+	}
+
+	// The frame number is coded like UTF-8
+	size_t offset = 4;
+	int continuationBytes = 0;
+	uint64_t number = in[offset];
+	if (number >= 0x80) {
+		while (continuationBytes < 6 && (number & (0x40u >> continuationBytes)) != 0) {
+			++continuationBytes;
+		}
+		if (continuationBytes == 0 || continuationBytes > 5) {
+			return false;
+		}
+		number &= 0x3fu >> continuationBytes;
+	}
+	++offset;
+	for (int i = 0; i < continuationBytes; ++i, ++offset) {
+		if (offset >= available || (in[offset] & 0xc0u) != 0x80u) {
+			return false;
+		}
+		number = (number << 6) | (in[offset] & 0x3fu);
+	}
+	header.numberEnd = offset;
+
+	const size_t blockBytes = blockCode == 6 ? 1 : (blockCode == 7 ? 2 : 0);
+	const size_t rateBytes = rateCode == 12 ? 1 : (rateCode == 13 || rateCode == 14 ? 2 : 0);
+	if (offset + blockBytes + rateBytes >= available) {
+		return false;
+	}
+	if (blockCode == 1) {
+		header.blockSize = 192;
+	}
+	else if (blockCode <= 5) {
+		header.blockSize = 576 << (blockCode - 2);
+	}
+	else if (blockCode == 6) {
+		header.blockSize = in[offset] + 1;
+	}
+	else if (blockCode == 7) {
+		header.blockSize = ((in[offset] << 8) | in[offset + 1]) + 1;
+	}
+	else {
+		header.blockSize = 256 << (blockCode - 8);
+	}
+	offset += blockBytes + rateBytes;
+	if (crc8(in, offset) != in[offset]) {
+		return false;
+	}
+	header.bytes = offset + 1;
+	header.number = number;
+	return true;
+}
+
+void appendFrameNumber(std::vector<uint8_t>& out, uint64_t number)
+{
+	if (number < 0x80) {
+		out.push_back(static_cast<uint8_t>(number));
+		return;
+	}
+	int continuationBytes = 1;
+	while (continuationBytes < 5 && number >= (uint64_t(1) << (6 * continuationBytes + 6 - continuationBytes))) {
+		++continuationBytes;
+	}
+	const auto lead = static_cast<uint8_t>(0xff00u >> (continuationBytes + 1));
+	out.push_back(static_cast<uint8_t>(lead | (number >> (6 * continuationBytes))));
+	for (int i = continuationBytes - 1; i >= 0; --i) {
+		out.push_back(static_cast<uint8_t>(0x80u | ((number >> (6 * i)) & 0x3fu)));
+	}
+}
+
+} // namespace
+
+struct ParallelFlacWriter::Segment {
+	explicit Segment(int numChannels)
+		: samples(static_cast<size_t>(numChannels), std::vector<int>(segmentFrames))
+		, pointers(static_cast<size_t>(numChannels) + 1, nullptr)
+	{
+		for (size_t channel = 0; channel < samples.size(); ++channel) {
+			pointers[channel] = samples[channel].data();
+		}
+	}
+
+	std::vector<std::vector<int>> samples;
+	std::vector<const int*> pointers; // Null terminated like the arrays AudioFormatWriter passes around
+	int frames { 0 };
+	MemoryBlock encoded;
+	WaitableEvent encodedEvent;
+	bool ok { false };
+};
+
+int ParallelFlacWriter::defaultNumWorkers()
+{
+	return jlimit(1, maximumWorkers, SystemStats::getNumCpus() / 2);
+}
+
+ParallelFlacWriter::ParallelFlacWriter(OutputStream* destStream, int sampleRate, int numChannels, int bitsPerSample, int qualityOptionIndex, int numWorkers)
+	: AudioFormatWriter(destStream, "FLAC file", sampleRate, static_cast<unsigned int>(numChannels), static_cast<unsigned int>(bitsPerSample))
+	, qualityOptionIndex_(qualityOptionIndex)
+	, header_(flacHeaderBytes, 0)
+{
+	numWorkers = jlimit(1, maximumWorkers, numWorkers);
+	// Every worker can hold one segment, and one more is filled and one is waiting to be written meanwhile
+	for (int i = 0; i < numWorkers + 2; ++i) {
+		segments_.push_back(std::make_unique<Segment>(numChannels));
+	}
+	pool_ = std::make_unique<ThreadPool>(ThreadPoolOptions {}
+		.withThreadName("FLAC encoder")
+		.withNumberOfThreads(numWorkers)
+		.withDesiredThreadPriority(Thread::Priority::low));
+	// Already a valid FLAC file with an unknown length, should it never be closed. Patched when it is.
+	fillStreamInfo();
+	failed_ = !output->write(header_.data(), header_.size());
+}
+
+ParallelFlacWriter::~ParallelFlacWriter()
+{
+	auto& current = *segments_[nextSegment_];
+	if (!failed_ && current.frames > 0) {
+		submit(current);
+	}
+	if (stitchSegments(0) && !writeStreamInfo()) {
+		std::cerr << "Error: could not finalize FLAC file, the stream can't seek back to its header" << std::endl;
+	}
+	// After an error, the remaining segments are still owned by the workers
+	for (auto* segment : inFlight_) {
+		segment->encodedEvent.wait(-1);
+	}
+	pool_.reset();
+	output->flush();
+}
+
+bool ParallelFlacWriter::write(const int** samplesToWrite, int numSamples)
+{
+	int done = 0;
+	while (!failed_ && done < numSamples) {
+		auto& segment = *segments_[nextSegment_];
+		const int frames = std::min(numSamples - done, segmentFrames - segment.frames);
+		for (size_t channel = 0; channel < segment.samples.size(); ++channel) {
+			auto* target = segment.samples[channel].data() + segment.frames;
+			if (samplesToWrite[channel]) {
+				std::copy_n(samplesToWrite[channel] + done, frames, target);
+			}
+			else {
+				std::fill_n(target, frames, 0);
+			}
+		}
+		segment.frames += frames;
+		done += frames;
+		if (segment.frames == segmentFrames) {
+			submit(segment);
+			// Only wait for the encoder when all segments are busy
+			stitchSegments(segments_.size() - 1);
+		}
+	}
+	return !failed_;
+}
+
+bool ParallelFlacWriter::flush()
+{
+	if (!stitchSegments(segments_.size())) {
+		return false;
+	}
+	output->flush();
+	return true;
+}
+
+uint64_t ParallelFlacWriter::segmentsWritten() const noexcept
+{
+	return segmentsWritten_;
+}
+
+void ParallelFlacWriter::submit(Segment& segment)
+{
+	inFlight_.push_back(&segment);
+	pool_->addJob([this, &segment] { encode(segment); });
+	nextSegment_ = (nextSegment_ + 1) % segments_.size();
+}
+
+void ParallelFlacWriter::encode(Segment& segment)
+{
+	segment.encoded.reset();
+	std::unique_ptr<OutputStream> stream = std::make_unique<MemoryOutputStream>(segment.encoded, false);
+	const auto options = AudioFormatWriterOptions {}
+		.withSampleRate(sampleRate)
+		.withNumChannels(static_cast<int>(numChannels))
+		.withBitsPerSample(static_cast<int>(bitsPerSample))
+		.withQualityOptionIndex(qualityOptionIndex_);
+	auto writer = FlacAudioFormat().createWriterFor(stream, options);
+	segment.ok = writer && writer->write(segment.pointers.data(), segment.frames);
+	// Closing the encoder writes the last frame
+	writer.reset();
+	segment.encodedEvent.signal();
+}
+
+bool ParallelFlacWriter::stitchSegments(size_t maximumInFlight)
+{
+	while (!failed_ && !inFlight_.empty()) {
+		auto& segment = *inFlight_.front();
+		if (!segment.encodedEvent.wait(inFlight_.size() > maximumInFlight ? -1 : 0)) {
+			break;
+		}
+		inFlight_.pop_front();
+		if (!segment.ok || !stitch(segment)) {
+			std::cerr << "Error: FLAC encoding failed, recording stopped at " << framesStitched_ << " frames" << std::endl;
+			failed_ = true;
+		}
+		segment.frames = 0;
+	}
+	return !failed_;
+}
+
+bool ParallelFlacWriter::stitch(Segment& segment)
+{
+	const auto* data = static_cast<const uint8_t*>(segment.encoded.getData());
+	const size_t size = segment.encoded.getSize();
+	int segmentBlockSize = 0;
+	size_t position = skipMetadata(data, size, segmentBlockSize);
+	if (position == 0 || segmentBlockSize == 0) {
+		return false;
+	}
+	if (blockSize_ == 0) {
+		blockSize_ = segmentBlockSize;
+	}
+	const bool lastSegment = segment.frames < segmentFrames;
+	if (!lastSegment && (segmentBlockSize != blockSize_ || segmentFrames % blockSize_ != 0)) {
+		return false;
+	}
+
+	FrameHeader header;
+	if (!parseFrameHeader(data, size, position, header) || header.number != 0) {
+		return false;
+	}
+	int frames = 0;
+	while (position < size) {
+		// A frame carries no length, it ends where the next one with a valid header starts and its own CRC matches
+		size_t end = size;
+		FrameHeader next;
+		for (size_t candidate = position + header.bytes + 2; candidate + 6 <= size; ++candidate) {
+			if (data[candidate] == 0xff && parseFrameHeader(data, size, candidate, next) && next.number == header.number + 1
+				&& crc16(data + position, candidate - position) == 0) {
+				end = candidate;
+				break;
+			}
+		}
+		if (end == size && crc16(data + position, size - position) != 0) {
+			return false;
+		}
+		// Only the last frame of the file may be shorter than the block size
+		const bool lastOfFile = end == size && lastSegment;
+		if (header.blockSize != blockSize_ && !(lastOfFile && header.blockSize < blockSize_)) {
+			return false;
+		}
+
+		frame_.assign(data + position, data + position + 4);
+		appendFrameNumber(frame_, nextFrameNumber_);
+		frame_.insert(frame_.end(), data + position + header.numberEnd, data + position + header.bytes - 1);
+		frame_.push_back(crc8(frame_.data(), frame_.size()));
+		frame_.insert(frame_.end(), data + position + header.bytes, data + end - 2);
+		const uint16_t crc = crc16(frame_.data(), frame_.size());
+		frame_.push_back(static_cast<uint8_t>(crc >> 8));
+		frame_.push_back(static_cast<uint8_t>(crc & 0xff));
+		if (!output->write(frame_.data(), frame_.size())) {
+			return false;
+		}
+		const auto frameBytes = static_cast<uint32_t>(frame_.size());
+		minFrameBytes_ = minFrameBytes_ == 0 ? frameBytes : std::min(minFrameBytes_, frameBytes);
+		maxFrameBytes_ = std::max(maxFrameBytes_, frameBytes);
+		++nextFrameNumber_;
+		frames += header.blockSize;
+
+		position = end;
+		header = next;
+	}
+	if (frames != segment.frames) {
+		return false;
+	}
+	framesStitched_ += static_cast<uint64_t>(frames);
+	++segmentsWritten_;
+	return true;
+}
+
+void ParallelFlacWriter::fillStreamInfo()
+{
+	auto* out = header_.data();
+	std::memcpy(out, "fLaC", 4);
+	// Stream info is the one and only metadata block
+	out[4] = 0x80;
+	out[5] = 0;
+	out[6] = 0;
+	out[7] = streamInfoBytes;
+	auto* info = out + 8;
+	// Before the first segment is encoded, the block size is only known to be within the format's limits.
+	// Zero frame sizes and a zero length mean unknown.
+	const int minimumBlockSize = blockSize_ != 0 ? blockSize_ : 16;
+	const int maximumBlockSize = blockSize_ != 0 ? blockSize_ : 65535;
+	info[0] = static_cast<uint8_t>(minimumBlockSize >> 8);
+	info[1] = static_cast<uint8_t>(minimumBlockSize & 0xff);
+	info[2] = static_cast<uint8_t>(maximumBlockSize >> 8);
+	info[3] = static_cast<uint8_t>(maximumBlockSize & 0xff);
+	for (int i = 0; i < 3; ++i) {
+		info[4 + i] = static_cast<uint8_t>(minFrameBytes_ >> (16 - 8 * i));
+		info[7 + i] = static_cast<uint8_t>(maxFrameBytes_ >> (16 - 8 * i));
+	}
+	const uint64_t packed = (static_cast<uint64_t>(sampleRate) << 44) | (static_cast<uint64_t>(numChannels - 1) << 41)
+		| (static_cast<uint64_t>(bitsPerSample - 1) << 36) | (framesStitched_ & 0xfffffffffull);
+	for (int i = 0; i < 8; ++i) {
+		info[10 + i] = static_cast<uint8_t>(packed >> (56 - 8 * i));
+	}
+	// The MD5 signature stays zero, meaning unknown
+	std::fill(info + 18, info + streamInfoBytes, uint8_t(0));
+}
+
+bool ParallelFlacWriter::writeStreamInfo()
+{
+	fillStreamInfo();
+	const auto end = output->getPosition();
+	if (!output->setPosition(0)) {
+		return false;
+	}
+	const bool written = output->write(header_.data(), header_.size());
+	return output->setPosition(end) && written;
+}
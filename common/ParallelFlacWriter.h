@@ -0,0 +1,65 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// Encodes FLAC on a small pool of low priority threads instead of the thread that writes.
+// The audio is cut into segments that are encoded as independent FLAC streams. FLAC frames
+// do not depend on each other, so the frames of each segment are renumbered and appended in
+// order, giving one ordinary FLAC file. The MD5 signature of the audio is left unset, which
+// the format allows.
+class ParallelFlacWriter final : public AudioFormatWriter {
+public:
+	// A multiple of every block size libFLAC picks (1152, 4096 and 4608), so only the very last frame of the file can be short
+	static constexpr int segmentFrames = 2 * 36864;
+
+	static int defaultNumWorkers();
+
+	// Same parameters as FlacAudioFormat. The file starts with stream info of unknown length, so it can be read even if it is
+	// never closed. Closing rewrites it with the length, that needs a seekable stream.
+	ParallelFlacWriter(OutputStream* destStream, int sampleRate, int numChannels, int bitsPerSample, int qualityOptionIndex, int numWorkers = defaultNumWorkers());
+	~ParallelFlacWriter() override;
+
+	bool write(const int** samplesToWrite, int numSamples) override;
+	// FLAC can't end a frame early, so this only writes the segments that are already encoded
+	bool flush() override;
+
+	uint64_t segmentsWritten() const noexcept;
+
+private:
+	struct Segment;
+
+	void submit(Segment& segment);
+	void encode(Segment& segment);
+	// Writes the encoded segments in order, waits only while more than maximumInFlight are pending
+	bool stitchSegments(size_t maximumInFlight);
+	bool stitch(Segment& segment);
+	void fillStreamInfo();
+	// Seeks back to the start and patches the stream info
+	bool writeStreamInfo();
+
+	int qualityOptionIndex_;
+	std::vector<std::unique_ptr<Segment>> segments_;
+	std::deque<Segment*> inFlight_; // Submitted, in file order
+	size_t nextSegment_ { 0 };
+	uint64_t nextFrameNumber_ { 0 };
+	uint64_t framesStitched_ { 0 };
+	uint64_t segmentsWritten_ { 0 };
+	int blockSize_ { 0 };
+	uint32_t minFrameBytes_ { 0 };
+	uint32_t maxFrameBytes_ { 0 };
+	bool failed_ { false };
+	std::vector<uint8_t> header_;
+	std::vector<uint8_t> frame_;
+	std::unique_ptr<ThreadPool> pool_;
+};
@@ -6,45 +6,303 @@
 
 #include "Recorder.h"
 
-Recorder::Recorder(File directory, std::string const &baseFileName, RecordingType recordingType)
-	:
-     samplesWritten_(0)
-    , directory_(directory)
-    , baseFileName_(baseFileName)
-    , recordingType_(recordingType)
-    , writer_(nullptr)
-    , lastChannelSetup_(false)
+#include "BoundedSpscQueue.h"
+#include "ParallelFlacWriter.h"
+#include "RecordingLog.h"
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+// Owns the writer of one recording. The producer copies into a preallocated ring of
+// audio and this thread drains it to disk. Everything the producer needs is allocated
+// up front, so pushing a block never allocates, locks or waits for the disk.
+class Recorder::DiskWriter final : private Thread {
+public:
+	DiskWriter(std::unique_ptr<AudioFormatWriter> writer, File file, int numChannels, int capacityFrames);
+	~DiskWriter() override;
+
+	// Producer, one at a time
+	void push(const float* const* data, int numSamples) noexcept;
+	void pushDropout(int numSamples) noexcept;
+
+	// Called once the producer is gone, writes everything that is left and finalizes the file
+	void finish();
+
+	RecorderStatistics statistics() const;
+
+private:
+	struct Dropout {
+		uint64_t acceptedBefore { 0 }; // Accepted frames that precede the gap
+		uint64_t frames { 0 };
+	};
+	static constexpr int dropoutQueueCapacity = 64;
+	static constexpr int writeBlockFrames = 4096;
+
+	bool queueOpenDropout() noexcept;
+	void run() override;
+	bool drain();
+	void writeFromRing(int start, int frames);
+	void writeDropout(uint64_t frames);
+	void measureThroughput();
+
+	std::unique_ptr<AudioFormatWriter> writer_;
+	File file_;
+	AudioBuffer<float> ring_;
+	AbstractFifo fifo_;
+	AudioBuffer<float> silence_;
+	std::vector<const float*> pointers_;
+	BoundedSpscQueue<Dropout> dropouts_ { dropoutQueueCapacity };
+
+	// Producer only
+	uint64_t accepted_ { 0 };
+	uint64_t openDropout_ { 0 };
+
+	// Disk thread only
+	uint64_t consumed_ { 0 };
+	uint64_t fileFrames_ { 0 };
+	std::optional<Dropout> nextDropout_;
+	std::unique_ptr<FileOutputStream> dropoutList_;
+	double lastMeasurementMs_ { 0.0 };
+	int64 lastFileSize_ { 0 };
+
+	std::atomic<uint64_t> recorded_ { 0 };
+	std::atomic<uint64_t> written_ { 0 };
+	std::atomic<uint64_t> dropped_ { 0 };
+	std::atomic<uint64_t> dropoutCount_ { 0 };
+	std::atomic<int> maximumBuffered_ { 0 };
+	std::atomic<double> bytesPerSecond_ { 0.0 };
+};
+
+Recorder::DiskWriter::DiskWriter(std::unique_ptr<AudioFormatWriter> writer, File file, int numChannels, int capacityFrames)
+	: Thread("RecorderDiskWriter")
+	, writer_(std::move(writer))
+	, file_(std::move(file))
+	, ring_(numChannels, capacityFrames + 1)
+	, fifo_(capacityFrames + 1)
+	, silence_(numChannels, writeBlockFrames)
+	, pointers_(static_cast<size_t>(numChannels) + 1, nullptr)
 {
-	thread_ = std::make_unique<TimeSliceThread>("RecorderDiskWriter");
-	thread_->startThread();
+	silence_.clear();
+	lastMeasurementMs_ = Time::getMillisecondCounterHiRes();
+	startThread();
 }
 
+Recorder::DiskWriter::~DiskWriter()
+{
+	finish();
+}
 
-Recorder::~Recorder()
+void Recorder::DiskWriter::push(const float* const* data, int numSamples) noexcept
 {
-	// Stop writing, make sure to finalize file
+	recorded_.fetch_add(static_cast<uint64_t>(numSamples), std::memory_order_relaxed);
+	// A pending gap has to be queued before any audio that follows it
+	if (fifo_.getFreeSpace() < numSamples || (openDropout_ > 0 && !queueOpenDropout())) {
+		openDropout_ += static_cast<uint64_t>(numSamples);
+		dropped_.fetch_add(static_cast<uint64_t>(numSamples), std::memory_order_relaxed);
+		return;
+	}
 	{
-		ScopedLock lock(stateLock_);
-		recording_.store(false, std::memory_order_release);
-		recordingGeneration_.store(0, std::memory_order_release);
-		writeThread_.reset();
+		const auto scope = fifo_.write(numSamples);
+		for (int channel = 0; channel < ring_.getNumChannels(); ++channel) {
+			if (data[channel]) {
+				ring_.copyFrom(channel, scope.startIndex1, data[channel], scope.blockSize1);
+				ring_.copyFrom(channel, scope.startIndex2, data[channel] + scope.blockSize1, scope.blockSize2);
+			}
+			else {
+				ring_.clear(channel, scope.startIndex1, scope.blockSize1);
+				ring_.clear(channel, scope.startIndex2, scope.blockSize2);
+			}
+		}
+	}
+	accepted_ += static_cast<uint64_t>(numSamples);
+	const int buffered = fifo_.getNumReady();
+	if (buffered > maximumBuffered_.load(std::memory_order_relaxed)) {
+		maximumBuffered_.store(buffered, std::memory_order_relaxed);
+	}
+}
+
+void Recorder::DiskWriter::pushDropout(int numSamples) noexcept
+{
+	recorded_.fetch_add(static_cast<uint64_t>(numSamples), std::memory_order_relaxed);
+	openDropout_ += static_cast<uint64_t>(numSamples);
+	dropped_.fetch_add(static_cast<uint64_t>(numSamples), std::memory_order_relaxed);
+}
+
+bool Recorder::DiskWriter::queueOpenDropout() noexcept
+{
+	const bool queued = dropouts_.tryWrite([this](Dropout& dropout) {
+		dropout.acceptedBefore = accepted_;
+		dropout.frames = openDropout_;
+	});
+	if (queued) {
+		openDropout_ = 0;
 	}
-	// Give it a second to flush and exit
-	thread_->stopThread(1000);
+	return queued;
+}
+
+void Recorder::DiskWriter::finish()
+{
+	if (!writer_) {
+		return;
+	}
+	// A gap at the very end still needs its marker, the disk thread is running and makes room
+	while (openDropout_ > 0 && !queueOpenDropout() && isThreadRunning()) {
+		Thread::sleep(1);
+	}
+	signalThreadShouldExit();
+	notify();
+	// Like AudioFormatWriter::ThreadedWriter, closing a file waits until everything buffered is on disk
+	stopThread(30000);
+	while (drain()) {
+	}
+	writer_.reset();
+	dropoutList_.reset();
+}
+
+RecorderStatistics Recorder::DiskWriter::statistics() const
+{
+	RecorderStatistics statistics;
+	statistics.bufferCapacityFrames = fifo_.getTotalSize() - 1;
+	statistics.bufferedFrames = fifo_.getNumReady();
+	statistics.maximumBufferedFrames = maximumBuffered_.load(std::memory_order_relaxed);
+	statistics.framesRecorded = recorded_.load(std::memory_order_relaxed);
+	statistics.framesWritten = written_.load(std::memory_order_relaxed);
+	statistics.framesDropped = dropped_.load(std::memory_order_relaxed);
+	statistics.dropouts = dropoutCount_.load(std::memory_order_relaxed);
+	statistics.diskBytesPerSecond = bytesPerSecond_.load(std::memory_order_relaxed);
+	return statistics;
+}
+
+void Recorder::DiskWriter::run()
+{
+	while (!threadShouldExit()) {
+		if (!drain()) {
+			wait(10);
+		}
+		measureThroughput();
+	}
+}
+
+bool Recorder::DiskWriter::drain()
+{
+	bool wroteSomething = false;
+	while (writer_) {
+		// Read the fill level before looking at the markers. A marker is queued before the
+		// audio behind it, so every frame counted here has its preceding marker visible.
+		const int ready = fifo_.getNumReady();
+		if (!nextDropout_) {
+			dropouts_.tryRead([this](Dropout& dropout) { nextDropout_ = dropout; });
+		}
+		if (nextDropout_ && nextDropout_->acceptedBefore == consumed_) {
+			writeDropout(nextDropout_->frames);
+			nextDropout_.reset();
+			wroteSomething = true;
+			continue;
+		}
+		uint64_t frames = static_cast<uint64_t>(std::min(ready, writeBlockFrames));
+		if (nextDropout_) {
+			frames = std::min(frames, nextDropout_->acceptedBefore - consumed_);
+		}
+		if (frames == 0) {
+			break;
+		}
+		{
+			const auto scope = fifo_.read(static_cast<int>(frames));
+			writeFromRing(scope.startIndex1, scope.blockSize1);
+			writeFromRing(scope.startIndex2, scope.blockSize2);
+		}
+		consumed_ += frames;
+		written_.fetch_add(frames, std::memory_order_relaxed);
+		wroteSomething = true;
+	}
+	return wroteSomething;
+}
+
+void Recorder::DiskWriter::writeFromRing(int start, int frames)
+{
+	if (frames <= 0) {
+		return;
+	}
+	for (int channel = 0; channel < ring_.getNumChannels(); ++channel) {
+		pointers_[static_cast<size_t>(channel)] = ring_.getReadPointer(channel, start);
+	}
+	writer_->writeFromFloatArrays(pointers_.data(), ring_.getNumChannels(), frames);
+	fileFrames_ += static_cast<uint64_t>(frames);
+}
+
+void Recorder::DiskWriter::writeDropout(uint64_t frames)
+{
+	// The marker goes into the file where the format allows it, otherwise into a list next to it
+	if (auto* log = dynamic_cast<RecordingLogWriter*>(writer_.get())) {
+		log->markDropout(static_cast<uint32_t>(std::min<uint64_t>(frames, UINT32_MAX)));
+	}
+	else {
+		if (!dropoutList_) {
+			dropoutList_ = file_.getSiblingFile(file_.getFileNameWithoutExtension() + "-dropouts.txt").createOutputStream();
+			if (dropoutList_) {
+				dropoutList_->writeText("# Silence written because the disk could not keep up: start frame, frames\n", false, false, nullptr);
+			}
+		}
+		if (dropoutList_) {
+			dropoutList_->writeText(String(fileFrames_) + "\t" + String(frames) + "\n", false, false, nullptr);
+			dropoutList_->flush();
+		}
+	}
+	// Silence of the same length keeps everything after the gap in time
+	for (uint64_t remaining = frames; remaining > 0;) {
+		const int block = static_cast<int>(std::min<uint64_t>(remaining, writeBlockFrames));
+		writer_->writeFromFloatArrays(silence_.getArrayOfReadPointers(), silence_.getNumChannels(), block);
+		remaining -= static_cast<uint64_t>(block);
+	}
+	fileFrames_ += frames;
+	dropoutCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Recorder::DiskWriter::measureThroughput()
+{
+	const double now = Time::getMillisecondCounterHiRes();
+	if (now - lastMeasurementMs_ < 1000.0) {
+		return;
+	}
+	const int64 size = file_.getSize();
+	bytesPerSecond_.store(static_cast<double>(size - lastFileSize_) * 1000.0 / (now - lastMeasurementMs_), std::memory_order_relaxed);
+	lastFileSize_ = size;
+	lastMeasurementMs_ = now;
+}
+
+Recorder::Recorder(File directory, std::string const &baseFileName, RecordingType recordingType, double bufferSeconds)
+	: directory_(directory)
+	, baseFileName_(baseFileName)
+	, recordingType_(recordingType)
+	, bufferSeconds_(bufferSeconds)
+	, lastSampleRate_(0)
+	, lastChannelSetup_(false)
+{
+}
+
+
+Recorder::~Recorder()
+{
+	// Stop writing, make sure to finalize file
+	ScopedLock lock(stateLock_);
+	recording_.store(false, std::memory_order_release);
+	recordingGeneration_.store(0, std::memory_order_release);
+	stopWriter();
 }
 
 void Recorder::setRecording(bool recordOn)
 {
 	ScopedLock lock(stateLock_);
-	const bool wasRecording = writeThread_ != nullptr;
-	if (recordOn && writeThread_ == nullptr) {
+	const bool wasRecording = diskWriter_ != nullptr;
+	if (recordOn && diskWriter_ == nullptr) {
 		if (updateChannelInfo(lastSampleRate_, lastChannelSetup_)) {
 			launchWriter();
 		}
-	} else if (!recordOn && writeThread_ != nullptr) {
-		writeThread_.reset();
+	} else if (!recordOn && diskWriter_ != nullptr) {
+		stopWriter();
 	}
-	const bool isNowRecording = writeThread_ != nullptr;
+	const bool isNowRecording = diskWriter_ != nullptr;
 	if (isNowRecording && !wasRecording) {
 		++nextRecordingGeneration_;
 		if (nextRecordingGeneration_ == 0) {
@@ -69,8 +327,9 @@ uint64_t Recorder::recordingGeneration() const noexcept
 
 RelativeTime Recorder::getElapsedTime() const
 {
+	const auto frames = getStatistics().framesRecorded;
 	ScopedLock lock(stateLock_);
-	return RelativeTime(lastSampleRate_ > 0 ? static_cast<double>(samplesWritten_) / static_cast<double>(lastSampleRate_) : 0.0);
+	return RelativeTime(lastSampleRate_ > 0 ? static_cast<double>(frames) / static_cast<double>(lastSampleRate_) : 0.0);
 }
 
 juce::String Recorder::getFilename() const
@@ -85,6 +344,13 @@ juce::File Recorder::getFile() const
 	return activeFile_;
 }
 
+RecorderStatistics Recorder::getStatistics() const
+{
+	ScopedLock lock(stateLock_);
+	// After a recording stopped, keep showing how it went
+	return diskWriter_ ? diskWriter_->statistics() : lastStatistics_;
+}
+
 void Recorder::setChannelInfo(int sampleRate, JammerNetzChannelSetup const &channelSetup)
 {
 	ScopedLock lock(stateLock_);
@@ -98,8 +364,8 @@ bool Recorder::updateChannelInfo(int sampleRate, JammerNetzChannelSetup const &c
 
 	// We have changed the channel setup - as our output files do like a varying number of channels (you need a DAW project for that)
 	// let's close the current file and start a new one
-	writeThread_.reset();
-	writer_ = nullptr;
+	stopWriter();
+	writer_.reset();
 
 	// Create the audio format writer
 	std::unique_ptr<AudioFormat> audioFormat;
@@ -108,20 +374,21 @@ bool Recorder::updateChannelInfo(int sampleRate, JammerNetzChannelSetup const &c
 	case RecordingType::WAV: audioFormat = std::make_unique<WavAudioFormat>(); fileExtension = ".wav";  break;
 	case RecordingType::FLAC: audioFormat = std::make_unique <FlacAudioFormat>(); fileExtension = ".flac"; break;
 	case RecordingType::AIFF: audioFormat = std::make_unique <AiffAudioFormat>(); fileExtension = ".aiff"; break;
+	case RecordingType::CrashSafeLog: fileExtension = RecordingLog::fileExtension; break;
 	}
 
 	// Need to check that sample rate, bit depth, and channel layout are supported!
 	int bitDepthRequested = 16;
-	bool bitsOk = false;
-	for (auto allowed : audioFormat->getPossibleBitDepths()) if (allowed == bitDepthRequested) bitsOk = true;
+	bool bitsOk = !audioFormat && RecordingLog::isSupportedBitDepth(bitDepthRequested);
+	if (audioFormat) for (auto allowed : audioFormat->getPossibleBitDepths()) if (allowed == bitDepthRequested) bitsOk = true;
 	if (!bitsOk) {
 		jassert(false);
 		std::cerr << "Error: trying to create a file with a bit depth that is not supported by the format: " << bitDepthRequested << std::endl;
 		return false;
 	}
 
-	bool rateOk = false;
-	for (auto rate : audioFormat->getPossibleSampleRates()) if (rate == sampleRate) rateOk = true;
+	bool rateOk = !audioFormat && sampleRate > 0;
+	if (audioFormat) for (auto rate : audioFormat->getPossibleSampleRates()) if (rate == sampleRate) rateOk = true;
 	if (!rateOk) {
 		jassert(false);
 		std::cerr << "Error: trying to create a file with a sample rate that is not supported by the format: " << sampleRate << std::endl;
@@ -159,7 +426,7 @@ bool Recorder::updateChannelInfo(int sampleRate, JammerNetzChannelSetup const &c
 	}
 
 	// Check if WAV likes it
-	if (!audioFormat->isChannelLayoutSupported(channels)) {
+	if (audioFormat && !audioFormat->isChannelLayoutSupported(channels)) {
 		return false;
 	}
 
@@ -169,36 +436,73 @@ bool Recorder::updateChannelInfo(int sampleRate, JammerNetzChannelSetup const &c
 	std::unique_ptr<OutputStream> outStream = activeFile_.createOutputStream(16384);
 
 	// Create the writer based on the format and file
+	constexpr int qualityOptionIndex = 1; // unused by wav
 	const auto writerOptions = AudioFormatWriterOptions{}
 	                               .withSampleRate(sampleRate)
 	                               .withNumChannels(numChannels)
 	                               .withBitsPerSample(bitDepthRequested)
-	                               .withQualityOptionIndex(1 /* unused by wav */);
-	writer_ = outStream ? audioFormat->createWriterFor(outStream, writerOptions).release() : nullptr;
+	                               .withQualityOptionIndex(qualityOptionIndex);
+	if (recordingType_ == RecordingType::CrashSafeLog) {
+		writer_ = RecordingLog::createWriter(outStream, sampleRate, numChannels, bitDepthRequested, 0, String(baseFileName_));
+	}
+	else if (recordingType_ == RecordingType::FLAC && outStream) {
+		// Encoding on a single thread competes with the audio threads on small machines
+		writer_ = std::make_unique<ParallelFlacWriter>(outStream.release(), sampleRate, numChannels, bitDepthRequested, qualityOptionIndex);
+	}
+	else if (outStream) {
+		writer_ = audioFormat->createWriterFor(outStream, writerOptions);
+	}
 	if (!writer_) {
 		jassert(false);
 		std::cerr << "Fatal: Could not create writer for Audio file, can't record to disk" << std::endl;
 		return false;
 	}
+	numChannels_ = numChannels;
 	return true;
 }
 
 void Recorder::launchWriter() {
-	// Finally, create the new writer associating it with the background thread
-	writeThread_ = std::make_unique<AudioFormatWriter::ThreadedWriter>(writer_, *thread_, 16384);
-	samplesWritten_ = 0;
+	// Finally, hand the new writer to its own disk thread with a buffer of a few seconds
+	const int capacityFrames = std::max(1, static_cast<int>(bufferSeconds_ * lastSampleRate_));
+	diskWriter_ = std::make_unique<DiskWriter>(std::move(writer_), activeFile_, numChannels_, capacityFrames);
+	activeWriter_.store(diskWriter_.get(), std::memory_order_seq_cst);
+}
+
+void Recorder::stopWriter() {
+	if (!diskWriter_) {
+		return;
+	}
+	// Keep the producer out, then wait for one that might be in the middle of a block
+	activeWriter_.store(nullptr, std::memory_order_seq_cst);
+	while (activeProducers_.load(std::memory_order_seq_cst) != 0) {
+		Thread::yield();
+	}
+	diskWriter_->finish();
+	lastStatistics_ = diskWriter_->statistics();
+	diskWriter_.reset();
 }
 
 void Recorder::saveBlock(const float* const* data, int numSamples) {
-	ScopedLock lock(stateLock_);
 	// Don't crash on me when there is surprisingly no data in the package
-	if (writeThread_ && data && data[0] && numSamples > 0) {
-		if (!writeThread_->write(data, numSamples)) {
-			//TODO - need a smarter strategy than that
-			std::cerr << "Ups, FIFO full and can't write block to disk, lost it!" << std::endl;
-		}
-		samplesWritten_ += (juce::uint64) numSamples;
+	if (!data || !data[0] || numSamples <= 0) {
+		return;
+	}
+	activeProducers_.fetch_add(1, std::memory_order_seq_cst);
+	if (auto* writer = activeWriter_.load(std::memory_order_seq_cst)) {
+		writer->push(data, numSamples);
+	}
+	activeProducers_.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+void Recorder::saveDropout(int numSamples) {
+	if (numSamples <= 0) {
+		return;
+	}
+	activeProducers_.fetch_add(1, std::memory_order_seq_cst);
+	if (auto* writer = activeWriter_.load(std::memory_order_seq_cst)) {
+		writer->pushDropout(numSamples);
 	}
+	activeProducers_.fetch_sub(1, std::memory_order_seq_cst);
 }
 
 juce::File Recorder::getDirectory() const
@@ -213,6 +517,6 @@ void Recorder::setDirectory(File &directory)
 	// Stop writing if any
 	recording_.store(false, std::memory_order_release);
 	recordingGeneration_.store(0, std::memory_order_release);
-	writeThread_.reset();
+	stopWriter();
 	directory_ = directory;
 }
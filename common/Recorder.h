@@ -15,12 +15,29 @@
 enum class RecordingType {
 	WAV,
 	FLAC,
-	AIFF
+	AIFF,
+	CrashSafeLog // RecordingLog, recoverable after a crash and converted offline
+};
+
+// Live view of the disk pipeline of a Recorder
+struct RecorderStatistics {
+	int bufferCapacityFrames { 0 };
+	int bufferedFrames { 0 }; // Waiting for the disk
+	int maximumBufferedFrames { 0 }; // High water mark of this recording
+	uint64_t framesRecorded { 0 }; // Everything handed to the recorder, written or not
+	uint64_t framesWritten { 0 };
+	uint64_t framesDropped { 0 }; // Recorded as silence with a dropout marker
+	uint64_t dropouts { 0 };
+	double diskBytesPerSecond { 0.0 };
+
+	double bufferFill() const { return bufferCapacityFrames > 0 ? static_cast<double>(bufferedFrames) / bufferCapacityFrames : 0.0; }
 };
 
 class Recorder {
 public:
-	Recorder(File directory, std::string const &baseFileName, RecordingType recordingType);
+	static constexpr double defaultBufferSeconds = 4.0;
+
+	Recorder(File directory, std::string const &baseFileName, RecordingType recordingType, double bufferSeconds = defaultBufferSeconds);
 	~Recorder();
 
 	void setRecording(bool recordOn);
@@ -30,30 +47,43 @@ public:
 	RelativeTime getElapsedTime() const;
 	String getFilename() const;
 	File getFile() const;
+	RecorderStatistics getStatistics() const;
 
 	void setChannelInfo(int sampleRate, JammerNetzChannelSetup const &channelSetup);
 
+	// Lock-free and never waits for the disk. Audio that does not fit into the buffer
+	// anymore is recorded as silence of the same length plus a dropout marker, so the
+	// file keeps its timing.
 	void saveBlock(const float* const* data, int numSamples);
+	// Audio that was lost before it reached the recorder, recorded like a dropout
+	void saveDropout(int numSamples);
 
 	File getDirectory() const;
 	void setDirectory(File &directory);
 
 private:
+	class DiskWriter;
+
 	bool updateChannelInfo(int sampleRate, JammerNetzChannelSetup const &channelSetup);
 	void launchWriter();
+	void stopWriter();
 
 	Time startTime_;
-	uint64 samplesWritten_;
 	File activeFile_;
 	File directory_;
 	std::string baseFileName_;
 	RecordingType recordingType_;
-	AudioFormatWriter *writer_;
-	std::unique_ptr<TimeSliceThread> thread_;
-	std::unique_ptr<AudioFormatWriter::ThreadedWriter> writeThread_;
+	double bufferSeconds_;
+	int numChannels_ { 0 };
+	std::unique_ptr<AudioFormatWriter> writer_; // Created by updateChannelInfo(), handed to the disk writer by launchWriter()
+	std::unique_ptr<DiskWriter> diskWriter_;
+	// The producer only ever touches the disk writer through this pointer, counted so stopWriter() knows when it is safe to destroy it
+	std::atomic<DiskWriter*> activeWriter_ { nullptr };
+	std::atomic<int> activeProducers_ { 0 };
 	std::atomic<bool> recording_ { false };
 	std::atomic<uint64_t> recordingGeneration_ { 0 };
 	uint64_t nextRecordingGeneration_ { 0 };
+	RecorderStatistics lastStatistics_;
 
 	int lastSampleRate_;
 	JammerNetzChannelSetup lastChannelSetup_;
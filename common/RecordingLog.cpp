@@ -0,0 +1,637 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "RecordingLog.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+constexpr std::array<char, 8> fileMagic { 'J', 'N', 'R', 'E', 'C', 'L', 'O', 'G' };
+constexpr std::array<char, 8> chunkMagic { 'J', 'N', 'C', 'H', 'U', 'N', 'K', '1' };
+constexpr std::array<char, 8> checkpointMagic { 'J', 'N', 'C', 'H', 'K', 'P', 'T', '1' };
+constexpr std::array<char, 8> dropoutMagic { 'J', 'N', 'D', 'R', 'O', 'P', 'O', '1' };
+constexpr uint32_t formatVersion = 1;
+constexpr int fileHeaderFixedBytes = 48;
+constexpr uint32_t checkpointPayloadBytes = 8;
+constexpr uint32_t dropoutPayloadBytes = 8;
+constexpr int maximumChannels = 256;
+constexpr int conversionBlockFrames = 65536;
+
+constexpr std::array<uint32_t, 256> makeCrcTable()
+{
+	std::array<uint32_t, 256> table {};
+	for (uint32_t i = 0; i < 256; ++i) {
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; ++bit) {
+			crc = (crc & 1u) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+		}
+		table[i] = crc;
+	}
+	return table;
+}
+
+constexpr auto crcTable = makeCrcTable();
+
+// The zlib CRC-32, so a damaged file can be inspected with standard tools
+uint32_t crc32(const uint8_t* data, size_t bytes, uint32_t crc = 0)
+{
+	crc = ~crc;
+	for (size_t i = 0; i < bytes; ++i) {
+		crc = crcTable[(crc ^ data[i]) & 0xffu] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+void putUInt32(uint8_t* out, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i) {
+		out[i] = static_cast<uint8_t>(value >> (8 * i));
+	}
+}
+
+void putUInt64(uint8_t* out, uint64_t value)
+{
+	for (int i = 0; i < 8; ++i) {
+		out[i] = static_cast<uint8_t>(value >> (8 * i));
+	}
+}
+
+uint32_t getUInt32(const uint8_t* in)
+{
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i) {
+		value |= static_cast<uint32_t>(in[i]) << (8 * i);
+	}
+	return value;
+}
+
+uint64_t getUInt64(const uint8_t* in)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < 8; ++i) {
+		value |= static_cast<uint64_t>(in[i]) << (8 * i);
+	}
+	return value;
+}
+
+int64 paddedRecordBytes(uint32_t payloadBytes)
+{
+	const int64 bytes = RecordingLog::recordHeaderBytes + static_cast<int64>(payloadBytes);
+	return (bytes + RecordingLog::blockSize - 1) / RecordingLog::blockSize * RecordingLog::blockSize;
+}
+
+enum class RecordType {
+	Chunk,
+	Checkpoint,
+	Dropout
+};
+
+// Record header: magic[8] sequence[8] position[8] frames[4] payloadBytes[4] payloadCrc[4] headerCrc[4]
+struct RecordHeader {
+	RecordType type { RecordType::Chunk };
+	uint64_t sequence { 0 };
+	uint64_t position { 0 }; // First frame of a chunk or dropout, total frames for a checkpoint
+	uint32_t frames { 0 };
+	uint32_t payloadBytes { 0 };
+	uint32_t payloadCrc { 0 };
+};
+
+void encodeRecordHeader(uint8_t* out, std::array<char, 8> const& magic, RecordHeader const& header)
+{
+	std::memcpy(out, magic.data(), magic.size());
+	putUInt64(out + 8, header.sequence);
+	putUInt64(out + 16, header.position);
+	putUInt32(out + 24, header.frames);
+	putUInt32(out + 28, header.payloadBytes);
+	putUInt32(out + 32, header.payloadCrc);
+	putUInt32(out + 36, crc32(out, 36));
+}
+
+bool decodeRecordHeader(const uint8_t* in, RecordHeader& header)
+{
+	if (std::memcmp(in, chunkMagic.data(), chunkMagic.size()) == 0) {
+		header.type = RecordType::Chunk;
+	}
+	else if (std::memcmp(in, checkpointMagic.data(), checkpointMagic.size()) == 0) {
+		header.type = RecordType::Checkpoint;
+	}
+	else if (std::memcmp(in, dropoutMagic.data(), dropoutMagic.size()) == 0) {
+		header.type = RecordType::Dropout;
+	}
+	else {
+		return false;
+	}
+	if (getUInt32(in + 36) != crc32(in, 36)) {
+		return false;
+	}
+	header.sequence = getUInt64(in + 8);
+	header.position = getUInt64(in + 16);
+	header.frames = getUInt32(in + 24);
+	header.payloadBytes = getUInt32(in + 28);
+	header.payloadCrc = getUInt32(in + 32);
+	return true;
+}
+
+} // namespace
+
+bool RecordingLog::isSupportedBitDepth(int bitsPerSample)
+{
+	return bitsPerSample == 16 || bitsPerSample == 24;
+}
+
+std::unique_ptr<AudioFormatWriter> RecordingLog::createWriter(std::unique_ptr<OutputStream>& streamToWriteTo, int sampleRate, int numChannels, int bitsPerSample,
+	int64 timeReference, String const& description)
+{
+	if (!streamToWriteTo || sampleRate <= 0 || numChannels <= 0 || numChannels > maximumChannels || !isSupportedBitDepth(bitsPerSample)) {
+		return nullptr;
+	}
+	return std::make_unique<RecordingLogWriter>(streamToWriteTo.release(), sampleRate, numChannels, bitsPerSample, timeReference, description);
+}
+
+RecordingLog::ConversionResult RecordingLog::convert(File const& source, File const& target)
+{
+	ConversionResult result;
+	RecordingLogReader reader(source);
+	if (!reader.openedOk()) {
+		result.error = reader.getError();
+		return result;
+	}
+
+	auto writerOptions = AudioFormatWriterOptions{}
+		.withSampleRate(reader.getSampleRate())
+		.withNumChannels(reader.getNumChannels())
+		.withBitsPerSample(reader.getBitsPerSample());
+	std::unique_ptr<AudioFormat> format;
+	const auto extension = target.getFileExtension().toLowerCase();
+	if (extension == ".wav") {
+		format = std::make_unique<WavAudioFormat>();
+		// Keep the position on the server timeline, a DAW uses it to line up the stems
+		writerOptions = writerOptions.withMetadataValues(WavAudioFormat::createBWAVMetadata(reader.getDescription(), "JammerNetz",
+			source.getFileNameWithoutExtension(), reader.getStartTime(), reader.getTimeReference(), {}));
+	}
+	else if (extension == ".flac") {
+		format = std::make_unique<FlacAudioFormat>();
+	}
+	else if (extension == ".aif" || extension == ".aiff") {
+		format = std::make_unique<AiffAudioFormat>();
+	}
+	else {
+		result.error = "Unsupported target format " + extension + ", use .wav, .flac or .aiff";
+		return result;
+	}
+
+	// Only replace the target once it is complete
+	TemporaryFile temporary(target);
+	std::unique_ptr<OutputStream> stream = temporary.getFile().createOutputStream(1 << 20);
+	if (!stream) {
+		result.error = "Could not create " + temporary.getFile().getFullPathName();
+		return result;
+	}
+	auto writer = format->createWriterFor(stream, writerOptions);
+	if (!writer) {
+		result.error = "The target format does not support " + String(reader.getNumChannels()) + " channels at " + String(reader.getSampleRate()) + " Hz";
+		return result;
+	}
+
+	// The samples stay integers all the way through, the conversion is lossless
+	const auto channels = static_cast<size_t>(reader.getNumChannels());
+	std::vector<int> samples(channels * conversionBlockFrames);
+	std::vector<int*> readPointers(channels);
+	std::vector<const int*> writePointers(channels + 1, nullptr);
+	for (size_t channel = 0; channel < channels; ++channel) {
+		readPointers[channel] = samples.data() + channel * conversionBlockFrames;
+		writePointers[channel] = readPointers[channel];
+	}
+	const uint64_t length = reader.getLengthInFrames();
+	for (uint64_t position = 0; position < length; position += conversionBlockFrames) {
+		const int frames = static_cast<int>(std::min<uint64_t>(conversionBlockFrames, length - position));
+		if (!reader.read(readPointers.data(), static_cast<int>(channels), position, frames)) {
+			result.error = reader.getError();
+			return result;
+		}
+		if (!writer->write(writePointers.data(), frames)) {
+			result.error = "Could not write " + temporary.getFile().getFullPathName();
+			return result;
+		}
+		result.framesWritten += frames;
+	}
+	writer.reset();
+	if (!temporary.overwriteTargetFileWithTemporary()) {
+		result.error = "Could not replace " + target.getFullPathName();
+		return result;
+	}
+	result.framesMissing = static_cast<int64>(reader.getFramesMissing());
+	result.dropouts = reader.getDropouts().size();
+	result.ok = true;
+	return result;
+}
+
+RecordingLogWriter::RecordingLogWriter(OutputStream* destStream, int sampleRate, int numChannels, int bitsPerSample, int64 timeReference, String const& description)
+	: AudioFormatWriter(destStream, "JammerNetz recording log", sampleRate, static_cast<unsigned int>(numChannels), static_cast<unsigned int>(bitsPerSample))
+	, bytesPerSample_(bitsPerSample / 8)
+	, framesPerChunk_((RecordingLog::targetRecordBytes - RecordingLog::recordHeaderBytes) / (numChannels * (bitsPerSample / 8)))
+	, record_(static_cast<size_t>(RecordingLog::targetRecordBytes), 0)
+{
+	// The file header takes the first block, so all records are block aligned
+	auto* header = record_.data();
+	std::memcpy(header, fileMagic.data(), fileMagic.size());
+	putUInt32(header + 8, formatVersion);
+	putUInt32(header + 12, static_cast<uint32_t>(sampleRate));
+	putUInt32(header + 16, static_cast<uint32_t>(numChannels));
+	putUInt32(header + 20, static_cast<uint32_t>(bitsPerSample));
+	putUInt64(header + 24, static_cast<uint64_t>(timeReference));
+	putUInt64(header + 32, static_cast<uint64_t>(Time::currentTimeMillis()));
+	const auto utf8 = description.toStdString();
+	const auto descriptionBytes = std::min<size_t>(utf8.size(), RecordingLog::maximumDescriptionBytes);
+	putUInt32(header + 40, static_cast<uint32_t>(descriptionBytes));
+	std::memcpy(header + fileHeaderFixedBytes, utf8.data(), descriptionBytes);
+	uint32_t crc = crc32(header, 44);
+	crc = crc32(header + fileHeaderFixedBytes, descriptionBytes, crc);
+	putUInt32(header + 44, crc);
+	if (!output->write(header, RecordingLog::blockSize)) {
+		failed_ = true;
+	}
+}
+
+RecordingLogWriter::~RecordingLogWriter()
+{
+	flush();
+}
+
+bool RecordingLogWriter::write(const int** samplesToWrite, int numSamples)
+{
+	if (failed_) {
+		return false;
+	}
+	const int channels = static_cast<int>(numChannels);
+	const int shift = 32 - static_cast<int>(bitsPerSample);
+	const size_t frameBytes = static_cast<size_t>(channels * bytesPerSample_);
+	int done = 0;
+	while (done < numSamples) {
+		const int frames = std::min(numSamples - done, framesPerChunk_ - framesInChunk_);
+		auto* out = record_.data() + RecordingLog::recordHeaderBytes + static_cast<size_t>(framesInChunk_) * frameBytes;
+		for (int frame = 0; frame < frames; ++frame) {
+			for (int channel = 0; channel < channels; ++channel) {
+				// JUCE hands over left justified 32 bit samples, a null channel is silence
+				const auto* source = samplesToWrite[channel];
+				const auto value = static_cast<uint32_t>(source ? source[done + frame] >> shift : 0);
+				for (int byte = 0; byte < bytesPerSample_; ++byte) {
+					*out++ = static_cast<uint8_t>(value >> (8 * byte));
+				}
+			}
+		}
+		framesInChunk_ += frames;
+		done += frames;
+		if (framesInChunk_ == framesPerChunk_ && !writeChunk()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool RecordingLogWriter::flush()
+{
+	if (failed_) {
+		return false;
+	}
+	if (!writeChunk()) {
+		return false;
+	}
+	if (checkpoints_ > 0 && totalFrames_ == framesAtLastCheckpoint_) {
+		return true;
+	}
+	return writeCheckpoint();
+}
+
+bool RecordingLogWriter::markDropout(uint32_t frames)
+{
+	// Markers sit between chunks, so the pending audio goes out first
+	if (failed_ || !writeChunk()) {
+		return false;
+	}
+	RecordHeader header;
+	header.type = RecordType::Dropout;
+	header.sequence = sequence_;
+	header.position = totalFrames_;
+	header.frames = frames;
+	header.payloadBytes = dropoutPayloadBytes;
+	auto* payload = record_.data() + RecordingLog::recordHeaderBytes;
+	putUInt64(payload, static_cast<uint64_t>(Time::currentTimeMillis()));
+	header.payloadCrc = crc32(payload, dropoutPayloadBytes);
+	encodeRecordHeader(record_.data(), dropoutMagic, header);
+	if (!appendRecord(dropoutPayloadBytes)) {
+		return false;
+	}
+	++dropouts_;
+	return true;
+}
+
+uint64_t RecordingLogWriter::chunksWritten() const noexcept
+{
+	return sequence_ - checkpoints_ - dropouts_;
+}
+
+uint64_t RecordingLogWriter::checkpointsWritten() const noexcept
+{
+	return checkpoints_;
+}
+
+bool RecordingLogWriter::writeChunk()
+{
+	if (framesInChunk_ == 0) {
+		return !failed_;
+	}
+	RecordHeader header;
+	header.sequence = sequence_;
+	header.position = totalFrames_;
+	header.frames = static_cast<uint32_t>(framesInChunk_);
+	header.payloadBytes = static_cast<uint32_t>(framesInChunk_ * static_cast<int>(numChannels) * bytesPerSample_);
+	header.payloadCrc = crc32(record_.data() + RecordingLog::recordHeaderBytes, header.payloadBytes);
+	encodeRecordHeader(record_.data(), chunkMagic, header);
+	if (!appendRecord(header.payloadBytes)) {
+		return false;
+	}
+	totalFrames_ += static_cast<uint64_t>(framesInChunk_);
+	framesInChunk_ = 0;
+	if (totalFrames_ - framesAtLastCheckpoint_ >= static_cast<uint64_t>(sampleRate * RecordingLog::checkpointIntervalSeconds)) {
+		return writeCheckpoint();
+	}
+	return true;
+}
+
+bool RecordingLogWriter::writeCheckpoint()
+{
+	RecordHeader header;
+	header.type = RecordType::Checkpoint;
+	header.sequence = sequence_;
+	header.position = totalFrames_;
+	header.payloadBytes = checkpointPayloadBytes;
+	auto* payload = record_.data() + RecordingLog::recordHeaderBytes;
+	putUInt64(payload, static_cast<uint64_t>(Time::currentTimeMillis()));
+	header.payloadCrc = crc32(payload, checkpointPayloadBytes);
+	encodeRecordHeader(record_.data(), checkpointMagic, header);
+	if (!appendRecord(checkpointPayloadBytes)) {
+		return false;
+	}
+	// Hand everything to the disk, this is the point a power loss cannot take away anymore
+	output->flush();
+	framesAtLastCheckpoint_ = totalFrames_;
+	++checkpoints_;
+	return true;
+}
+
+bool RecordingLogWriter::appendRecord(size_t payloadBytes)
+{
+	const auto used = static_cast<size_t>(RecordingLog::recordHeaderBytes) + payloadBytes;
+	const auto padded = static_cast<size_t>(paddedRecordBytes(static_cast<uint32_t>(payloadBytes)));
+	std::fill(record_.begin() + static_cast<std::ptrdiff_t>(used), record_.begin() + static_cast<std::ptrdiff_t>(padded), uint8_t(0));
+	if (!output->write(record_.data(), padded)) {
+		failed_ = true;
+		return false;
+	}
+	++sequence_;
+	return true;
+}
+
+RecordingLogReader::RecordingLogReader(File const& file)
+	: input_(std::make_unique<FileInputStream>(file))
+{
+	if (input_->failedToOpen()) {
+		error_ = "Could not open " + file.getFullPathName() + ": " + input_->getStatus().getErrorMessage();
+		return;
+	}
+	if (readFileHeader()) {
+		scanRecords();
+	}
+}
+
+bool RecordingLogReader::openedOk() const noexcept
+{
+	return error_.isEmpty();
+}
+
+String RecordingLogReader::getError() const
+{
+	return error_;
+}
+
+int RecordingLogReader::getSampleRate() const noexcept
+{
+	return sampleRate_;
+}
+
+int RecordingLogReader::getNumChannels() const noexcept
+{
+	return numChannels_;
+}
+
+int RecordingLogReader::getBitsPerSample() const noexcept
+{
+	return bitsPerSample_;
+}
+
+int64 RecordingLogReader::getTimeReference() const noexcept
+{
+	return timeReference_;
+}
+
+Time RecordingLogReader::getStartTime() const
+{
+	return Time(startTimeMs_);
+}
+
+String RecordingLogReader::getDescription() const
+{
+	return description_;
+}
+
+uint64_t RecordingLogReader::getLengthInFrames() const noexcept
+{
+	return chunks_.empty() ? 0 : chunks_.back().firstFrame + chunks_.back().frames;
+}
+
+size_t RecordingLogReader::getNumChunks() const noexcept
+{
+	return chunks_.size();
+}
+
+size_t RecordingLogReader::getNumCheckpoints() const noexcept
+{
+	return checkpoints_;
+}
+
+uint64_t RecordingLogReader::getFramesAfterLastCheckpoint() const noexcept
+{
+	const auto length = getLengthInFrames();
+	return length > checkpointedFrames_ ? length - checkpointedFrames_ : 0;
+}
+
+int64 RecordingLogReader::getDamagedBytes() const noexcept
+{
+	return damagedBytes_;
+}
+
+uint64_t RecordingLogReader::getFramesMissing() const noexcept
+{
+	return framesMissing_;
+}
+
+std::vector<RecordingLogReader::Dropout> const& RecordingLogReader::getDropouts() const noexcept
+{
+	return dropouts_;
+}
+
+bool RecordingLogReader::readFileHeader()
+{
+	std::array<uint8_t, RecordingLog::blockSize> header {};
+	if (input_->read(header.data(), RecordingLog::blockSize) != RecordingLog::blockSize
+		|| std::memcmp(header.data(), fileMagic.data(), fileMagic.size()) != 0) {
+		error_ = "Not a JammerNetz recording log";
+		return false;
+	}
+	const auto descriptionBytes = getUInt32(header.data() + 40);
+	if (descriptionBytes > RecordingLog::maximumDescriptionBytes
+		|| getUInt32(header.data() + 44) != crc32(header.data() + fileHeaderFixedBytes, descriptionBytes, crc32(header.data(), 44))) {
+		error_ = "The file header of the recording log is damaged";
+		return false;
+	}
+	if (getUInt32(header.data() + 8) != formatVersion) {
+		error_ = "Unsupported recording log version " + String(getUInt32(header.data() + 8));
+		return false;
+	}
+	sampleRate_ = static_cast<int>(getUInt32(header.data() + 12));
+	numChannels_ = static_cast<int>(getUInt32(header.data() + 16));
+	bitsPerSample_ = static_cast<int>(getUInt32(header.data() + 20));
+	timeReference_ = static_cast<int64>(getUInt64(header.data() + 24));
+	startTimeMs_ = static_cast<int64>(getUInt64(header.data() + 32));
+	description_ = String::fromUTF8(reinterpret_cast<const char*>(header.data() + fileHeaderFixedBytes), static_cast<int>(descriptionBytes));
+	if (sampleRate_ <= 0 || numChannels_ <= 0 || numChannels_ > maximumChannels || !RecordingLog::isSupportedBitDepth(bitsPerSample_)) {
+		error_ = "The recording log has an invalid audio format";
+		return false;
+	}
+	return true;
+}
+
+void RecordingLogReader::scanRecords()
+{
+	const int64 fileSize = input_->getTotalLength();
+	const auto frameBytes = static_cast<uint64_t>(numChannels_) * static_cast<uint64_t>(bitsPerSample_ / 8);
+	std::array<uint8_t, RecordingLog::recordHeaderBytes> bytes {};
+	uint64_t nextSequence = 0;
+	uint64_t nextFrame = 0;
+	int64 offset = RecordingLog::blockSize;
+	while (offset + RecordingLog::recordHeaderBytes <= fileSize) {
+		RecordHeader header;
+		const bool readable = input_->setPosition(offset) && input_->read(bytes.data(), RecordingLog::recordHeaderBytes) == RecordingLog::recordHeaderBytes;
+		bool valid = readable && decodeRecordHeader(bytes.data(), header) && header.sequence >= nextSequence;
+		if (valid && header.type == RecordType::Chunk) {
+			valid = header.frames > 0 && header.payloadBytes == header.frames * frameBytes && header.position >= nextFrame;
+		}
+		else if (valid) {
+			valid = header.payloadBytes == (header.type == RecordType::Checkpoint ? checkpointPayloadBytes : dropoutPayloadBytes);
+		}
+		if (!valid) {
+			// Resynchronise on the next block, records always start block aligned
+			damagedBytes_ += std::min<int64>(RecordingLog::blockSize, fileSize - offset);
+			offset += RecordingLog::blockSize;
+			continue;
+		}
+		if (offset + RecordingLog::recordHeaderBytes + static_cast<int64>(header.payloadBytes) > fileSize) {
+			// Torn write at the end of the file, everything before it is fine
+			break;
+		}
+		switch (header.type) {
+		case RecordType::Chunk:
+			framesMissing_ += header.position - nextFrame;
+			chunks_.push_back({ offset, header.position, header.frames, header.payloadBytes, header.payloadCrc });
+			nextFrame = header.position + header.frames;
+			break;
+		case RecordType::Checkpoint:
+			++checkpoints_;
+			checkpointedFrames_ = header.position;
+			break;
+		case RecordType::Dropout:
+			dropouts_.push_back({ header.position, header.frames });
+			break;
+		}
+		nextSequence = header.sequence + 1;
+		offset += paddedRecordBytes(header.payloadBytes);
+	}
+	if (offset < fileSize) {
+		damagedBytes_ += fileSize - offset;
+	}
+}
+
+bool RecordingLogReader::loadChunk(size_t index)
+{
+	if (index == loadedChunk_) {
+		return true;
+	}
+	auto& chunk = chunks_[index];
+	payload_.resize(chunk.payloadBytes);
+	if (!input_->setPosition(chunk.offset + RecordingLog::recordHeaderBytes)
+		|| input_->read(payload_.data(), static_cast<int>(chunk.payloadBytes)) != static_cast<int>(chunk.payloadBytes)) {
+		error_ = "Could not read the recording log: " + input_->getStatus().getErrorMessage();
+		loadedChunk_ = SIZE_MAX;
+		return false;
+	}
+	loadedChunk_ = index;
+	loadedChunkValid_ = crc32(payload_.data(), payload_.size()) == chunk.payloadCrc;
+	if (!loadedChunkValid_ && !chunk.corrupt) {
+		chunk.corrupt = true;
+		framesMissing_ += chunk.frames;
+	}
+	return true;
+}
+
+bool RecordingLogReader::read(int* const* destChannels, int numDestChannels, uint64_t startFrame, int numFrames)
+{
+	for (int channel = 0; channel < numDestChannels; ++channel) {
+		if (destChannels[channel]) {
+			std::fill(destChannels[channel], destChannels[channel] + numFrames, 0);
+		}
+	}
+	if (!openedOk() || numFrames <= 0) {
+		return openedOk();
+	}
+	const uint64_t endFrame = startFrame + static_cast<uint64_t>(numFrames);
+	const int channels = std::min(numDestChannels, numChannels_);
+	const int bytesPerSample = bitsPerSample_ / 8;
+	const int shift = 32 - bitsPerSample_;
+	const auto frameBytes = static_cast<size_t>(numChannels_ * bytesPerSample);
+	auto index = static_cast<size_t>(std::partition_point(chunks_.begin(), chunks_.end(), [startFrame](ChunkIndex const& chunk) {
+		return chunk.firstFrame + chunk.frames <= startFrame;
+	}) - chunks_.begin());
+	for (; index < chunks_.size() && chunks_[index].firstFrame < endFrame; ++index) {
+		if (!loadChunk(index)) {
+			return false;
+		}
+		if (!loadedChunkValid_) {
+			continue;
+		}
+		const auto& chunk = chunks_[index];
+		const uint64_t from = std::max(startFrame, chunk.firstFrame);
+		const uint64_t to = std::min(endFrame, chunk.firstFrame + chunk.frames);
+		for (uint64_t frame = from; frame < to; ++frame) {
+			const auto* in = payload_.data() + static_cast<size_t>(frame - chunk.firstFrame) * frameBytes;
+			const auto destIndex = static_cast<size_t>(frame - startFrame);
+			for (int channel = 0; channel < channels; ++channel) {
+				uint32_t value = 0;
+				for (int byte = 0; byte < bytesPerSample; ++byte) {
+					value |= static_cast<uint32_t>(in[channel * bytesPerSample + byte]) << (8 * byte);
+				}
+				// Back to left justified, the shift also restores the sign
+				if (destChannels[channel]) {
+					destChannels[channel][destIndex] = static_cast<int>(value << shift);
+				}
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,159 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// The JammerNetz recording log (.jnrec) is an append-only container for PCM audio
+// that can be read back no matter when the writing process died. WAV, FLAC and AIFF
+// only get a valid header when the writer is closed, a crash loses the whole take.
+//
+// Layout, all integers little endian, every record starts at a multiple of blockSize:
+//   file header   magic "JNRECLOG", format, start time, time reference and a description
+//   chunk         record header plus interleaved 16 or 24 bit PCM, the payload is CRC protected
+//   checkpoint    record header written every checkpointIntervalSeconds, after which the file is synced
+//   dropout       marks audio the recorder lost because the disk fell behind, it was recorded as silence
+// Records are padded to whole blocks and appended with a single large write, which keeps
+// the writes page aligned and O_DIRECT friendly. A reader resynchronises after a damaged
+// record by searching the next block that starts with a valid record header, and simply
+// ignores a torn record at the end of the file.
+namespace RecordingLog {
+
+	static constexpr const char* fileExtension = ".jnrec";
+	static constexpr int blockSize = 4096;
+	static constexpr int recordHeaderBytes = 40;
+	// About 1.4 seconds of stereo 16 bit audio per chunk
+	static constexpr int targetRecordBytes = 256 * 1024;
+	static constexpr int checkpointIntervalSeconds = 5;
+	static constexpr int maximumDescriptionBytes = 2048;
+
+	bool isSupportedBitDepth(int bitsPerSample);
+
+	// Same contract as AudioFormat::createWriterFor(): takes the stream on success, returns nullptr if the parameters are not supported.
+	// The time reference is stored like the BWF time reference, the sample position of the first sample.
+	std::unique_ptr<AudioFormatWriter> createWriter(std::unique_ptr<OutputStream>& streamToWriteTo, int sampleRate, int numChannels, int bitsPerSample,
+		int64 timeReference, String const& description);
+
+	struct ConversionResult {
+		bool ok { false };
+		String error;
+		int64 framesWritten { 0 };
+		int64 framesMissing { 0 }; // Damaged or lost ranges that were replaced by silence
+		size_t dropouts { 0 }; // Places where the recorder itself had to write silence
+	};
+
+	// Offline finalize: converts a possibly unfinished log into a WAV, FLAC or AIFF file, chosen by the extension of the target.
+	ConversionResult convert(File const& source, File const& target);
+}
+
+// Appends to a recording log. It is driven like any other AudioFormatWriter, the chunk
+// buffer is allocated once and write() never allocates.
+class RecordingLogWriter final : public AudioFormatWriter {
+public:
+	RecordingLogWriter(OutputStream* destStream, int sampleRate, int numChannels, int bitsPerSample, int64 timeReference, String const& description);
+	~RecordingLogWriter() override;
+
+	bool write(const int** samplesToWrite, int numSamples) override;
+	// Writes the pending partial chunk and a checkpoint, after this everything written so far survives a crash
+	bool flush() override;
+	// The next frames written are silence standing in for lost audio
+	bool markDropout(uint32_t frames);
+
+	uint64_t chunksWritten() const noexcept;
+	uint64_t checkpointsWritten() const noexcept;
+
+private:
+	bool writeChunk();
+	bool writeCheckpoint();
+	bool appendRecord(size_t payloadBytes);
+
+	int bytesPerSample_;
+	int framesPerChunk_;
+	int framesInChunk_ { 0 };
+	uint64_t totalFrames_ { 0 };
+	uint64_t framesAtLastCheckpoint_ { 0 };
+	uint64_t sequence_ { 0 };
+	uint64_t checkpoints_ { 0 };
+	uint64_t dropouts_ { 0 };
+	bool failed_ { false };
+	std::vector<uint8_t> record_;
+};
+
+// Reads a recording log, also one that is still being written or was never closed.
+// The constructor only scans the record headers, the audio is read and verified on demand.
+class RecordingLogReader {
+public:
+	struct Dropout {
+		uint64_t position;
+		uint32_t frames;
+	};
+
+	explicit RecordingLogReader(File const& file);
+
+	bool openedOk() const noexcept;
+	String getError() const;
+
+	int getSampleRate() const noexcept;
+	int getNumChannels() const noexcept;
+	int getBitsPerSample() const noexcept;
+	int64 getTimeReference() const noexcept;
+	Time getStartTime() const;
+	String getDescription() const;
+
+	// Position after the last complete chunk, gaps in between read as silence
+	uint64_t getLengthInFrames() const noexcept;
+	size_t getNumChunks() const noexcept;
+	size_t getNumCheckpoints() const noexcept;
+	// Frames that were recovered behind the last checkpoint, i.e. written after the last sync
+	uint64_t getFramesAfterLastCheckpoint() const noexcept;
+	// Bytes skipped while resynchronising or dropped as a torn record at the end
+	int64 getDamagedBytes() const noexcept;
+	uint64_t getFramesMissing() const noexcept;
+	// Places where the recorder could not keep up and wrote silence instead
+	std::vector<Dropout> const& getDropouts() const noexcept;
+
+	// Fills left justified 32 bit samples like AudioFormatReader, channels beyond the file are cleared.
+	// Returns false only on an I/O error, a chunk with a bad CRC reads as silence and counts as missing.
+	bool read(int* const* destChannels, int numDestChannels, uint64_t startFrame, int numFrames);
+
+private:
+	struct ChunkIndex {
+		int64 offset;
+		uint64_t firstFrame;
+		uint32_t frames;
+		uint32_t payloadBytes;
+		uint32_t payloadCrc;
+		bool corrupt { false };
+	};
+
+	bool readFileHeader();
+	void scanRecords();
+	bool loadChunk(size_t index);
+
+	std::unique_ptr<FileInputStream> input_;
+	String error_;
+	int sampleRate_ { 0 };
+	int numChannels_ { 0 };
+	int bitsPerSample_ { 0 };
+	int64 timeReference_ { 0 };
+	int64 startTimeMs_ { 0 };
+	String description_;
+	std::vector<ChunkIndex> chunks_;
+	std::vector<Dropout> dropouts_;
+	size_t checkpoints_ { 0 };
+	uint64_t checkpointedFrames_ { 0 };
+	int64 damagedBytes_ { 0 };
+	uint64_t framesMissing_ { 0 };
+	size_t loadedChunk_ { SIZE_MAX };
+	bool loadedChunkValid_ { false };
+	std::vector<uint8_t> payload_;
+};
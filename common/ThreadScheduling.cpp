@@ -0,0 +1,225 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "ThreadScheduling.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#if JUCE_LINUX || JUCE_MAC
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if JUCE_LINUX
+#include <sys/mman.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#endif
+
+namespace {
+
+std::vector<std::string> split(const std::string& text, char separator)
+{
+	std::vector<std::string> parts;
+	std::stringstream stream(text);
+	std::string part;
+	while (std::getline(stream, part, separator)) {
+		parts.push_back(part);
+	}
+	return parts;
+}
+
+bool parseInteger(const std::string& text, int minimum, int maximum, int& value)
+{
+	try {
+		size_t consumed = 0;
+		value = std::stoi(text, &consumed);
+		return consumed == text.size() && value >= minimum && value <= maximum;
+	}
+	catch (const std::exception&) {
+		return false;
+	}
+}
+
+bool parseCpus(const std::string& text, std::vector<int>& cpus)
+{
+	cpus.clear();
+	for (const auto& entry : split(text, '/')) {
+		const auto dash = entry.find('-');
+		int first = 0;
+		int last = 0;
+		if (dash == std::string::npos) {
+			if (!parseInteger(entry, 0, ThreadSchedulingConfig::maximumCpu, first)) {
+				return false;
+			}
+			last = first;
+		}
+		else if (!parseInteger(entry.substr(0, dash), 0, ThreadSchedulingConfig::maximumCpu, first)
+			|| !parseInteger(entry.substr(dash + 1), first, ThreadSchedulingConfig::maximumCpu, last)) {
+			return false;
+		}
+		for (int cpu = first; cpu <= last; ++cpu) {
+			cpus.push_back(cpu);
+		}
+	}
+	return !cpus.empty();
+}
+
+std::string describeCpus(const std::vector<int>& cpus)
+{
+	std::string result = cpus.size() == 1 ? "cpu " : "cpus ";
+	for (size_t i = 0; i < cpus.size(); ++i) {
+		result += (i == 0 ? "" : ",") + std::to_string(cpus[i]);
+	}
+	return result;
+}
+
+std::string policyName(SchedulingPolicy policy)
+{
+	switch (policy) {
+	case SchedulingPolicy::Fifo:
+		return "SCHED_FIFO";
+	case SchedulingPolicy::RoundRobin:
+		return "SCHED_RR";
+	case SchedulingPolicy::Normal:
+		break;
+	}
+	return "normal priority";
+}
+
+} // namespace
+
+bool ThreadSchedulingConfig::isDefault() const noexcept
+{
+	return policy == SchedulingPolicy::Normal && cpus.empty();
+}
+
+std::optional<ThreadSchedulingConfig> ThreadSchedulingConfig::parse(const std::string& spec, std::string& error)
+{
+	ThreadSchedulingConfig config;
+	for (const auto& entry : split(spec, ',')) {
+		if (entry.empty()) {
+			continue;
+		}
+		const auto equals = entry.find('=');
+		if (equals == std::string::npos) {
+			error = "Scheduling setting '" + entry + "' needs a value, e.g. policy=fifo";
+			return {};
+		}
+		const auto key = entry.substr(0, equals);
+		const auto value = entry.substr(equals + 1);
+		if (key == "policy") {
+			if (value == "normal") {
+				config.policy = SchedulingPolicy::Normal;
+			}
+			else if (value == "fifo") {
+				config.policy = SchedulingPolicy::Fifo;
+			}
+			else if (value == "rr") {
+				config.policy = SchedulingPolicy::RoundRobin;
+			}
+			else {
+				error = "Unknown scheduling policy '" + value + "', use normal, fifo or rr";
+				return {};
+			}
+		}
+		else if (key == "priority") {
+			if (!parseInteger(value, 1, 99, config.priority)) {
+				error = "Invalid real-time priority '" + value + "', use a value from 1 to 99";
+				return {};
+			}
+		}
+		else if (key == "cpus") {
+			if (!parseCpus(value, config.cpus)) {
+				error = "Invalid cpu list '" + value + "', use cores and ranges separated by '/', e.g. cpus=2/4-5";
+				return {};
+			}
+		}
+		else {
+			error = "Unknown scheduling setting '" + key + "'";
+			return {};
+		}
+	}
+	return config;
+}
+
+ThreadSchedulingResult applyThreadScheduling(juce::Thread::ThreadID thread, const ThreadSchedulingConfig& config)
+{
+	ThreadSchedulingResult result;
+	std::string refused;
+#if JUCE_LINUX || JUCE_MAC
+	const auto handle = reinterpret_cast<pthread_t>(thread);
+	if (config.policy != SchedulingPolicy::Normal) {
+		sched_param parameters {};
+		parameters.sched_priority = config.priority;
+		const int error = pthread_setschedparam(handle, config.policy == SchedulingPolicy::Fifo ? SCHED_FIFO : SCHED_RR, &parameters);
+		if (error != 0) {
+			refused = policyName(config.policy) + " refused: " + std::strerror(error);
+		}
+	}
+	// Report what the thread runs with now, not what was asked for
+	int policy = SCHED_OTHER;
+	sched_param granted {};
+	if (pthread_getschedparam(handle, &policy, &granted) == 0 && (policy == SCHED_FIFO || policy == SCHED_RR)) {
+		result.realtime = true;
+		result.description = policyName(policy == SCHED_FIFO ? SchedulingPolicy::Fifo : SchedulingPolicy::RoundRobin)
+			+ " " + std::to_string(granted.sched_priority);
+	}
+#else
+	ignoreUnused(thread);
+	if (config.policy != SchedulingPolicy::Normal) {
+		refused = policyName(config.policy) + " is not available on this platform";
+	}
+#endif
+	if (!result.realtime) {
+		result.description = policyName(SchedulingPolicy::Normal);
+	}
+
+	if (!config.cpus.empty()) {
+#if JUCE_LINUX
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		for (const int cpu : config.cpus) {
+			CPU_SET(static_cast<size_t>(cpu), &cpus);
+		}
+		const int error = pthread_setaffinity_np(handle, sizeof(cpus), &cpus);
+		if (error == 0) {
+			result.pinned = true;
+			result.description += " on " + describeCpus(config.cpus);
+		}
+		else {
+			refused += (refused.empty() ? "" : ", ") + describeCpus(config.cpus) + " refused: " + std::strerror(error);
+		}
+#else
+		refused += (refused.empty() ? "" : ", ") + std::string("cpu affinity is not available on this platform");
+#endif
+	}
+	if (!refused.empty()) {
+		result.description += " (" + refused + ")";
+	}
+	return result;
+}
+
+bool lockProcessMemory(std::string& error)
+{
+#if JUCE_LINUX
+#if defined(__GLIBC__)
+	// Freed memory stays in the heap instead of going back to the system, where it would fault again on reuse
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+#endif
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+		error = std::string("mlockall failed: ") + std::strerror(errno);
+		return false;
+	}
+	return true;
+#else
+	error = "Locking memory is only supported on Linux";
+	return false;
+#endif
+}
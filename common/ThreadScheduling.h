@@ -0,0 +1,50 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+enum class SchedulingPolicy : uint8_t {
+	Normal,
+	Fifo, // SCHED_FIFO, runs until it blocks or a higher priority thread wants the core
+	RoundRobin // SCHED_RR, shares the core with threads of the same priority
+};
+
+// How one latency critical thread is to be scheduled.
+struct ThreadSchedulingConfig {
+	static constexpr int maximumCpu = 1023;
+
+	SchedulingPolicy policy { SchedulingPolicy::Normal };
+	int priority { 50 }; // 1 to 99, only for the real-time policies
+	std::vector<int> cpus; // Cores the thread may run on, empty for any
+
+	bool isDefault() const noexcept;
+
+	// Parses a comma separated spec such as "policy=fifo,priority=80,cpus=2/4-5".
+	// Keys: policy (normal|fifo|rr), priority, cpus (cores and ranges separated by '/').
+	static std::optional<ThreadSchedulingConfig> parse(const std::string& spec, std::string& error);
+};
+
+// What the operating system actually granted, which without CAP_SYS_NICE or an rtprio limit is less than asked for.
+struct ThreadSchedulingResult {
+	bool realtime { false };
+	bool pinned { false };
+	std::string description; // e.g. "SCHED_FIFO 80 on cpus 2,3"
+};
+
+// Applies the config to a running thread. Real-time policies need Linux or macOS, affinity needs Linux.
+ThreadSchedulingResult applyThreadScheduling(juce::Thread::ThreadID thread, const ThreadSchedulingConfig& config);
+
+// Locks all current and future memory of the process into RAM and keeps freed heap memory in the process, so
+// a real-time thread never waits for a page fault. Call before the threads and their buffers are created,
+// then their stacks and buffers are faulted in right away. Linux only.
+bool lockProcessMemory(std::string& error);
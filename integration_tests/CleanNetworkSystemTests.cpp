@@ -295,7 +295,7 @@ private:
 	CapturedAudio observedOutput_;
 };
 
-AudioBuffer<float> expectedServerMix(const ServerInputPackets& inputs, const std::string& receiver)
+AudioBuffer<float> expectedServerMix(const ServerInputPackets& inputs, const ClientId receiver)
 {
 	AudioBuffer<float> expected(2, SAMPLE_BUFFER_SIZE);
 	expected.clear();
@@ -431,7 +431,8 @@ private:
 					return;
 				}
 				const auto& next = clients_[clientIndex]->pendingPackets().front();
-				inputs.emplace(clients_[clientIndex]->identifier(), next.packet);
+				// The client index stands in for the id the server registry would hand out
+				inputs.emplace(static_cast<ClientId>(clientIndex), next.packet);
 				frameIndices[clientIndex] = next.frameIndex;
 			}
 			if (inputs.empty()) {
@@ -466,17 +467,14 @@ private:
 				throw std::runtime_error("Server mixer violated a clean-network invariant");
 			}
 			for (const auto& outgoing : result.outgoing) {
-				const auto foundClient = std::find_if(clients_.begin(), clients_.end(), [&outgoing](const auto& client) {
-					return client->identifier() == outgoing.targetAddress;
-				});
-				if (foundClient == clients_.end()) {
-					throw std::runtime_error("Server output has an unknown target address");
+				if (outgoing.target >= clients_.size()) {
+					throw std::runtime_error("Server output has an unknown target client");
 				}
-				auto expected = expectedServerMix(inputs, outgoing.targetAddress);
+				auto expected = expectedServerMix(inputs, outgoing.target);
 				if (maximumError(expected, *outgoing.audioBlock.audioBuffer) > comparisonEpsilon) {
 					throw std::runtime_error("Server output differs from the independent routing oracle");
 				}
-				(*foundClient)->deliver(outgoing, expected);
+				clients_[outgoing.target]->deliver(outgoing, expected);
 			}
 			++mixCount_;
 			if (allClientsActive) {
@@ -369,11 +369,29 @@ private:
 	ReceiverQualityResult result_;
 };
 
-nlohmann::json queueJson(const std::map<std::string, ServerQueueObservation>& queues)
+// Registered in this order by both scenarios
+constexpr ClientId clientAId = 0;
+constexpr ClientId clientBId = 1;
+
+std::string clientName(const ClientId client)
+{
+	return client == clientAId ? "client-a" : "client-b";
+}
+
+nlohmann::json clientNames(const std::vector<ClientId>& clients)
+{
+	nlohmann::json result = nlohmann::json::array();
+	for (const auto client : clients) {
+		result.push_back(clientName(client));
+	}
+	return result;
+}
+
+nlohmann::json queueJson(const std::map<ClientId, ServerQueueObservation>& queues)
 {
 	nlohmann::json result = nlohmann::json::object();
-	for (const auto& [name, queue] : queues) {
-		result[name] = {
+	for (const auto& [client, queue] : queues) {
+		result[clientName(client)] = {
 			{ "state", jammernetz::test::connectionStateName(queue.state) },
 			{ "size", queue.size },
 			{ "activity_generation", queue.activityGeneration }
@@ -383,11 +401,11 @@ nlohmann::json queueJson(const std::map<std::string, ServerQueueObservation>& qu
 }
 
 nlohmann::json fastForwardJson(
-	const std::map<std::string, PacketStreamQueueFastForwardResult>& fastForwards)
+	const std::map<ClientId, PacketStreamQueueFastForwardResult>& fastForwards)
 {
 	nlohmann::json result = nlohmann::json::object();
-	for (const auto& [name, fastForward] : fastForwards) {
-		result[name] = {
+	for (const auto& [client, fastForward] : fastForwards) {
+		result[clientName(client)] = {
 			{ "discarded_packets", fastForward.discardedPackets },
 			{ "oldest_retained_counter", fastForward.oldestRetainedCounter
 				? nlohmann::json(*fastForward.oldestRetainedCounter) : nlohmann::json(nullptr) }
@@ -437,8 +455,8 @@ nlohmann::json toJson(const HoldFlushResult& result)
 class HoldFlushScenario {
 public:
 	HoldFlushScenario(const std::size_t holdFrames, const bool flushHeldBeforeCurrent)
-		: clientA_(std::make_shared<ClientState>("client-a"))
-		, clientB_(std::make_shared<ClientState>("client-b"))
+		: clientA_(clients_.find(*clients_.idFor("10.0.0.1", 1001))->state)
+		, clientB_(clients_.find(*clients_.idFor("10.0.0.2", 1002))->state)
 		, scheduler_(stereoMixdown(), {
 			SERVER_INCOMING_JITTER_BUFFER,
 			SERVER_INCOMING_MAXIMUM_BUFFER,
@@ -449,8 +467,6 @@ public:
 	{
 		result_.holdFrames = holdFrames;
 		result_.flushHeldBeforeCurrent = flushHeldBeforeCurrent;
-		clients_.emplace("client-a", clientA_);
-		clients_.emplace("client-b", clientB_);
 	}
 
 	HoldFlushResult run()
@@ -562,11 +578,11 @@ private:
 			throw std::runtime_error("The characterization input produced an invalid mixer diagnostic");
 		}
 
-		for (const auto& [name, queue] : step.queuesBefore) {
-			if (name == "client-a") {
+		for (const auto& [client, queue] : step.queuesBefore) {
+			if (client == clientAId) {
 				result_.maximumQueueA = std::max(result_.maximumQueueA, queue.size);
 			}
-			else if (name == "client-b") {
+			else if (client == clientBId) {
 				result_.maximumQueueB = std::max(result_.maximumQueueB, queue.size);
 			}
 		}
@@ -583,11 +599,11 @@ private:
 
 		nlohmann::json selectedCounters = nlohmann::json::object();
 		nlohmann::json selectedSources = nlohmann::json::object();
-		for (const auto& [name, packet] : step.incoming) {
-			selectedCounters[name] = packet->messageCounter();
-			selectedSources[name] = {
+		for (const auto& [client, packet] : step.incoming) {
+			selectedCounters[clientName(client)] = packet->messageCounter();
+			selectedSources[clientName(client)] = {
 				{ "counter", packet->messageCounter() },
-				{ "contribution", std::find(step.fillInClients.begin(), step.fillInClients.end(), name)
+				{ "contribution", std::find(step.fillInClients.begin(), step.fillInClients.end(), client)
 					!= step.fillInClients.end() ? "concealment" : "packet" }
 			};
 		}
@@ -598,7 +614,7 @@ private:
 			{ "selected_counters", selectedCounters },
 			{ "selected_sources", selectedSources },
 			{ "fast_forwards", fastForwardJson(step.fastForwardedClients) },
-			{ "underrun_clients", step.underrunClients }
+			{ "underrun_clients", clientNames(step.underrunClients) }
 		} });
 
 		if (step.incoming.empty()) {
@@ -611,9 +627,9 @@ private:
 		}
 		else if (step.incoming.size() == 2U) {
 			const auto a = static_cast<std::uint64_t>(
-				step.incoming.at("client-a")->messageCounter());
+				step.incoming.at(clientAId)->messageCounter());
 			const auto b = static_cast<std::uint64_t>(
-				step.incoming.at("client-b")->messageCounter());
+				step.incoming.at(clientBId)->messageCounter());
 			const auto skew = a > b ? a - b : b - a;
 			result_.maximumSourceSkew = std::max(result_.maximumSourceSkew, skew);
 			coherent = skew == 0;
@@ -632,7 +648,7 @@ private:
 	}
 
 	HoldFlushResult result_;
-	TPacketStreamBundle clients_;
+	ClientRegistry clients_;
 	std::shared_ptr<ClientState> clientA_;
 	std::shared_ptr<ClientState> clientB_;
 	ServerMixScheduler scheduler_;
@@ -847,8 +863,8 @@ class ProgressiveImpairmentScenario {
 public:
 	explicit ProgressiveImpairmentScenario(ImpairmentProfile profile)
 		: profile_(std::move(profile))
-		, clientA_(std::make_shared<ClientState>("client-a"))
-		, clientB_(std::make_shared<ClientState>("client-b"))
+		, clientA_(clients_.find(*clients_.idFor("10.0.0.1", 1001))->state)
+		, clientB_(clients_.find(*clients_.idFor("10.0.0.2", 1002))->state)
 		, scheduler_(stereoMixdown(), {
 			SERVER_INCOMING_JITTER_BUFFER,
 			SERVER_INCOMING_MAXIMUM_BUFFER,
@@ -859,8 +875,6 @@ public:
 		, events_(profile_.seed)
 	{
 		result_.profile = profile_.name;
-		clients_.emplace("client-a", clientA_);
-		clients_.emplace("client-b", clientB_);
 	}
 
 	ImpairmentRunResult run()
@@ -1062,11 +1076,11 @@ private:
 		if (!step.mix.diagnostics.empty()) {
 			throw std::runtime_error("The impairment input produced an invalid mixer diagnostic");
 		}
-		for (const auto& [name, queue] : step.queuesBefore) {
-			if (name == "client-a") {
+		for (const auto& [client, queue] : step.queuesBefore) {
+			if (client == clientAId) {
 				result_.maximumQueueA = std::max(result_.maximumQueueA, queue.size);
 			}
-			else if (name == "client-b") {
+			else if (client == clientBId) {
 				result_.maximumQueueB = std::max(result_.maximumQueueB, queue.size);
 			}
 		}
@@ -1083,11 +1097,11 @@ private:
 
 		nlohmann::json selectedCounters = nlohmann::json::object();
 		nlohmann::json selectedSources = nlohmann::json::object();
-		for (const auto& [name, packet] : step.incoming) {
-			selectedCounters[name] = packet->messageCounter();
-			selectedSources[name] = {
+		for (const auto& [client, packet] : step.incoming) {
+			selectedCounters[clientName(client)] = packet->messageCounter();
+			selectedSources[clientName(client)] = {
 				{ "counter", packet->messageCounter() },
-				{ "contribution", std::find(step.fillInClients.begin(), step.fillInClients.end(), name)
+				{ "contribution", std::find(step.fillInClients.begin(), step.fillInClients.end(), client)
 					!= step.fillInClients.end() ? "concealment" : "packet" }
 			};
 		}
@@ -1098,17 +1112,17 @@ private:
 			{ "selected_counters", selectedCounters },
 			{ "selected_sources", selectedSources },
 			{ "fast_forwards", fastForwardJson(step.fastForwardedClients) },
-			{ "underrun_clients", step.underrunClients }
+			{ "underrun_clients", clientNames(step.underrunClients) }
 		});
 
 		if (step.incoming.empty()) {
 			return;
 		}
 		for (const auto& outgoing : step.mix.outgoing) {
-			if (outgoing.targetAddress == "client-a") {
+			if (outgoing.target == clientAId) {
 				receiverA_->deliver(outgoing);
 			}
-			else if (outgoing.targetAddress == "client-b") {
+			else if (outgoing.target == clientBId) {
 				receiverB_->deliver(outgoing);
 			}
 		}
@@ -1119,9 +1133,9 @@ private:
 		}
 		else if (step.incoming.size() == 2U) {
 			const auto counterA = static_cast<std::uint64_t>(
-				step.incoming.at("client-a")->messageCounter());
+				step.incoming.at(clientAId)->messageCounter());
 			const auto counterB = static_cast<std::uint64_t>(
-				step.incoming.at("client-b")->messageCounter());
+				step.incoming.at(clientBId)->messageCounter());
 			const auto skew = counterA > counterB ? counterA - counterB : counterB - counterA;
 			result_.maximumSourceSkew = std::max(result_.maximumSourceSkew, skew);
 			coherent = skew == 0;
@@ -1144,7 +1158,7 @@ private:
 
 	ImpairmentProfile profile_;
 	ImpairmentRunResult result_;
-	TPacketStreamBundle clients_;
+	ClientRegistry clients_;
 	std::shared_ptr<ClientState> clientA_;
 	std::shared_ptr<ClientState> clientB_;
 	ServerMixScheduler scheduler_;
@@ -0,0 +1,58 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "ServerProcess.h"
+#include "VirtualClientSwarm.h"
+
+#include "gtest/gtest.h"
+
+TEST(MixSequenceTrackerTest, CountsGapsAsLost)
+{
+	MixSequenceTracker tracker;
+	tracker.received(10, 0.0);
+	tracker.received(11, 2.7);
+	tracker.received(14, 10.7);
+	EXPECT_EQ(tracker.received(), 3u);
+	EXPECT_EQ(tracker.lost(), 2u);
+	EXPECT_EQ(tracker.outOfOrder(), 0u);
+	EXPECT_DOUBLE_EQ(tracker.takeMaximumInterArrivalMs(), 8.0);
+	EXPECT_DOUBLE_EQ(tracker.takeMaximumInterArrivalMs(), 0.0);
+}
+
+TEST(MixSequenceTrackerTest, LateMixIsOutOfOrderNotLost)
+{
+	MixSequenceTracker tracker;
+	tracker.received(10, 0.0);
+	tracker.received(12, 5.0);
+	tracker.received(11, 6.0);
+	tracker.received(13, 8.0);
+	EXPECT_EQ(tracker.received(), 4u);
+	EXPECT_EQ(tracker.lost(), 1u);
+	EXPECT_EQ(tracker.outOfOrder(), 1u);
+}
+
+TEST(JitterProfileTest, KnowsNamedProfiles)
+{
+	for (const auto* name : { "none", "lan", "wifi", "mobile" }) {
+		const auto profile = JitterProfile::named(name);
+		ASSERT_TRUE(profile.has_value()) << name;
+		EXPECT_EQ(profile->name, name);
+	}
+	EXPECT_FALSE(JitterProfile::named("satellite").has_value());
+}
+
+TEST(ServerTraceFollowerTest, ExtractsServerStages)
+{
+	const std::string line = R"({"virtual_sample":0,"sequence":0,"kind":"latency_breakdown","details":{"stream":1,"packet":64,"complete":true,"total_ms":4.0,)"
+		R"("stages":[{"stage":"server_receive","time_ms":100.0,"since_previous_ms":0.0},{"stage":"server_queue_pop","time_ms":102.5,"since_previous_ms":2.5},)"
+		R"({"stage":"server_mix","time_ms":103.0,"since_previous_ms":0.5},{"stage":"server_send","time_ms":104.0,"since_previous_ms":1.0}]}})";
+	const auto sample = ServerTraceFollower::parseLine(line);
+	ASSERT_TRUE(sample.has_value());
+	EXPECT_DOUBLE_EQ(sample->serverTimeMs, 103.0);
+	EXPECT_DOUBLE_EQ(sample->mixMs, 0.5);
+	EXPECT_DOUBLE_EQ(sample->serverResidencyMs, 4.0);
+	EXPECT_FALSE(ServerTraceFollower::parseLine("not json").has_value());
+}
@@ -0,0 +1,307 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "JuceHeader.h"
+
+#include "ClientRegistry.h"
+#include "Encryption.h"
+#include "ServerPort.h"
+
+#include "ServerProcess.h"
+#include "VirtualClientSwarm.h"
+
+#include "nlohmann/json.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+namespace {
+
+struct StepReport {
+	int clients { 0 };
+	double durationSeconds { 0.0 };
+	std::optional<double> serverCpuPercent;
+	double meanLossPercent { 0.0 };
+	double maximumLossPercent { 0.0 };
+	uint64_t mixesReceived { 0 };
+	uint64_t mixesOutOfOrder { 0 };
+	double maximumInterArrivalMs { 0.0 };
+	size_t mixSamples { 0 };
+	double meanMixMs { 0.0 };
+	double p99MixMs { 0.0 };
+	double meanServerResidencyMs { 0.0 };
+};
+
+double percentile(std::vector<double> values, double fraction)
+{
+	if (values.empty()) {
+		return 0.0;
+	}
+	const auto index = static_cast<size_t>(std::ceil(fraction * static_cast<double>(values.size()))) - 1;
+	std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+	return values[index];
+}
+
+double mean(const std::vector<double>& values)
+{
+	return values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+}
+
+StepReport measureStep(VirtualClientSwarm& swarm, ServerProcess* server, ServerTraceFollower* trace, double stepSeconds)
+{
+	StepReport report;
+	report.clients = swarm.activeClients();
+
+	const auto before = swarm.snapshot();
+	const auto cpuBefore = server ? server->cpuSeconds() : std::nullopt;
+	const double startMs = Time::getMillisecondCounterHiRes();
+	if (trace) {
+		trace->readNewSamples(); // Discard what the warmup produced
+	}
+	Thread::sleep(static_cast<int>(stepSeconds * 1000.0));
+	const double endMs = Time::getMillisecondCounterHiRes();
+	const auto after = swarm.snapshot();
+	const auto cpuAfter = server ? server->cpuSeconds() : std::nullopt;
+
+	report.durationSeconds = (endMs - startMs) / 1000.0;
+	if (cpuBefore && cpuAfter && report.durationSeconds > 0.0) {
+		report.serverCpuPercent = 100.0 * (*cpuAfter - *cpuBefore) / report.durationSeconds;
+	}
+
+	std::vector<double> losses;
+	for (size_t client = 0; client < after.size() && client < before.size(); ++client) {
+		const auto received = after[client].mixesReceived - before[client].mixesReceived;
+		const auto lost = after[client].mixesLost - before[client].mixesLost;
+		losses.push_back(received + lost > 0 ? 100.0 * static_cast<double>(lost) / static_cast<double>(received + lost) : 100.0);
+		report.mixesReceived += received;
+		report.mixesOutOfOrder += after[client].mixesOutOfOrder - before[client].mixesOutOfOrder;
+		report.maximumInterArrivalMs = std::max(report.maximumInterArrivalMs, after[client].maximumInterArrivalMs);
+	}
+	report.meanLossPercent = mean(losses);
+	report.maximumLossPercent = losses.empty() ? 0.0 : *std::max_element(losses.begin(), losses.end());
+
+	if (trace) {
+		// Give the server's once-per-second trace flush a chance to catch up with the window
+		Thread::sleep(1500);
+		std::vector<double> mixTimes;
+		std::vector<double> residencies;
+		for (const auto& sample : trace->readNewSamples()) {
+			if (sample.serverTimeMs >= startMs && sample.serverTimeMs <= endMs) {
+				mixTimes.push_back(sample.mixMs);
+				if (sample.serverResidencyMs > 0.0) {
+					residencies.push_back(sample.serverResidencyMs);
+				}
+			}
+		}
+		report.mixSamples = mixTimes.size();
+		report.meanMixMs = mean(mixTimes);
+		report.p99MixMs = percentile(mixTimes, 0.99);
+		report.meanServerResidencyMs = mean(residencies);
+	}
+	return report;
+}
+
+nlohmann::json toJson(const StepReport& report, const LoadProfile& profile)
+{
+	nlohmann::json result = {
+		{ "kind", "load_step" },
+		{ "clients", report.clients },
+		{ "channels", profile.channels },
+		{ "block_size", profile.sampleBufferSize },
+		{ "sample_rate", profile.sampleRate },
+		{ "fec", profile.useFEC },
+		{ "jitter", profile.jitter.name },
+		{ "duration_s", report.durationSeconds },
+		{ "loss_mean_percent", report.meanLossPercent },
+		{ "loss_max_percent", report.maximumLossPercent },
+		{ "mixes_received", report.mixesReceived },
+		{ "mixes_out_of_order", report.mixesOutOfOrder },
+		{ "max_inter_arrival_ms", report.maximumInterArrivalMs },
+		{ "mix_samples", report.mixSamples },
+		{ "mix_mean_ms", report.meanMixMs },
+		{ "mix_p99_ms", report.p99MixMs },
+		{ "server_residency_mean_ms", report.meanServerResidencyMs }
+	};
+	result["server_cpu_percent"] = report.serverCpuPercent ? nlohmann::json(*report.serverCpuPercent) : nlohmann::json();
+	return result;
+}
+
+void printStep(const StepReport& report)
+{
+	std::cout << std::fixed << std::setprecision(2)
+		<< std::setw(8) << report.clients << " clients"
+		<< "  cpu " << (report.serverCpuPercent ? String(*report.serverCpuPercent, 1) + "%" : String("n/a"))
+		<< "  loss mean " << report.meanLossPercent << "% max " << report.maximumLossPercent << "%"
+		<< "  mix mean " << report.meanMixMs << " ms p99 " << report.p99MixMs << " ms"
+		<< "  residency " << report.meanServerResidencyMs << " ms"
+		<< "  max gap " << report.maximumInterArrivalMs << " ms" << std::endl;
+}
+
+std::vector<int> parseClientSteps(const String& value)
+{
+	std::vector<int> steps;
+	for (const auto& token : StringArray::fromTokens(value, ",", "")) {
+		const int clients = token.trim().getIntValue();
+		if (clients > 0) {
+			steps.push_back(clients);
+		}
+	}
+	std::sort(steps.begin(), steps.end());
+	return steps;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	ArgumentList arguments(argc, argv);
+	File myself(arguments.executableName);
+	String shortExeName = myself.getFileName();
+
+	ConsoleApplication app;
+	app.addHelpCommand("--help|-h", "Drives a JammerNetzServer with a swarm of headless virtual clients and reports how it scales\n\n  " + shortExeName
+		+ " (--server=<JammerNetzServer executable>|--host=<address>) [--port=<port>] [--key=<key file>] [--clients=10,50,100,200]"
+		+ " [--step-seconds=<s>] [--warmup-seconds=<s>] [--channels=<n>] [--block-size=32|64|128|256] [--sample-rate=44100|48000|88200|96000] [--fec] [--jitter=none|lan|wifi|mobile] [--seed=<n>] [--report=<jsonl file>] [--receive-threads=<n>] [--io-uring]\n\n"
+		+ "With --server the load generator starts its own server and reports its CPU load and mix cycle times,\n"
+		+ "with --host it only measures what the clients see of an already running server.\n\n", true);
+	app.addDefaultCommand({ "run", "--server=<executable>", "Run the load steps", "Use this to measure server scaling", [&](const auto& args) {
+		std::shared_ptr<MemoryBlock> cryptoKey;
+		File keyFile;
+		if (args.containsOption("--key|-k")) {
+			keyFile = args.getFileForOption("--key|-k");
+			if (!keyFile.existsAsFile() || !UDPEncryption::loadKeyfile(keyFile.getFullPathName().toStdString().c_str(), &cryptoKey)) {
+				app.fail("Failed to load crypto file from file " + keyFile.getFullPathName(), -1);
+			}
+		}
+		int serverPort = 7777;
+		if (args.containsOption("--port|-P")) {
+			const String portValue = args.getValueForOption("--port|-P");
+			if (const auto parsedPort = parseServerPort(portValue.toStdString())) {
+				serverPort = *parsedPort;
+			}
+			else {
+				app.fail("Invalid server port '" + portValue + "'", -1);
+			}
+		}
+		LoadProfile profile;
+		if (args.containsOption("--channels")) {
+			profile.channels = std::clamp(args.getValueForOption("--channels").getIntValue(), 1, 16);
+		}
+		if (args.containsOption("--block-size")) {
+			profile.sampleBufferSize = args.getValueForOption("--block-size").getIntValue();
+			if (!isSupportedSampleBufferSize(profile.sampleBufferSize)) {
+				app.fail("Invalid block size, use --block-size=32, 64, 128 or 256", -1);
+			}
+		}
+		if (args.containsOption("--sample-rate")) {
+			profile.sampleRate = args.getValueForOption("--sample-rate").getIntValue();
+			if (!isSupportedSampleRate(profile.sampleRate)) {
+				app.fail("Invalid sample rate, use --sample-rate=44100, 48000, 88200 or 96000", -1);
+			}
+		}
+		profile.useFEC = args.containsOption("--fec|-F");
+		if (args.containsOption("--jitter")) {
+			const auto jitter = JitterProfile::named(args.getValueForOption("--jitter").toStdString());
+			if (!jitter) {
+				app.fail("Unknown jitter profile, use none, lan, wifi or mobile", -1);
+			}
+			profile.jitter = *jitter;
+		}
+		const auto steps = parseClientSteps(args.containsOption("--clients") ? args.getValueForOption("--clients") : String("10,50,100,200"));
+		if (steps.empty()) {
+			app.fail("No client counts given, use --clients=10,50,100", -1);
+		}
+		// The server ignores clients beyond its registry, they would only show up as total loss
+		if (steps.back() > static_cast<int>(ClientRegistry::maximumClients)) {
+			app.fail("The server takes at most " + String(static_cast<int>(ClientRegistry::maximumClients)) + " clients, use a smaller --clients step", -1);
+		}
+		const double stepSeconds = args.containsOption("--step-seconds") ? std::max(1.0, args.getValueForOption("--step-seconds").getDoubleValue()) : 10.0;
+		const double warmupSeconds = args.containsOption("--warmup-seconds") ? std::max(0.0, args.getValueForOption("--warmup-seconds").getDoubleValue()) : 2.0;
+		const auto seed = static_cast<uint32_t>(args.containsOption("--seed") ? args.getValueForOption("--seed").getLargeIntValue() : 1);
+
+		String serverHost = "127.0.0.1";
+		std::unique_ptr<ServerProcess> server;
+		std::unique_ptr<ServerTraceFollower> trace;
+		File traceFile;
+		if (args.containsOption("--server")) {
+			const File executable = args.getFileForOption("--server");
+			traceFile = File::createTempFile(".jsonl");
+			// Sample often enough that even the first step yields a few hundred mix cycles
+			const int traceInterval = std::max(16, steps.back() / 2);
+			StringArray serverArguments { "--port=" + String(serverPort), "--latency-trace=" + traceFile.getFullPathName(), "--trace-interval=" + String(traceInterval) };
+			if (keyFile.existsAsFile()) {
+				serverArguments.add("--key=" + keyFile.getFullPathName());
+			}
+			if (profile.useFEC) {
+				serverArguments.add("--fec");
+			}
+			serverArguments.add("--block-size=" + String(profile.sampleBufferSize));
+			serverArguments.add("--sample-rate=" + String(profile.sampleRate));
+			if (args.containsOption("--receive-threads")) {
+				serverArguments.add("--receive-threads=" + args.getValueForOption("--receive-threads"));
+			}
+			if (args.containsOption("--io-uring")) {
+				serverArguments.add("--io-uring");
+			}
+			server = std::make_unique<ServerProcess>();
+			String error;
+			if (!server->launch(executable, serverArguments, error)) {
+				app.fail(error, -1);
+			}
+			trace = std::make_unique<ServerTraceFollower>(traceFile);
+			Thread::sleep(1000);
+		}
+		else if (args.containsOption("--host")) {
+			serverHost = args.getValueForOption("--host");
+		}
+		else {
+			app.fail("Specify either --server=<executable> to launch a server or --host=<address> of a running one", -1);
+		}
+
+		VirtualClientSwarm swarm(serverHost, serverPort, cryptoKey, profile, steps.back(), seed);
+		String error;
+		if (!swarm.bindSockets(error)) {
+			app.fail(error, -1);
+		}
+		swarm.start();
+
+		std::unique_ptr<FileOutputStream> reportStream;
+		if (args.containsOption("--report")) {
+			File reportFile = args.getFileForOption("--report");
+			reportFile.deleteFile();
+			reportStream = std::make_unique<FileOutputStream>(reportFile);
+		}
+
+		std::cout << "Load profile: " << profile.channels << " channels, " << profile.sampleBufferSize << " samples at "
+			<< profile.sampleRate << " Hz, FEC " << (profile.useFEC ? "on" : "off")
+			<< ", jitter " << profile.jitter.name << ", " << stepSeconds << " s per step" << std::endl;
+		for (const int clients : steps) {
+			swarm.setActiveClients(clients);
+			Thread::sleep(static_cast<int>(warmupSeconds * 1000.0));
+			if (server && !server->isRunning()) {
+				std::cerr << "Server terminated during the run" << std::endl;
+				break;
+			}
+			const auto report = measureStep(swarm, server.get(), trace.get(), stepSeconds);
+			printStep(report);
+			if (reportStream && reportStream->openedOk()) {
+				reportStream->writeText(String(toJson(report, profile).dump()) + "\n", false, false, nullptr);
+				reportStream->flush();
+			}
+		}
+
+		swarm.stop();
+		if (server) {
+			server->terminate();
+			traceFile.deleteFile();
+		}
+		return 0;
+	} });
+
+	return app.findAndRunCommand(arguments);
+}
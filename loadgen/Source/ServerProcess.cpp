@@ -0,0 +1,193 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "ServerProcess.h"
+
+#include "nlohmann/json.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#if JUCE_LINUX || JUCE_MAC
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+ServerProcess::~ServerProcess()
+{
+	terminate();
+}
+
+bool ServerProcess::launch(const juce::File& executable, const juce::StringArray& arguments, juce::String& error)
+{
+#if JUCE_LINUX || JUCE_MAC
+	std::vector<std::string> storage;
+	storage.push_back(executable.getFullPathName().toStdString());
+	for (const auto& argument : arguments) {
+		storage.push_back(argument.toStdString());
+	}
+	std::vector<char*> argv;
+	for (auto& argument : storage) {
+		argv.push_back(argument.data());
+	}
+	argv.push_back(nullptr);
+
+	// The server draws its curses status screen on stdout, keep that out of our report
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+	posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+	pid_t pid = -1;
+	const int result = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if (result != 0) {
+		error = "Could not launch " + executable.getFullPathName() + ": " + juce::String(strerror(result));
+		return false;
+	}
+	pid_ = static_cast<int>(pid);
+	return true;
+#else
+	juce::ignoreUnused(executable, arguments);
+	error = "Launching the server is only supported on Linux and macOS, start it separately and pass --port";
+	return false;
+#endif
+}
+
+void ServerProcess::terminate()
+{
+#if JUCE_LINUX || JUCE_MAC
+	if (pid_ > 0) {
+		kill(pid_, SIGTERM);
+		int status = 0;
+		waitpid(pid_, &status, 0);
+		pid_ = -1;
+	}
+#endif
+}
+
+bool ServerProcess::isRunning() const
+{
+#if JUCE_LINUX || JUCE_MAC
+	if (pid_ <= 0) {
+		return false;
+	}
+	int status = 0;
+	return waitpid(pid_, &status, WNOHANG) == 0;
+#else
+	return false;
+#endif
+}
+
+std::optional<double> ServerProcess::cpuSeconds() const
+{
+#if JUCE_LINUX
+	if (pid_ <= 0) {
+		return {};
+	}
+	std::ifstream stat("/proc/" + std::to_string(pid_) + "/stat");
+	std::string contents;
+	if (!std::getline(stat, contents)) {
+		return {};
+	}
+	// The command name in field 2 may contain spaces, so count fields after its closing parenthesis
+	const auto nameEnd = contents.rfind(')');
+	if (nameEnd == std::string::npos) {
+		return {};
+	}
+	std::istringstream fields(contents.substr(nameEnd + 2));
+	std::string field;
+	unsigned long long userTicks = 0;
+	unsigned long long systemTicks = 0;
+	// Fields 3 to 13 precede utime (14) and stime (15)
+	for (int index = 3; index <= 15 && fields >> field; ++index) {
+		if (index == 14) {
+			userTicks = std::stoull(field);
+		}
+		else if (index == 15) {
+			systemTicks = std::stoull(field);
+		}
+	}
+	const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+	if (ticksPerSecond <= 0) {
+		return {};
+	}
+	return static_cast<double>(userTicks + systemTicks) / static_cast<double>(ticksPerSecond);
+#else
+	return {};
+#endif
+}
+
+ServerTraceFollower::ServerTraceFollower(juce::File traceFile) : traceFile_(std::move(traceFile))
+{
+}
+
+std::vector<MixCycleSample> ServerTraceFollower::readNewSamples()
+{
+	std::vector<MixCycleSample> result;
+	juce::FileInputStream input(traceFile_);
+	if (!input.openedOk() || !input.setPosition(readPosition_)) {
+		return result;
+	}
+	std::string appended;
+	appended.resize(static_cast<size_t>(std::max<juce::int64>(0, input.getTotalLength() - readPosition_)));
+	const auto bytesRead = input.read(appended.data(), static_cast<int>(appended.size()));
+	if (bytesRead <= 0) {
+		return result;
+	}
+	readPosition_ += bytesRead;
+	appended.resize(static_cast<size_t>(bytesRead));
+
+	partialLine_ += appended;
+	size_t lineStart = 0;
+	for (auto lineEnd = partialLine_.find('\n'); lineEnd != std::string::npos; lineEnd = partialLine_.find('\n', lineStart)) {
+		if (auto sample = parseLine(partialLine_.substr(lineStart, lineEnd - lineStart))) {
+			result.push_back(*sample);
+		}
+		lineStart = lineEnd + 1;
+	}
+	partialLine_.erase(0, lineStart);
+	return result;
+}
+
+std::optional<MixCycleSample> ServerTraceFollower::parseLine(const std::string& line)
+{
+	const auto document = nlohmann::json::parse(line, nullptr, false);
+	if (document.is_discarded() || document.value("kind", "") != "latency_breakdown"
+		|| !document.contains("details") || !document["details"].contains("stages")) {
+		return {};
+	}
+	std::map<std::string, double> stages;
+	for (const auto& stage : document["details"]["stages"]) {
+		if (stage.contains("stage") && stage.contains("time_ms")) {
+			stages[stage["stage"].get<std::string>()] = stage["time_ms"].get<double>();
+		}
+	}
+	const auto stamp = [&stages](const char* name) -> std::optional<double> {
+		const auto found = stages.find(name);
+		return found != stages.end() ? std::optional<double>(found->second) : std::nullopt;
+	};
+	const auto popped = stamp("server_queue_pop");
+	const auto mixed = stamp("server_mix");
+	if (!popped || !mixed) {
+		return {};
+	}
+	MixCycleSample sample;
+	sample.serverTimeMs = *mixed;
+	sample.mixMs = *mixed - *popped;
+	const auto received = stamp("server_receive");
+	const auto sent = stamp("server_send");
+	if (received && sent) {
+		sample.serverResidencyMs = *sent - *received;
+	}
+	return sample;
+}
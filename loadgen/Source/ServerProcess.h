@@ -0,0 +1,56 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// A JammerNetzServer launched by the load generator. Only POSIX platforms can
+// spawn it, because CPU accounting needs the child's process id.
+class ServerProcess {
+public:
+	ServerProcess() = default;
+	~ServerProcess();
+
+	bool launch(const juce::File& executable, const juce::StringArray& arguments, juce::String& error);
+	void terminate();
+	bool isRunning() const;
+
+	// User plus system CPU time the server consumed so far, if the platform exposes it.
+	std::optional<double> cpuSeconds() const;
+
+private:
+	int pid_ { -1 };
+};
+
+struct MixCycleSample {
+	double serverTimeMs { 0.0 };
+	double mixMs { 0.0 }; // Queue pop to mix done, the work of one mix cycle
+	double serverResidencyMs { 0.0 }; // Packet received to the mix sent back
+};
+
+// Follows the latency trace the server writes with --latency-trace and extracts
+// the server-side stages. The server and the load generator run on the same
+// machine, so their Time::getMillisecondCounterHiRes() values are comparable.
+class ServerTraceFollower {
+public:
+	explicit ServerTraceFollower(juce::File traceFile);
+
+	// Reads all complete lines appended since the last call.
+	std::vector<MixCycleSample> readNewSamples();
+
+	// Exposed for tests: parses one line of the trace.
+	static std::optional<MixCycleSample> parseLine(const std::string& line);
+
+private:
+	juce::File traceFile_;
+	juce::int64 readPosition_ { 0 };
+	std::string partialLine_;
+};
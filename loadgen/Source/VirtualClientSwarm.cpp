@@ -0,0 +1,318 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "VirtualClientSwarm.h"
+
+#include "JammerNetzMessageView.h"
+#include "XPlatformUtils.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+std::optional<JitterProfile> JitterProfile::named(const std::string& name)
+{
+	if (name == "none") {
+		return JitterProfile { "none", 0.0, 0.0, 0.0, 0.0 };
+	}
+	if (name == "lan") {
+		return JitterProfile { "lan", 0.2, 0.1, 0.0, 0.0 };
+	}
+	if (name == "wifi") {
+		return JitterProfile { "wifi", 2.0, 1.5, 0.002, 30.0 };
+	}
+	if (name == "mobile") {
+		return JitterProfile { "mobile", 8.0, 5.0, 0.01, 80.0 };
+	}
+	return {};
+}
+
+void MixSequenceTracker::received(uint64_t messageCounter, double arrivalMs) noexcept
+{
+	received_.fetch_add(1, std::memory_order_relaxed);
+	if (lastCounter_) {
+		if (messageCounter > *lastCounter_ + 1) {
+			lost_.fetch_add(messageCounter - *lastCounter_ - 1, std::memory_order_relaxed);
+		}
+		else if (messageCounter <= *lastCounter_) {
+			outOfOrder_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		const double interArrival = arrivalMs - lastArrivalMs_;
+		if (interArrival > maximumInterArrivalMs_.load(std::memory_order_relaxed)) {
+			maximumInterArrivalMs_.store(interArrival, std::memory_order_relaxed);
+		}
+	}
+	lastCounter_ = messageCounter;
+	lastArrivalMs_ = arrivalMs;
+}
+
+double MixSequenceTracker::takeMaximumInterArrivalMs() noexcept
+{
+	return maximumInterArrivalMs_.exchange(0.0, std::memory_order_relaxed);
+}
+
+// Generates one packet per active client and block, and sends each one when its jittered due time arrives.
+class VirtualClientSwarm::SendThread final : public juce::Thread {
+public:
+	explicit SendThread(VirtualClientSwarm& swarm) : juce::Thread("LoadGeneratorSend"), swarm_(swarm),
+		blockDurationMs_(1000.0 * swarm.profile_.sampleBufferSize / swarm.profile_.sampleRate), random_(swarm.seed_)
+	{
+		if (swarm_.cryptoKey_ && sizet_is_safe_as_int(swarm_.cryptoKey_->getSize())) {
+			blowFish_ = std::make_unique<BlowFish>(swarm_.cryptoKey_->getData(), static_cast<int>(swarm_.cryptoKey_->getSize()));
+		}
+		audio_ = std::make_shared<AudioBuffer<float>>(swarm_.profile_.channels, swarm_.profile_.sampleBufferSize);
+		for (int channel = 0; channel < audio_->getNumChannels(); ++channel) {
+			for (int sample = 0; sample < audio_->getNumSamples(); ++sample) {
+				audio_->setSample(channel, sample, 0.1f * std::sin(static_cast<float>(sample) * 0.1f + static_cast<float>(channel)));
+			}
+		}
+		for (int channel = 0; channel < swarm_.profile_.channels; ++channel) {
+			JammerNetzSingleChannelSetup single(channel % 2 == 0 ? JammerNetzChannelTarget::Left : JammerNetzChannelTarget::Right);
+			single.name = "Load " + std::to_string(channel);
+			setup_.channels.push_back(single);
+		}
+	}
+
+	void run() override
+	{
+		if (swarm_.profile_.useFEC) {
+			nlohmann::json fecControl;
+			fecControl["FEC"] = true;
+			JammerNetzControlMessage control(fecControl);
+			size_t length = 0;
+			control.serialize(serializeBuffer_.data(), length);
+			const std::vector<uint8> datagram(serializeBuffer_.begin(), serializeBuffer_.begin() + static_cast<std::ptrdiff_t>(length));
+			for (size_t client = 0; client < swarm_.clients_.size(); ++client) {
+				send(client, datagram);
+			}
+		}
+
+		double nextBlockMs = Time::getMillisecondCounterHiRes();
+		while (!threadShouldExit()) {
+			const double now = Time::getMillisecondCounterHiRes();
+			while (now >= nextBlockMs) {
+				generateBlock(nextBlockMs);
+				nextBlockMs += blockDurationMs_;
+			}
+			while (!pending_.empty() && pending_.top().dueMs <= now) {
+				const auto& due = pending_.top();
+				send(due.client, due.datagram);
+				pending_.pop();
+			}
+			const double nextEventMs = pending_.empty() ? nextBlockMs : std::min(nextBlockMs, pending_.top().dueMs);
+			if (nextEventMs - Time::getMillisecondCounterHiRes() > 1.5) {
+				juce::Thread::sleep(1);
+			}
+			else {
+				juce::Thread::yield();
+			}
+		}
+	}
+
+private:
+	struct PendingDatagram {
+		double dueMs;
+		size_t client;
+		std::vector<uint8> datagram;
+
+		bool operator>(const PendingDatagram& other) const { return dueMs > other.dueMs; }
+	};
+
+	void generateBlock(double blockMs)
+	{
+		const auto active = static_cast<size_t>(swarm_.activeClients());
+		const auto& jitter = swarm_.profile_.jitter;
+		for (size_t client = 0; client < active && client < swarm_.clients_.size(); ++client) {
+			auto& state = *swarm_.clients_[client];
+			JammerNetzAudioData message(state.messageCounter++, blockMs, setup_, swarm_.profile_.sampleRate, 120.0f, MidiSignal_None, audio_, nullptr);
+			size_t length = 0;
+			message.serialize(serializeBuffer_.data(), length);
+			std::vector<uint8> datagram(serializeBuffer_.begin(), serializeBuffer_.begin() + static_cast<std::ptrdiff_t>(length));
+
+			double delayMs = std::max(0.0, jitter.meanDelayMs + jitter.delayStandardDeviationMs * normal_(random_));
+			if (jitter.burstProbability > 0.0 && uniform_(random_) < jitter.burstProbability) {
+				state.burstUntilMs = std::max(state.burstUntilMs, blockMs + jitter.burstDelayMs);
+			}
+			// A stalled link releases the held packets together when it recovers
+			const double dueMs = std::max(blockMs + delayMs, state.burstUntilMs);
+			pending_.push({ dueMs, client, std::move(datagram) });
+		}
+	}
+
+	void send(size_t client, const std::vector<uint8>& datagram)
+	{
+		auto& state = *swarm_.clients_[client];
+		// Encrypt a copy, the cipher pads in place and needs the full frame as headroom
+		std::copy(datagram.begin(), datagram.end(), sendBuffer_.begin());
+		int length = static_cast<int>(datagram.size());
+		if (blowFish_) {
+			length = blowFish_->encrypt(sendBuffer_.data(), datagram.size(), MAXFRAMESIZE);
+			if (length == -1) {
+				return;
+			}
+		}
+		if (state.socket->write(swarm_.serverHost_, swarm_.serverPort_, sendBuffer_.data(), length) == length) {
+			state.packetsSent.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	VirtualClientSwarm& swarm_;
+	const double blockDurationMs_;
+	std::unique_ptr<BlowFish> blowFish_;
+	std::array<uint8, MAXFRAMESIZE> serializeBuffer_ {};
+	std::array<uint8, MAXFRAMESIZE> sendBuffer_ {};
+	std::shared_ptr<AudioBuffer<float>> audio_;
+	JammerNetzChannelSetup setup_ { false };
+	std::priority_queue<PendingDatagram, std::vector<PendingDatagram>, std::greater<>> pending_;
+	std::mt19937 random_;
+	std::normal_distribution<double> normal_ { 0.0, 1.0 };
+	std::uniform_real_distribution<double> uniform_ { 0.0, 1.0 };
+};
+
+// Polls all client sockets without blocking; one thread is enough because each client only receives one mix per block.
+class VirtualClientSwarm::ReceiveThread final : public juce::Thread {
+public:
+	explicit ReceiveThread(VirtualClientSwarm& swarm) : juce::Thread("LoadGeneratorReceive"), swarm_(swarm)
+	{
+		if (swarm_.cryptoKey_ && sizet_is_safe_as_int(swarm_.cryptoKey_->getSize())) {
+			blowFish_ = std::make_unique<BlowFish>(swarm_.cryptoKey_->getData(), static_cast<int>(swarm_.cryptoKey_->getSize()));
+		}
+	}
+
+	void run() override
+	{
+		while (!threadShouldExit()) {
+			bool receivedAny = false;
+			const auto active = static_cast<size_t>(swarm_.activeClients());
+			for (size_t client = 0; client < active && client < swarm_.clients_.size(); ++client) {
+				while (receiveOne(*swarm_.clients_[client])) {
+					receivedAny = true;
+				}
+			}
+			if (!receivedAny) {
+				juce::Thread::sleep(1);
+			}
+		}
+	}
+
+private:
+	bool receiveOne(VirtualClient& client)
+	{
+		String senderAddress;
+		int senderPort = 0;
+		const int bytesRead = client.socket->read(buffer_.data(), MAXFRAMESIZE, false, senderAddress, senderPort);
+		if (bytesRead <= 0) {
+			return false;
+		}
+		const double arrivalMs = Time::getMillisecondCounterHiRes();
+		int messageLength = bytesRead;
+		if (blowFish_) {
+			messageLength = blowFish_->decrypt(buffer_.data(), safe_int_to_sizet(bytesRead));
+			if (messageLength == -1) {
+				return true;
+			}
+		}
+		// Only the counter is needed, so the mix is never copied out of the buffer
+		const auto message = decodeJammerNetzMessage(buffer_.data(), safe_int_to_sizet(messageLength));
+		if (const auto audioData = std::get_if<JammerNetzAudioDataView>(&message)) {
+			client.mixes.received(audioData->messageCounter(), arrivalMs);
+		}
+		return true;
+	}
+
+	VirtualClientSwarm& swarm_;
+	std::unique_ptr<BlowFish> blowFish_;
+	std::array<uint8, MAXFRAMESIZE> buffer_ {};
+};
+
+VirtualClientSwarm::VirtualClientSwarm(juce::String serverHost, int serverPort, std::shared_ptr<juce::MemoryBlock> cryptoKey,
+	LoadProfile profile, int maximumClients, uint32_t seed)
+	: serverHost_(std::move(serverHost)), serverPort_(serverPort), cryptoKey_(std::move(cryptoKey)),
+	profile_(std::move(profile)), seed_(seed)
+{
+	for (int i = 0; i < std::max(0, maximumClients); ++i) {
+		clients_.push_back(std::make_unique<VirtualClient>());
+	}
+}
+
+VirtualClientSwarm::~VirtualClientSwarm()
+{
+	stop();
+}
+
+bool VirtualClientSwarm::bindSockets(juce::String& error)
+{
+	for (size_t i = 0; i < clients_.size(); ++i) {
+		auto& client = *clients_[i];
+		client.socket = std::make_unique<juce::DatagramSocket>();
+		// Port 0 lets the OS pick, so the swarm never collides with a real client on 8888 and up
+		if (!client.socket->bindToPort(0, "0.0.0.0")) {
+			error = "Could not bind a UDP socket for virtual client " + String(static_cast<int>(i));
+			return false;
+		}
+	}
+	return true;
+}
+
+void VirtualClientSwarm::setActiveClients(int clients)
+{
+	activeClients_.store(std::clamp(clients, 0, maximumClients()), std::memory_order_release);
+}
+
+int VirtualClientSwarm::activeClients() const noexcept
+{
+	return activeClients_.load(std::memory_order_acquire);
+}
+
+int VirtualClientSwarm::maximumClients() const noexcept
+{
+	return static_cast<int>(clients_.size());
+}
+
+int VirtualClientSwarm::localPort(int client) const
+{
+	const auto& state = clients_.at(static_cast<size_t>(client));
+	return state->socket ? state->socket->getBoundPort() : -1;
+}
+
+void VirtualClientSwarm::start()
+{
+	receiveThread_ = std::make_unique<ReceiveThread>(*this);
+	sendThread_ = std::make_unique<SendThread>(*this);
+	receiveThread_->startThread(juce::Thread::Priority::high);
+	sendThread_->startThread(juce::Thread::Priority::highest);
+}
+
+void VirtualClientSwarm::stop()
+{
+	if (sendThread_) {
+		sendThread_->stopThread(2000);
+		sendThread_.reset();
+	}
+	if (receiveThread_) {
+		receiveThread_->stopThread(2000);
+		receiveThread_.reset();
+	}
+}
+
+std::vector<VirtualClientStats> VirtualClientSwarm::snapshot()
+{
+	std::vector<VirtualClientStats> result;
+	for (int i = 0; i < activeClients(); ++i) {
+		auto& client = *clients_[static_cast<size_t>(i)];
+		VirtualClientStats stats;
+		stats.packetsSent = client.packetsSent.load(std::memory_order_relaxed);
+		stats.mixesReceived = client.mixes.received();
+		stats.mixesLost = client.mixes.lost();
+		stats.mixesOutOfOrder = client.mixes.outOfOrder();
+		stats.maximumInterArrivalMs = client.mixes.takeMaximumInterArrivalMs();
+		result.push_back(stats);
+	}
+	return result;
+}
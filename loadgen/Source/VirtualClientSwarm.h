@@ -0,0 +1,116 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include "BuffersConfig.h"
+#include "JammerNetzPackage.h"
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+// Network timing seen by the server for a virtual client. Each packet leaves at
+// its nominal block time plus a delay drawn from a normal distribution, with
+// occasional bursts that hold back a run of packets like a stalled Wi-Fi link.
+struct JitterProfile {
+	std::string name { "none" };
+	double meanDelayMs { 0.0 };
+	double delayStandardDeviationMs { 0.0 };
+	double burstProbability { 0.0 }; // per packet
+	double burstDelayMs { 0.0 };
+
+	static std::optional<JitterProfile> named(const std::string& name);
+};
+
+struct LoadProfile {
+	int channels { 2 };
+	bool useFEC { false };
+	// Must match the session of the server, which mixes at the size and rate it was started with
+	int sampleBufferSize { SAMPLE_BUFFER_SIZE };
+	int sampleRate { SAMPLE_RATE };
+	JitterProfile jitter;
+};
+
+// Upstream and downstream counters of one virtual client, read while the swarm runs.
+struct VirtualClientStats {
+	uint64_t packetsSent { 0 };
+	uint64_t mixesReceived { 0 };
+	// Gaps in the client message counters the server echoes in its mix
+	uint64_t mixesLost { 0 };
+	uint64_t mixesOutOfOrder { 0 };
+	double maximumInterArrivalMs { 0.0 };
+};
+
+// Tracks the echoed message counters of one client's incoming mix stream.
+class MixSequenceTracker {
+public:
+	void received(uint64_t messageCounter, double arrivalMs) noexcept;
+
+	uint64_t received() const noexcept { return received_.load(std::memory_order_relaxed); }
+	uint64_t lost() const noexcept { return lost_.load(std::memory_order_relaxed); }
+	uint64_t outOfOrder() const noexcept { return outOfOrder_.load(std::memory_order_relaxed); }
+	// Largest gap between two mixes since the last call, then restarts the measurement.
+	double takeMaximumInterArrivalMs() noexcept;
+
+private:
+	std::optional<uint64_t> lastCounter_;
+	double lastArrivalMs_ { 0.0 };
+	std::atomic<uint64_t> received_ { 0 };
+	std::atomic<uint64_t> lost_ { 0 };
+	std::atomic<uint64_t> outOfOrder_ { 0 };
+	std::atomic<double> maximumInterArrivalMs_ { 0.0 };
+};
+
+// Headless packet-only clients. They speak the audio protocol like the real
+// client, but skip the audio engine, so a single process can drive hundreds of
+// streams against one server. All sockets are created up front; growing the
+// swarm only activates more of them, so running clients never see a gap.
+class VirtualClientSwarm {
+public:
+	VirtualClientSwarm(juce::String serverHost, int serverPort, std::shared_ptr<juce::MemoryBlock> cryptoKey,
+		LoadProfile profile, int maximumClients, uint32_t seed);
+	~VirtualClientSwarm();
+
+	bool bindSockets(juce::String& error);
+	void setActiveClients(int clients);
+	int activeClients() const noexcept;
+	int maximumClients() const noexcept;
+	// Local port of a client, which is the port the server sees and names the stream after.
+	int localPort(int client) const;
+
+	void start();
+	void stop();
+
+	std::vector<VirtualClientStats> snapshot();
+
+private:
+	class SendThread;
+	class ReceiveThread;
+
+	struct VirtualClient {
+		std::unique_ptr<juce::DatagramSocket> socket;
+		uint64 messageCounter { 10 }; // Same start value as Client, the server prefill expects it
+		double burstUntilMs { 0.0 };
+		std::atomic<uint64_t> packetsSent { 0 };
+		MixSequenceTracker mixes;
+	};
+
+	juce::String serverHost_;
+	int serverPort_;
+	std::shared_ptr<juce::MemoryBlock> cryptoKey_;
+	LoadProfile profile_;
+	uint32_t seed_;
+	std::vector<std::unique_ptr<VirtualClient>> clients_;
+	std::atomic<int> activeClients_ { 0 };
+	std::unique_ptr<SendThread> sendThread_;
+	std::unique_ptr<ReceiveThread> receiveThread_;
+};
@@ -0,0 +1,116 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "JuceHeader.h"
+
+#include "RecordingLog.h"
+
+#include <iostream>
+
+namespace {
+
+void printInfo(File const& file)
+{
+	RecordingLogReader reader(file);
+	if (!reader.openedOk()) {
+		std::cerr << file.getFullPathName() << ": " << reader.getError() << std::endl;
+		return;
+	}
+	const auto seconds = static_cast<double>(reader.getLengthInFrames()) / reader.getSampleRate();
+	std::cout << file.getFullPathName() << std::endl
+		<< "  " << reader.getDescription() << ", started " << reader.getStartTime().toString(true, true) << std::endl
+		<< "  " << reader.getNumChannels() << " channels, " << reader.getSampleRate() << " Hz, " << reader.getBitsPerSample() << " bit, time reference " << reader.getTimeReference() << std::endl
+		<< "  " << RelativeTime(seconds).getDescription() << " in " << reader.getNumChunks() << " chunks, " << reader.getNumCheckpoints() << " checkpoints" << std::endl;
+	if (reader.getFramesAfterLastCheckpoint() > 0) {
+		std::cout << "  " << reader.getFramesAfterLastCheckpoint() << " frames were written after the last checkpoint, the writer did not close the file" << std::endl;
+	}
+	for (const auto& dropout : reader.getDropouts()) {
+		std::cout << "  dropout at " << RelativeTime(static_cast<double>(dropout.position) / reader.getSampleRate()).getDescription()
+			<< ", " << dropout.frames << " frames of silence where the recorder could not keep up" << std::endl;
+	}
+	if (reader.getDamagedBytes() > 0) {
+		std::cout << "  " << reader.getDamagedBytes() << " bytes are damaged or incomplete and will be skipped" << std::endl;
+	}
+}
+
+bool convertFile(File const& file, String const& extension)
+{
+	const auto target = file.withFileExtension(extension);
+	const auto start = Time::getMillisecondCounterHiRes();
+	const auto result = RecordingLog::convert(file, target);
+	if (!result.ok) {
+		std::cerr << file.getFullPathName() << ": " << result.error << std::endl;
+		return false;
+	}
+	std::cout << file.getFileName() << " -> " << target.getFileName() << ": " << result.framesWritten << " frames in "
+		<< String((Time::getMillisecondCounterHiRes() - start) / 1000.0, 2) << " s";
+	if (result.framesMissing > 0) {
+		std::cout << ", " << result.framesMissing << " damaged frames replaced by silence";
+	}
+	if (result.dropouts > 0) {
+		std::cout << ", " << result.dropouts << " recording dropouts";
+	}
+	std::cout << std::endl;
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	ArgumentList arguments(argc, argv);
+	File myself(arguments.executableName);
+	String shortExeName = myself.getFileName();
+
+	ConsoleApplication app;
+	app.addHelpCommand("--help|-h", "Finalizes JammerNetz recording logs (" + String(RecordingLog::fileExtension) + "), also ones that were never closed because the recorder crashed\n\n  "
+		+ shortExeName + " [--info] [--format=wav|flac|aiff] <log file or directory>...\n\n"
+		+ "Converts every log given, or every log in the directories given, into a file next to it.\n"
+		+ "WAV files keep the time reference of the log, so the stems of a server recording stay aligned.\n\n", true);
+	app.addDefaultCommand({ "convert", "<log file or directory>", "Convert recording logs", "Use this to turn recording logs into WAV, FLAC or AIFF files", [&](const auto& args) {
+		String extension = ".wav";
+		if (args.containsOption("--format")) {
+			extension = "." + args.getValueForOption("--format").toLowerCase();
+			if (extension != ".wav" && extension != ".flac" && extension != ".aiff") {
+				app.fail("Unknown format, use --format=wav, --format=flac or --format=aiff", -1);
+			}
+		}
+		const bool infoOnly = args.containsOption("--info");
+
+		Array<File> logs;
+		for (const auto& argument : args.arguments) {
+			if (argument.isOption()) {
+				continue;
+			}
+			const auto file = argument.resolveAsFile();
+			if (file.isDirectory()) {
+				logs.addArray(file.findChildFiles(File::findFiles, false, "*" + String(RecordingLog::fileExtension)));
+			}
+			else if (file.existsAsFile()) {
+				logs.add(file);
+			}
+			else {
+				app.fail("No such file or directory: " + file.getFullPathName(), -1);
+			}
+		}
+		if (logs.isEmpty()) {
+			app.fail("No recording logs given, see --help", -1);
+		}
+
+		int failed = 0;
+		for (const auto& log : logs) {
+			if (infoOnly) {
+				printInfo(log);
+			}
+			else if (!convertFile(log, extension)) {
+				++failed;
+			}
+		}
+		return failed == 0 ? 0 : 1;
+	} });
+
+	return app.findAndRunCommand(arguments);
+}
@@ -0,0 +1,60 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local bool countAllocations = false;
+thread_local std::uint64_t countedAllocations = 0;
+} // namespace
+
+#if JAMMERNETZ_ALLOCATION_TESTS
+
+void* operator new(std::size_t size)
+{
+	if (countAllocations) {
+		++countedAllocations;
+	}
+	if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	if (countAllocations) {
+		++countedAllocations;
+	}
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+#endif
+
+namespace jammernetz::test {
+
+AllocationCounter::AllocationCounter()
+{
+	countedAllocations = 0;
+	countAllocations = true;
+}
+
+AllocationCounter::~AllocationCounter()
+{
+	countAllocations = false;
+}
+
+std::uint64_t AllocationCounter::allocations() const noexcept
+{
+	return countedAllocations;
+}
+
+} // namespace jammernetz::test
@@ -0,0 +1,33 @@
+/*
+   Copyright (c) 2026 Christof Ruch. All rights reserved.
+
+   Dual licensed: Distributed under Affero GPL license by default, an MIT license is available for purchase
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#ifndef JAMMERNETZ_ALLOCATION_TESTS
+#define JAMMERNETZ_ALLOCATION_TESTS 0
+#endif
+
+namespace jammernetz::test {
+
+// Counts the heap allocations of the current thread while alive. Only when built with the CMake option
+// JAMMERNETZ_ALLOCATION_TESTS, which replaces the global operator new of the test binaries linking
+// JammerNetzAllocationCounter. Without it nothing is counted, and the tests skip their allocation checks.
+class AllocationCounter {
+public:
+	static constexpr bool enabled = JAMMERNETZ_ALLOCATION_TESTS != 0;
+
+	AllocationCounter();
+	~AllocationCounter();
+
+	AllocationCounter(AllocationCounter const &) = delete;
+	AllocationCounter &operator=(AllocationCounter const &) = delete;
+
+	[[nodiscard]] std::uint64_t allocations() const noexcept;
+};
+
+} // namespace jammernetz::test